@@ -0,0 +1,148 @@
+/**
+ * Copyright (c) 2021 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file cached-filter.hpp
+ *
+ * Filter wrapper with tabulated weights.
+ */
+
+#ifndef imgproc_cached_filter_hpp_included_
+#define imgproc_cached_filter_hpp_included_
+
+#include <cmath>
+#include <vector>
+
+#include "detail/separable.hpp"
+
+namespace imgproc {
+
+/** Wraps any Filter2 (anything providing operator()(x, y), halfwinx() and
+ *  halfwiny()) and replaces filter evaluation with table lookup. Filter is
+ *  sampled with 1 / Phases pixel resolution, i.e. reconstruction positions
+ *  are quantized to Phases subpixel phases per axis.
+ *
+ *  Separable filters are stored as two 1D tables (f(x, 0) and f(0, y) /
+ *  f(0, 0)), other filters as one 2D table unless it would be larger than
+ *  MaxTable2 samples; in that case filter is evaluated directly. Arguments
+ *  outside the table (more than ceil(halfwin) + 1 pixels from center) are
+ *  always evaluated directly.
+ *
+ *  Tables are built in constructor: create cached filter once and reuse it
+ *  for many reconstructions, e.g.:
+ *
+ *      const CachedFilter2<math::SincHamming2> filter
+ *          (math::SincHamming2(2.0, 2.0));
+ *      for (...) { value = reconstruct(raster, filter, pos); }
+ *
+ *  Do not use as LowPassFilter2 in transform() which creates filter for each
+ *  pixel.
+ */
+template <typename Filter2, int Phases = 64>
+class CachedFilter2 {
+public:
+    /** Maximum number of samples of non-separable filter table.
+     */
+    static constexpr std::size_t MaxTable2 = 1 << 20;
+
+    explicit CachedFilter2(const Filter2 &filter);
+
+    double halfwinx() const { return filter_.halfwinx(); }
+    double halfwiny() const { return filter_.halfwiny(); }
+
+    double operator()(double x, double y) const;
+
+    const Filter2& filter() const { return filter_; }
+
+    bool separable() const { return separable_; }
+
+private:
+    /** Table index of given argument, -1 if outside table.
+     */
+    static int index(double value, int base, int size) {
+        const int i(std::floor((value + base) * Phases + 0.5));
+        return ((i >= 0) && (i < size)) ? i : -1;
+    }
+
+    Filter2 filter_;
+    bool separable_;
+    int baseX_, baseY_;
+    int sizeX_, sizeY_;
+    std::vector<double> x_;
+    std::vector<double> y_;
+    std::vector<double> xy_;
+};
+
+// inlines
+
+template <typename Filter2, int Phases>
+constexpr std::size_t CachedFilter2<Filter2, Phases>::MaxTable2;
+
+template <typename Filter2, int Phases>
+CachedFilter2<Filter2, Phases>::CachedFilter2(const Filter2 &filter)
+    : filter_(filter), separable_(detail::separable(filter))
+    , baseX_(std::ceil(filter.halfwinx()) + 1)
+    , baseY_(std::ceil(filter.halfwiny()) + 1)
+    , sizeX_(2 * baseX_ * Phases + 1), sizeY_(2 * baseY_ * Phases + 1)
+{
+    const auto x([&](int i) { return double(i) / Phases - baseX_; });
+    const auto y([&](int j) { return double(j) / Phases - baseY_; });
+
+    if (separable_) {
+        const double center(filter_(0.0, 0.0));
+        x_.resize(sizeX_);
+        y_.resize(sizeY_);
+        for (int i(0); i < sizeX_; ++i) { x_[i] = filter_(x(i), 0.0); }
+        for (int j(0); j < sizeY_; ++j) {
+            y_[j] = filter_(0.0, y(j)) / center;
+        }
+        return;
+    }
+
+    if ((std::size_t(sizeX_) * sizeY_) > MaxTable2) { return; }
+
+    xy_.resize(std::size_t(sizeX_) * sizeY_);
+    auto *v(xy_.data());
+    for (int j(0); j < sizeY_; ++j) {
+        for (int i(0); i < sizeX_; ++i) { *v++ = filter_(x(i), y(j)); }
+    }
+}
+
+template <typename Filter2, int Phases>
+inline double CachedFilter2<Filter2, Phases>::operator()(double x, double y)
+    const
+{
+    const int i(index(x, baseX_, sizeX_));
+    const int j(index(y, baseY_, sizeY_));
+    if ((i < 0) || (j < 0)) { return filter_(x, y); }
+
+    if (separable_) { return x_[i] * y_[j]; }
+    if (xy_.empty()) { return filter_(x, y); }
+    return xy_[std::size_t(j) * sizeX_ + i];
+}
+
+} // namespace imgproc
+
+#endif // imgproc_cached_filter_hpp_included_
@@ -29,20 +29,85 @@
 
 #include <stdexcept>
 
-
 #include "clahe.hpp"
 
 #include <dbglog/dbglog.hpp>
-#include <math/math_all.hpp>
+#include <utility/openmp.hpp>
 
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
-//#include <opencv2/highgui/highgui.hpp>
 
 #include "detail/clahe.hpp"
 
 namespace imgproc {
 
+namespace {
+
+/** Runs equalizer over the image band by band. Only luminance of two bands
+ *  is kept for colour images, memory use does not grow with image height.
+ */
+template <typename T>
+void equalize(const cv::Mat &src, cv::Mat &dst, int regionSize, int bins
+              , float clipLimit)
+{
+    const bool color(src.channels() == 3);
+    const int type(src.depth());
+
+    detail::clahe::Equalizer<T> eq(src.cols, src.rows, regionSize, bins
+                                   , clipLimit);
+
+    // luminance of last two bands (colour images only)
+    cv::Mat ring[2];
+
+    auto luminance([&](int y) -> const T*
+    {
+        if (!color) { return src.ptr<T>(y); }
+        return ring[(y / regionSize) % 2].ptr<T>(y % regionSize);
+    });
+
+    for (int k(0); k <= eq.bands(); ++k) {
+        if (k < eq.bands()) {
+            const auto band(eq.band(k));
+            if (color) {
+                cv::Mat ycc;
+                cv::cvtColor(src.rowRange(band.first, band.second), ycc
+                             , cv::COLOR_RGB2YCrCb);
+                cv::extractChannel(ycc, ring[k % 2], 0);
+                eq.map(k, ring[k % 2].ptr<T>(), ring[k % 2].step1());
+            } else {
+                eq.map(k, src.ptr<T>(band.first), src.step1());
+            }
+        }
+
+        const auto stripe(eq.stripe(k));
+        if (stripe.first >= stripe.second) { continue; }
+
+        if (!color) {
+            UTILITY_OMP(parallel for)
+            for (int y = stripe.first; y < stripe.second; ++y) {
+                eq.interpolate(y, luminance(y), dst.ptr<T>(y));
+            }
+            continue;
+        }
+
+        cv::Mat ycc;
+        cv::cvtColor(src.rowRange(stripe.first, stripe.second), ycc
+                     , cv::COLOR_RGB2YCrCb);
+        cv::Mat y(stripe.second - stripe.first, src.cols, type);
+
+        UTILITY_OMP(parallel for)
+        for (int j = stripe.first; j < stripe.second; ++j) {
+            eq.interpolate(j, luminance(j), y.ptr<T>(j - stripe.first));
+        }
+
+        cv::insertChannel(y, ycc, 0);
+        cv::Mat out(dst.rowRange(stripe.first, stripe.second));
+        cv::cvtColor(ycc, out, cv::COLOR_YCrCb2RGB);
+    }
+}
+
+} // namespace
+
 void CLAHE( const cv::Mat & src, cv::Mat & dst, const int regionSize,
             float clipLimit ) {
 
@@ -51,90 +116,36 @@ void CLAHE( const cv::Mat & src, cv::Mat & dst, const int regionSize,
             << "CLAHE: Empty input image.";
     }
 
-    cv::Mat srcsc, rawscn, dstsc;
-    std::vector<cv::Mat> srcsplit;
-    
     if ( src.type() != CV_8UC1 && src.type() != CV_16UC1
         && src.type() != CV_8UC3 && src.type() != CV_16UC3 )
         LOGTHROW( err2, std::runtime_error ) << "CLAHE does not support "
             " image type " << src.type() << ".";
 
-    // convert channels
-    if ( src.type() == CV_8UC1 || src.type() == CV_16UC1 ) {
-        
-        srcsc = src;
-    }
-
-    if ( src.type() == CV_8UC3 || src.type() == CV_16UC3 ) {
-
-        cv::Mat srcluv;
-        
-        cvtColor( src, srcluv, cv::COLOR_RGB2YCrCb );
-
-        split( srcluv, srcsplit );
-
-        srcsc = srcsplit[0];        
-    }
-
-    // convert dimensions
-    int divx = (int) ceil( (float) srcsc.cols / regionSize );
-    int divy = (int) ceil( (float) srcsc.rows / regionSize );
-    
-    rawscn.create( divy * regionSize, divx * regionSize, srcsc.type() );
-    rawscn.setTo(cv::Scalar::all(0));
-    
-    srcsc.copyTo(
-        rawscn( cv::Rect( 0, 0, srcsc.cols, srcsc.rows ) ) );
-    
-    // clahe
-    int retval( -1 );
-    
-    if ( src.depth() == CV_8U ) {
-        
-        retval = detail::CLAHE<unsigned char>(
-            reinterpret_cast<unsigned char *>( rawscn.data ),
-            rawscn.cols, rawscn.rows,
-            0, 0xff, divx, divy, 0x100, clipLimit );
+    if (regionSize < 1) {
+        LOGTHROW(err2, std::runtime_error)
+            << "CLAHE: Invalid region size " << regionSize << ".";
     }
 
-    if ( src.depth() == CV_16U ) {
-
-        retval = detail::CLAHE<unsigned short>(
-            reinterpret_cast<unsigned short *>( rawscn.data ),
-            rawscn.cols, rawscn.rows,
-            0, 0xffff, divx, divy, std::min( 0x10000, math::sqr( regionSize ) ), clipLimit );
+    if (clipLimit == 1.0) {
+        // no-op
+        if (dst.data != src.data) { src.copyTo(dst); }
+        return;
     }
 
-    if ( retval != 0 ) {
+    // output must not reallocate source when processing in place
+    dst.create(src.rows, src.cols, src.type());
 
-        LOGTHROW( err2, std::runtime_error ) << "CLAHE returned error code "
-            << retval << ". See imgproc/detail/clahe.hpp for details.";
-    }
-    
-    // convert dimensions
-    dstsc.create( srcsc.rows, srcsc.cols, srcsc.type() );
-    rawscn.rowRange( 0, srcsc.rows ).colRange( 0, srcsc.cols ).copyTo( dstsc );
-    
-    // convert channels
-    if ( src.type() == CV_8UC1 || src.type() == CV_16UC1 ) {
-
-        dst = dstsc;
+    if ( src.depth() == CV_8U ) {
+        equalize<unsigned char>(src, dst, regionSize, 0x100, clipLimit);
+    } else {
+        equalize<unsigned short>
+            (src, dst, regionSize
+             , std::min<long long>(0x10000
+                                   , (long long)(regionSize) * regionSize)
+             , clipLimit);
     }
 
-    if ( src.type() == CV_8UC3 || src.type() == CV_16UC3 ) {
-
-        cv::Mat dstluv;
-        
-        srcsplit[0] = dstsc;
-
-        merge( srcsplit, dstluv );
-    
-        cvtColor( dstluv, dst, cv::COLOR_YCrCb2RGB );
-    }
-    
     // done
 }
 
-
-
 } // namespace imgproc
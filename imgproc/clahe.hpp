@@ -46,7 +46,13 @@ namespace imgproc {
  * contrast limiting and result in the standard AHE algorithm. The input
  * image can be of type CV_8UC1, CV_8UC3, CV_16UC1 or CV_16UC3. If a 3 channel
  * image is supplied, CLAHE is applied to the intensity channel only and
- * chromatic information is left untouched. */
+ * chromatic information is left untouched.
+ *
+ * Image size need not be a multiple of regionSize, regions at the right and
+ * bottom edges are partial. The image is processed in bands of regionSize
+ * rows (region histograms are built in parallel), memory use therefore
+ * does not grow with image height. Processing in place (dst == src) is
+ * supported. */
 void CLAHE( const cv::Mat & src, cv::Mat & dst, const int regionSize,
             float clipLimit = -1.0 );
 
@@ -27,25 +27,20 @@
 #include <bitset>
 #include <map>
 #include <list>
+#include <deque>
 #include <algorithm>
 #include <limits>
-
-#include <boost/multi_index_container.hpp>
-#include <boost/multi_index/ordered_index.hpp>
-#include <boost/multi_index/identity.hpp>
-#include <boost/multi_index/member.hpp>
-#include <boost/multi_index/mem_fun.hpp>
+#include <cstdint>
 
 #include "dbglog/dbglog.hpp"
 
 #include "math/geometry.hpp"
 
 #include "utility/streams.hpp"
+#include "utility/openmp.hpp"
 
 #include "contours.hpp"
 
-namespace bmi = boost::multi_index;
-
 namespace imgproc {
 
 namespace {
@@ -113,24 +108,125 @@ struct Segment {
     {}
 };
 
-struct StartIdx {};
-struct EndIdx {};
-
-typedef boost::multi_index_container<
-    Segment
-    , bmi::indexed_by<
-          bmi::ordered_unique<
-              bmi::tag<StartIdx>
-              , BOOST_MULTI_INDEX_MEMBER
-              (Segment, decltype(Segment::start), start)
-              >
-          , bmi::ordered_unique<
-                bmi::tag<EndIdx>
-                , BOOST_MULTI_INDEX_MEMBER
-                (Segment, decltype(Segment::end), end)
-                >
-          >
-    > SegmentMap;
+/** Segment storage. Deque keeps segments at stable addresses.
+ */
+typedef std::deque<Segment> Segments;
+
+/** Vertex -> segment map. Flat open-addressing hash table with linear
+ *  probing. Entries are removed by backward shift deletion (entries
+ *  following the hole in its probe cluster are moved back), therefore no
+ *  tombstones are needed and lookups stop at the first empty slot.
+ */
+class VertexIndex {
+public:
+    struct Slot {
+        std::uint64_t key;
+        const Segment *segment;
+    };
+
+    VertexIndex() : shift_(64), size_() {}
+
+    const Segment* find(const Vertex &v) const {
+        if (slots_.empty()) { return nullptr; }
+
+        const auto k(key(v));
+        for (auto i(hash(k)); ; i = (i + 1) & mask()) {
+            const auto &slot(slots_[i]);
+            if (!slot.segment) { return nullptr; }
+            if (slot.key == k) { return slot.segment; }
+        }
+    }
+
+    /** Returns slot occupied by given vertex or empty slot where vertex
+     *  belongs. Room for one new entry is ensured beforehand, empty slot is
+     *  occupied by set().
+     */
+    Slot& slot(const Vertex &v) {
+        if (2 * (size_ + 1) > slots_.size()) { grow(); }
+
+        const auto k(key(v));
+        for (auto i(hash(k)); ; i = (i + 1) & mask()) {
+            auto &slot(slots_[i]);
+            if (!slot.segment) {
+                slot.key = k;
+                return slot;
+            }
+            if (slot.key == k) { return slot; }
+        }
+    }
+
+    void set(Slot &slot, const Segment *segment) {
+        slot.segment = segment;
+        ++size_;
+    }
+
+    /** Removes vertex from index (backward shift deletion, no tombstones).
+     */
+    void erase(const Vertex &v) {
+        if (slots_.empty()) { return; }
+
+        const auto k(key(v));
+        auto i(hash(k));
+        for (; ; i = (i + 1) & mask()) {
+            if (!slots_[i].segment) { return; }
+            if (slots_[i].key == k) { break; }
+        }
+
+        // move following entries of the same cluster to the hole unless
+        // their home slot lies cyclically in (hole, entry]
+        for (auto j((i + 1) & mask()); slots_[j].segment
+                 ; j = (j + 1) & mask())
+        {
+            const auto home(hash(slots_[j].key));
+            if ((i <= j) ? ((i < home) && (home <= j))
+                : ((i < home) || (home <= j)))
+            {
+                continue;
+            }
+            slots_[i] = slots_[j];
+            i = j;
+        }
+
+        slots_[i].segment = nullptr;
+        --size_;
+    }
+
+private:
+    static std::uint64_t key(const Vertex &v) {
+        return ((std::uint64_t(std::uint32_t(v(0))) << 32)
+                | std::uint32_t(v(1)));
+    }
+
+    std::size_t hash(std::uint64_t key) const {
+        // Fibonacci hashing: top bits of multiplied key
+        return std::size_t((key * 0x9e3779b97f4a7c15ull) >> shift_);
+    }
+
+    std::size_t mask() const { return slots_.size() - 1; }
+
+    void grow() {
+        std::vector<Slot> old(slots_.size() ? (2 * slots_.size()) : 1024
+                              , Slot{0, nullptr});
+        std::swap(old, slots_);
+
+        shift_ = 64;
+        for (auto size(slots_.size()); size > 1; size >>= 1) { --shift_; }
+
+        for (const auto &slot : old) {
+            if (!slot.segment) { continue; }
+            for (auto i(hash(slot.key)); ; i = (i + 1) & mask()) {
+                if (!slots_[i].segment) {
+                    slots_[i] = slot;
+                    break;
+                }
+            }
+        }
+    }
+
+    std::vector<Slot> slots_;
+    int shift_;
+    std::size_t size_;
+};
 
 inline void distributeRingLeaderPrev(const Segment *s)
 {
@@ -158,20 +254,52 @@ struct Builder {
         : params(&params), contour(rasterSize)
         , offset(params.pixelOrigin == PixelOrigin::center
                  ? math::Point2d() : math::Point2d(0.5, 0.5))
+        , origin(0, 0), streaming(false)
+    {}
+
+    struct StreamingTag {};
+
+    /** Streaming builder: border is not computed and segments of extracted
+     *  rings are recycled.
+     */
+    Builder(const ContourParameters &params, StreamingTag)
+        : params(&params), contour(math::Size2(0, 0))
+        , offset(params.pixelOrigin == PixelOrigin::center
+                 ? math::Point2d() : math::Point2d(0.5, 0.5))
+        , origin(0, 0), streaming(true)
+    {}
+
+    /** Tile builder: only cells inside given extents are to be added. Border
+     *  covers only pixels touched by these cells.
+     */
+    Builder(const math::Size2 &rasterSize, const math::Extents2i &cells
+            , const ContourParameters &params)
+        : params(&params)
+        , contour(tileBorderSize(rasterSize, cells))
+        , offset(params.pixelOrigin == PixelOrigin::center
+                 ? math::Point2d() : math::Point2d(0.5, 0.5))
+        , origin(std::max(cells.ll(0), 0), std::max(cells.ll(1), 0))
+        , streaming(false)
     {}
 
-    template <typename Index>
-    const Segment* find(Index &idx, const Vertex &v) {
-        auto fidx(idx.find(v));
-        return ((fidx == idx.end()) ? nullptr : &*fidx);
+    static math::Size2 tileBorderSize(const math::Size2 &rasterSize
+                                      , const math::Extents2i &cells)
+    {
+        // cell (x, y) touches pixels x..x+1, y..y+1
+        const auto ox(std::max(cells.ll(0), 0));
+        const auto oy(std::max(cells.ll(1), 0));
+        return math::Size2
+            (std::max(std::min(cells.ur(0) + 1, rasterSize.width) - ox, 0)
+             , std::max(std::min(cells.ur(1) + 1, rasterSize.height) - oy
+                        , 0));
     }
 
     const Segment* findByStart(const Vertex &v) {
-        return find(segments.get<StartIdx>(), v);
+        return byStart.find(v);
     }
 
     const Segment* findByEnd(const Vertex &v) {
-        return find(segments.get<EndIdx>(), v);
+        return byEnd.find(v);
     }
 
     void addSegment(CellType type, Direction direction, int i, int j
@@ -186,18 +314,43 @@ struct Builder {
 
     void extract(const Segment *head);
 
+    /** Returns segments of extracted ring for reuse (streaming only).
+     */
+    void recycle(const Segment *head);
+
+    /** Number of segments in use.
+     */
+    std::size_t live() const { return segments.size() - unused.size(); }
+
     void setBorder(CellType type, int i, int j);
 
     const ContourParameters *params;
-    SegmentMap segments;
+    Segments segments;
+    VertexIndex byStart;
+    VertexIndex byEnd;
     Contour contour;
     math::Point2d offset;
     MultiRingKeystones multiKeystones;
+
+    /** Position of contour.border in raster.
+     */
+    math::Point2i origin;
+
+    /** Streaming mode: no border, recycle segments.
+     */
+    bool streaming;
+
+    /** Recycled segments.
+     */
+    std::vector<Segment*> unused;
 };
 
 void Builder::setBorder(CellType type, int i, int j)
 {
-#define SET_BORDER(X, Y) contour.border.set(i + X, j + Y)
+    if (streaming) { return; }
+
+#define SET_BORDER(X, Y)                                        \
+    contour.border.set(i + X - origin(0), j + Y - origin(1))
 
     switch (type) {
     case b0000: return;
@@ -247,9 +400,26 @@ void Builder::addSegment(CellType type, Direction direction, int i, int j
     auto *prev(findByEnd(start));
     auto *next(findByStart(end));
 
-    const auto &s
-        (*segments.insert(Segment(type, direction, start, end
-                                  , prev, next, keystone)).first);
+    // insert segment unless there is already one with the same start or end
+    auto &startSlot(byStart.slot(start));
+    auto &endSlot(byEnd.slot(end));
+    const Segment *existing(startSlot.segment ? startSlot.segment
+                            : endSlot.segment);
+    if (!existing) {
+        const Segment segment(type, direction, start, end, prev, next
+                              , keystone);
+        if (unused.empty()) {
+            segments.push_back(segment);
+            existing = &segments.back();
+        } else {
+            *unused.back() = segment;
+            existing = unused.back();
+            unused.pop_back();
+        }
+        byStart.set(startSlot, existing);
+        byEnd.set(endSlot, existing);
+    }
+    const auto &s(*existing);
 
     // LOG(info4) << "Segment " << s.start << " -> " << s.end << "> " << &s;
 
@@ -295,9 +465,25 @@ void Builder::addSegment(CellType type, Direction direction, int i, int j
 
         // new ringLeader, extract contour
         extract(pRingLeader);
+
+        // ring is complete, its vertices cannot be reached anymore
+        if (streaming) { recycle(pRingLeader); }
     }
 }
 
+void Builder::recycle(const Segment *head)
+{
+    const auto *s(head);
+    do {
+        const auto *next(s->next);
+        byStart.erase(s->start);
+        byEnd.erase(s->end);
+        // segment storage is owned by this builder
+        unused.push_back(const_cast<Segment*>(s));
+        s = next;
+    } while (s != head);
+}
+
 #define ADD_SEGMENT(D, X1, Y1, X2, Y2)                         \
     addSegment(type, Direction::D, i, j                        \
                , { x + X1, y + Y1 }, { x + X2, y + Y2 })
@@ -727,6 +913,170 @@ private:
 
 } // namespace
 
+namespace {
+
+/** Simplifies rings (if configured) and steals contour from builder.
+ */
+Contour finish(Builder &builder, const ContourParameters &params)
+{
+    if (params.simplification == ChainSimplification::rdp) {
+        // simplify rings
+        auto imultiKeystones(builder.multiKeystones.begin());
+        for (auto &ring : builder.contour.rings) {
+            ring = RDP(ring, *imultiKeystones++, params.rdpMaxError)();
+        }
+    }
+
+    // steal contour
+    return std::move(builder.contour);
+}
+
+/** Merges tile border into raster border. Tile origin must be aligned to
+ *  bitfield word.
+ */
+void mergeBorder(Contour::Border &border, const Contour::Border &tile
+                 , const math::Point2i &origin)
+{
+    const auto offset(origin(0) / Contour::Border::WordBits);
+    const auto &size(tile.dims());
+    if (!size.width) { return; }
+
+    const auto words(std::min(tile.stride(), border.stride() - offset));
+    for (int j(0); j < size.height; ++j) {
+        const auto *src(tile.row(j));
+        auto *dst(border.row(origin(1) + j) + offset);
+        for (std::size_t i(0); i < words; ++i) { dst[i] |= src[i]; }
+    }
+}
+
+/** Stitches all tiles into output builder. Rings closed inside tiles are
+ *  moved as is, open chains ending at tile seams are linked together and
+ *  extracted as rings by the output builder.
+ */
+void stitch(Builder &out, const std::vector<Builder*> &tiles)
+{
+    typedef std::map<Vertex, const Segment*> SegmentIndex;
+    SegmentIndex heads;
+    std::vector<const Segment*> tails;
+
+    for (auto *tile : tiles) {
+        mergeBorder(out.contour.border, tile->contour.border, tile->origin);
+
+        // closed rings
+        auto &rings(out.contour.rings);
+        rings.insert(rings.end()
+                     , std::make_move_iterator(tile->contour.rings.begin())
+                     , std::make_move_iterator(tile->contour.rings.end()));
+        auto &keystones(out.multiKeystones);
+        keystones.insert(keystones.end()
+                         , std::make_move_iterator
+                         (tile->multiKeystones.begin())
+                         , std::make_move_iterator
+                         (tile->multiKeystones.end()));
+
+        // open chains
+        for (const auto &s : tile->segments) {
+            if (!s.prev) {
+                heads.insert(SegmentIndex::value_type(s.start, &s));
+                // reset ring leader in whole chain
+                for (const auto *c(&s); c; c = c->next) {
+                    c->ringLeader = nullptr;
+                }
+            }
+            if (!s.next) { tails.push_back(&s); }
+        }
+    }
+
+    out.contour.border.recount();
+
+    // link chains across seams
+    for (const auto *tail : tails) {
+        auto fheads(heads.find(tail->end));
+        if (fheads == heads.end()) {
+            LOGTHROW(err1, std::runtime_error)
+                << "Contour chain ending at " << tail->end
+                << " has no continuation in neighbouring tile.";
+        }
+        tail->next = fheads->second;
+        fheads->second->prev = tail;
+    }
+
+    // extract stitched rings
+    for (const auto &item : heads) {
+        const auto *head(item.second);
+        if (head->ringLeader) { continue; }
+
+        const auto *s(head);
+        do {
+            s->ringLeader = head;
+            s = s->next;
+        } while (s != head);
+
+        out.extract(head);
+    }
+}
+
+/** Feeds multi-color cell to per-color builders. Cells is per-color cell
+ *  type storage.
+ */
+void feedCell(std::vector<Builder> &builders, std::vector<CellType> &cells
+              , int x, int y, int ul, int ur, int lr, int ll)
+{
+    const int colors(builders.size());
+
+    const auto cellValue([&](int c) -> CellType
+    {
+        return ((ul == c) << 3 | (ur == c) << 2 | (lr == c) << 1 | (ll == c));
+    });
+
+    // compute cell value for all cells and count non-zero cells (i.e. number of
+    // different areas meeting in this cell)
+    int cardinality(0);
+    for (int c(0); c < colors; ++c) {
+        cardinality += bool((cells[c] = cellValue(c)));
+    }
+    // virtual areas for invalid pixels (<0) and border pixels (>= colors)
+    cardinality += ((ul < 0) || (ur < 0) || (lr < 0) || (ll < 0));
+    cardinality += ((ul >= colors) || (ur  >= colors)
+                    || (lr  >= colors) || (ll  >= colors));
+
+    CellType ambiguous(0);
+
+    auto icells(cells.begin());
+    if (cardinality > 2) {
+        // more than two areas meet at this place, use 90 degree connection
+        for (auto &builder : builders) {
+            builder.add(x, y, *icells++, ambiguous);
+        }
+    } else {
+        // use mitre connections
+        for (auto &builder : builders) {
+            builder.addMitre(x, y, *icells++, ambiguous);
+        }
+    }
+}
+
+} // namespace
+
+std::vector<math::Extents2i> contourTiles(const math::Size2 &rasterSize
+                                          , int tileSize)
+{
+    // align tiles to bitfield words
+    const int align(Contour::Border::WordBits);
+    tileSize = std::max(((tileSize + align - 1) / align) * align, align);
+
+    std::vector<math::Extents2i> tiles;
+    for (int y(0); y < rasterSize.height; y += tileSize) {
+        for (int x(0); x < rasterSize.width; x += tileSize) {
+            // first tile includes cells left/above raster
+            tiles.emplace_back(x ? x : -1, y ? y : -1
+                               , std::min(x + tileSize, rasterSize.width)
+                               , std::min(y + tileSize, rasterSize.height));
+        }
+    }
+    return tiles;
+}
+
 struct FindContours::Impl {
     Impl(const math::Size2 &rasterSize, int colorCount
          , const ContourParameters &params)
@@ -734,7 +1084,17 @@ struct FindContours::Impl {
         , cells(colors)
     {
         for (int i(0); i < colors; ++i) {
-            builders.emplace_back(size, params);
+            builders.emplace_back(size, this->params);
+        }
+    }
+
+    Impl(const math::Size2 &rasterSize, const math::Extents2i &tile
+         , int colorCount, const ContourParameters &params)
+        : size(rasterSize), colors(colorCount), params(params)
+        , cells(colors)
+    {
+        for (int i(0); i < colors; ++i) {
+            builders.emplace_back(size, tile, this->params);
         }
     }
 
@@ -755,6 +1115,16 @@ FindContours::FindContours(const math::Size2 &rasterSize, int colorCount
     : impl_(new Impl(rasterSize, colorCount, params))
 {}
 
+FindContours::FindContours(const math::Size2 &rasterSize
+                           , const math::Extents2i &cells, int colorCount
+                           , const ContourParameters &params)
+    : impl_(new Impl(rasterSize, cells, colorCount, params))
+{}
+
+FindContours::FindContours(FindContours &&other)
+    : impl_(std::move(other.impl_))
+{}
+
 FindContours::~FindContours() {}
 
 void FindContours::operator()(int x, int y, int ul, int ur, int lr, int ll)
@@ -767,66 +1137,209 @@ const math::Size2 FindContours::rasterSize() const {
 }
 
 Contour::list FindContours::contours() {
-    if (impl_->params.simplification == ChainSimplification::rdp) {
-        // simplify rings
-        for (auto &builder : impl_->builders) {
-            auto imultiKeystones(builder.multiKeystones.begin());
-            for (auto &ring : builder.contour.rings) {
-                ring = RDP(ring, *imultiKeystones++
-                           , impl_->params.rdpMaxError)();
-            }
-        }
+    Contour::list contours;
+    for (auto &builder : impl_->builders) {
+        contours.push_back(finish(builder, impl_->params));
     }
+    return contours;
+}
+
+Contour::list FindContours::contours(std::vector<FindContours> &tiles)
+{
+    if (tiles.empty()) { return {}; }
+
+    const auto &impl(*tiles.front().impl_);
 
-    // steal contours
     Contour::list contours;
-    for (auto &builder : impl_->builders) {
-        contours.push_back(std::move(builder.contour));
+    for (int c(0); c < impl.colors; ++c) {
+        std::vector<Builder*> builders;
+        for (auto &tile : tiles) {
+            builders.push_back(&tile.impl_->builders[c]);
+        }
+
+        Builder out(impl.size, impl.params);
+        stitch(out, builders);
+        contours.push_back(finish(out, impl.params));
     }
     return contours;
 }
 
 void FindContours::Impl::feed(int x, int y, int ul, int ur, int lr, int ll)
 {
-    const auto cellValue([&](int c) -> CellType
+    feedCell(builders, cells, x, y, ul, ur, lr, ll);
+}
+
+struct ContourStream::Impl {
+    Impl(int width, int colorCount, const RingSink &sink
+         , const ContourParameters &params)
+        : width(width), colors(colorCount), sink(sink), params(params)
+        , rows(0), finished(false), cells(colors)
+        , upper(width + 2), lower(width + 2)
     {
-        return ((ul == c) << 3 | (ur == c) << 2 | (lr == c) << 1 | (ll == c));
-    });
+        for (int i(0); i < colors; ++i) {
+            builders.emplace_back(this->params, Builder::StreamingTag());
+        }
 
-    // compute cell value for all cells and count non-zero cells (i.e. number of
-    // different areas meeting in this cell)
-    int cardinality(0);
+        // virtual row above raster
+        virtualRow(lower);
+    }
+
+    /** Row outside raster: corners are invalid (-1), the rest is border.
+     */
+    void virtualRow(std::vector<int> &row) {
+        std::fill(row.begin(), row.end(), colors);
+        row.front() = row.back() = -1;
+    }
+
+    /** Feeds all cells between upper and lower rows, y is index of upper
+     *  row, then emits closed rings.
+     */
+    void feed(int y);
+
+    void emit();
+
+    const int width;
+    const int colors;
+    const RingSink sink;
+    const ContourParameters params;
+
+    int rows;
+    bool finished;
+
+    std::vector<CellType> cells;
+    std::vector<Builder> builders;
+
+    /** Rows padded by one border pixel on both sides.
+     */
+    std::vector<int> upper;
+    std::vector<int> lower;
+};
+
+void ContourStream::Impl::feed(int y)
+{
+    const auto *u(upper.data());
+    const auto *l(lower.data());
+    for (int i(-1); i < width; ++i, ++u, ++l) {
+        feedCell(builders, cells, i, y, u[0], u[1], l[1], l[0]);
+    }
+
+    emit();
+}
+
+void ContourStream::Impl::emit()
+{
     for (int c(0); c < colors; ++c) {
-        cardinality += bool((cells[c] = cellValue(c)));
+        auto &builder(builders[c]);
+        auto &rings(builder.contour.rings);
+        if (rings.empty()) { continue; }
+
+        auto imultiKeystones(builder.multiKeystones.begin());
+        for (auto &ring : rings) {
+            if (params.simplification == ChainSimplification::rdp) {
+                ring = RDP(ring, *imultiKeystones, params.rdpMaxError)();
+            }
+            ++imultiKeystones;
+            sink(c, std::move(ring));
+        }
+
+        rings.clear();
+        builder.multiKeystones.clear();
     }
-    // virtual areas for invalid pixels (<0) and border pixels (>= colors)
-    cardinality += ((ul < 0) || (ur < 0) || (lr < 0) || (ll < 0));
-    cardinality += ((ul >= colors) || (ur  >= colors)
-                    || (lr  >= colors) || (ll  >= colors));
+}
 
-    CellType ambiguous(0);
+ContourStream::ContourStream(int rasterWidth, int colorCount
+                             , const RingSink &sink
+                             , const ContourParameters &params)
+    : impl_(new Impl(rasterWidth, colorCount, sink, params))
+{}
 
-    auto icells(cells.begin());
-    if (cardinality > 2) {
-        // more than two areas meet at this place, use 90 degree connection
-        for (auto &builder : builders) {
-            builder.add(x, y, *icells++, ambiguous);
+ContourStream::~ContourStream() {}
+
+void ContourStream::feedRow(const int *row)
+{
+    auto &impl(*impl_);
+    if (impl.finished) {
+        LOGTHROW(err1, std::logic_error)
+            << "Cannot feed row into finished contour stream.";
+    }
+
+    // previous lower row becomes upper row
+    std::swap(impl.upper, impl.lower);
+    impl.lower.front() = impl.lower.back() = impl.colors;
+    std::copy(row, row + impl.width, impl.lower.begin() + 1);
+
+    impl.feed(impl.rows - 1);
+    ++impl.rows;
+}
+
+void ContourStream::finish()
+{
+    auto &impl(*impl_);
+    if (impl.finished) { return; }
+    impl.finished = true;
+    if (!impl.rows) { return; }
+
+    // virtual row below raster
+    std::swap(impl.upper, impl.lower);
+    impl.virtualRow(impl.lower);
+    impl.feed(impl.rows - 1);
+
+    for (const auto &builder : impl.builders) {
+        if (builder.live()) {
+            LOGTHROW(err1, std::runtime_error)
+                << "Contour stream finished with " << builder.live()
+                << " segment(s) of unclosed rings.";
         }
-    } else {
-        // use mitre connections
-        for (auto &builder : builders) {
-            builder.addMitre(x, y, *icells++, ambiguous);
+    }
+}
+
+int ContourStream::rows() const
+{
+    return impl_->rows;
+}
+
+namespace {
+
+/** Finds type of first (in row-major order) ambiguous cell, i.e. cell with
+ *  diagonal pixels set (b0101 or b1010). Returns 0 if there is none.
+ */
+CellType firstAmbiguous(const Contour::Raster &raster)
+{
+    typedef Contour::Raster::Word Word;
+    const auto stride(raster.stride());
+
+    for (int j(0), je(raster.dims().height - 1); j < je; ++j) {
+        const auto *top(raster.row(j));
+        const auto *bottom(raster.row(j + 1));
+        for (std::size_t k(0); k < stride; ++k) {
+            // pixels in cell: ul = a, ur = a1, ll = b, lr = b1
+            const Word a(top[k]);
+            const Word b(bottom[k]);
+            const Word a1((a >> 1) | ((k + 1 < stride) ? top[k + 1] << 63
+                                      : Word(0)));
+            const Word b1((b >> 1) | ((k + 1 < stride) ? bottom[k + 1] << 63
+                                      : Word(0)));
+
+            // ul != ur, ul != ll, ul == lr; zero padding never matches
+            auto bits((a ^ a1) & (a ^ b) & ~(a ^ b1));
+            if (!bits) { continue; }
+
+            int i(0);
+            for (; !(bits & 1); bits >>= 1) { ++i; }
+            return ((a >> i) & 1) ? b1010 : b0101;
         }
     }
+
+    return 0;
 }
 
-Contour findContour(const Contour::Raster &raster
-                    , const ContourParameters &params)
+/** Adds all cells inside given extents to builder.
+ */
+void build(Builder &cb, const Contour::Raster &raster
+           , const math::Extents2i &cells, CellType ambiguous)
 {
     const auto size(raster.dims());
 
-    Builder cb(size, params);
-
     const auto getFlags([&](int x, int y) -> CellType
     {
         return (CellType(raster.get(x, y + 1))
@@ -835,45 +1348,64 @@ Contour findContour(const Contour::Raster &raster
                 | CellType((raster.get(x, y)) << 3));
     });
 
-    CellType dummy(0);
+#define ADD_MITRE(x, y) cb.addMitre(x, y, getFlags(x, y), ambiguous)
+#define ADD(x, y) cb.add(x, y, getFlags(x, y), ambiguous)
 
-#define ADD_MITRE(x, y) cb.addMitre(x, y, getFlags(x, y), dummy)
-#define ADD(x, y) cb.add(x, y, getFlags(x, y), dummy)
+    const int xend(size.width - 1);
+    const int yend(size.height - 1);
 
-    int xend(size.width - 1);
-    int yend(size.height - 1);
+    // cells in first row, last row and last column use 90 degree
+    // connections, all other cells use mitre connections
+    const int ie(std::min(cells.ur(0), xend));
+    for (int j(cells.ll(1)); j < cells.ur(1); ++j) {
+        if ((j < 0) || (j == yend)) {
+            for (int i(cells.ll(0)); i < cells.ur(0); ++i) { ADD(i, j); }
+            continue;
+        }
 
-    // first row
-    for (int i(-1); i <= xend; ++i) { ADD(i, -1); }
+        for (int i(cells.ll(0)); i < ie; ++i) { ADD_MITRE(i, j); }
+        if (cells.ur(0) > xend) { ADD(xend, j); }
+    }
 
-    // all inner rows
-    for (int j(0); j < yend; ++j) {
-        // first column
-        ADD_MITRE(-1, j);
+#undef ADD_MITRE
+#undef ADD
+}
 
-        // all inner columns
-        for (int i(0); i < xend; ++i) { ADD_MITRE(i, j); }
+} // namespace
+
+Contour findContour(const Contour::Raster &raster
+                    , const ContourParameters &params)
+{
+    const auto size(raster.dims());
 
-        // last column
-        ADD(xend, j);
+    if (!params.tileSize) {
+        Builder cb(size, params);
+        build(cb, raster, math::Extents2i(-1, -1, size.width, size.height)
+              , 0);
+        return finish(cb, params);
     }
 
-    // last row
-    for (int i(-1); i <= xend; ++i) { ADD(i, yend); }
+    // ambiguous cells are resolved consistently by the type of first
+    // ambiguous cell, find it upfront to have the same result in all tiles
+    const auto ambiguous(firstAmbiguous(raster));
 
-#undef ADD_MITRE
-#undef ADD
+    const auto tiles(contourTiles(size, params.tileSize));
+    std::vector<Builder> builders;
+    builders.reserve(tiles.size());
+    for (const auto &tile : tiles) { builders.emplace_back(size, tile, params); }
 
-    if (params.simplification == ChainSimplification::rdp) {
-        // simplify rings
-        auto imultiKeystones(cb.multiKeystones.begin());
-        for (auto &ring : cb.contour.rings) {
-            ring = RDP(ring, *imultiKeystones++, params.rdpMaxError)();
-        }
+    const int count(tiles.size());
+    UTILITY_OMP(parallel for schedule(dynamic))
+    for (int t = 0; t < count; ++t) {
+        build(builders[t], raster, tiles[t], ambiguous);
     }
 
-    // steal contour
-    return std::move(cb.contour);
+    std::vector<Builder*> pointers;
+    for (auto &builder : builders) { pointers.push_back(&builder); }
+
+    Builder cb(size, params);
+    stitch(cb, pointers);
+    return finish(cb, params);
 }
 
 } // namespace imgproc
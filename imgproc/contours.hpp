@@ -30,8 +30,10 @@
 #include <memory>
 #include <vector>
 #include <array>
+#include <functional>
 
 #include "utility/enum-io.hpp"
+#include "utility/openmp.hpp"
 
 #include "math/geometry_core.hpp"
 #include "math/geometry.hpp"
@@ -90,14 +92,25 @@ struct ContourParameters {
      */
     double rdpMaxError;
 
+    /** Tiled processing: raster is split into tiles of given size (in pixels,
+     *  rounded up to multiple of 64) that are processed in parallel. Chains
+     *  crossing tile seams are stitched afterwards. Zero disables tiling.
+     *
+     *  Output contains the same rings (with the same orientation) as
+     *  non-tiled processing, only the order of rings and ring starting
+     *  vertices may differ.
+     */
+    int tileSize;
+
     ContourParameters()
         : pixelOrigin(PixelOrigin::center)
         , simplification(ChainSimplification::simple)
-        , rdpMaxError(0.9)
+        , rdpMaxError(0.9), tileSize()
     {}
 
     ContourParameters(PixelOrigin pixelOrigin)
         : pixelOrigin(pixelOrigin), simplification(ChainSimplification::simple)
+        , rdpMaxError(0.9), tileSize()
     {}
 
     ContourParameters& setPixelOrigin(PixelOrigin pixelOrigin) {
@@ -111,6 +124,10 @@ struct ContourParameters {
     ContourParameters& setRdpMaxError(double rdpMaxError) {
         this->rdpMaxError = rdpMaxError; return *this;
     }
+
+    ContourParameters& setTileSize(int tileSize) {
+        this->tileSize = tileSize; return *this;
+    }
 };
 
 /** Find region contrours in const raster. Region is defined by pixels for wich
@@ -150,6 +167,17 @@ class FindContours {
 public:
     FindContours(const math::Size2 &rasterSize, int colorCount
                  , const ContourParameters &params = ContourParameters());
+
+    /** Tile contour finder: only cells inside given cell extents (see
+     *  contourTiles()) are fed in. Contours from all tiles are obtained by
+     *  FindContours::contours(tiles).
+     */
+    FindContours(const math::Size2 &rasterSize, const math::Extents2i &cells
+                 , int colorCount
+                 , const ContourParameters &params = ContourParameters());
+
+    FindContours(FindContours &&other);
+
     ~FindContours();
 
     /** Feed contour finder with value at given cell.
@@ -160,18 +188,85 @@ public:
 
     Contour::list contours();
 
+    /** Stitches contours from tile contour finders covering whole raster.
+     */
+    static Contour::list contours(std::vector<FindContours> &tiles);
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+/** Streaming contour finder. Raster is fed row by row from top to bottom
+ *  (e.g. directly from an image decoder) and rings are passed to the sink as
+ *  soon as they are closed (checked after each row). Only two raster rows and
+ *  segments of not yet closed rings are held in memory, therefore rasters
+ *  larger than available memory can be processed.
+ *
+ *  Pixel values have the same meaning as in FindContours: colors are
+ *  0..colorCount-1, negative values (invalid pixels) and values >= colorCount
+ *  form virtual areas.
+ *
+ *  NB: Border masks are not computed and ContourParameters::tileSize is
+ *  ignored in streaming mode.
+ */
+class ContourStream {
+public:
+    /** Receives color index and closed ring.
+     */
+    typedef std::function<void(int color, Contour::Ring &&ring)> RingSink;
+
+    ContourStream(int rasterWidth, int colorCount, const RingSink &sink
+                  , const ContourParameters &params = ContourParameters());
+    ~ContourStream();
+
+    /** Feeds next raster row (rasterWidth values).
+     */
+    void feedRow(const int *row);
+
+    /** Finishes contour finding: closes all rings at the bottom edge of the
+     *  raster. No row can be fed afterwards.
+     */
+    void finish();
+
+    /** Number of rows fed so far.
+     */
+    int rows() const;
+
 private:
     struct Impl;
     std::unique_ptr<Impl> impl_;
 };
 
-/** Helper function for whole raster feed.
+/** Helper function for whole raster feed. Raster is processed in parallel
+ *  tiles if params.tileSize is set.
  */
 template <typename ConstRaster>
 Contour::list findContours(const ConstRaster &raster, int colorCount
                            , const ContourParameters &params
                            = ContourParameters());
 
+/** Splits raster into tiles for tiled contour finding. Returns extents of
+ *  cells (cell (x, y) spans pixels x..x+1, y..y+1) processed by each tile;
+ *  all tiles cover cells from (-1, -1) to raster size (exclusive).
+ *
+ * \param rasterSize size of raster
+ * \param tileSize tile size in pixels, rounded up to multiple of 64
+ * \return list of tiles
+ */
+std::vector<math::Extents2i> contourTiles(const math::Size2 &rasterSize
+                                          , int tileSize);
+
+namespace detail {
+
+/** Feeds contour finder with all cells inside given cell extents.
+ */
+template <typename ConstRaster>
+void feedContours(FindContours &fc, const ConstRaster &raster, int colorCount
+                  , const math::Extents2i &cells);
+
+} // namespace detail
+
 // inlines
 
 template <typename ConstRaster, typename Threshold>
@@ -181,56 +276,60 @@ Contour findContour(const ConstRaster &raster, const Threshold &threshold
     return findContour(bitfield::fromRaster(raster, threshold), params);
 }
 
+template <typename ConstRaster>
+void detail::feedContours(FindContours &fc, const ConstRaster &raster
+                          , int colorCount, const math::Extents2i &cells)
+{
+    const auto size(raster.size());
+
+    // pixels outside raster: colorCount if outside in one direction, -1 if
+    // outside in both directions (i.e. beyond raster corner)
+    const auto value([&](int x, int y) -> int
+    {
+        const bool xout((x < 0) || (x >= size.width));
+        const bool yout((y < 0) || (y >= size.height));
+        if (xout) { return yout ? -1 : colorCount; }
+        if (yout) { return colorCount; }
+        return raster(x, y)[0];
+    });
+
+    for (int j(cells.ll(1)); j < cells.ur(1); ++j) {
+        for (int i(cells.ll(0)); i < cells.ur(0); ++i) {
+            fc(i, j, value(i, j), value(i + 1, j)
+               , value(i + 1, j + 1), value(i, j + 1));
+        }
+    }
+}
+
 template <typename ConstRaster>
 Contour::list findContours(const ConstRaster &raster, int colorCount
                            , const ContourParameters &params)
 {
     const auto size(raster.size());
-    auto xend(size.width - 1);
-    auto yend(size.height - 1);
-
-    FindContours fc(size, colorCount, params);
-
-    // first row
-    // first column
-    fc(-1, -1, -1, colorCount
-       , raster(0, 0)[0], colorCount);
-    for (int i(0); i < xend; ++i) {
-        fc(i, -1, colorCount, colorCount
-           , raster(i + 1, 0)[0], raster(i, 0)[0]);
+
+    if (!params.tileSize) {
+        FindContours fc(size, colorCount, params);
+        detail::feedContours(fc, raster, colorCount
+                             , math::Extents2i(-1, -1, size.width
+                                               , size.height));
+        return fc.contours();
     }
-    // last column
-    fc(xend, -1, colorCount, -1
-       , colorCount, raster(xend, 0)[0]);
-
-    for (int j(0); j < yend; ++j) {
-        // first column
-        fc(-1, j, colorCount, raster(0, j)[0]
-           , raster(0, j + 1)[0], colorCount);
-
-        for (int i(0); i < xend; ++i) {
-            fc(i, j, raster(i, j)[0], raster(i + 1, j)[0]
-               , raster(i + 1, j + 1)[0], raster(i, j + 1)[0]);
-        }
 
-        // last column
-        fc(xend, j, raster(xend, j)[0], colorCount
-           , colorCount, raster(xend, j + 1)[0]);
+    const auto tiles(contourTiles(size, params.tileSize));
+
+    std::vector<FindContours> finders;
+    finders.reserve(tiles.size());
+    for (const auto &tile : tiles) {
+        finders.emplace_back(size, tile, colorCount, params);
     }
 
-    // last row
-    // first column
-    fc(-1, yend, colorCount, raster(0, yend)[0]
-       , colorCount, -1);
-    for (int i(0); i < xend; ++i) {
-        fc(i, yend, raster(i, yend)[0], raster(i + 1, yend)[0]
-           , colorCount, colorCount);
+    const int count(tiles.size());
+    UTILITY_OMP(parallel for schedule(dynamic))
+    for (int t = 0; t < count; ++t) {
+        detail::feedContours(finders[t], raster, colorCount, tiles[t]);
     }
-    // last column
-    fc(xend, yend, raster(xend, yend)[0], colorCount
-       , -1, colorCount);
 
-    return fc.contours();
+    return FindContours::contours(finders);
 }
 
 } // namespace imgproc
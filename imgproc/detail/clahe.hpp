@@ -23,379 +23,360 @@
  * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
  * POSSIBILITY OF SUCH DAMAGE.
  */
-// *****************************************************************************
-/*
- * ANSI C code from the article
- * "Contrast Limited Adaptive Histogram Equalization"
- * by Karel Zuiderveld, karel@cv.ruu.nl
- * in "Graphics Gems IV", Academic Press, 1994
- *
- *
- *  These functions implement Contrast Limited Adaptive Histogram Equalization.
- *  The main routine (CLAHE) expects an input image that is stored contiguously in
- *  memory;  the CLAHE output image overwrites the original input image and has the
- *  same minimum and maximum values (which must be provided by the user).
- *  This implementation assumes that the X- and Y image resolutions are an integer
- *  multiple of the X- and Y sizes of the contextual regions. A check on various other
- *  error conditions is performed.
+/**
+ * @file detail/clahe.hpp
  *
- *  #define the symbol BYTE_IMAGE to make this implementation suitable for
- *  8-bit images. The maximum number of contextual regions can be redefined
- *  by changing uiMAX_REG_X and/or uiMAX_REG_Y; the use of more than 256
- *  contextual regions is not recommended.
+ * Contrast-limited adaptive histogram equalization engine.
  *
- *  The code is ANSI-C and is also C++ compliant.
+ * Greylevel mapping of each contextual region follows Karel Zuiderveld's
+ * "Contrast Limited Adaptive Histogram Equalization" (Graphics Gems IV,
+ * 1994), including the IAC fix of the excess redistribution loop, and
+ * output pixels are bilinearly interpolated between the mappings of four
+ * surrounding regions.
  *
- *  Author: Karel Zuiderveld, Computer Vision Research Group,
- *           Utrecht, The Netherlands (karel@cv.ruu.nl)
+ * The image is processed in horizontal bands, one row of regions at a time:
+ * mappings of a band are computed (regions in parallel) as soon as its
+ * pixels are available and only the mappings of two bands are kept, since
+ * every output row lies between two region centers. The image size does not
+ * have to be a multiple of the region size: regions at the right and bottom
+ * edge are partial and their histograms are built from the pixels inside
+ * the image only.
  */
 
-/*
+#ifndef imgproc_detail_clahe_hpp_included_
+#define imgproc_detail_clahe_hpp_included_
 
-EULA: The Graphics Gems code is copyright-protected. In other words, you cannot
-claim the text of the code as your own and resell it. Using the code is permitted
-in any program, product, or library, non-commercial or commercial. Giving credit
-is not required, though is a nice gesture. The code comes as-is, and if there are
-any flaws or problems with any Gems code, nobody involved with Gems - authors,
-editors, publishers, or webmasters - are to be held responsible. Basically,
-don't be a jerk, and remember that anything free comes with no guarantee.
+#include <cstdint>
+#include <vector>
+#include <limits>
+#include <algorithm>
 
-- http://tog.acm.org/resources/GraphicsGems/ (August 2009)
+#include "utility/openmp.hpp"
 
-*/
+namespace imgproc { namespace detail { namespace clahe {
 
-#include <cstring>
-#include <limits>
-#include <iostream>
+typedef std::uint32_t Count;
 
-namespace imgproc {
+/** Clips histogram at given limit and redistributes excess pixels equally
+ *  across all bins (not exceeding the limit).
+ */
+inline void clip(Count *hist, int bins, Count limit)
+{
+    std::int64_t excess(0);
+    for (int i(0); i < bins; ++i) {
+        if (hist[i] > limit) { excess += hist[i] - limit; }
+    }
 
-namespace detail {
+    // average increment; bins above upper are set to limit
+    const Count incr(excess / bins);
+    const Count upper(limit - incr);
+
+    for (int i(0); i < bins; ++i) {
+        if (hist[i] > limit) {
+            hist[i] = limit;
+        } else if (hist[i] > upper) {
+            excess -= hist[i] - upper;
+            hist[i] = limit;
+        } else {
+            excess -= incr;
+            hist[i] += incr;
+        }
+    }
 
-/*********************** Local prototypes ************************/
-static void ClipHistogram (unsigned long*, unsigned int, unsigned long);
+    // redistribute the rest; stop when nothing could be redistributed in
+    // the last pass
+    std::int64_t old;
+    do {
+        old = excess;
+        for (int start(0); (excess > 0) && (start < bins); ++start) {
+            const int step(std::max<std::int64_t>(bins / excess, 1));
+            for (int i(start); (i < bins) && (excess > 0); i += step) {
+                if (hist[i] < limit) {
+                    ++hist[i];
+                    --excess;
+                }
+            }
+        }
+    } while ((excess > 0) && (excess < old));
+}
 
-template <class kz_pixel_t>
-static void MakeHistogram (kz_pixel_t*, unsigned int, unsigned int, unsigned int,
-                unsigned long*, unsigned int, kz_pixel_t*);
+/** Contrast-limited histogram equalization of an image of T pixels in
+ *  [0, std::numeric_limits<T>::max()].
+ */
+template <typename T>
+class Equalizer {
+public:
+    /** Sets up equalizer for an image of given size.
+     *
+     * \param width image width
+     * \param height image height
+     * \param regionSize size of contextual region
+     * \param bins number of histogram bins
+     * \param clipLimit normalized clip limit; no limit if not positive
+     */
+    Equalizer(int width, int height, int regionSize, int bins
+              , float clipLimit);
 
-template <class kz_pixel_t>
-static void MapHistogram (unsigned long*, kz_pixel_t, kz_pixel_t,
-               unsigned int, unsigned long);
+    /** Number of region rows (bands).
+     */
+    int bands() const { return ny_; }
 
-template <class kz_pixel_t>
-static void MakeLut (kz_pixel_t*, kz_pixel_t, kz_pixel_t, unsigned int);
+    /** Rows [first, last) of given band.
+     */
+    std::pair<int, int> band(int index) const;
 
-template <class kz_pixel_t>
-static void Interpolate (kz_pixel_t*, int, unsigned long*, unsigned long*,
-        unsigned long*, unsigned long*, unsigned int, unsigned int, kz_pixel_t*);
+    /** Output rows [first, last) that can be interpolated once given band
+     *  has been mapped (and the band before it is still available). Indices
+     *  run in [0, bands()], the last stripe needs no new band.
+     */
+    std::pair<int, int> stripe(int index) const;
+
+    /** Computes mappings of all regions in given band. Bands must be mapped
+     *  in order.
+     *
+     * \param index band index
+     * \param data first pixel of the band
+     * \param step row step (in pixels)
+     */
+    void map(int index, const T *data, std::size_t step);
 
-// *****************************************************************************
+    /** Interpolates one output row.
+     *
+     * \param y row index
+     * \param src source row
+     * \param dst destination row (can be the same as src)
+     */
+    void interpolate(int y, const T *src, T *dst) const;
 
-/**************  Start of actual code **************/
-#include <stdlib.h>                      /* To get prototypes of malloc() and free() */
+private:
+    /** Computes mapping of one region.
+     */
+    void region(const T *data, std::size_t step, int width, int height
+                , T *map, std::vector<Count> &work) const;
 
-const static unsigned int uiMAX_REG_X = 1024;      /* max. # contextual regions in x-direction */
-const static unsigned int uiMAX_REG_Y = 1024;      /* max. # contextual regions in y-direction */
+    /** Interpolates pixels [0, n) of one segment starting at the center of
+     *  left region column. Acc must hold max() * regionSize^2.
+     */
+    template <typename Acc>
+    void segment(const T *src, T *dst, int n
+                 , const T *lu, const T *ru, const T *lb, const T *rb
+                 , int wu, int wb) const;
+
+    int width_;
+    int height_;
+    int size_;
+    int bins_;
+    float clipLimit_;
+
+    /** Number of regions.
+     */
+    int nx_;
+    int ny_;
 
-/************************** main function CLAHE ******************/
+    /** Region center offset.
+     */
+    int half_;
 
+    /** log2(regionSize^2) if it is a power of two, -1 otherwise.
+     */
+    int shift_;
 
-template <class kz_pixel_t>
-static int CLAHE (kz_pixel_t* pImage, unsigned int uiXRes, unsigned int uiYRes,
-         kz_pixel_t Min, kz_pixel_t Max, unsigned int uiNrX, unsigned int uiNrY,
-              unsigned int uiNrBins, float fCliplimit)
-/*   pImage - Pointer to the input/output image
- *   uiXRes - Image resolution in the X direction
- *   uiYRes - Image resolution in the Y direction
- *   Min - Minimum greyvalue of input image (also becomes minimum of output image)
- *   Max - Maximum greyvalue of input image (also becomes maximum of output image)
- *   uiNrX - Number of contextial regions in the X direction (min 2, max uiMAX_REG_X)
- *   uiNrY - Number of contextial regions in the Y direction (min 2, max uiMAX_REG_Y)
- *   uiNrBins - Number of greybins for histogram ("dynamic range")
- *   float fCliplimit - Normalized cliplimit (higher values give more contrast)
- * The number of "effective" greylevels in the output image is set by uiNrBins; selecting
- * a small value (eg. 128) speeds up processing and still produce an output image of
- * good quality. The output image will have the same minimum and maximum value as the input
- * image. A clip limit smaller than 1 results in standard (non-contrast limited) AHE.
- */
+    /** Blending needs 64-bit accumulator.
+     */
+    bool wide_;
+
+    /** Pixel value -> histogram bin.
+     */
+    std::vector<std::uint16_t> lut_;
+
+    /** Mappings of two region rows (bins_ values per region).
+     */
+    std::vector<T> maps_[2];
+};
+
+// implementation
+
+template <typename T>
+Equalizer<T>::Equalizer(int width, int height, int regionSize, int bins
+                        , float clipLimit)
+    : width_(width), height_(height), size_(regionSize), bins_(bins)
+    , clipLimit_(clipLimit)
+    , nx_((width + regionSize - 1) / regionSize)
+    , ny_((height + regionSize - 1) / regionSize)
+    , half_(regionSize / 2)
+    , shift_(-1)
+    , wide_((std::uint64_t(std::numeric_limits<T>::max()) * regionSize
+             * regionSize) >> 32)
+    , lut_(std::size_t(std::numeric_limits<T>::max()) + 1)
 {
-    unsigned int uiX, uiY;                /* counters */
-    unsigned int uiXSize, uiYSize, uiSubX, uiSubY; /* size of context. reg. and subimages */
-    unsigned int uiXL, uiXR, uiYU, uiYB;  /* auxiliary variables interpolation routine */
-    unsigned long ulClipLimit, ulNrPixels;/* clip limit and region pixel count */
-    kz_pixel_t* pImPointer;                /* pointer to image */
-    kz_pixel_t aLUT[ std::numeric_limits<kz_pixel_t>::max() + 1];
-                                          /* lookup table used for scaling of input image */
-    unsigned long* pulHist, *pulMapArray; /* pointer to histogram and mappings*/
-    unsigned long* pulLU, *pulLB, *pulRU, *pulRB; /* auxiliary pointers interpolation */
-
-    if (uiNrX > uiMAX_REG_X) return -1;    /* # of regions x-direction too large */
-    if (uiNrY > uiMAX_REG_Y) return -2;    /* # of regions y-direction too large */
-    if (uiXRes % uiNrX) return -3;        /* x-resolution no multiple of uiNrX */
-    if (uiYRes % uiNrY) return -4;        /* y-resolution no multiple of uiNrY #TPB FIX */
-    if (Min >= Max) return -6;            /* minimum equal or larger than maximum */
-    if (uiNrX < 2 || uiNrY < 2) return -7;/* at least 4 contextual regions required */
-    if (fCliplimit == 1.0) return 0;      /* is OK, immediately returns original image. */
-    if (uiNrBins == 0) uiNrBins = 128;    /* default value when not specified */
-
-    pulMapArray=(unsigned long *)malloc(sizeof(unsigned long)*uiNrX*uiNrY*uiNrBins);
-    if (pulMapArray == 0) return -8;      /* Not enough memory! (try reducing uiNrBins) */
-
-    uiXSize = uiXRes/uiNrX; uiYSize = uiYRes/uiNrY;  /* Actual size of contextual regions */
-    ulNrPixels = (unsigned long)uiXSize * (unsigned long)uiYSize;
-
-    if(fCliplimit > 0.0) {                /* Calculate actual cliplimit  */
-       ulClipLimit = (unsigned long) (fCliplimit * (uiXSize * uiYSize) / uiNrBins);
-       ulClipLimit = (ulClipLimit < 1UL) ? 1UL : ulClipLimit;
-    }
-    else ulClipLimit = 1UL<<14;           /* Large value, do not clip (AHE) */
-    MakeLut<kz_pixel_t>(aLUT, Min, Max, uiNrBins);    /* Make lookup table for mapping of greyvalues */
-    /* Calculate greylevel mappings for each contextual region */
-    for (uiY = 0, pImPointer = pImage; uiY < uiNrY; uiY++) {
-        for (uiX = 0; uiX < uiNrX; uiX++, pImPointer += uiXSize) {
-            pulHist = &pulMapArray[uiNrBins * (uiY * uiNrX + uiX)];
-            MakeHistogram<kz_pixel_t>(pImPointer,uiXRes,uiXSize,uiYSize,pulHist,uiNrBins,aLUT);
-            ClipHistogram(pulHist, uiNrBins, ulClipLimit);
-            MapHistogram<kz_pixel_t>(pulHist, Min, Max, uiNrBins, ulNrPixels);
-        }
-        pImPointer += (uiYSize - 1) * uiXRes;             /* skip lines, set pointer */
-    }
+    const int max(std::numeric_limits<T>::max());
+    const int binSize(1 + max / bins_);
+    for (int i(0); i <= max; ++i) { lut_[i] = i / binSize; }
 
-    /* Interpolate greylevel mappings to get CLAHE image */
-    for (pImPointer = pImage, uiY = 0; uiY <= uiNrY; uiY++) {
-        if (uiY == 0) {                                   /* special case: top row */
-            uiSubY = uiYSize >> 1;  uiYU = 0; uiYB = 0;
-        }
-        else {
-            if (uiY == uiNrY) {                           /* special case: bottom row */
-                uiSubY = uiYSize >> 1;  uiYU = uiNrY-1;  uiYB = uiYU;
-            }
-            else {                                        /* default values */
-                uiSubY = uiYSize; uiYU = uiY - 1; uiYB = uiYU + 1;
-            }
-        }
-        for (uiX = 0; uiX <= uiNrX; uiX++) {
-            if (uiX == 0) {                               /* special case: left column */
-                uiSubX = uiXSize >> 1; uiXL = 0; uiXR = 0;
-            }
-            else {
-                if (uiX == uiNrX) {                       /* special case: right column */
-                    uiSubX = uiXSize >> 1;  uiXL = uiNrX - 1; uiXR = uiXL;
-                }
-                else {                                    /* default values */
-                    uiSubX = uiXSize; uiXL = uiX - 1; uiXR = uiXL + 1;
-                }
-            }
+    for (auto &maps : maps_) { maps.resize(std::size_t(nx_) * bins_); }
 
-            pulLU = &pulMapArray[uiNrBins * (uiYU * uiNrX + uiXL)];
-            pulRU = &pulMapArray[uiNrBins * (uiYU * uiNrX + uiXR)];
-            pulLB = &pulMapArray[uiNrBins * (uiYB * uiNrX + uiXL)];
-            pulRB = &pulMapArray[uiNrBins * (uiYB * uiNrX + uiXR)];
-            Interpolate<kz_pixel_t>(pImPointer,uiXRes,pulLU,pulRU,pulLB,pulRB,uiSubX,uiSubY,aLUT);
-            pImPointer += uiSubX;                         /* set pointer on next matrix */
-        }
-        pImPointer += (uiSubY - 1) * uiXRes;
+    const std::uint64_t area(std::uint64_t(size_) * size_);
+    if (!(area & (area - 1))) {
+        for (shift_ = 0; (std::uint64_t(1) << shift_) < area; ++shift_) {}
     }
-    free(pulMapArray);                                    /* free space for histograms */
-    return 0;                                             /* return status OK */
 }
 
-inline void ClipHistogram (unsigned long* pulHistogram, unsigned int
-                     uiNrGreylevels, unsigned long ulClipLimit)
-/* This function performs clipping of the histogram and redistribution of bins.
- * The histogram is clipped and the number of excess pixels is counted. Afterwards
- * the excess pixels are equally redistributed across the whole histogram (providing
- * the bin count is smaller than the cliplimit).
- */
+template <typename T>
+std::pair<int, int> Equalizer<T>::band(int index) const
 {
-    unsigned long* pulBinPointer, *pulEndPointer, *pulHisto;
-    unsigned long ulNrExcess, ulUpper, ulBinIncr, ulStepSize, i;
-    unsigned long ulOldNrExcess;  // #IAC Modification
-
-    long lBinExcess;
-
-    ulNrExcess = 0;  pulBinPointer = pulHistogram;
-    for (i = 0; i < uiNrGreylevels; i++) { /* calculate total number of excess pixels */
-        lBinExcess = (long) pulBinPointer[i] - (long) ulClipLimit;
-        if (lBinExcess > 0) ulNrExcess += lBinExcess;     /* excess in current bin */
-    };
-
-    /* Second part: clip histogram and redistribute excess pixels in each bin */
-    ulBinIncr = ulNrExcess / uiNrGreylevels;              /* average binincrement */
-    ulUpper =  ulClipLimit - ulBinIncr;  /* Bins larger than ulUpper set to cliplimit */
-
-    for (i = 0; i < uiNrGreylevels; i++) {
-      if (pulHistogram[i] > ulClipLimit) pulHistogram[i] = ulClipLimit; /* clip bin */
-      else {
-          if (pulHistogram[i] > ulUpper) {              /* high bin count */
-              ulNrExcess -= pulHistogram[i] - ulUpper; pulHistogram[i]=ulClipLimit;
-          }
-          else {                                        /* low bin count */
-              ulNrExcess -= ulBinIncr; pulHistogram[i] += ulBinIncr;
-          }
-       }
-    }
-
-    // while (ulNrExcess) {   /* Redistribute remaining excess  */
-    //    pulEndPointer = &pulHistogram[uiNrGreylevels]; pulHisto = pulHistogram;
-    //
-    //    while (ulNrExcess && pulHisto < pulEndPointer) {
-    //        ulStepSize = uiNrGreylevels / ulNrExcess;
-    //        if (ulStepSize < 1) ulStepSize = 1;           /* stepsize at least 1 */
-    //        for (pulBinPointer=pulHisto; pulBinPointer < pulEndPointer && ulNrExcess;
-    //             pulBinPointer += ulStepSize) {
-    //            if (*pulBinPointer < ulClipLimit) {
-    //                (*pulBinPointer)++;  ulNrExcess--;    /* reduce excess */
-    //            }
-    //        }
-    //        pulHisto++;           /* restart redistributing on other bin location */
-    //    }
-    //}
-
-/* ####
-
-       IAC Modification:
-       In the original version of the loop below (commented out above) it was possible for an infinite loop to get
-       created.  If there was more pixels to be redistributed than available space then the
-       while loop would never end.  This problem has been fixed by stopping the loop when all
-       pixels have been redistributed OR when no pixels where redistributed in the previous iteration.
-       This change allows very low clipping levels to be used.
-
-*/
-
-     do {   /* Redistribute remaining excess  */
-         pulEndPointer = &pulHistogram[uiNrGreylevels]; pulHisto = pulHistogram;
-
-         ulOldNrExcess = ulNrExcess;     /* Store number of excess pixels for test later. */
-
-         while (ulNrExcess && pulHisto < pulEndPointer)
-         {
-             ulStepSize = uiNrGreylevels / ulNrExcess;
-             if (ulStepSize < 1)
-                 ulStepSize = 1;       /* stepsize at least 1 */
-             for (pulBinPointer=pulHisto; pulBinPointer < pulEndPointer && ulNrExcess;
-             pulBinPointer += ulStepSize)
-             {
-                 if (*pulBinPointer < ulClipLimit)
-                 {
-                     (*pulBinPointer)++;  ulNrExcess--;    /* reduce excess */
-                 }
-            }
-             pulHisto++;       /* restart redistributing on other bin location */
-         }
-     } while ((ulNrExcess) && (ulNrExcess < ulOldNrExcess));
-     /* Finish loop when we have no more pixels or we can't redistribute any more pixels */
-
+    return { index * size_, std::min((index + 1) * size_, height_) };
+}
 
+template <typename T>
+std::pair<int, int> Equalizer<T>::stripe(int index) const
+{
+    const int first(index ? std::min(half_ + (index - 1) * size_, height_)
+                    : 0);
+    const int last((index < ny_)
+                   ? std::min(half_ + index * size_, height_) : height_);
+    return { first, last };
 }
 
-template <class kz_pixel_t>
-void MakeHistogram (kz_pixel_t* pImage, unsigned int uiXRes,
-     unsigned int uiSizeX, unsigned int uiSizeY,
-     unsigned long* pulHistogram,
-     unsigned int uiNrGreylevels, kz_pixel_t* pLookupTable)
-    /* This function classifies the greylevels present in the array image into
-     * a greylevel histogram. The pLookupTable specifies the relationship
-     * between the greyvalue of the pixel (typically between 0 and 4095) and
-     * the corresponding bin in the histogram (usually containing only 128 bins).
-     */
-    {
-     unsigned int i,j=0;
+template <typename T>
+void Equalizer<T>::region(const T *data, std::size_t step
+                          , int width, int height
+                          , T *map, std::vector<Count> &work) const
+{
+    // four interleaved sub-histograms break the store-to-load dependency
+    // on runs of equal pixel values; not worth it for large histograms
+    // that do not fit in L1 cache
+    const int ways((bins_ <= 4096) ? 4 : 1);
+    work.assign(std::size_t(ways) * bins_, 0);
+    Count *h0(work.data());
+
+    const auto *lut(lut_.data());
+    if (ways == 4) {
+        Count *h1(h0 + bins_), *h2(h1 + bins_), *h3(h2 + bins_);
+        for (int j(0); j < height; ++j, data += step) {
+            int i(0);
+            for (; (i + 4) <= width; i += 4) {
+                ++h0[lut[data[i]]];
+                ++h1[lut[data[i + 1]]];
+                ++h2[lut[data[i + 2]]];
+                ++h3[lut[data[i + 3]]];
+            }
+            for (; i < width; ++i) { ++h0[lut[data[i]]]; }
+        }
 
-    for (i = 0; i < uiNrGreylevels; i++) pulHistogram[i] = 0L; /* clear histogram */
+        for (int b(0); b < bins_; ++b) { h0[b] += h1[b] + h2[b] + h3[b]; }
+    } else {
+        for (int j(0); j < height; ++j, data += step) {
+            for (int i(0); i < width; ++i) { ++h0[lut[data[i]]]; }
+        }
+    }
 
-    for (i = 0; i < uiSizeY; i++) {
-     j = 0;
-     while (j < uiSizeX) { pulHistogram[pLookupTable[pImage[j]]]++; ++j; }
-     pImage = &pImage[uiXRes];
-     }
+    // limit is derived from actual number of pixels in (partial) region
+    const Count pixels(Count(width) * height);
+    if (clipLimit_ > 0) {
+        const Count limit(clipLimit_ * pixels / bins_);
+        clip(h0, bins_, std::max(limit, Count(1)));
+    }
+
+    // cumulate and rescale into [0, max]
+    const Count max(std::numeric_limits<T>::max());
+    const float scale(float(max) / pixels);
+    Count sum(0);
+    for (int b(0); b < bins_; ++b) {
+        sum += h0[b];
+        map[b] = std::min(Count(sum * scale), max);
+    }
 }
 
-template <class kz_pixel_t>
-void MapHistogram (unsigned long* pulHistogram, kz_pixel_t Min, kz_pixel_t Max,
-               unsigned int uiNrGreylevels, unsigned long ulNrOfPixels)
-/* This function calculates the equalized lookup table (mapping) by
- * cumulating the input histogram. Note: lookup table is rescaled in range [Min..Max].
- */
+template <typename T>
+void Equalizer<T>::map(int index, const T *data, std::size_t step)
 {
-    unsigned int i;  unsigned long ulSum = 0;
-    const float fScale = ((float)(Max - Min)) / ulNrOfPixels;
-    const unsigned long ulMin = (unsigned long) Min;
-
-    for (i = 0; i < uiNrGreylevels; i++) {
-        ulSum += pulHistogram[i]; pulHistogram[i]=(unsigned long)(ulMin+ulSum*fScale);
-        if (pulHistogram[i] > Max) pulHistogram[i] = Max;
-        //std::cout << i << "->" << pulHistogram[i] << std::endl;
+    const auto rows(band(index));
+    auto *maps(maps_[index % 2].data());
+
+    UTILITY_OMP(parallel for schedule(dynamic))
+    for (int r = 0; r < nx_; ++r) {
+        std::vector<Count> work;
+        const int x(r * size_);
+        region(data + x, step, std::min(size_, width_ - x)
+               , rows.second - rows.first, maps + std::size_t(r) * bins_
+               , work);
     }
 }
 
-template <class kz_pixel_t>
-void MakeLut (kz_pixel_t * pLUT, kz_pixel_t Min, kz_pixel_t Max, unsigned int uiNrBins)
-/* To speed up histogram clipping, the input image [Min,Max] is scaled down to
- * [0,uiNrBins-1]. This function calculates the LUT.
- */
+template <typename T>
+template <typename Acc>
+void Equalizer<T>::segment(const T *src, T *dst, int n
+                           , const T *lu, const T *ru, const T *lb
+                           , const T *rb, int wu, int wb) const
 {
-    int i;
-    const kz_pixel_t BinSize = (kz_pixel_t) (1 + (Max - Min) / uiNrBins);
+    // the loop is bound by the four map lookups per pixel; exact integer
+    // blending is cheaper than converting the gathered values for vector
+    // arithmetic
+    const auto *lut(lut_.data());
+    const Acc size(size_), u(wu), b(wb);
+
+    if (shift_ >= 0) {
+        for (Acc i(0); i < Acc(n); ++i) {
+            const auto v(lut[src[i]]);
+            const Acc l(size - i);
+            dst[i] = T((u * (l * lu[v] + i * ru[v])
+                        + b * (l * lb[v] + i * rb[v])) >> shift_);
+        }
+        return;
+    }
 
-    //std::cout << "BinSize: " << (int) BinSize << std::endl;
-    
-    for (i = Min; i <= Max; i++)  pLUT[i] = (i - Min) / BinSize;
+    const Acc den(size * size);
+    for (Acc i(0); i < Acc(n); ++i) {
+        const auto v(lut[src[i]]);
+        const Acc l(size - i);
+        dst[i] = T((u * (l * lu[v] + i * ru[v])
+                    + b * (l * lb[v] + i * rb[v])) / den);
+    }
 }
 
-template <class kz_pixel_t>
-void Interpolate (kz_pixel_t * pImage, int uiXRes, unsigned long * pulMapLU,
-     unsigned long * pulMapRU, unsigned long * pulMapLB,  unsigned long * pulMapRB,
-     unsigned int uiXSize, unsigned int uiYSize, kz_pixel_t * pLUT)
-/* pImage      - pointer to input/output image
- * uiXRes      - resolution of image in x-direction
- * pulMap*     - mappings of greylevels from histograms
- * uiXSize     - uiXSize of image submatrix
- * uiYSize     - uiYSize of image submatrix
- * pLUT        - lookup table containing mapping greyvalues to bins
- * This function calculates the new greylevel assignments of pixels within a submatrix
- * of the image with size uiXSize and uiYSize. This is done by a bilinear interpolation
- * between four different mappings in order to eliminate boundary artifacts.
- * It uses a division; since division is often an expensive operation, I added code to
- * perform a logical shift instead when feasible.
- */
+template <typename T>
+void Equalizer<T>::interpolate(int y, const T *src, T *dst) const
 {
-    const unsigned int uiIncr = uiXRes-uiXSize; /* Pointer increment after processing row */
-    kz_pixel_t GreyValue; unsigned int uiNum = uiXSize*uiYSize; /* Normalization factor */
-
-    unsigned int uiXCoef, uiYCoef, uiXInvCoef, uiYInvCoef, uiShift = 0;
-
-    if (uiNum & (uiNum - 1))   /* If uiNum is not a power of two, use division */
-    for (uiYCoef = 0, uiYInvCoef = uiYSize; uiYCoef < uiYSize;
-         uiYCoef++, uiYInvCoef--,pImage+=uiIncr) {
-        for (uiXCoef = 0, uiXInvCoef = uiXSize; uiXCoef < uiXSize;
-             uiXCoef++, uiXInvCoef--) {
-            GreyValue = pLUT[*pImage];             /* get histogram bin value */
-            *pImage++ = (kz_pixel_t ) ((uiYInvCoef * (uiXInvCoef*pulMapLU[GreyValue]
-                                      + uiXCoef * pulMapRU[GreyValue])
-                                + uiYCoef * (uiXInvCoef * pulMapLB[GreyValue]
-                                      + uiXCoef * pulMapRB[GreyValue])) / uiNum);
-        }
+    // vertical neighbours and weights; rows outside the outermost region
+    // centers use single region
+    int u(0), yc(0);
+    if (y >= half_) {
+        u = (y - half_) / size_;
+        yc = (y - half_) % size_;
     }
-    else {                         /* avoid the division and use a right shift instead */
-        while (uiNum >>= 1) uiShift++;             /* Calculate 2log of uiNum */
-        for (uiYCoef = 0, uiYInvCoef = uiYSize; uiYCoef < uiYSize;
-             uiYCoef++, uiYInvCoef--,pImage+=uiIncr) {
-             for (uiXCoef = 0, uiXInvCoef = uiXSize; uiXCoef < uiXSize;
-               uiXCoef++, uiXInvCoef--) {
-               GreyValue = pLUT[*pImage];         /* get histogram bin value */
-               *pImage++ = (kz_pixel_t)((uiYInvCoef* (uiXInvCoef * pulMapLU[GreyValue]
-                                      + uiXCoef * pulMapRU[GreyValue])
-                                + uiYCoef * (uiXInvCoef * pulMapLB[GreyValue]
-                                      + uiXCoef * pulMapRB[GreyValue])) >> uiShift);
-            }
+    int b(u + 1);
+    if ((y < half_) || (b >= ny_)) {
+        u = b = std::min(u, ny_ - 1);
+        yc = 0;
+    }
+
+    const auto *mu(maps_[u % 2].data());
+    const auto *mb(maps_[b % 2].data());
+    const int wu(size_ - yc), wb(yc);
+
+    for (int s(0); s <= nx_; ++s) {
+        // segment between centers of region columns l and r
+        const int x0(s ? std::min(half_ + (s - 1) * size_, width_) : 0);
+        const int x1((s < nx_) ? std::min(half_ + s * size_, width_)
+                     : width_);
+        if (x0 >= x1) { continue; }
+
+        const int l(std::max(s - 1, 0)), r(std::min(s, nx_ - 1));
+        const std::size_t lo(std::size_t(l) * bins_);
+        const std::size_t ro(std::size_t(r) * bins_);
+
+        if (wide_) {
+            segment<std::uint64_t>(src + x0, dst + x0, x1 - x0
+                                   , mu + lo, mu + ro, mb + lo, mb + ro
+                                   , wu, wb);
+        } else {
+            segment<std::uint32_t>(src + x0, dst + x0, x1 - x0
+                                   , mu + lo, mu + ro, mb + lo, mb + ro
+                                   , wu, wb);
         }
     }
 }
-// *****************************************************************************
 
-} // namespace detail
- 
-} // namespace imgproc
+} } } // namespace imgproc::detail::clahe
 
+#endif // imgproc_detail_clahe_hpp_included_
@@ -0,0 +1,171 @@
+/**
+ * Copyright (c) 2021 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file detail/inpaint.hpp
+ *
+ * Per-pattern Laplace interpolation of small image blocks.
+ *
+ * For a block with at most 64 pixels the Laplace interpolation system
+ * depends only on the block size and on which pixels are given. Its
+ * solution is a fixed linear combination of the given pixels on the
+ * boundary of the holes: u = A^-1 * B * g. BlockSolver precomputes the
+ * weight matrix A^-1 * B once per pattern (dense Cholesky factorization of
+ * the at most 64x64 matrix), interpolating a block is then a small
+ * matrix-vector product per channel.
+ */
+
+#ifndef imgproc_detail_inpaint_hpp_included_
+#define imgproc_detail_inpaint_hpp_included_
+
+#include <cstdint>
+#include <vector>
+#include <tuple>
+
+#include <Eigen/Dense>
+
+namespace imgproc { namespace detail { namespace inpaint {
+
+/** Maximum number of pixels in a block handled by BlockSolver.
+ */
+constexpr int MaxBlockArea(64);
+
+/** Maximum number of BlockSolvers alive at once. A solver holds at most
+ *  32x32 weights (free x given pixels), i.e. about 4 KiB.
+ */
+constexpr std::size_t MaxPatterns(4096);
+
+/** Block mask pattern.
+ */
+struct BlockKey {
+    /** Bit (y * width + x) is set iff pixel (x, y) is given.
+     */
+    std::uint64_t given;
+    int width;
+    int height;
+
+    BlockKey() : given(), width(), height() {}
+
+    /** All pixels are given.
+     */
+    bool full() const {
+        const int area(width * height);
+        return given == ((area == 64) ? ~std::uint64_t(0)
+                         : ((std::uint64_t(1) << area) - 1));
+    }
+
+    /** No pixel is given.
+     */
+    bool empty() const { return !given; }
+
+    bool operator<(const BlockKey &o) const {
+        return (std::tie(given, width, height)
+                < std::tie(o.given, o.width, o.height));
+    }
+
+    bool operator==(const BlockKey &o) const {
+        return ((given == o.given) && (width == o.width)
+                && (height == o.height));
+    }
+};
+
+/** Precomputed Laplace interpolation of one block pattern.
+ */
+struct BlockSolver {
+    /** Free pixels (y * width + x).
+     */
+    std::vector<int> free;
+
+    /** Given pixels neighbouring at least one free pixel.
+     */
+    std::vector<int> given;
+
+    /** Interpolation weights, one row (of given.size() weights) per free
+     *  pixel.
+     */
+    std::vector<float> weights;
+
+    BlockSolver() = default;
+
+    /** Factorizes system of given pattern. Pattern must be neither full nor
+     *  empty.
+     */
+    explicit BlockSolver(const BlockKey &key);
+};
+
+inline BlockSolver::BlockSolver(const BlockKey &key)
+{
+    const int w(key.width), h(key.height), area(w * h);
+    const auto isGiven([&](int p) { return (key.given >> p) & 1; });
+
+    // number free pixels, find given pixels on holes' boundary
+    int ids[MaxBlockArea];
+    for (int p(0); p < area; ++p) {
+        ids[p] = -1;
+        if (!isGiven(p)) { ids[p] = free.size(); free.push_back(p); }
+    }
+
+    const int n(free.size());
+    Eigen::MatrixXd A(Eigen::MatrixXd::Zero(n, n));
+    Eigen::MatrixXd B(Eigen::MatrixXd::Zero(n, area));
+
+    for (int k(0); k < n; ++k) {
+        const int p(free[k]), x(p % w), y(p / w);
+        const auto neighbour([&](int q)
+        {
+            A(k, k) += 1.0;
+            if (ids[q] >= 0) {
+                A(k, ids[q]) = -1.0;
+            } else {
+                B(k, q) += 1.0;
+            }
+        });
+
+        if (x > 0) { neighbour(p - 1); }
+        if (x + 1 < w) { neighbour(p + 1); }
+        if (y > 0) { neighbour(p - w); }
+        if (y + 1 < h) { neighbour(p + w); }
+    }
+
+    // keep only given pixels that influence free ones
+    for (int p(0); p < area; ++p) {
+        if (isGiven(p) && B.col(p).any()) { given.push_back(p); }
+    }
+
+    // A is symmetric positive definite: every free component touches some
+    // given pixel (block is not empty)
+    const Eigen::LLT<Eigen::MatrixXd> llt(A);
+
+    const int m(given.size());
+    weights.resize(std::size_t(n) * m);
+    for (int c(0); c < m; ++c) {
+        const Eigen::VectorXd s(llt.solve(B.col(given[c])));
+        for (int k(0); k < n; ++k) { weights[k * m + c] = s(k); }
+    }
+}
+
+} } } // namespace imgproc::detail::inpaint
+
+#endif // imgproc_detail_inpaint_hpp_included_
@@ -0,0 +1,419 @@
+/**
+ * Copyright (c) 2021 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file detail/laplace.hpp
+ *
+ * Matrix-free multigrid solver for the Laplace interpolation system.
+ *
+ * The system lives on the image grid: every free pixel p has the equation
+ *
+ *     diag(p) * u(p) - sum_q w(p, q) * u(q) = b(p)
+ *
+ * where q runs over the 4-neighbourhood of p. On the finest level diag(p) is
+ * the number of in-image neighbours, w(p, q) is 1 when both pixels are free
+ * and given neighbours are moved to b. Given pixels have zero diagonal and
+ * do not take part in the computation.
+ *
+ * Operator is stored per cell (diagonal, coupling to the east and to the
+ * south neighbour), i.e. no sparse matrix is ever assembled. Coarse levels
+ * are obtained by 2x2 aggregation with the Galerkin product P^T A P where P
+ * is the piecewise constant prolongation; the coarse operator is again a
+ * 5-point stencil that naturally follows the shape of the hole.
+ *
+ * One symmetric V-cycle (red-black Gauss-Seidel, red-black before and
+ * black-red after the scaled coarse correction) is used as the preconditioner of
+ * the conjugate gradient method. All computation is done in double
+ * precision, memory and time per iteration are linear in the number of
+ * cells.
+ */
+
+#ifndef imgproc_detail_laplace_hpp_included_
+#define imgproc_detail_laplace_hpp_included_
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+
+namespace imgproc { namespace detail { namespace laplace {
+
+/** One level of the multigrid hierarchy.
+ *
+ *  Cells are stored with one cell wide inactive border so neighbours can be
+ *  accessed without bounds checks; use index() to get cell storage index.
+ */
+struct Level {
+    int width;
+    int height;
+
+    /** Distance between rows in storage.
+     */
+    std::size_t stride;
+
+    /** Diagonal of the operator, zero for inactive (given) cells.
+     */
+    std::vector<float> diag;
+
+    /** Coupling between cell and its east (x + 1) neighbour.
+     */
+    std::vector<float> east;
+
+    /** Coupling between cell and its south (y + 1) neighbour.
+     */
+    std::vector<float> south;
+
+    /** Solution and right hand side; used by the V-cycle.
+     */
+    std::vector<double> u;
+    std::vector<double> b;
+
+    /** Active cells split by color ((i + j) % 2); built by activate().
+     */
+    std::vector<std::size_t> cells[2];
+
+    /** Coarse level cell of each active cell (parallel to cells), built by
+     *  coarsen().
+     */
+    std::vector<std::size_t> parents[2];
+
+    Level(int width, int height)
+        : width(width), height(height), stride(width + 2)
+        , diag(stride * (height + 2))
+        , east(diag.size()), south(diag.size())
+        , u(diag.size()), b(diag.size())
+    {}
+
+    std::size_t size() const { return diag.size(); }
+
+    std::size_t index(int i, int j) const {
+        return (j + 1) * stride + (i + 1);
+    }
+
+    /** Sum of couplings with all neighbours weighted by values in x.
+     */
+    double neighbours(const double *x, std::size_t p) const {
+        return (east[p - 1] * x[p - 1] + east[p] * x[p + 1]
+                + south[p - stride] * x[p - stride]
+                + south[p] * x[p + stride]);
+    }
+
+    /** Collects active cells. Must be called once operator is set up.
+     */
+    void activate();
+
+    /** y = A * x
+     */
+    void apply(const double *x, double *y) const;
+
+    /** r = b - A * x
+     */
+    void residual(const double *x, const double *b, double *r) const;
+
+    /** Gauss-Seidel update of all cells of given color.
+     */
+    void relax(double *x, const double *b, int color) const;
+
+    /** Builds coarse level (Galerkin operator of 2x2 aggregation) and links
+     *  active cells to their parents.
+     */
+    Level coarsen();
+};
+
+/** Multigrid-preconditioned conjugate gradient solver.
+ */
+class Solver {
+public:
+    /** Takes the finest level operator and builds the hierarchy.
+     */
+    Solver(Level fine);
+
+    /** Solves A * x = b. x is used as the initial guess. Stops when
+     *  |b - A * x| <= tol * |b| or after maxIterations. Vectors are indexed
+     *  by fine level's index().
+     *
+     * \return number of iterations
+     */
+    int solve(std::vector<double> &x, const std::vector<double> &b
+              , double tol, int maxIterations);
+
+    /** Relative residual reached by the last solve().
+     */
+    double error() const { return error_; }
+
+    /** Number of levels.
+     */
+    std::size_t depth() const { return levels_.size(); }
+
+    /** Finest level.
+     */
+    const Level& fine() const { return levels_.front(); }
+
+private:
+    /** Approximately solves levels_[l].u from levels_[l].b (zero initial
+     *  guess).
+     */
+    void vcycle(std::size_t l);
+
+    std::vector<Level> levels_;
+    std::vector<double> r_;
+    double error_;
+};
+
+/** Levels are coarsened until both dimensions drop to this size.
+ */
+constexpr int CoarsestSize(4);
+
+/** Number of symmetric smoothing sweep pairs on the coarsest level.
+ */
+constexpr int CoarsestSweeps(32);
+
+/** Scale of the coarse grid correction. Galerkin operator of piecewise
+ *  constant prolongation is about twice as stiff as the rediscretized one,
+ *  over-correction compensates for it (cuts number of iterations to about
+ *  one third).
+ */
+constexpr double CorrectionScale(1.8);
+
+inline void Level::activate()
+{
+    for (auto &c : cells) { c.clear(); }
+    for (int j(0); j < height; ++j) {
+        for (int i(0); i < width; ++i) {
+            const auto p(index(i, j));
+            if (diag[p]) { cells[(i + j) & 1].push_back(p); }
+        }
+    }
+}
+
+inline void Level::apply(const double *x, double *y) const
+{
+    for (const auto &c : cells) {
+        for (const auto p : c) {
+            y[p] = diag[p] * x[p] - neighbours(x, p);
+        }
+    }
+}
+
+inline void Level::residual(const double *x, const double *b
+                            , double *r) const
+{
+    for (const auto &c : cells) {
+        for (const auto p : c) {
+            r[p] = b[p] - diag[p] * x[p] + neighbours(x, p);
+        }
+    }
+}
+
+inline void Level::relax(double *x, const double *b, int color) const
+{
+    for (const auto p : cells[color]) {
+        x[p] = (b[p] + neighbours(x, p)) / diag[p];
+    }
+}
+
+inline Level Level::coarsen()
+{
+    Level c((width + 1) / 2, (height + 1) / 2);
+
+    for (int cj(0); cj < c.height; ++cj) {
+        const int j(2 * cj);
+        const bool bottom(j + 1 < height);
+        for (int ci(0); ci < c.width; ++ci) {
+            const int i(2 * ci);
+            const bool right(i + 1 < width);
+            const auto p(index(i, j));
+            const auto cp(c.index(ci, cj));
+            const auto s(stride);
+
+            // sum of children's diagonals minus (twice) internal couplings
+            double d(diag[p]);
+            if (right) { d += diag[p + 1] - 2.0 * east[p]; }
+            if (bottom) {
+                d += diag[p + s] - 2.0 * south[p];
+                if (right) {
+                    d += diag[p + s + 1] - 2.0 * (east[p + s] + south[p + 1]);
+                }
+            }
+            c.diag[cp] = d;
+
+            // couplings crossing the aggregate's east and south edges
+            if (right) {
+                c.east[cp] = east[p + 1];
+                if (bottom) { c.east[cp] += east[p + s + 1]; }
+            }
+            if (bottom) {
+                c.south[cp] = south[p + s];
+                if (right) { c.south[cp] += south[p + s + 1]; }
+            }
+        }
+    }
+
+    c.activate();
+
+    for (int color(0); color < 2; ++color) {
+        auto &parents(this->parents[color]);
+        parents.clear();
+        parents.reserve(cells[color].size());
+        for (const auto p : cells[color]) {
+            const int i((p % stride) - 1), j((p / stride) - 1);
+            parents.push_back(c.index(i / 2, j / 2));
+        }
+    }
+
+    return c;
+}
+
+inline Solver::Solver(Level fine)
+    : error_()
+{
+    levels_.push_back(std::move(fine));
+    levels_.back().activate();
+    while ((levels_.back().width > CoarsestSize)
+           || (levels_.back().height > CoarsestSize))
+    {
+        auto coarse(levels_.back().coarsen());
+        levels_.push_back(std::move(coarse));
+    }
+    r_.resize(levels_.front().size());
+}
+
+inline void Solver::vcycle(std::size_t l)
+{
+    auto &level(levels_[l]);
+    auto *u(level.u.data());
+    const auto *b(level.b.data());
+    std::fill(level.u.begin(), level.u.end(), 0.0);
+
+    if ((l + 1) == levels_.size()) {
+        for (int s(0); s < CoarsestSweeps; ++s) {
+            level.relax(u, b, 0);
+            level.relax(u, b, 1);
+            level.relax(u, b, 1);
+            level.relax(u, b, 0);
+        }
+        return;
+    }
+
+    // pre-smoothing
+    level.relax(u, b, 0);
+    level.relax(u, b, 1);
+
+    // restrict residual (sum over aggregate) into coarse rhs
+    auto &coarse(levels_[l + 1]);
+    {
+        auto *r(r_.data());
+        level.residual(u, b, r);
+        std::fill(coarse.b.begin(), coarse.b.end(), 0.0);
+        auto *cb(coarse.b.data());
+        for (int color(0); color < 2; ++color) {
+            const auto &cells(level.cells[color]);
+            const auto &parents(level.parents[color]);
+            for (std::size_t k(0), ke(cells.size()); k != ke; ++k) {
+                cb[parents[k]] += r[cells[k]];
+            }
+        }
+    }
+
+    vcycle(l + 1);
+
+    // prolongate correction (piecewise constant)
+    {
+        const auto *cu(coarse.u.data());
+        for (int color(0); color < 2; ++color) {
+            const auto &cells(level.cells[color]);
+            const auto &parents(level.parents[color]);
+            for (std::size_t k(0), ke(cells.size()); k != ke; ++k) {
+                u[cells[k]] += CorrectionScale * cu[parents[k]];
+            }
+        }
+    }
+
+    // post-smoothing
+    level.relax(u, b, 1);
+    level.relax(u, b, 0);
+}
+
+inline int Solver::solve(std::vector<double> &x, const std::vector<double> &b
+                         , double tol, int maxIterations)
+{
+    const auto dot([](const std::vector<double> &a
+                      , const std::vector<double> &b) -> double
+    {
+        double s(0.0);
+        for (std::size_t i(0), e(a.size()); i != e; ++i) { s += a[i] * b[i]; }
+        return s;
+    });
+
+    auto &fine(levels_.front());
+    const std::size_t n(fine.size());
+
+    error_ = 0.0;
+    const double bnorm(std::sqrt(dot(b, b)));
+    if (!bnorm) {
+        std::fill(x.begin(), x.end(), 0.0);
+        return 0;
+    }
+
+    std::vector<double> r(n), p(n), q(n);
+    fine.residual(x.data(), b.data(), r.data());
+
+    double rnorm(std::sqrt(dot(r, r)));
+    double rz(0.0);
+    int it(0);
+    for (; (rnorm > tol * bnorm) && (it < maxIterations); ++it) {
+        // z = M^-1 r (V-cycle result ends up in fine.u)
+        fine.b = r;
+        vcycle(0);
+        const auto &z(fine.u);
+
+        const double rzNew(dot(r, z));
+        if (!it) {
+            p = z;
+        } else {
+            const double beta(rzNew / rz);
+            for (std::size_t i(0); i != n; ++i) { p[i] = z[i] + beta * p[i]; }
+        }
+        rz = rzNew;
+
+        fine.apply(p.data(), q.data());
+        const double pq(dot(p, q));
+        if (!(pq > 0.0)) { break; }
+        const double alpha(rz / pq);
+
+        for (std::size_t i(0); i != n; ++i) {
+            x[i] += alpha * p[i];
+            r[i] -= alpha * q[i];
+        }
+        rnorm = std::sqrt(dot(r, r));
+    }
+
+    error_ = rnorm / bnorm;
+    return it;
+}
+
+} } } // namespace imgproc::detail::laplace
+
+#endif // imgproc_detail_laplace_hpp_included_
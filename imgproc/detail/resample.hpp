@@ -0,0 +1,242 @@
+/**
+ * Copyright (c) 2021 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file detail/resample.hpp
+ *
+ * Separable resampling core used by transform() for axis-aligned mappings.
+ *
+ * For a separable filter f(x, y) = g(x) * h(y) and a mapping where source x
+ * depends only on destination x (and likewise for y) the filter weights of
+ * every destination column (row) are the same for all destination rows
+ * (columns). Weights are therefore computed once into per-axis tables and
+ * the image is resampled in two passes: source rows are filtered
+ * horizontally into a small ring buffer and destination rows are then
+ * accumulated vertically from the buffered rows.
+ *
+ * Semantics match imgproc::reconstruct(): filter window is
+ * [floor(pos - halfwin), ceil(pos + halfwin)], pixels outside the source
+ * view contribute zero value but their weight is counted, result is
+ * normalized by the weight sum and clamped to the channel range.
+ * Accumulation is done in single precision.
+ */
+
+#ifndef imgproc_detail_resample_hpp_included_
+#define imgproc_detail_resample_hpp_included_
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#if defined(__AVX__)
+#  include <immintrin.h>
+#elif defined(__SSE2__)
+#  include <emmintrin.h>
+#endif
+
+#include "math/boost_gil_all.hpp"
+
+#include "../filtering.hpp"
+#include "separable.hpp"
+
+namespace imgproc { namespace detail { namespace resample {
+
+namespace gil = boost::gil;
+
+/** Precomputed filter taps along one axis.
+ */
+struct Axis {
+    /** Maximum number of taps of one destination coordinate.
+     */
+    int taps;
+
+    /** First source coordinate of each destination coordinate, clipped to
+     *  source.
+     */
+    std::vector<int> first;
+
+    /** Number of in-source taps of each destination coordinate.
+     */
+    std::vector<int> count;
+
+    /** Sum of weights of the whole filtering window (including taps outside
+     *  source).
+     */
+    std::vector<double> weightSum;
+
+    /** Weights of in-source taps, taps per destination coordinate.
+     */
+    std::vector<float> weights;
+
+    const float* at(int i) const { return weights.data() + i * taps; }
+};
+
+/** Builds taps for one axis.
+ *
+ *  \param dstSize number of destination coordinates
+ *  \param srcSize number of source coordinates
+ *  \param halfwin filter half window
+ *  \param position maps destination coordinate to source position
+ *  \param weight 1D filter function
+ */
+template <typename Position, typename Weight>
+Axis axis(int dstSize, int srcSize, double halfwin
+          , const Position &position, const Weight &weight)
+{
+    Axis a;
+    a.taps = int(std::ceil(2.0 * halfwin)) + 3;
+    a.first.resize(dstSize);
+    a.count.resize(dstSize);
+    a.weightSum.resize(dstSize);
+    a.weights.assign(std::size_t(dstSize) * a.taps, 0.f);
+
+    for (int d(0); d < dstSize; ++d) {
+        const double pos(position(d));
+        const int x1(std::floor(pos - halfwin));
+        const int x2(std::ceil(pos + halfwin));
+
+        a.first[d] = std::min(std::max(x1, 0), srcSize);
+        auto *w(a.weights.data() + std::size_t(d) * a.taps);
+        double sum(0.0);
+        int count(0);
+        for (int x(x1); x <= x2; ++x) {
+            const double value(weight(x - pos));
+            sum += value;
+            if ((x >= 0) && (x < srcSize)) { w[count++] = value; }
+        }
+        a.count[d] = count;
+        a.weightSum[d] = sum;
+    }
+
+    return a;
+}
+
+/** acc[i] += w * src[i] for i in [0, n)
+ */
+inline void axpy(float *acc, const float *src, float w, std::size_t n)
+{
+    std::size_t i(0);
+#if defined(__AVX__)
+    const __m256 ww(_mm256_set1_ps(w));
+    for (; (i + 8) <= n; i += 8) {
+        _mm256_storeu_ps(acc + i, _mm256_add_ps
+                         (_mm256_loadu_ps(acc + i)
+                          , _mm256_mul_ps(ww, _mm256_loadu_ps(src + i))));
+    }
+#elif defined(__SSE2__)
+    const __m128 ww(_mm_set1_ps(w));
+    for (; (i + 4) <= n; i += 4) {
+        _mm_storeu_ps(acc + i, _mm_add_ps
+                      (_mm_loadu_ps(acc + i)
+                       , _mm_mul_ps(ww, _mm_loadu_ps(src + i))));
+    }
+#endif
+    for (; i < n; ++i) { acc[i] += w * src[i]; }
+}
+
+/** Filters one source line (interleaved channels) horizontally.
+ */
+template <int Channels>
+void horizontal(float *out, const float *line, const Axis &x)
+{
+    for (int d(0), de(x.first.size()); d != de; ++d) {
+        const float *w(x.at(d));
+        const float *s(line + x.first[d] * Channels);
+        float sum[Channels] = {};
+        for (int k(0), ke(x.count[d]); k != ke; ++k, s += Channels) {
+            for (int c(0); c < Channels; ++c) { sum[c] += w[k] * s[c]; }
+        }
+        for (int c(0); c < Channels; ++c) { *out++ = sum[c]; }
+    }
+}
+
+/** Resamples destination rows [rowBegin, rowEnd) of dst from src using
+ *  precomputed axes. Each call uses its own row buffer, therefore disjoint
+ *  row ranges can be processed concurrently.
+ */
+template <typename SrcView, typename DstView>
+void resample(const SrcView &src, const DstView &dst
+              , const Axis &x, const Axis &y
+              , int rowBegin, int rowEnd)
+{
+    typedef typename SrcView::value_type Pixel;
+    constexpr int Channels(gil::num_channels<SrcView>::value);
+
+    PixelLimits<Pixel> pl;
+    const auto &zero(pl.zero());
+
+    const int srcWidth(src.width());
+    const int dstWidth(dst.width());
+    const std::size_t rowSize(std::size_t(dstWidth) * Channels);
+
+    // ring buffer of horizontally filtered source rows
+    std::vector<float> ring(y.taps * rowSize);
+    std::vector<int> ringRow(y.taps, -1);
+    std::vector<float> line(std::size_t(srcWidth) * Channels);
+    std::vector<float> acc(rowSize);
+
+    const auto filtered([&](int sy) -> const float*
+    {
+        const int slot(sy % y.taps);
+        float *out(ring.data() + slot * rowSize);
+        if (ringRow[slot] == sy) { return out; }
+        ringRow[slot] = sy;
+
+        auto *l(line.data());
+        for (auto is(src.row_begin(sy)), ie(is + srcWidth); is != ie; ++is) {
+            for (int c(0); c < Channels; ++c) { *l++ = (*is)[c]; }
+        }
+        horizontal<Channels>(out, line.data(), x);
+        return out;
+    });
+
+    for (int i(rowBegin); i < rowEnd; ++i) {
+        std::fill(acc.begin(), acc.end(), 0.f);
+
+        const float *w(y.at(i));
+        for (int k(0), ke(y.count[i]); k != ke; ++k) {
+            axpy(acc.data(), filtered(y.first[i] + k), w[k], rowSize);
+        }
+
+        const float *a(acc.data());
+        auto dstit(dst.row_begin(i));
+        for (int j(0); j < dstWidth; ++j, a += Channels) {
+            const double weightSum(x.weightSum[j] * y.weightSum[i]);
+            Pixel px;
+            for (int c(0); c < Channels; ++c) {
+                if (weightSum > 1e-15) {
+                    px[c] = pl.clamp(a[c] / weightSum);
+                } else {
+                    px[c] = zero[c];
+                }
+            }
+            *dstit++ = px;
+        }
+    }
+}
+
+} } } // namespace imgproc::detail::resample
+
+#endif // imgproc_detail_resample_hpp_included_
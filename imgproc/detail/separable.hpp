@@ -0,0 +1,72 @@
+/**
+ * Copyright (c) 2021 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file detail/separable.hpp
+ *
+ * Numerical separability test of 2D filters.
+ */
+
+#ifndef imgproc_detail_separable_hpp_included_
+#define imgproc_detail_separable_hpp_included_
+
+#include <cmath>
+
+namespace imgproc { namespace detail {
+
+/** Checks whether 2D filter is a product of its marginals, i.e. whether
+ *  f(x, y) * f(0, 0) == f(x, 0) * f(0, y) on a sample grid covering the
+ *  filter window. Filters with zero center are never considered separable.
+ */
+template <typename Filter2>
+bool separable(const Filter2 &filter)
+{
+    const double center(filter(0.0, 0.0));
+    if (std::abs(center) < 1e-12) { return false; }
+
+    // samples are offset from the integer grid to avoid hitting only zeros
+    // of sinc-like filters
+    const int samples(9);
+    const double tolerance(1e-9 * center * center);
+    for (int j(0); j < samples; ++j) {
+        const double y(filter.halfwiny() * (0.977 * (2.0 * j + 0.61)
+                                             / samples - 0.977));
+        const double fy(filter(0.0, y));
+        for (int i(0); i < samples; ++i) {
+            const double x(filter.halfwinx() * (0.977 * (2.0 * i + 0.39)
+                                                 / samples - 0.977));
+            if (std::abs(filter(x, y) * center - filter(x, 0.0) * fy)
+                > tolerance)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+} } // namespace imgproc::detail
+
+#endif // imgproc_detail_separable_hpp_included_
@@ -148,7 +148,10 @@ inline typename SrcView::value_type reconstruct( const SrcView & view,
     ur.x = (int) ceil( pos.x + filter.halfwinx() );
     ur.y = (int) ceil( pos.y + filter.halfwiny() );
 
-    typename SrcView::xy_locator cpos = view.xy_at( ll.x, ll.y );
+    // filter window may reach outside of view: use locator arithmetic
+    // (xy_at() asserts position lies inside view)
+    typename SrcView::xy_locator cpos = view.xy_at( 0, 0 )
+        + gil::point2<std::ptrdiff_t>( ll.x, ll.y );
 
     auto numChannels = gil::num_channels<SrcView>::value;
     using ChannelT = decltype(numChannels);
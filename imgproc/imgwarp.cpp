@@ -24,89 +24,291 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <cmath>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#if defined(__SSE2__)
+#  include <emmintrin.h>
+#endif
+
 #include "imgwarp.hpp"
 #include "utility/openmp.hpp"
 #include "math/math.hpp"
 
-// Computes a value of given image functor at floating-point coordinates,
-// using bilinear interpolation.
-template <typename TImg>
-static float interpolate(const float x, const float y, const TImg& img) {
-    const int x0 = int(std::floor(x));
-    const int y0 = int(std::floor(y));
-    const float fx = x - x0;
-    const float fy = y - y0;
+namespace {
+
+// Returns i % n for i>0 and i % n + n for i<0
+int positiveMod(const int i, const int n) {
+     return (i % n + n) % n;
+}
+
+// Border modes. Each maps pixel coordinates outside of the image into the
+// image and returns true, or returns false if border value is to be used.
+
+struct BorderConstant {
+    static bool map(int&, int&, const int, const int, const int, const int) {
+        return false;
+    }
+};
+
+struct BorderReplicate {
+    static bool map(int& x, int& y, const int maxX, const int maxY, const int, const int) {
+        x = math::clamp(x, 0, maxX);
+        y = math::clamp(y, 0, maxY);
+        return true;
+    }
+};
+
+struct BorderReflect {
+    static bool map(int& x, int& y, const int maxX, const int maxY, const int, const int) {
+        const int x1 = x - (x < 0) * (2 * x + 1) + (x > maxX) * (2 * maxX - 2 * x + 1);
+        const int y1 = y - (y < 0) * (2 * y + 1) + (y > maxY) * (2 * maxY - 2 * y + 1);
+        x = math::clamp(x1, 0, maxX);
+        y = math::clamp(y1, 0, maxY);
+        return true;
+    }
+};
+
+struct BorderWrap {
+    static bool map(int& x, int& y, const int, const int, const int cols, const int rows) {
+        x = positiveMod(x, cols);
+        y = positiveMod(y, rows);
+        return true;
+    }
+};
+
+struct BorderReflect101 {
+    static bool map(int& x, int& y, const int maxX, const int maxY, const int, const int) {
+        const int x1 = x - (x < 0) * 2 * x + (x > maxX) * (2 * maxX - 2 * x);
+        const int y1 = y - (y < 0) * 2 * y + (y > maxY) * (2 * maxY - 2 * y);
+        x = math::clamp(x1, 0, maxX);
+        y = math::clamp(y1, 0, maxY);
+        return true;
+    }
+};
+
+// Computes source coordinates of count pixels of destination row y.
+void homography(const cv::Mat_<double>& Hinv, const int y, const int count,
+                float* u, float* v) {
+    const double h00 = Hinv(0, 0), h01 = Hinv(0, 1) * y, h02 = Hinv(0, 2);
+    const double h10 = Hinv(1, 0), h11 = Hinv(1, 1) * y, h12 = Hinv(1, 2);
+    const double h20 = Hinv(2, 0), h21 = Hinv(2, 1) * y, h22 = Hinv(2, 2);
 
-    const float v00 = img(x0, y0);
-    const float v01 = img(x0 + 1, y0);
-    const float v10 = img(x0, y0 + 1);
-    const float v11 = img(x0 + 1, y0 + 1);
+    int x = 0;
+#if defined(__SSE2__)
+    const __m128d a00 = _mm_set1_pd(h00), a01 = _mm_set1_pd(h01), a02 = _mm_set1_pd(h02);
+    const __m128d a10 = _mm_set1_pd(h10), a11 = _mm_set1_pd(h11), a12 = _mm_set1_pd(h12);
+    const __m128d a20 = _mm_set1_pd(h20), a21 = _mm_set1_pd(h21), a22 = _mm_set1_pd(h22);
+    const __m128d one = _mm_set1_pd(1.0), two = _mm_set1_pd(2.0);
+    __m128d xx = _mm_set_pd(1.0, 0.0);
+    for (; x + 2 <= count; x += 2, xx = _mm_add_pd(xx, two)) {
+        const __m128d iw = _mm_div_pd(
+            one, _mm_add_pd(_mm_add_pd(_mm_mul_pd(a20, xx), a21), a22));
+        const __m128d uu = _mm_mul_pd(
+            _mm_add_pd(_mm_add_pd(_mm_mul_pd(a00, xx), a01), a02), iw);
+        const __m128d vv = _mm_mul_pd(
+            _mm_add_pd(_mm_add_pd(_mm_mul_pd(a10, xx), a11), a12), iw);
+        _mm_storel_pi(reinterpret_cast<__m64*>(u + x), _mm_cvtpd_ps(uu));
+        _mm_storel_pi(reinterpret_cast<__m64*>(v + x), _mm_cvtpd_ps(vv));
+    }
+#endif
+    for (; x < count; ++x) {
+        const double iw = 1.0 / (h20 * x + h21 + h22);
+        u[x] = (h00 * x + h01 + h02) * iw;
+        v[x] = (h10 * x + h11 + h12) * iw;
+    }
+}
 
+// Bilinear interpolation of one channel, same operation order as
+// interpolation of a scalar image.
+inline float bilinear(const float v00, const float v01, const float v10, const float v11,
+                      const float fx, const float fy) {
     const float w0 = v00 + (v01 - v00) * fx;
     const float w1 = v10 + (v11 - v10) * fx;
-
     return w0 + (w1 - w0) * fy;
 }
 
-// Returns i % n for i>0 and i % n + n for i<0
-static int positiveMod(const int i, const int n) {
-     return (i % n + n) % n;
+#if defined(__SSE2__)
+// Rounds 4 floats down to integers, same as int(std::floor(value)).
+inline __m128i floor4(const __m128 value) {
+    const __m128i t = _mm_cvttps_epi32(value);
+    // truncation rounds negative values up: subtract one (mask is -1) there
+    return _mm_add_epi32(
+        t, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(t), value)));
 }
 
-static float handleBorderAndIntepolate(const cv::Mat& img, const float u, const float v,
-                                       const int border, const uchar borderValue) {
-    const int maxX = img.cols - 1;
-    const int maxY = img.rows - 1;
+// Interpolates 4 consecutive destination pixels at once if all of them fall
+// inside the source image (i.e. no border handling is needed). Taps are
+// gathered per channel and blended in the operation order of bilinear(),
+// results are identical to the scalar path. Returns false if any pixel
+// needs border handling.
+template <typename T, int Channels>
+bool interior4(const cv::Mat& src, const int maxX, const int maxY,
+               const float* us, const float* vs, T* out) {
+    const __m128 u = _mm_loadu_ps(us);
+    const __m128 v = _mm_loadu_ps(vs);
+    const __m128i x0 = floor4(u);
+    const __m128i y0 = floor4(v);
+
+    // interior: 0 <= x0 < maxX and 0 <= y0 < maxY
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i outside = _mm_or_si128(
+        _mm_or_si128(_mm_cmplt_epi32(x0, zero),
+                     _mm_cmpgt_epi32(x0, _mm_set1_epi32(maxX - 1))),
+        _mm_or_si128(_mm_cmplt_epi32(y0, zero),
+                     _mm_cmpgt_epi32(y0, _mm_set1_epi32(maxY - 1))));
+    if (_mm_movemask_epi8(outside)) { return false; }
+
+    const __m128 fx = _mm_sub_ps(u, _mm_cvtepi32_ps(x0));
+    const __m128 fy = _mm_sub_ps(v, _mm_cvtepi32_ps(y0));
+
+    alignas(16) int xs[4], ys[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(xs), x0);
+    _mm_store_si128(reinterpret_cast<__m128i*>(ys), y0);
+
+    const T *r0[4], *r1[4];
+    for (int i = 0; i < 4; ++i) {
+        r0[i] = src.ptr<T>(ys[i]) + xs[i] * Channels;
+        r1[i] = src.ptr<T>(ys[i] + 1) + xs[i] * Channels;
+    }
+
+    const auto gather = [](const T* const* p, const int c) -> __m128 {
+        return _mm_set_ps(p[3][c], p[2][c], p[1][c], p[0][c]);
+    };
+
+    for (int c = 0; c < Channels; ++c) {
+        const __m128 v00 = gather(r0, c), v01 = gather(r0, c + Channels);
+        const __m128 v10 = gather(r1, c), v11 = gather(r1, c + Channels);
+        const __m128 w0 = _mm_add_ps(v00, _mm_mul_ps(_mm_sub_ps(v01, v00), fx));
+        const __m128 w1 = _mm_add_ps(v10, _mm_mul_ps(_mm_sub_ps(v11, v10), fx));
+
+        alignas(16) float result[4];
+        _mm_store_ps(result,
+                     _mm_add_ps(w0, _mm_mul_ps(_mm_sub_ps(w1, w0), fy)));
+        for (int i = 0; i < 4; ++i) {
+            out[i * Channels + c] = T(result[i]);
+        }
+    }
+    return true;
+}
+#endif
+
+template <typename T, int Channels, typename Border>
+void warp(const cv::Mat& src, cv::Mat& dst, const cv::Mat_<double>& Hinv,
+          const double borderValue) {
+    const int maxX = src.cols - 1;
+    const int maxY = src.rows - 1;
+
+    T outside[Channels];
+    for (int c = 0; c < Channels; ++c) {
+        outside[c] = cv::saturate_cast<T>(borderValue);
+    }
+
+    // pointer to source pixel, handles border
+    const auto pixel = [&](int x, int y) -> const T* {
+        if (uint(x) <= uint(maxX) && uint(y) <= uint(maxY)) {
+            return src.ptr<T>(y) + x * Channels;
+        }
+        if (!Border::map(x, y, maxX, maxY, src.cols, src.rows)) {
+            return outside;
+        }
+        return src.ptr<T>(y) + x * Channels;
+    };
+
+    UTILITY_OMP(parallel shared(dst))
+    {
+        std::vector<float> us(dst.cols), vs(dst.cols);
+
+        UTILITY_OMP(for schedule(static))
+        for (int y = 0; y < dst.rows; y++) {
+            homography(Hinv, y, dst.cols, us.data(), vs.data());
+
+            T* out = dst.ptr<T>(y);
+            for (int x = 0; x < dst.cols; x++, out += Channels) {
+#if defined(__SSE2__)
+                // gathering taps costs more than the blend of a single
+                // channel saves, vectorize multi-channel images only
+                if ((Channels > 1) && (x + 4 <= dst.cols)
+                    && interior4<T, Channels>(src, maxX, maxY, &us[x], &vs[x], out)) {
+                    x += 3;
+                    out += 3 * Channels;
+                    continue;
+                }
+#endif
+                const float u = us[x];
+                const float v = vs[x];
+                const int x0 = int(std::floor(u));
+                const int y0 = int(std::floor(v));
+                const float fx = u - x0;
+                const float fy = v - y0;
+
+                const T *p00, *p01, *p10, *p11;
+                if (uint(x0) < uint(maxX) && uint(y0) < uint(maxY)) {
+                    // interior: all 4 pixels inside
+                    p00 = src.ptr<T>(y0) + x0 * Channels;
+                    p01 = p00 + Channels;
+                    p10 = src.ptr<T>(y0 + 1) + x0 * Channels;
+                    p11 = p10 + Channels;
+                } else {
+                    p00 = pixel(x0, y0);
+                    p01 = pixel(x0 + 1, y0);
+                    p10 = pixel(x0, y0 + 1);
+                    p11 = pixel(x0 + 1, y0 + 1);
+                }
+
+                for (int c = 0; c < Channels; ++c) {
+                    out[c] = T(bilinear(p00[c], p01[c], p10[c], p11[c], fx, fy));
+                }
+            }
+        }
+    }
+}
+
+template <typename T, int Channels>
+void warp(const cv::Mat& src, cv::Mat& dst, const cv::Mat_<double>& Hinv,
+          const int border, const double borderValue) {
     switch (border) {
     case cv::BORDER_CONSTANT:
-        return interpolate(u, v, [maxX, maxY, borderValue, &img](const int x, const int y) {
-            if (uint(x) <= uint(maxX) && uint(y) <= uint(maxY)) {
-                return img.at<uchar>(y, x);
-            } else {
-                return borderValue;
-            }
-        });
+        return warp<T, Channels, BorderConstant>(src, dst, Hinv, borderValue);
     case cv::BORDER_REPLICATE:
-        return interpolate(u, v, [maxX, maxY, &img](const int x, const int y) {
-            return img.at<uchar>(math::clamp(y, 0, maxY), math::clamp(x, 0, maxX));
-        });
+        return warp<T, Channels, BorderReplicate>(src, dst, Hinv, borderValue);
     case cv::BORDER_REFLECT:
-        return interpolate(u, v, [maxX, maxY, &img](const int x, const int y) {
-            const int x1 = x - (x < 0) * (2 * x + 1) + (x > maxX) * (2 * maxX - 2 * x + 1);
-            const int y1 = y - (y < 0) * (2 * y + 1) + (y > maxY) * (2 * maxY - 2 * y + 1);
-            return img.at<uchar>(math::clamp(y1, 0, maxY), math::clamp(x1, 0, maxX));
-        });
+        return warp<T, Channels, BorderReflect>(src, dst, Hinv, borderValue);
     case cv::BORDER_WRAP:
-        return interpolate(u, v, [&img](const int x, const int y) {
-            return img.at<uchar>(positiveMod(y, img.rows), positiveMod(x, img.cols));
-        });
+        return warp<T, Channels, BorderWrap>(src, dst, Hinv, borderValue);
     case cv::BORDER_REFLECT_101:
-        return interpolate(u, v, [maxX, maxY, &img](const int x, const int y) {
-            const int x1 = x - (x < 0) * 2 * x + (x > maxX) * (2 * maxX - 2 * x);
-            const int y1 = y - (y < 0) * 2 * y + (y > maxY) * (2 * maxY - 2 * y);
-            return img.at<uchar>(math::clamp(y1, 0, maxY), math::clamp(x1, 0, maxX));
-        });
+        return warp<T, Channels, BorderReflect101>(src, dst, Hinv, borderValue);
     default:
         throw std::runtime_error("Unknown border mode " + std::to_string(border));
     }
 }
 
+} // namespace
+
 void imgproc::warpPerspective(const cv::Mat& src, cv::Mat& dst, const cv::Mat& H, const cv::Size dsize,
-    const int border, const uchar borderValue) {
-    dst.create(dsize, CV_8U);
+    const int border, const double borderValue) {
+    if (src.empty()) {
+        throw std::runtime_error("Cannot warp an empty image");
+    }
+
+    dst.create(dsize, src.type());
 
     cv::Mat_<double> Hinv;
     cv::invert(H, Hinv);
 
-    UTILITY_OMP(parallel for shared(dst))
-    for (int y = 0; y < dst.rows; y++) {
-        for (int x = 0; x < dst.cols; x++) {
-            const double iw = 1.0 / (Hinv(2, 0) * x + Hinv(2, 1) * y + Hinv(2, 2));
-
-            const float u = (Hinv(0, 0) * x + Hinv(0, 1) * y + Hinv(0, 2)) * iw;
-            const float v = (Hinv(1, 0) * x + Hinv(1, 1) * y + Hinv(1, 2)) * iw;
-
-            dst.at<uchar>(y, x) = handleBorderAndIntepolate(src, u, v, border, borderValue);
-        }
+    switch (src.type()) {
+    case CV_8UC1: return warp<uchar, 1>(src, dst, Hinv, border, borderValue);
+    case CV_8UC3: return warp<uchar, 3>(src, dst, Hinv, border, borderValue);
+    case CV_8UC4: return warp<uchar, 4>(src, dst, Hinv, border, borderValue);
+    case CV_16UC1: return warp<ushort, 1>(src, dst, Hinv, border, borderValue);
+    case CV_16UC3: return warp<ushort, 3>(src, dst, Hinv, border, borderValue);
+    case CV_16UC4: return warp<ushort, 4>(src, dst, Hinv, border, borderValue);
+    case CV_32FC1: return warp<float, 1>(src, dst, Hinv, border, borderValue);
+    case CV_32FC3: return warp<float, 3>(src, dst, Hinv, border, borderValue);
+    case CV_32FC4: return warp<float, 4>(src, dst, Hinv, border, borderValue);
+    default:
+        throw std::runtime_error("Unsupported image type " + std::to_string(src.type()));
     }
 }
@@ -43,16 +43,17 @@ namespace imgproc {
  * necessary due to bad performance of the OpenCV function with OpenMP parallelization.
  * The results should be identical, except for minor numerical differences.
  *
- * @param src         Input image of type CV_8U
- * @param dst         Output image, resized and filled by the function
+ * @param src         Input image of type CV_8U, CV_16U or CV_32F with 1, 3 or 4 channels
+ * @param dst         Output image of the same type as src, resized and filled by the function
  * @param H           3x3 matrix of the transformation
  * @param dsize       Required size of the output image
  * @param border      Specifies handling of pixels outside of the image area.
  *                    Uses values from enum \ref cv::BorderTypes.
- * @param borderValue Value assigned to outside pixels for border mode cv::BORDER_CONSTANT.
+ * @param borderValue Value assigned to all channels of outside pixels for border mode
+ *                    cv::BORDER_CONSTANT (saturated to image depth).
  */
 void warpPerspective(const cv::Mat& src, cv::Mat& dst, const cv::Mat& H, const cv::Size dsize,
-    const int border, const uchar borderValue = 0);
+    const int border, const double borderValue = 0);
 
 } // namespace imgproc
 
@@ -34,6 +34,11 @@
 #ifndef imgproc_inpaint_hpp_included_
 #define imgproc_inpaint_hpp_included_
 
+#include <cstdint>
+#include <vector>
+#include <set>
+#include <algorithm>
+
 #include <opencv2/core/core.hpp>
 
 #include "utility/gccversion.hpp"
@@ -43,16 +48,38 @@
 #include "scattered-interpolation.hpp"
 #include "utility/openmp.hpp"
 
+#include "detail/inpaint.hpp"
+
 namespace imgproc {
 
 #if !defined(IMGPROC_HAS_OPENCV) || !defined(IMGPROC_HAS_EIGEN3)
     UTILITY_FUNCTION_ERROR("JPEG inpaint is available only when compiled with both OpenCV and Eigen3 libraries.")
 #endif
 
+namespace detail {
+
+template<typename T_DATA, int nChan>
+void jpegBlockInpaintGeneric(cv::Mat &img, const cv::Mat &mask,
+                             int blkWidth, int blkHeight, float eps);
+
+template<typename T_DATA, int nChan>
+void jpegBlockInpaintPatterns(cv::Mat &img, const cv::Mat &mask,
+                              int blkWidth, int blkHeight,
+                              std::size_t maxPatterns);
+
+} // namespace detail
+
 /** Fill in pixels in JPEG blocks that have zeros in 'mask', with values
  *  interpolated from neighboring pixels with nonzero 'mask'. Completely
  *  empty blocks are filled with zeros. Completely full blocks are left intact.
  *
+ *  Blocks of at most 64 pixels are solved exactly: the interpolation of
+ *  each distinct mask pattern is factorized once and reused by all blocks
+ *  sharing the pattern ('eps' is unused). Blocks are processed in runs
+ *  holding at most detail::inpaint::MaxPatterns distinct patterns, solvers
+ *  of a run are freed before the next one starts. Larger blocks are solved
+ *  one by one by laplaceInterpolate() with tolerance 'eps'.
+ *
  *  typename T_DATA: numeric type of (per-channel) elements of 'img' matrix
  *  int nChan:       number of channels of 'img' matrix
  *
@@ -67,6 +94,154 @@ void jpegBlockInpaint(cv::Mat &img, const cv::Mat &mask,
 
     assert(sizeof(T_DATA) == img.elemSize1() && img.channels() == nChan);
 
+    if (blkWidth * blkHeight > detail::inpaint::MaxBlockArea) {
+        detail::jpegBlockInpaintGeneric<T_DATA, nChan>
+            (img, mask, blkWidth, blkHeight, eps);
+        return;
+    }
+
+    detail::jpegBlockInpaintPatterns<T_DATA, nChan>
+        (img, mask, blkWidth, blkHeight, detail::inpaint::MaxPatterns);
+
+    //cv::imwrite("inpaint.png", img);
+}
+
+namespace detail {
+
+/** Pattern-table jpegBlockInpaint() for blocks of at most 64 pixels: at most
+ *  'maxPatterns' solvers are alive at any time.
+ */
+template<typename T_DATA, int nChan>
+void jpegBlockInpaintPatterns(cv::Mat &img, const cv::Mat &mask,
+                              int blkWidth, int blkHeight,
+                              std::size_t maxPatterns)
+{
+    using inpaint::BlockKey;
+    using inpaint::BlockSolver;
+    using cvVec = cv::Vec<T_DATA, nChan>;
+
+    // at least one pattern per run to make progress
+    maxPatterns = std::max(maxPatterns, std::size_t(1));
+
+    const int bxCount = (img.cols + blkWidth - 1) / blkWidth;
+    const int byCount = (img.rows + blkHeight - 1) / blkHeight;
+    const int blkCount = bxCount * byCount;
+
+    // mask pattern of every block
+    std::vector<BlockKey> keys(blkCount);
+
+    UTILITY_OMP(parallel for)
+    for (int j = 0; j < byCount; ++j)
+    {
+        const int by = j * blkHeight, h = std::min(blkHeight, img.rows - by);
+        for (int i = 0; i < bxCount; ++i)
+        {
+            const int bx = i * blkWidth, w = std::min(blkWidth, img.cols - bx);
+
+            auto &key = keys[j * bxCount + i];
+            key.width = w;
+            key.height = h;
+            for (int y = 0, p = 0; y < h; ++y)
+            {
+                const auto *m = mask.ptr<uchar>(by + y) + bx;
+                for (int x = 0; x < w; ++x, ++p)
+                {
+                    if (m[x]) { key.given |= std::uint64_t(1) << p; }
+                }
+            }
+        }
+    }
+
+    // runs of blocks with at most maxPatterns distinct partial patterns,
+    // one solver per pattern, freed at the end of the run
+    for (int b0 = 0, b1 = 0; b0 < blkCount; b0 = b1)
+    {
+        std::set<BlockKey> distinct;
+        for (; b1 < blkCount; ++b1)
+        {
+            const auto &key = keys[b1];
+            if (key.full() || key.empty()) { continue; }
+            if ((distinct.size() >= maxPatterns) && !distinct.count(key)) {
+                break;
+            }
+            distinct.insert(key);
+        }
+
+        const std::vector<BlockKey> patterns(distinct.begin()
+                                             , distinct.end());
+        distinct.clear();
+
+        LOG(debug) << "Inpainting blocks " << b0 << "-" << b1 << " of "
+                   << blkCount << " with " << patterns.size()
+                   << " distinct partial patterns.";
+
+        std::vector<BlockSolver> solvers(patterns.size());
+
+        UTILITY_OMP(parallel for schedule(dynamic))
+        for (int k = 0; k < int(patterns.size()); ++k)
+        {
+            solvers[k] = BlockSolver(patterns[k]);
+        }
+
+        UTILITY_OMP(parallel for schedule(dynamic, 64))
+        for (int b = b0; b < b1; ++b)
+        {
+            const auto &key = keys[b];
+            if (key.full()) { continue; }
+
+            const int bx = (b % bxCount) * blkWidth;
+            const int by = (b / bxCount) * blkHeight;
+            const auto pixel([&](int p) -> cvVec&
+            {
+                return img.at<cvVec>(by + p / key.width
+                                     , bx + p % key.width);
+            });
+
+            if (key.empty()) // make sure empty block is zeroed
+            {
+                const int area = key.width * key.height;
+                for (int p = 0; p < area; ++p) { pixel(p) = cvVec(); }
+                continue;
+            }
+
+            const auto &solver
+                = solvers[std::lower_bound(patterns.begin(), patterns.end()
+                                           , key) - patterns.begin()];
+
+            const int m = solver.given.size();
+            float given[inpaint::MaxBlockArea][nChan];
+            for (int g = 0; g < m; ++g)
+            {
+                const auto &value = pixel(solver.given[g]);
+                for (int c = 0; c < nChan; ++c) { given[g][c] = value[c]; }
+            }
+
+            const float *weights = solver.weights.data();
+            for (const auto p : solver.free)
+            {
+                float sum[nChan] = {};
+                for (int g = 0; g < m; ++g, ++weights)
+                {
+                    for (int c = 0; c < nChan; ++c) {
+                        sum[c] += *weights * given[g][c];
+                    }
+                }
+
+                auto &value = pixel(p);
+                for (int c = 0; c < nChan; ++c) {
+                    value[c] = cv::saturate_cast<T_DATA>(sum[c]);
+                }
+            }
+        }
+    }
+}
+
+/** Generic jpegBlockInpaint(): solves every partial block separately.
+ */
+template<typename T_DATA, int nChan>
+void jpegBlockInpaintGeneric(cv::Mat &img, const cv::Mat &mask,
+                             int blkWidth, int blkHeight, float eps)
+{
     const auto zeroVec = cv::Vec<T_DATA, nChan>();
 
     UTILITY_OMP(parallel for shared(img))
@@ -101,10 +276,10 @@ void jpegBlockInpaint(cv::Mat &img, const cv::Mat &mask,
             }
         }
     }
-
-    //cv::imwrite("inpaint.png", img);
 }
 
+} // namespace detail
+
 } // imgproc
 
 #endif // imgproc_inpaint_hpp_included_
@@ -0,0 +1,151 @@
+/**
+ * Copyright (c) 2021 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file morphology.cpp
+ *
+ * Morphological operations on bit-field raster mask.
+ */
+
+#include <vector>
+#include <algorithm>
+
+#include "rastermask/bitfield.hpp"
+
+#include "morphology.hpp"
+
+namespace imgproc { namespace bitfield {
+
+namespace {
+
+typedef RasterMask::Word Word;
+const int WordBits(RasterMask::WordBits);
+
+/** dst |= src shifted by d pixels: pixel x of result is pixel x + d of
+ *  source (pixels outside of row are zero).
+ */
+void shiftOr(Word *dst, const Word *src, int n, int d)
+{
+    const int q((d >= 0) ? (d / WordBits) : (-d / WordBits));
+    const int s((d >= 0) ? (d % WordBits) : (-d % WordBits));
+
+    const auto at([&](int i) -> Word {
+        return ((i >= 0) && (i < n)) ? src[i] : Word(0);
+    });
+
+    if (d >= 0) {
+        for (int i(0); i < n; ++i) {
+            dst[i] |= s ? ((at(i + q) >> s)
+                           | (at(i + q + 1) << (WordBits - s)))
+                : at(i + q);
+        }
+    } else {
+        for (int i(0); i < n; ++i) {
+            dst[i] |= s ? ((at(i - q) << s)
+                           | (at(i - q - 1) >> (WordBits - s)))
+                : at(i - q);
+        }
+    }
+}
+
+/** In place OR of w consecutive pixels of a row: pixel x becomes OR of
+ *  pixels [x, x + w) for direction 1 and (x - w, x] for direction -1. Built
+ *  by doubling, i.e. O(log w) word passes.
+ */
+void runningOr(Word *row, int n, int w, int direction, Word *tmp)
+{
+    int len(1);
+    while (2 * len <= w) {
+        std::copy(row, row + n, tmp);
+        shiftOr(row, tmp, n, direction * len);
+        len *= 2;
+    }
+    if (len < w) {
+        std::copy(row, row + n, tmp);
+        shiftOr(row, tmp, n, direction * (w - len));
+    }
+}
+
+/** Horizontal dilation of one row in place: [x, x + radius] followed by
+ *  [x - radius, x] gives window [x - radius, x + radius].
+ */
+void dilateRow(Word *row, int n, int radius, Word trail, Word *tmp)
+{
+    runningOr(row, n, radius + 1, 1, tmp);
+    runningOr(row, n, radius + 1, -1, tmp);
+    row[n - 1] &= trail;
+}
+
+} // namespace
+
+void dilate(RasterMask &mask, int kernelSize)
+{
+    const int radius(kernelSize / 2);
+    const auto &size(mask.dims());
+    const int n(mask.stride());
+    if ((radius <= 0) || !n || !size.height) { return; }
+
+    const int rest(size.width % WordBits);
+    const Word trail(rest ? ((Word(1) << rest) - 1) : ~Word(0));
+
+    UTILITY_OMP(parallel)
+    {
+        std::vector<Word> tmp(n);
+        UTILITY_OMP(for schedule(static))
+        for (int y = 0; y < size.height; ++y) {
+            dilateRow(mask.row(y), n, radius, trail, tmp.data());
+        }
+    }
+
+    // whole words as vector elements
+    imgproc::detail::morphology::columns
+        (mask.row(0), n, n, size.height, radius
+         , imgproc::detail::morphology::Or<Word>());
+
+    mask.recount();
+}
+
+void erode(RasterMask &mask, int kernelSize)
+{
+    // erosion is dilation of complement; padding stays zero, i.e. outside
+    // pixels do not erode
+    mask.invert();
+    dilate(mask, kernelSize);
+    mask.invert();
+}
+
+void open(RasterMask &mask, int kernelSize)
+{
+    erode(mask, kernelSize);
+    dilate(mask, kernelSize);
+}
+
+void close(RasterMask &mask, int kernelSize)
+{
+    dilate(mask, kernelSize);
+    erode(mask, kernelSize);
+}
+
+} } // namespace imgproc::bitfield
@@ -26,75 +26,292 @@
 #ifndef IMGPROC_MORPHOLOGY_HPP
 #define IMGPROC_MORPHOLOGY_HPP
 
+#include <cstddef>
+#include <limits>
+#include <vector>
+#include <algorithm>
+
+#include "utility/openmp.hpp"
+
 #include "math/geometry_core.hpp"
 
+#include "rastermask/bitfieldfwd.hpp"
+
 #if IMGPROC_HAS_OPENCV
 #include <opencv2/core/core.hpp>
 #endif
 
+/** Morphological operations with square (kernelSize / 2 * 2 + 1) kernel.
+ *  Pixels outside of image are ignored (i.e. image border never erodes).
+ *
+ *  Implemented as separable running minimum/maximum (van Herk/Gil-Werman),
+ *  i.e. O(1) operations per pixel regardless of kernel size.
+ */
+
 namespace imgproc {
 
 #if IMGPROC_HAS_OPENCV
+/** Erodes single channel matrix in place.
+ */
 template<typename MatType>
-void erode(cv::Mat &mat, int kernelSize = 3)
-{
-    cv::Mat result(mat.rows, mat.cols, mat.type());
+void erode(cv::Mat &mat, int kernelSize = 3);
 
-    kernelSize /= 2;
+/** Dilates single channel matrix in place.
+ */
+template<typename MatType>
+void dilate(cv::Mat &mat, int kernelSize = 3);
 
-    for (int y = 0; y < mat.rows; y++)
-    for (int x = 0; x < mat.cols; x++)
-    {
-        MatType minimum = mat.at<MatType>(y, x);
+/** Morphological opening (erode, then dilate).
+ */
+template<typename MatType>
+void open(cv::Mat &mat, int kernelSize = 3);
 
-        for (int i = -kernelSize; i <= kernelSize; i++) {
-            if (y+i < 0 || y+i >= mat.rows) continue;
+/** Morphological closing (dilate, then erode).
+ */
+template<typename MatType>
+void close(cv::Mat &mat, int kernelSize = 3);
+#endif
 
-            for (int j = -kernelSize; j <= kernelSize; j++) {
-                if (x+j < 0 || x+j >= mat.cols) continue;
+namespace bitfield {
 
-                MatType value = mat.at<MatType>(y+i, x+j);
-                minimum = std::min(value, minimum);
-            }
+/** Erodes mask in place.
+ */
+void erode(RasterMask &mask, int kernelSize = 3);
+
+/** Dilates mask in place.
+ */
+void dilate(RasterMask &mask, int kernelSize = 3);
+
+/** Morphological opening (erode, then dilate).
+ */
+void open(RasterMask &mask, int kernelSize = 3);
+
+/** Morphological closing (dilate, then erode).
+ */
+void close(RasterMask &mask, int kernelSize = 3);
+
+} // namespace bitfield
+
+namespace detail { namespace morphology {
+
+template <typename T>
+struct Min {
+    static T identity() { return std::numeric_limits<T>::max(); }
+    T operator()(T a, T b) const { return std::min(a, b); }
+};
+
+template <typename T>
+struct Max {
+    static T identity() { return std::numeric_limits<T>::lowest(); }
+    T operator()(T a, T b) const { return std::max(a, b); }
+};
+
+template <typename T>
+struct Or {
+    static T identity() { return T(0); }
+    T operator()(T a, T b) const { return a | b; }
+};
+
+/** Number of columns processed together by columns().
+ */
+constexpr int ColumnStripe(64);
+
+/** Running extremum over window of 2 * radius + 1 elements of one line
+ *  (van Herk/Gil-Werman), in place. Buffers p, g and h must hold at least
+ *  n + 2 * radius elements rounded up to a multiple of window size.
+ */
+template <typename T, typename Op>
+void line(T *data, int n, int radius, const Op &op, T *p, T *g, T *h)
+{
+    const int w(2 * radius + 1);
+    const int size(((n + 2 * radius + w - 1) / w) * w);
+
+    // padded input: identity outside of line
+    std::fill(p, p + radius, Op::identity());
+    std::copy(data, data + n, p + radius);
+    std::fill(p + radius + n, p + size, Op::identity());
+
+    // block prefix/suffix extrema
+    for (int i(0); i < size; i += w) {
+        g[i] = p[i];
+        for (int k(i + 1), ke(i + w); k < ke; ++k) {
+            g[k] = op(g[k - 1], p[k]);
         }
 
-        result.at<MatType>(y, x) = minimum;
+        h[i + w - 1] = p[i + w - 1];
+        for (int k(i + w - 2); k >= i; --k) {
+            h[k] = op(h[k + 1], p[k]);
+        }
     }
 
-    result.copyTo(mat);
+    // window of output i is [i, i + 2 * radius] in padded coordinates
+    for (int i(0); i < n; ++i) { data[i] = op(h[i], g[i + 2 * radius]); }
 }
 
-
-template<typename MatType>
-void dilate(cv::Mat &mat, int kernelSize = 3)
+/** Runs line() on all rows of image. Rows are processed in parallel.
+ *
+ *  \param data pointer to first row
+ *  \param stride distance between rows (in elements)
+ */
+template <typename T, typename Op>
+void rows(T *data, std::size_t stride, int width, int height, int radius
+          , const Op &op)
 {
-    cv::Mat result(mat.rows, mat.cols, mat.type());
+    if ((radius <= 0) || (width <= 0)) { return; }
+    const int w(2 * radius + 1);
+    const std::size_t size(((width + 2 * radius + w - 1) / w) * w);
 
-    kernelSize /= 2;
+    UTILITY_OMP(parallel)
+    {
+        std::vector<T> p(size), g(size), h(size);
+        UTILITY_OMP(for schedule(static))
+        for (int y = 0; y < height; ++y) {
+            line(data + y * stride, width, radius, op
+                 , p.data(), g.data(), h.data());
+        }
+    }
+}
 
-    for (int y = 0; y < mat.rows; y++)
-    for (int x = 0; x < mat.cols; x++)
+/** Running extremum over window of 2 * radius + 1 rows, in place.
+ *
+ *  Whole rows are treated as vectors: van Herk/Gil-Werman is run block by
+ *  block on stripes of ColumnStripe columns so that inner loops are
+ *  contiguous and only three blocks of each stripe are kept in memory.
+ *  Stripes are processed in parallel.
+ */
+template <typename T, typename Op>
+void columns(T *data, std::size_t stride, int width, int height, int radius
+             , const Op &op)
+{
+    if ((radius <= 0) || (height <= 0)) { return; }
+    const int w(2 * radius + 1);
+    const int stripes((width + ColumnStripe - 1) / ColumnStripe);
+
+    UTILITY_OMP(parallel)
     {
-        MatType maximum = mat.at<MatType>(y, x);
+        std::vector<T> hcur(w * ColumnStripe), hnext(w * ColumnStripe)
+            , gnext(w * ColumnStripe);
+
+        UTILITY_OMP(for schedule(dynamic))
+        for (int s = 0; s < stripes; ++s) {
+            const int x0(s * ColumnStripe);
+            const int sw(std::min(ColumnStripe, width - x0));
+
+            // padded row i is source row i - radius, null outside
+            const auto row([&](int i) -> const T* {
+                i -= radius;
+                return ((i >= 0) && (i < height))
+                    ? (data + i * stride + x0) : nullptr;
+            });
+
+            // block prefix extrema
+            const auto prefix([&](int b, T *g) {
+                for (int k(0); k < w; ++k) {
+                    const T *r(row(b * w + k));
+                    T *gk(g + k * ColumnStripe);
+                    if (!k) {
+                        if (r) { std::copy(r, r + sw, gk); }
+                        else { std::fill(gk, gk + sw, Op::identity()); }
+                    } else if (r) {
+                        const T *prev(gk - ColumnStripe);
+                        for (int x(0); x < sw; ++x) {
+                            gk[x] = op(prev[x], r[x]);
+                        }
+                    } else {
+                        std::copy(gk - ColumnStripe, gk - ColumnStripe + sw
+                                  , gk);
+                    }
+                }
+            });
+
+            // block suffix extrema
+            const auto suffix([&](int b, T *h) {
+                for (int k(w - 1); k >= 0; --k) {
+                    const T *r(row(b * w + k));
+                    T *hk(h + k * ColumnStripe);
+                    if (k == w - 1) {
+                        if (r) { std::copy(r, r + sw, hk); }
+                        else { std::fill(hk, hk + sw, Op::identity()); }
+                    } else if (r) {
+                        const T *next(hk + ColumnStripe);
+                        for (int x(0); x < sw; ++x) {
+                            hk[x] = op(next[x], r[x]);
+                        }
+                    } else {
+                        std::copy(hk + ColumnStripe, hk + ColumnStripe + sw
+                                  , hk);
+                    }
+                }
+            });
 
-        for (int i = -kernelSize; i <= kernelSize; i++) {
-            if (y+i < 0 || y+i >= mat.rows) continue;
+            suffix(0, hcur.data());
+            for (int b(0); b * w < height; ++b) {
+                // next block must be read before this block is overwritten
+                prefix(b + 1, gnext.data());
+                suffix(b + 1, hnext.data());
 
-            for (int j = -kernelSize; j <= kernelSize; j++) {
-                if (x+j < 0 || x+j >= mat.cols) continue;
+                for (int k(0), ke(std::min(w, height - b * w)); k < ke; ++k) {
+                    T *out(data + (b * w + k) * stride + x0);
+                    const T *hk(hcur.data() + k * ColumnStripe);
+                    if (!k) {
+                        // window is exactly this block
+                        std::copy(hk, hk + sw, out);
+                        continue;
+                    }
+                    const T *gk(gnext.data() + (k - 1) * ColumnStripe);
+                    for (int x(0); x < sw; ++x) { out[x] = op(hk[x], gk[x]); }
+                }
 
-                MatType value = mat.at<MatType>(y+i, x+j);
-                maximum = std::max(value, maximum);
+                std::swap(hcur, hnext);
             }
         }
-
-        result.at<MatType>(y, x) = maximum;
     }
+}
 
-    result.copyTo(mat);
+/** Separable 2D running extremum.
+ */
+template <typename T, typename Op>
+void filter(T *data, std::size_t stride, int width, int height, int radius
+            , const Op &op)
+{
+    rows(data, stride, width, height, radius, op);
+    columns(data, stride, width, height, radius, op);
+}
+
+} } // namespace detail::morphology
+
+#if IMGPROC_HAS_OPENCV
+template<typename MatType>
+void erode(cv::Mat &mat, int kernelSize)
+{
+    detail::morphology::filter(mat.ptr<MatType>(), mat.step1(), mat.cols
+                               , mat.rows, kernelSize / 2
+                               , detail::morphology::Min<MatType>());
+}
+
+template<typename MatType>
+void dilate(cv::Mat &mat, int kernelSize)
+{
+    detail::morphology::filter(mat.ptr<MatType>(), mat.step1(), mat.cols
+                               , mat.rows, kernelSize / 2
+                               , detail::morphology::Max<MatType>());
+}
+
+template<typename MatType>
+void open(cv::Mat &mat, int kernelSize)
+{
+    erode<MatType>(mat, kernelSize);
+    dilate<MatType>(mat, kernelSize);
+}
+
+template<typename MatType>
+void close(cv::Mat &mat, int kernelSize)
+{
+    dilate<MatType>(mat, kernelSize);
+    erode<MatType>(mat, kernelSize);
 }
 #endif
 
 } // namespace imgproc
 
-#endif // IMGPROC_MORPHOLOGY_HPP
\ No newline at end of file
+#endif // IMGPROC_MORPHOLOGY_HPP
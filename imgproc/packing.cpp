@@ -0,0 +1,546 @@
+/**
+ * Copyright (c) 2021 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file packing.cpp
+ *
+ * Rectangle packing engine.
+ */
+
+#include <set>
+#include <limits>
+#include <vector>
+#include <algorithm>
+
+#include <boost/optional/optional_io.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "utility/openmp.hpp"
+
+#include "error.hpp"
+#include "packing.hpp"
+
+namespace imgproc {
+
+namespace {
+
+typedef decltype(math::area(*static_cast<math::Size2*>(nullptr)))
+    AreaType;
+
+const math::Size2 MaxSize(1 << 17, 1 << 17);
+
+/** Guillotine packing: every allocation splits a free rectangle into the
+ *  allocated one, space below it (as wide as the allocated rectangle) and
+ *  space to the right of it (full height).
+ *
+ *  Free rectangles live in an arena (slots are recycled and the arena is
+ *  reused between packing attempts) and are indexed by area only: a
+ *  rectangle is placed into the smallest free rectangle that can hold it
+ *  (best area fit). The lookup is logarithmic, followed by a scan over
+ *  rectangles of sufficient area but unsuitable shape; the scan is linear
+ *  in the number of free rectangles in the worst case (e.g. many thin
+ *  free rectangles of the wrong orientation), short in practice.
+ */
+class Guillotine {
+public:
+    /** Starts over with empty bin of given size.
+     */
+    void reset(const math::Size2 &size);
+
+    /** Allocates space for rectangle of given size. Returns false if there
+     *  is no space left.
+     */
+    bool allocate(const math::Size2 &size, math::Point2i &position);
+
+private:
+    struct Rect {
+        int x, y;
+        int width, height;
+
+        Rect(int x, int y, int width, int height)
+            : x(x), y(y), width(width), height(height)
+        {}
+    };
+
+    /** Free rectangle index entry: (area, arena slot).
+     */
+    typedef std::pair<AreaType, int> Key;
+
+    void add(int x, int y, int width, int height);
+
+    std::vector<Rect> rects_;
+    std::vector<int> unused_;
+    std::set<Key> index_;
+};
+
+void Guillotine::reset(const math::Size2 &size)
+{
+    rects_.clear();
+    unused_.clear();
+    index_.clear();
+    add(0, 0, size.width, size.height);
+}
+
+void Guillotine::add(int x, int y, int width, int height)
+{
+    if (!width || !height) { return; }
+
+    int slot;
+    if (unused_.empty()) {
+        slot = rects_.size();
+        rects_.emplace_back(x, y, width, height);
+    } else {
+        slot = unused_.back();
+        unused_.pop_back();
+        rects_[slot] = Rect(x, y, width, height);
+    }
+
+    index_.emplace(AreaType(width) * height, slot);
+}
+
+bool Guillotine::allocate(const math::Size2 &size, math::Point2i &position)
+{
+    auto iindex(index_.lower_bound(Key(math::area(size), -1)));
+    for (auto eindex(index_.end()); iindex != eindex; ++iindex) {
+        const auto &rect(rects_[iindex->second]);
+        if ((rect.width >= size.width) && (rect.height >= size.height)) {
+            break;
+        }
+    }
+    if (iindex == index_.end()) { return false; }
+
+    const int slot(iindex->second);
+    const Rect rect(rects_[slot]);
+    index_.erase(iindex);
+    unused_.push_back(slot);
+
+    position = math::Point2i(rect.x, rect.y);
+    add(rect.x, rect.y + size.height
+        , size.width, rect.height - size.height);
+    add(rect.x + size.width, rect.y
+        , rect.width - size.width, rect.height);
+    return true;
+}
+
+/** Skyline bin: used space is described by its upper envelope, a sequence
+ *  of horizontal segments covering the whole bin width from left to right.
+ *  Rectangles are placed bottom-left: at the lowest possible top edge,
+ *  leftmost on ties.
+ */
+class Skyline {
+public:
+    Skyline(const math::Size2 &size)
+        : size_(size), segments_{ Segment(0, 0, size.width) }
+    {}
+
+    /** Allocates space for rectangle of given size. Returns false if it
+     *  does not fit.
+     */
+    bool allocate(const math::Size2 &size, math::Point2i &position);
+
+    /** Enlarges bin. Already placed rectangles are kept intact.
+     */
+    void grow(const math::Size2 &size);
+
+private:
+    struct Segment {
+        int x; ///< segment start
+        int y; ///< skyline height
+        int width; ///< segment length
+
+        Segment(int x, int y, int width) : x(x), y(y), width(width) {}
+    };
+
+    typedef std::vector<Segment> Segments;
+
+    /** Computes bottom of rectangle placed at the start of given segment.
+     *  Returns -1 if rectangle does not fit.
+     */
+    int fit(Segments::size_type index, const math::Size2 &size) const;
+
+    /** Raises skyline under rectangle placed at the start of given segment.
+     */
+    void add(Segments::size_type index, int y, const math::Size2 &size);
+
+    math::Size2 size_;
+    Segments segments_;
+};
+
+int Skyline::fit(Segments::size_type index, const math::Size2 &size) const
+{
+    const auto x(segments_[index].x);
+    if ((x + size.width) > size_.width) { return -1; }
+
+    int y(0);
+    for (int remaining(size.width); remaining > 0; ++index) {
+        const auto &segment(segments_[index]);
+        y = std::max(y, segment.y);
+        if ((y + size.height) > size_.height) { return -1; }
+        remaining -= segment.width;
+    }
+    return y;
+}
+
+void Skyline::add(Segments::size_type index, int y, const math::Size2 &size)
+{
+    const int x(segments_[index].x);
+    const int end(x + size.width);
+
+    // find segments covered by the rectangle, the last one may stick out
+    auto last(index);
+    while ((last < segments_.size()) && (segments_[last].x < end)) { ++last; }
+
+    auto &tail(segments_[last - 1]);
+    const int tailEnd(tail.x + tail.width);
+
+    if (tailEnd > end) {
+        // keep the rest of the last covered segment
+        tail.width = tailEnd - end;
+        tail.x = end;
+        --last;
+    }
+
+    // replace covered segments with new one
+    if (index + 1 < last) {
+        segments_.erase(segments_.begin() + index + 1
+                        , segments_.begin() + last);
+    }
+    if (index == last) {
+        segments_.insert(segments_.begin() + index
+                         , Segment(x, y + size.height, size.width));
+    } else {
+        segments_[index] = Segment(x, y + size.height, size.width);
+    }
+
+    // merge with neighbours of the same height
+    if ((index + 1 < segments_.size())
+        && (segments_[index + 1].y == segments_[index].y))
+    {
+        segments_[index].width += segments_[index + 1].width;
+        segments_.erase(segments_.begin() + index + 1);
+    }
+    if (index && (segments_[index - 1].y == segments_[index].y)) {
+        segments_[index - 1].width += segments_[index].width;
+        segments_.erase(segments_.begin() + index);
+    }
+}
+
+bool Skyline::allocate(const math::Size2 &size, math::Point2i &position)
+{
+    Segments::size_type best(0);
+    int bestY(-1), bestTop(std::numeric_limits<int>::max());
+    for (Segments::size_type i(0), e(segments_.size()); i != e; ++i) {
+        // rectangle never goes below its own segment
+        if ((segments_[i].y + size.height) >= bestTop) { continue; }
+
+        const auto y(fit(i, size));
+        if ((y >= 0) && ((y + size.height) < bestTop)) {
+            best = i;
+            bestY = y;
+            bestTop = y + size.height;
+        }
+    }
+
+    if (bestY < 0) { return false; }
+
+    position = math::Point2i(segments_[best].x, bestY);
+    add(best, bestY, size);
+    return true;
+}
+
+void Skyline::grow(const math::Size2 &size)
+{
+    if (size.width > size_.width) {
+        auto &last(segments_.back());
+        if (!last.y) {
+            last.width += size.width - size_.width;
+        } else {
+            segments_.emplace_back(size_.width, 0, size.width - size_.width);
+        }
+    }
+    size_ = size;
+}
+
+/** Order in which rectangles are packed.
+ */
+enum class SortOrder { width, height, area, side };
+
+/** One packing configuration.
+ */
+struct Strategy {
+    PackAlgorithm algorithm;
+    SortOrder order;
+
+    /** Grow atlas height first (width first otherwise).
+     */
+    bool heightFirst;
+
+    Strategy(PackAlgorithm algorithm, SortOrder order, bool heightFirst)
+        : algorithm(algorithm), order(order), heightFirst(heightFirst)
+    {}
+};
+
+inline bool empty(const math::Size2 &size)
+{
+    return (size.width <= 0) || (size.height <= 0);
+}
+
+/** Returns indices of non-empty rectangles in packing order (stable, i.e.
+ *  deterministic).
+ */
+std::vector<int> sortRectangles(const std::vector<math::Size2> &sizes
+                                , SortOrder order)
+{
+    std::vector<int> indices;
+    for (int i(0), e(sizes.size()); i != e; ++i) {
+        if (!empty(sizes[i])) { indices.push_back(i); }
+    }
+
+    const auto sort([&](const auto &less)
+    {
+        std::stable_sort(indices.begin(), indices.end()
+                         , [&](int l, int r) {
+                             return less(sizes[l], sizes[r]);
+                         });
+    });
+
+    switch (order) {
+    case SortOrder::width:
+        sort([](const math::Size2 &l, const math::Size2 &r) {
+                return l.width > r.width;
+            });
+        break;
+
+    case SortOrder::height:
+        sort([](const math::Size2 &l, const math::Size2 &r) {
+                return ((l.height > r.height)
+                        || ((l.height == r.height) && (l.width > r.width)));
+            });
+        break;
+
+    case SortOrder::area:
+        sort([](const math::Size2 &l, const math::Size2 &r) {
+                return math::area(l) > math::area(r);
+            });
+        break;
+
+    case SortOrder::side:
+        sort([](const math::Size2 &l, const math::Size2 &r) {
+                return (std::max(l.width, l.height)
+                        > std::max(r.width, r.height));
+            });
+        break;
+    }
+
+    return indices;
+}
+
+/** Packs rectangles using given strategy.
+ */
+math::Size2 pack(const std::vector<math::Size2> &sizes
+                 , std::vector<math::Point2i> &positions
+                 , const PackOptions &options, const Strategy &strategy)
+{
+    const auto &maxAllowed(options.maxAllowed);
+
+    // initial size
+    math::Size2 packSize(64, 64);
+
+    auto inflate([&]()
+    {
+        if (maxAllowed && packSize == *maxAllowed) {
+            LOGTHROW(err2, AreaTooLarge)
+                << "Won't fit: maximum (allowed) size reached: " << maxAllowed
+                << ".";
+        }
+
+        // inflate area, grow the shorter side (the primary one on ties)
+        // unless it is at its limit already
+        const auto grow([&](int &side, int other, int limit) -> bool
+        {
+            if ((side > other) || (maxAllowed && (side >= limit))) {
+                return false;
+            }
+            side *= options.inflateFactor;
+            if (maxAllowed) { side = std::min(side, limit); }
+            return true;
+        });
+
+        const int maxWidth(maxAllowed ? maxAllowed->width : 0);
+        const int maxHeight(maxAllowed ? maxAllowed->height : 0);
+        if (strategy.heightFirst) {
+            if (!grow(packSize.height, packSize.width, maxHeight)) {
+                packSize.width *= options.inflateFactor;
+                if (maxAllowed) {
+                    packSize.width = std::min(packSize.width, maxWidth);
+                }
+            }
+        } else {
+            if (!grow(packSize.width, packSize.height, maxWidth)) {
+                packSize.height *= options.inflateFactor;
+                if (maxAllowed) {
+                    packSize.height = std::min(packSize.height, maxHeight);
+                }
+            }
+        }
+
+        // and check
+        if ((packSize.width > MaxSize.width)
+            || (packSize.height > MaxSize.height))
+        {
+            LOGTHROW(err2, AreaTooLarge)
+                << "Packing area too large (" << packSize << ").";
+        }
+    });
+
+    // calculate total area of the rectangles
+    {
+        AreaType total(0);
+        for (const auto &size : sizes) {
+            if (!empty(size)) { total += math::area(size); }
+        }
+        LOG(debug) << "Total area: " << total << " pixels";
+
+        // inflate to hold total area
+        while (math::area(packSize) < total) { inflate(); }
+    }
+
+    LOG(debug) << "Initial packing area: " << packSize << ".";
+
+    // empty rectangles (e.g. patches clipped away) occupy no space and stay
+    // at the origin
+    const auto order(sortRectangles(sizes, strategy.order));
+    positions.assign(sizes.size(), math::Point2i(0, 0));
+
+    if (strategy.algorithm == PackAlgorithm::skyline) {
+        // single pass, grow bin in place when rectangle doesn't fit
+        Skyline bin(packSize);
+        for (const auto index : order) {
+            while (!bin.allocate(sizes[index], positions[index])) {
+                inflate();
+                bin.grow(packSize);
+
+                LOG(debug) << "Rectangle won't fit, growing to "
+                           << packSize.width << "x" << packSize.height << ".";
+            }
+        }
+
+        LOG(debug) << "Packed size: " << packSize;
+        return packSize;
+    }
+
+    // tries to pack rectangles into one atlas, returns false when bigger
+    // atlas is needed
+    Guillotine bin;
+    auto tryToPack([&]() -> bool
+    {
+        bin.reset(packSize);
+        for (const auto index : order) {
+            if (!bin.allocate(sizes[index], positions[index])) {
+                return false;
+            }
+        }
+        return true;
+    });
+
+    // try to pack until rectangles fit
+    while (!tryToPack()) {
+        // if there is not enough room, enlarge the space and start over
+        inflate();
+
+        LOG(debug) << "Rectangle won't fit, retrying with "
+                   << packSize.width << "x" << packSize.height << ".";
+    }
+
+    LOG(debug) << "Packed size: " << packSize;
+    return packSize;
+}
+
+} // namespace
+
+math::Size2 packRectangles(const std::vector<math::Size2> &sizes
+                           , std::vector<math::Point2i> &positions
+                           , const PackOptions &options)
+{
+    LOG(debug) << "Packing " << sizes.size() << " rectangles.";
+
+    if (!options.tryAll) {
+        return pack(sizes, positions, options
+                    , Strategy(options.algorithm
+                               , ((options.algorithm
+                                   == PackAlgorithm::skyline)
+                                  ? SortOrder::height : SortOrder::width)
+                               , false));
+    }
+
+    std::vector<Strategy> strategies;
+    for (const auto algorithm : { PackAlgorithm::guillotine
+                                  , PackAlgorithm::skyline })
+    {
+        for (const auto order : { SortOrder::width, SortOrder::height
+                                  , SortOrder::area, SortOrder::side })
+        {
+            for (const bool heightFirst : { false, true }) {
+                strategies.emplace_back(algorithm, order, heightFirst);
+            }
+        }
+    }
+
+    const int count(strategies.size());
+    std::vector<math::Size2> results(count);
+    std::vector<std::vector<math::Point2i>> layouts(count);
+    std::vector<char> valid(count, false);
+
+    UTILITY_OMP(parallel for schedule(dynamic))
+    for (int i = 0; i < count; ++i) {
+        try {
+            results[i] = pack(sizes, layouts[i], options, strategies[i]);
+            valid[i] = true;
+        } catch (const AreaTooLarge&) {}
+    }
+
+    // smallest atlas wins, first strategy on ties
+    int best(-1);
+    for (int i(0); i < count; ++i) {
+        if (valid[i] && ((best < 0) || (math::area(results[i])
+                                        < math::area(results[best]))))
+        {
+            best = i;
+        }
+    }
+
+    if (best < 0) {
+        LOGTHROW(err2, AreaTooLarge)
+            << "Won't fit with any packing strategy.";
+    }
+
+    LOG(debug) << "Best packing strategy #" << best << ": "
+               << results[best] << ".";
+    positions.swap(layouts[best]);
+    return results[best];
+}
+
+} // namespace imgproc
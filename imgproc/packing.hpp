@@ -0,0 +1,137 @@
+/**
+ * Copyright (c) 2021 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file packing.hpp
+ *
+ * Rectangle packing engine shared by texture atlas builders (tx::pack(),
+ * RectPacker).
+ */
+
+#ifndef imgproc_packing_hpp_included_
+#define imgproc_packing_hpp_included_
+
+#include <vector>
+
+#include <boost/optional.hpp>
+
+#include "math/geometry_core.hpp"
+
+namespace imgproc {
+
+/** Packing algorithm.
+ */
+enum class PackAlgorithm {
+    /** Guillotine binary tree. Restarts from scratch in a larger atlas when
+     *  a rectangle does not fit.
+     */
+    guillotine,
+
+    /** Bottom-left skyline. Atlas grows in place when a rectangle does not
+     *  fit, already placed rectangles are kept.
+     */
+    skyline
+};
+
+/** Packing options.
+ */
+struct PackOptions {
+    /** Specifies how much the atlas grows (in 1 dimension) after every
+     *  unsuccessful packing attempt.
+     */
+    float inflateFactor;
+
+    /** The maximum atlas size acceptable by the caller.
+     */
+    boost::optional<math::Size2i> maxAllowed;
+
+    /** Packing algorithm.
+     */
+    PackAlgorithm algorithm;
+
+    /** Try all algorithms, several sort orders and both atlas growth
+     *  directions (concurrently) and keep the packing with the smallest
+     *  atlas; algorithm is ignored.
+     */
+    bool tryAll;
+
+    explicit PackOptions(float inflateFactor = 2.f
+                , const boost::optional<math::Size2i> &maxAllowed
+                = boost::none
+                , PackAlgorithm algorithm = PackAlgorithm::guillotine
+                , bool tryAll = false)
+        : inflateFactor(inflateFactor), maxAllowed(maxAllowed)
+        , algorithm(algorithm), tryAll(tryAll)
+    {}
+};
+
+/** Packs rectangles of given sizes into one atlas.
+ *
+ *  Throws AreaTooLarge when rectangles do not fit into the maximum
+ *  (allowed) atlas size.
+ *
+ *  @param sizes rectangle sizes
+ *  @param positions filled with rectangle positions (in sizes' order)
+ *  @param options packing options
+ *  @return atlas size
+ */
+math::Size2 packRectangles(const std::vector<math::Size2> &sizes
+                           , std::vector<math::Point2i> &positions
+                           , const PackOptions &options = PackOptions());
+
+/** Generic interface: packs rectangles in range [begin, end).
+ *
+ *  @param sizeOf function returning math::Size2 of *iterator
+ *  @param place function called as place(*iterator, math::Point2i) for
+ *               every rectangle once packing is finished
+ *  @param options packing options
+ *  @return atlas size
+ */
+template <typename Iterator, typename SizeOf, typename Place>
+math::Size2 packRectangles(Iterator begin, Iterator end
+                           , const SizeOf &sizeOf, const Place &place
+                           , const PackOptions &options = PackOptions());
+
+// inlines
+
+template <typename Iterator, typename SizeOf, typename Place>
+math::Size2 packRectangles(Iterator begin, Iterator end
+                           , const SizeOf &sizeOf, const Place &place
+                           , const PackOptions &options)
+{
+    std::vector<math::Size2> sizes;
+    for (auto i(begin); i != end; ++i) { sizes.push_back(sizeOf(*i)); }
+
+    std::vector<math::Point2i> positions;
+    const auto size(packRectangles(sizes, positions, options));
+
+    auto position(positions.begin());
+    for (auto i(begin); i != end; ++i) { place(*i, *position++); }
+    return size;
+}
+
+} // namespace imgproc
+
+#endif // imgproc_packing_hpp_included_
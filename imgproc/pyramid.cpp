@@ -0,0 +1,324 @@
+/**
+ * Copyright (c) 2021 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file pyramid.cpp
+ *
+ * Image pyramid (mipmap) builder.
+ */
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "dbglog/dbglog.hpp"
+
+#include "pyramid.hpp"
+
+namespace imgproc {
+
+namespace {
+
+/** Decimation kernel [1 3 3 1] / 8: output pixel i is computed from source
+ *  pixels 2 * i - 1 .. 2 * i + 2.
+ */
+const float Kernel[4] = { 1.f / 8, 3.f / 8, 3.f / 8, 1.f / 8 };
+
+math::Size2 half(const math::Size2 &size)
+{
+    return math::Size2((size.width + 1) / 2, (size.height + 1) / 2);
+}
+
+/** Horizontally decimated source row: weighted channel sums, weight sum and
+ *  coverage (any of 2 source pixels valid) of each output pixel.
+ */
+struct HalfRow {
+    std::vector<float> sum;
+    std::vector<float> weight;
+    std::vector<std::uint8_t> cover;
+};
+
+/** One pyramid level: decimates rows of previous level.
+ */
+class Level {
+public:
+    Level(int index, const math::Size2 &srcSize, int channels, int tileSize)
+        : index(index), src(srcSize), size(half(srcSize))
+        , channels(channels), rows(0), next(0)
+        , values(std::size_t(size.width) * channels), valid(size.width)
+        , weight(size.width)
+        , tileWidth(tileSize ? std::min(tileSize, size.width) : size.width)
+        , bandHeight(tileSize ? std::min(tileSize, size.height)
+                     : size.height)
+        , band(std::size_t(bandHeight) * values.size())
+        , bandMask(std::size_t(bandHeight) * size.width)
+        , bandStart(0)
+    {
+        for (auto &row : ring) {
+            row.sum.resize(values.size());
+            row.weight.resize(size.width);
+            row.cover.resize(size.width);
+        }
+    }
+
+    /** Adds source row. Calls emit(values, valid) for each finished output
+     *  row.
+     */
+    template <typename Emit>
+    void add(const float *srcValues, const std::uint8_t *srcValid
+             , const Emit &emit);
+
+    /** Stores output row into tile band and passes full band to the sink.
+     */
+    void store(int y, const PyramidBuilder::TileSink &sink);
+
+    const int index;
+    const math::Size2 src;
+    const math::Size2 size;
+    const int channels;
+
+    /** Number of source rows consumed.
+     */
+    int rows;
+
+    /** Next output row.
+     */
+    int next;
+
+    /** Current output row.
+     */
+    std::vector<float> values;
+    std::vector<std::uint8_t> valid;
+
+private:
+    void decimate(HalfRow &row, const float *srcValues
+                  , const std::uint8_t *srcValid) const;
+
+    void vertical(int y);
+
+    /** Last 4 source rows, row r is in slot r % 4.
+     */
+    HalfRow ring[4];
+
+    /** Weight sums of current output row.
+     */
+    std::vector<float> weight;
+
+    const int tileWidth;
+    const int bandHeight;
+    std::vector<float> band;
+    std::vector<std::uint8_t> bandMask;
+    int bandStart;
+};
+
+void Level::decimate(HalfRow &row, const float *srcValues
+                     , const std::uint8_t *srcValid) const
+{
+    std::fill(row.sum.begin(), row.sum.end(), 0.f);
+    std::fill(row.weight.begin(), row.weight.end(), 0.f);
+
+    auto *sum(row.sum.data());
+    for (int i(0); i < size.width; ++i, sum += channels) {
+        for (int k(0); k < 4; ++k) {
+            const int x(2 * i - 1 + k);
+            if ((x < 0) || (x >= src.width) || !srcValid[x]) { continue; }
+            const auto *v(srcValues + std::size_t(x) * channels);
+            for (int c(0); c < channels; ++c) { sum[c] += Kernel[k] * v[c]; }
+            row.weight[i] += Kernel[k];
+        }
+        row.cover[i] = (srcValid[2 * i]
+                        || (((2 * i + 1) < src.width) && srcValid[2 * i + 1]));
+    }
+}
+
+void Level::vertical(int y)
+{
+    std::fill(values.begin(), values.end(), 0.f);
+    std::fill(weight.begin(), weight.end(), 0.f);
+
+    for (int k(0); k < 4; ++k) {
+        const int r(2 * y - 1 + k);
+        if ((r < 0) || (r >= src.height)) { continue; }
+        const auto &row(ring[r % 4]);
+        const float w(Kernel[k]);
+        for (std::size_t i(0), ie(values.size()); i != ie; ++i) {
+            values[i] += w * row.sum[i];
+        }
+        for (int i(0); i < size.width; ++i) {
+            weight[i] += w * row.weight[i];
+        }
+    }
+
+    const auto &upper(ring[(2 * y) % 4]);
+    const auto *lower(((2 * y + 1) < src.height)
+                      ? &ring[(2 * y + 1) % 4] : nullptr);
+
+    auto *v(values.data());
+    for (int i(0); i < size.width; ++i, v += channels) {
+        valid[i] = (upper.cover[i] || (lower && lower->cover[i]));
+        // covered pixel always has positive weight
+        const float scale(valid[i] ? 1.f / weight[i] : 0.f);
+        for (int c(0); c < channels; ++c) { v[c] *= scale; }
+    }
+}
+
+template <typename Emit>
+void Level::add(const float *srcValues, const std::uint8_t *srcValid
+                , const Emit &emit)
+{
+    const int r(rows++);
+    decimate(ring[r % 4], srcValues, srcValid);
+
+    // output row y needs source rows up to 2 * y + 2
+    while ((next < size.height)
+           && (std::min(2 * next + 2, src.height - 1) <= r))
+    {
+        vertical(next);
+        emit(next++);
+    }
+}
+
+void Level::store(int y, const PyramidBuilder::TileSink &sink)
+{
+    const int by(y - bandStart);
+    std::copy(values.begin(), values.end()
+              , band.begin() + by * values.size());
+    std::copy(valid.begin(), valid.end()
+              , bandMask.begin() + by * valid.size());
+
+    const int height(by + 1);
+    if ((height < bandHeight) && (y + 1 < size.height)) { return; }
+
+    PyramidTile tile;
+    tile.level = index;
+    tile.channels = channels;
+    tile.stride = values.size();
+    tile.maskStride = valid.size();
+    for (int x(0); x < size.width; x += tileWidth) {
+        tile.extents = math::Extents2i
+            (x, bandStart, std::min(x + tileWidth, size.width)
+             , bandStart + height);
+        tile.data = band.data() + std::size_t(x) * channels;
+        tile.mask = bandMask.data() + x;
+        sink(tile);
+    }
+
+    bandStart += height;
+}
+
+} // namespace
+
+struct PyramidBuilder::Impl {
+    Impl(const math::Size2 &size, int channels, const TileSink &sink
+         , const PyramidParameters &params)
+        : size(size), channels(channels), sink(sink), rows(0)
+        , allValid(size.width, 1)
+    {
+        if (channels <= 0) {
+            LOGTHROW(err1, std::logic_error)
+                << "Invalid number of pyramid channels: " << channels << ".";
+        }
+
+        auto levelSize(size);
+        while ((levelSize.width > 1) || (levelSize.height > 1)) {
+            if (params.levels && (int(levels.size()) >= params.levels)) {
+                break;
+            }
+
+            levels.emplace_back(levels.size() + 1, levelSize, channels
+                                , params.tileSize);
+            levelSize = levels.back().size;
+        }
+    }
+
+    /** Pushes row into given level and generated rows to next levels.
+     */
+    void push(std::size_t index, const float *values
+              , const std::uint8_t *valid)
+    {
+        if (index >= levels.size()) { return; }
+        auto &level(levels[index]);
+        level.add(values, valid, [&](int y)
+        {
+            level.store(y, sink);
+            push(index + 1, level.values.data(), level.valid.data());
+        });
+    }
+
+    const math::Size2 size;
+    const int channels;
+    const TileSink sink;
+    int rows;
+    std::vector<std::uint8_t> allValid;
+    std::vector<Level> levels;
+};
+
+PyramidBuilder::PyramidBuilder(const math::Size2 &size, int channels
+                               , const TileSink &sink
+                               , const PyramidParameters &params)
+    : impl_(new Impl(size, channels, sink, params))
+{}
+
+PyramidBuilder::~PyramidBuilder() {}
+
+void PyramidBuilder::feedRow(const float *values, const std::uint8_t *valid)
+{
+    auto &impl(*impl_);
+    if (impl.rows >= impl.size.height) {
+        LOGTHROW(err1, std::logic_error)
+            << "Cannot feed more than " << impl.size.height
+            << " rows into pyramid builder.";
+    }
+
+    ++impl.rows;
+    impl.push(0, values, valid ? valid : impl.allValid.data());
+}
+
+void PyramidBuilder::finish()
+{
+    const auto &impl(*impl_);
+    if (impl.rows != impl.size.height) {
+        LOGTHROW(err1, std::logic_error)
+            << "Pyramid builder finished after " << impl.rows
+            << " rows, expected " << impl.size.height << ".";
+    }
+}
+
+int PyramidBuilder::levels() const
+{
+    return impl_->levels.size();
+}
+
+math::Size2 PyramidBuilder::levelSize(int level) const
+{
+    const auto &impl(*impl_);
+    if (!level) { return impl.size; }
+    if ((level < 0) || (level > int(impl.levels.size()))) {
+        LOGTHROW(err1, std::logic_error)
+            << "Invalid pyramid level " << level << ".";
+    }
+    return impl.levels[level - 1].size;
+}
+
+} // namespace imgproc
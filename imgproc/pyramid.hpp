@@ -0,0 +1,195 @@
+/**
+ * Copyright (c) 2021 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file pyramid.hpp
+ *
+ * Image pyramid (mipmap) builder.
+ */
+
+#ifndef imgproc_pyramid_hpp_included_
+#define imgproc_pyramid_hpp_included_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <functional>
+
+#include "math/geometry_core.hpp"
+
+namespace imgproc {
+
+/** Pyramid builder parameters.
+ */
+struct PyramidParameters {
+    /** Number of generated levels (not counting the source image), 0 means
+     *  all levels down to 1x1 pixel.
+     */
+    int levels;
+
+    /** Size of output tiles in pixels. Tiles are passed to the sink as soon
+     *  as the tile row is complete. 0 means whole levels.
+     */
+    int tileSize;
+
+    PyramidParameters() : levels(), tileSize(256) {}
+
+    PyramidParameters& setLevels(int value) {
+        levels = value; return *this;
+    }
+
+    PyramidParameters& setTileSize(int value) {
+        tileSize = value; return *this;
+    }
+};
+
+/** One output tile of pyramid level. Tile data are owned by the builder and
+ *  valid only during the sink call.
+ */
+struct PyramidTile {
+    /** Level index, level 1 has half size of source.
+     */
+    int level;
+
+    /** Tile extents in level pixels (ll inclusive, ur exclusive).
+     */
+    math::Extents2i extents;
+
+    /** Number of channels.
+     */
+    int channels;
+
+    /** Tile data: interleaved channels, rows are stride floats apart.
+     */
+    const float *data;
+    std::size_t stride;
+
+    /** Tile validity: one byte per pixel, rows are maskStride bytes apart.
+     */
+    const std::uint8_t *mask;
+    std::size_t maskStride;
+
+    /** Value of given channel at tile-relative pixel.
+     */
+    float value(int x, int y, int channel) const {
+        return data[y * stride + x * channels + channel];
+    }
+
+    /** Validity of tile-relative pixel.
+     */
+    bool valid(int x, int y) const { return mask[y * maskStride + x]; }
+};
+
+/** Streaming pyramid builder. Source image is fed row by row, all levels are
+ *  generated in one pass: each level is derived from the previous one by a
+ *  2:1 decimation with separable [1 3 3 1] / 8 kernel. Only a few rows of
+ *  each level (and one tile row if tiling is used) are held in memory.
+ *
+ *  Decimation is mask-aware (normalized convolution): invalid pixels
+ *  contribute neither value nor weight, so they do not bleed into valid
+ *  ones. Output pixel is valid if any of its 2x2 source pixels is valid;
+ *  invalid output pixels have zero value. Pixels outside image are
+ *  invalid. Values are kept in float between levels.
+ *
+ *  Level n has size ceil(size / 2^n).
+ */
+class PyramidBuilder {
+public:
+    /** Receives finished tiles.
+     */
+    typedef std::function<void(const PyramidTile &tile)> TileSink;
+
+    PyramidBuilder(const math::Size2 &size, int channels
+                   , const TileSink &sink
+                   , const PyramidParameters &params = PyramidParameters());
+    ~PyramidBuilder();
+
+    /** Feeds next source row: width * channels interleaved values and
+     *  optional validity (width bytes, non-zero means valid; all pixels are
+     *  valid if null).
+     */
+    void feedRow(const float *values, const std::uint8_t *valid = nullptr);
+
+    /** Checks that all rows have been fed. All tiles have been already
+     *  passed to the sink at this point.
+     */
+    void finish();
+
+    /** Number of generated levels.
+     */
+    int levels() const;
+
+    /** Size of given level (0 is source).
+     */
+    math::Size2 levelSize(int level) const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+/** Builds pyramid from const raster (see const-raster.hpp), pixel validity
+ *  is taken from raster.valid() so masked rasters (e.g. MaskedCvConstRaster
+ *  or rasters with MaskedPlugin) are supported out of the box.
+ */
+template <typename ConstRaster>
+void buildPyramid(const ConstRaster &raster
+                  , const PyramidBuilder::TileSink &sink
+                  , const PyramidParameters &params = PyramidParameters());
+
+// inlines
+
+template <typename ConstRaster>
+void buildPyramid(const ConstRaster &raster
+                  , const PyramidBuilder::TileSink &sink
+                  , const PyramidParameters &params)
+{
+    const int width(raster.width());
+    const int channels(raster.channels());
+    PyramidBuilder builder(math::Size2(width, raster.height()), channels
+                           , sink, params);
+
+    std::vector<float> values(std::size_t(width) * channels);
+    std::vector<std::uint8_t> valid(width);
+    for (int j(0), je(raster.height()); j != je; ++j) {
+        auto *v(values.data());
+        for (int i(0); i < width; ++i) {
+            valid[i] = raster.valid(i, j);
+            if (valid[i]) {
+                const auto &value(raster(i, j));
+                for (int c(0); c < channels; ++c) { *v++ = value[c]; }
+            } else {
+                for (int c(0); c < channels; ++c) { *v++ = 0.f; }
+            }
+        }
+        builder.feedRow(values.data(), valid.data());
+    }
+
+    builder.finish();
+}
+
+} // namespace imgproc
+
+#endif // imgproc_pyramid_hpp_included_
@@ -31,10 +31,18 @@
 #include <iostream>
 #include <stdexcept>
 #include <numeric>
+#include <vector>
 #include <cmath>
 
+#if defined(__AVX2__)
+#  include <immintrin.h>
+#elif defined(__SSE2__)
+#  include <emmintrin.h>
+#endif
+
 #include "dbglog/dbglog.hpp"
 #include "utility/binaryio.hpp"
+#include "utility/openmp.hpp"
 #include "math/math.hpp"
 
 #include "bitfield.hpp"
@@ -48,6 +56,8 @@ namespace {
     using utility::binaryio::write;
 }
 
+constexpr int RasterMask::WordBits;
+
 void RasterMask::dump(std::ostream &f) const
 {
     write(f, BF_RASTERMASK_IO_MAGIC); // 5 bytes
@@ -60,7 +70,7 @@ void RasterMask::dump(std::ostream &f) const
     write(f, width);
     write(f, height);
 
-    write(f, mask_.get(), bytes_);
+    writeData(f);
 }
 
 void RasterMask::load(std::istream &f)
@@ -84,22 +94,237 @@ void RasterMask::load(std::istream &f)
 
     size_.width = width;
     size_.height = height;
-    bytes_ = (size_.height * size_.width + 7) >> 3;
-    mask_.reset(new std::uint8_t[bytes_]);
+    allocate(EMPTY);
+
+    readData(f);
+}
+
+namespace {
+
+typedef RasterMask::Word Word;
+
+/** Word-wise operations. Each operation provides scalar apply() and a vector
+ *  one for the widest available instruction set. All operations map zero
+ *  padding to zero padding.
+ */
+struct Or {
+    static Word apply(Word a, Word b) { return a | b; }
+#if defined(__AVX2__)
+    static __m256i apply(__m256i a, __m256i b) {
+        return _mm256_or_si256(a, b);
+    }
+#elif defined(__SSE2__)
+    static __m128i apply(__m128i a, __m128i b) { return _mm_or_si128(a, b); }
+#endif
+};
+
+struct And {
+    static Word apply(Word a, Word b) { return a & b; }
+#if defined(__AVX2__)
+    static __m256i apply(__m256i a, __m256i b) {
+        return _mm256_and_si256(a, b);
+    }
+#elif defined(__SSE2__)
+    static __m128i apply(__m128i a, __m128i b) { return _mm_and_si128(a, b); }
+#endif
+};
+
+struct AndNot {
+    static Word apply(Word a, Word b) { return a & ~b; }
+#if defined(__AVX2__)
+    static __m256i apply(__m256i a, __m256i b) {
+        return _mm256_andnot_si256(b, a);
+    }
+#elif defined(__SSE2__)
+    static __m128i apply(__m128i a, __m128i b) {
+        return _mm_andnot_si128(b, a);
+    }
+#endif
+};
+
+struct Xor {
+    static Word apply(Word a, Word b) { return a ^ b; }
+#if defined(__AVX2__)
+    static __m256i apply(__m256i a, __m256i b) {
+        return _mm256_xor_si256(a, b);
+    }
+#elif defined(__SSE2__)
+    static __m128i apply(__m128i a, __m128i b) { return _mm_xor_si128(a, b); }
+#endif
+};
+
+/** Applies operation to n words: dst = op(dst, src).
+ */
+template <typename Operation>
+void apply(Word *dst, const Word *src, std::size_t n)
+{
+    std::size_t i(0);
+#if defined(__AVX2__)
+    for (; (i + 4) <= n; i += 4) {
+        auto *d(reinterpret_cast<__m256i*>(dst + i));
+        const auto *s(reinterpret_cast<const __m256i*>(src + i));
+        _mm256_storeu_si256(d, Operation::apply(_mm256_loadu_si256(d)
+                                                , _mm256_loadu_si256(s)));
+    }
+#elif defined(__SSE2__)
+    for (; (i + 2) <= n; i += 2) {
+        auto *d(reinterpret_cast<__m128i*>(dst + i));
+        const auto *s(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(d, Operation::apply(_mm_loadu_si128(d)
+                                             , _mm_loadu_si128(s)));
+    }
+#endif
+    for (; i < n; ++i) { dst[i] = Operation::apply(dst[i], src[i]); }
+}
 
-    read(f, mask_.get(), bytes_);
+std::size_t popcount(const Word *words, std::size_t n)
+{
+    std::size_t count(0);
+    for (const auto *e(words + n); words != e; ++words) {
+        count += detail::popcount(*words);
+    }
+    return count;
+}
+
+/** Number of words processed by one task. Small enough to keep block in L1
+ *  cache between operation and popcount passes.
+ */
+const std::size_t BlockSize(2048);
 
+/** Do not spawn threads for masks smaller than this (in words).
+ */
+const std::size_t ParallelThreshold(1 << 16);
+
+} // namespace
+
+template <typename Operation>
+void RasterMask::combine(const RasterMask &op, const char *what)
+{
+    if (size_ != op.size_) {
+        LOGTHROW(err1, std::logic_error)
+            << "Cannot " << what << " masks of different sizes ("
+            << size_ << " and " << op.size_ << ").";
+    }
+
+    const std::size_t total(stride_ * size_.height);
+    const long blocks((total + BlockSize - 1) / BlockSize);
+    auto *dst(words_.get());
+    const auto *src(op.words_.get());
+
+    std::size_t count(0);
+    UTILITY_OMP(parallel for reduction(+:count) \
+                if(total >= ParallelThreshold))
+    for (long b = 0; b < blocks; ++b) {
+        const std::size_t start(b * BlockSize);
+        const std::size_t n(std::min(BlockSize, total - start));
+        apply<Operation>(dst + start, src + start, n);
+        count += popcount(dst + start, n);
+    }
+    count_ = count;
+}
+
+void RasterMask::merge(const RasterMask &op)
+{
+    combine<Or>(op, "merge");
+}
+
+void RasterMask::intersect(const RasterMask &op)
+{
+    combine<And>(op, "intersect");
+}
+
+void RasterMask::subtract(const RasterMask &op)
+{
+    combine<AndNot>(op, "subtract");
+}
+
+void RasterMask::symmetricDifference(const RasterMask &op)
+{
+    combine<Xor>(op, "xor");
+}
+
+void RasterMask::invert()
+{
+    const std::size_t total(stride_ * size_.height);
+    auto *words(words_.get());
+    for (std::size_t i(0); i < total; ++i) { words[i] = ~words[i]; }
     resetTrail();
+    count_ = math::area(size_) - count_;
+}
 
-    // compute count_
-    count_ = std::accumulate
-        (mask_.get(), mask_.get() + bytes_, 0u
-         , [](unsigned int value, std::uint8_t byte) {
-            return (value + (byte & 0x01) + ((byte & 0x02) >> 1)
-                    + ((byte & 0x04) >> 2) + ((byte & 0x08) >> 3)
-                    + ((byte & 0x10) >> 4) + ((byte & 0x20) >> 5)
-                    + ((byte & 0x40) >> 6) + ((byte & 0x80) >> 7));
-        });
+void RasterMask::recount()
+{
+    const std::size_t total(stride_ * size_.height);
+    const long blocks((total + BlockSize - 1) / BlockSize);
+    const auto *words(words_.get());
+
+    std::size_t count(0);
+    UTILITY_OMP(parallel for reduction(+:count) \
+                if(total >= ParallelThreshold))
+    for (long b = 0; b < blocks; ++b) {
+        const std::size_t start(b * BlockSize);
+        count += popcount(words + start
+                          , std::min(BlockSize, total - start));
+    }
+    count_ = count;
+}
+
+void RasterMask::pack(std::uint8_t *out) const
+{
+    std::fill_n(out, bytes_, std::uint8_t(0));
+
+    // output bit position
+    std::size_t bit(0);
+    for (int j(0); j < size_.height; ++j) {
+        const auto *words(row(j));
+        for (int i(0); i < size_.width; i += WordBits, ++words) {
+            const int n(std::min(WordBits, size_.width - i));
+            const Word word(*words);
+
+            // spread word over (up to 9) output bytes; bits past n are zero
+            const auto byte(bit >> 3);
+            const int shift(bit & 7);
+            const int count((shift + n + 7) >> 3);
+            const Word low(word << shift);
+            for (int k(0), ke(std::min(count, 8)); k < ke; ++k) {
+                out[byte + k] |= std::uint8_t(low >> (8 * k));
+            }
+            if (count > 8) {
+                out[byte + 8] |= std::uint8_t(word >> (64 - shift));
+            }
+
+            bit += n;
+        }
+    }
+}
+
+void RasterMask::unpack(const std::uint8_t *in)
+{
+    // input bit position
+    std::size_t bit(0);
+    for (int j(0); j < size_.height; ++j) {
+        auto *words(row(j));
+        for (int i(0); i < size_.width; i += WordBits, ++words) {
+            const int n(std::min(WordBits, size_.width - i));
+
+            // gather word from (up to 9) input bytes
+            const auto byte(bit >> 3);
+            const int shift(bit & 7);
+            const int count((shift + n + 7) >> 3);
+            Word word(0);
+            for (int k(0), ke(std::min(count, 8)); k < ke; ++k) {
+                word |= Word(in[byte + k]) << (8 * k);
+            }
+            word >>= shift;
+            if (count > 8) {
+                word |= Word(in[byte + 8]) << (64 - shift);
+            }
+            if (n < WordBits) { word &= (Word(1) << n) - 1; }
+
+            *words = word;
+            bit += n;
+        }
+    }
 }
 
 namespace {
@@ -169,12 +394,17 @@ int radius(const RasterMask &m
 
 void RasterMask::writeData(std::ostream &f) const
 {
-    write(f, mask_.get(), bytes_);
+    std::vector<std::uint8_t> data(bytes_);
+    pack(data.data());
+    write(f, data.data(), bytes_);
 }
 
 void RasterMask::readData(std::istream &f)
 {
-    read(f, mask_.get(), bytes_);
+    std::vector<std::uint8_t> data(bytes_);
+    read(f, data.data(), bytes_);
+    unpack(data.data());
+    recount();
 }
 
 } } // namespace imgproc::bitfield
@@ -38,6 +38,10 @@
 #include <algorithm>
 #include <iosfwd>
 
+#if defined(_MSC_VER)
+#  include <intrin.h>
+#endif
+
 #include <boost/scoped_array.hpp>
 #include <boost/optional.hpp>
 
@@ -48,12 +52,30 @@
 
 /**** bit-field version of rastermask ****/
 
+/** Storage:
+ *
+ *  Pixels are stored in 64-bit words, bit x % 64 of word x / 64 holds pixel
+ *  x. Each row starts at word boundary (rows are stride() words apart), bits
+ *  past mask width in the last word of each row are always zero.
+ *
+ *  Serialized form (dump/writeData) is packed, i.e. without row padding: bit
+ *  (width * y + x) % 8 of byte (width * y + x) / 8.
+ */
+
 namespace imgproc { namespace bitfield {
 
 class RasterMask {
 public:
     enum InitMode { EMPTY = 0, FULL = 1, SOURCE = 2 };
 
+    /** Storage word.
+     */
+    typedef std::uint64_t Word;
+
+    /** Number of pixels in one storage word.
+     */
+    static constexpr int WordBits = 64;
+
     RasterMask(const math::Size2 &size, InitMode mode);
 
     RasterMask(int width = 1, int height = 1, InitMode mode = EMPTY);
@@ -80,14 +102,22 @@ public:
     bool empty() const { return count_; }
 
     /** invert a mask (negate pixels) */
-    void invert() {
-        std::transform(mask_.get(), mask_.get() + bytes_
-                       , mask_.get(), [](std::uint8_t b) { return ~b; });
-    }
+    void invert();
 
-    /** FIXME: IMPLEMENT ME
-     *  do a set difference with two masks. */
-    void subtract( const RasterMask & op );
+    /** do a set difference with two masks. */
+    void subtract(const RasterMask &op);
+
+    /** Merges other mask into this mask (union).
+     */
+    void merge(const RasterMask &op);
+
+    /** In place intersects other mask with this mask.
+     */
+    void intersect(const RasterMask &op);
+
+    /** Symmetric difference (xor) with other mask.
+     */
+    void symmetricDifference(const RasterMask &op);
 
     /** implement! obtain mask value at given pos. */
     bool get(int x, int y) const;
@@ -132,13 +162,68 @@ public:
         return (size.height * size.width + 7) >> 3;
     }
 
+    /** Number of storage words in one row.
+     */
+    std::size_t stride() const { return stride_; }
+
+    /** Raw access to row storage. When modifying the mask via row(), bits
+     *  past mask width must be kept zero and recount() must be called
+     *  afterwards.
+     */
+    Word* row(int y) { return words_.get() + y * stride_; }
+
+    /** Raw access to row storage.
+     */
+    const Word* row(int y) const { return words_.get() + y * stride_; }
+
+    /** Recomputes number of set pixels from storage.
+     */
+    void recount();
+
+    /** Word stride from width.
+     */
+    static std::size_t stride(int width) {
+        return (width + WordBits - 1) / WordBits;
+    }
+
 private:
+    template <typename Operation>
+    void combine(const RasterMask &op, const char *what);
+
+    /** Allocates storage and fills it based on mode (EMPTY/FULL).
+     */
+    void allocate(InitMode mode);
+
+    /** Packs storage into serialized form (byteCount() bytes).
+     */
+    void pack(std::uint8_t *out) const;
+
+    /** Unpacks storage from serialized form (byteCount() bytes).
+     */
+    void unpack(const std::uint8_t *in);
+
     math::Size2 size_;
+    std::size_t stride_;
     std::size_t bytes_;
-    boost::scoped_array<std::uint8_t> mask_;
+    boost::scoped_array<Word> words_;
     std::size_t count_;
 };
 
+namespace detail {
+
+/** Number of set bits in word.
+ */
+inline int popcount(RasterMask::Word word)
+{
+#if defined(_MSC_VER)
+    return int(__popcnt64(word));
+#else
+    return __builtin_popcountll(word);
+#endif
+}
+
+} // namespace detail
+
 /** Calculate radius of restart mask (having circle center is its center)
  * \param m raster mask to use
  * \param refSize size of reference image if mask is not 1:1 of orignal image
@@ -151,12 +236,9 @@ int radius(const RasterMask &m
 /** Generates bitfield raster mask from constant raster.
  *  See ../const-raster.hpp for const raster interface.
  *
- *  If the Inverse template parameter is false:
- *      * mask is created empty
- *      * valid pixels are added to mask
- *  If the Inverse template parameter is true:
- *      * mask is created full
- *      * only invalid pixels are removed from mask
+ *  Mask is built word by word: pixel is set iff threshold returns true.
+ *  Inverse template parameter is kept for backward compatibility, since mask
+ *  has the same size as raster both variants produce the same result.
  *
  *  \param raster source raster
  *  \param threshold thresholding function: raster value -> bool
@@ -167,36 +249,43 @@ RasterMask fromRaster(const ConstRaster &raster, const Threshold &threshold);
 
 // Inline method implementation
 
-inline RasterMask::RasterMask(const math::Size2 &size, InitMode mode)
-    : size_(size), bytes_(byteCount(size_))
-    , mask_(new std::uint8_t[bytes_])
-    , count_((mode == EMPTY) ? 0 : math::area(size_))
+inline void RasterMask::allocate(InitMode mode)
 {
-    std::memset(mask_.get(), (mode == EMPTY) ? 0x00 : 0xff, bytes_);
+    stride_ = stride(size_.width);
+    bytes_ = byteCount(size_);
+    words_.reset(new Word[stride_ * size_.height]);
+    std::fill_n(words_.get(), stride_ * size_.height
+                , (mode == EMPTY) ? Word(0) : ~Word(0));
+    count_ = ((mode == EMPTY) ? 0 : math::area(size_));
     resetTrail();
 }
 
+inline RasterMask::RasterMask(const math::Size2 &size, InitMode mode)
+    : size_(size), stride_(), bytes_(), count_()
+{
+    allocate(mode);
+}
+
 inline RasterMask::RasterMask(int width, int height
                               , InitMode mode)
-    : size_(width, height), bytes_(byteCount(size_))
-    , mask_(new std::uint8_t[bytes_])
-    , count_((mode == EMPTY) ? 0 : math::area(size_))
+    : size_(width, height), stride_(), bytes_(), count_()
 {
-    std::memset(mask_.get(), (mode == EMPTY) ? 0x00 : 0xff, bytes_);
-    resetTrail();
+    allocate(mode);
 }
 
 /** initialize a mask of the same order, optionally copying mask. */
 inline RasterMask::RasterMask(const RasterMask &o, InitMode mode)
-    : size_(o.size_), bytes_(o.bytes_)
-    , mask_(new std::uint8_t[bytes_])
-    , count_((mode == EMPTY) ? 0 : math::area(size_))
+    : size_(o.size_), stride_(), bytes_(), count_()
 {
     if (mode == SOURCE) {
         // deep copy
-        std::memcpy(mask_.get(), o.mask_.get(), bytes_);
-        resetTrail();
+        stride_ = o.stride_;
+        bytes_ = o.bytes_;
+        words_.reset(new Word[stride_ * size_.height]);
+        std::copy_n(o.words_.get(), stride_ * size_.height, words_.get());
         count_ = o.count_;
+    } else {
+        allocate(mode);
     }
 }
 
@@ -207,11 +296,12 @@ inline RasterMask& RasterMask::operator=(const RasterMask &o) {
     }
 
     size_ = o.size_;
+    stride_ = o.stride_;
     bytes_ = o.bytes_;
-    mask_.reset(new std::uint8_t[bytes_]);
+    words_.reset(new Word[stride_ * size_.height]);
 
     // deep copy
-    std::memcpy(mask_.get(), o.mask_.get(), bytes_);
+    std::copy_n(o.words_.get(), stride_ * size_.height, words_.get());
     count_ = o.count_;
     return *this;
 }
@@ -219,11 +309,7 @@ inline RasterMask& RasterMask::operator=(const RasterMask &o) {
 inline RasterMask& RasterMask::create(const math::Size2 &size, InitMode mode)
 {
     size_ = size;
-    bytes_ = (size.height * size.width + 7) >> 3;
-    mask_.reset(new std::uint8_t[bytes_]);
-    count_ = ((mode == EMPTY) ? 0 : size.height * size.width);
-    std::memset(mask_.get(), (mode == EMPTY) ? 0x00 : 0xff, bytes_);
-    resetTrail();
+    allocate(mode);
     return *this;
 }
 
@@ -233,29 +319,15 @@ inline bool RasterMask::get(int x, int y) const
         return false;
     }
 
-    const auto offset(size_.width * y + x);
-    return mask_[offset >> 3] & (1 << (offset & 0x07));
+    return (row(y)[x / WordBits] >> (x % WordBits)) & 1;
 }
 
 inline void RasterMask::set(int x, int y, bool value)
 {
-    if ((x < 0) || (y < 0) || (x >= size_.width) || (y >= size_.height)) {
-        return;
-    }
-
-    const auto offset(size_.width * y + x);
-    const auto mask(1 << (offset & 0x07));
-    auto &byteValue(mask_[offset >> 3]);
     if (value) {
-        if (!(byteValue & mask)) {
-            byteValue |= mask;
-            ++count_;
-        }
+        add(x, y);
     } else {
-        if (byteValue & mask) {
-            byteValue &= ~mask;
-            --count_;
-        }
+        remove(x, y);
     }
 }
 
@@ -265,12 +337,11 @@ inline void RasterMask::add(int x, int y)
         return;
     }
 
-    const auto offset(size_.width * y + x);
-    const auto mask(1 << (offset & 0x07));
-    auto &byteValue(mask_[offset >> 3]);
+    auto &word(row(y)[x / WordBits]);
+    const auto mask(Word(1) << (x % WordBits));
 
-    if (!(byteValue & mask)) {
-        byteValue |= mask;
+    if (!(word & mask)) {
+        word |= mask;
         ++count_;
     }
 }
@@ -281,60 +352,48 @@ inline void RasterMask::remove(int x, int y)
         return;
     }
 
-    const auto offset(size_.width * y + x);
-    const auto mask(1 << (offset & 0x07));
-    auto &byteValue(mask_[offset >> 3]);
+    auto &word(row(y)[x / WordBits]);
+    const auto mask(Word(1) << (x % WordBits));
 
-    if (byteValue & mask) {
-        byteValue &= ~mask;
+    if (word & mask) {
+        word &= ~mask;
         --count_;
     }
 }
 
 inline void RasterMask::resetTrail()
 {
-    mask_[bytes_ - 1] &=
-        (std::uint8_t(0xffu) >> ((bytes_ << 3) - size_.height * size_.width));
-}
+    const int rest(size_.width % WordBits);
+    if (!rest || !stride_) { return; }
 
-namespace detail {
-
-template <bool Inverse>
-struct MaskBuilder {
-    MaskBuilder(RasterMask &mask) : mask(mask) {}
-    RasterMask &mask;
-
-    void operator()(int x, int y, bool value);
-};
-
-template<>
-inline void MaskBuilder<false>::operator()(int x, int y, bool value)
-{
-    if (value) { mask.add(x, y); }
-}
-
-template<>
-inline void MaskBuilder<true>::operator()(int x, int y, bool value)
-{
-    if (!value) { mask.remove(x, y); }
+    const Word mask((Word(1) << rest) - 1);
+    for (int j(0); j < size_.height; ++j) {
+        row(j)[stride_ - 1] &= mask;
+    }
 }
 
-} // namespace detail
-
 template <typename ConstRaster, typename Threshold, bool Inverse>
 RasterMask fromRaster(const ConstRaster &raster, const Threshold &threshold)
 {
-    RasterMask mask(raster.size()
-                    , (Inverse ? RasterMask::FULL : RasterMask::EMPTY));
+    typedef RasterMask::Word Word;
 
-    detail::MaskBuilder<Inverse> store(mask);
+    RasterMask mask(raster.size(), RasterMask::EMPTY);
 
+    const int width(raster.width());
     for (int j(0), je(raster.height()); j != je; ++j) {
-        for (int i(0), ie(raster.width()); i != ie; ++i) {
-            store(i, j, threshold(raster(i, j)));
+        auto *row(mask.row(j));
+        for (int i(0); i < width; i += RasterMask::WordBits) {
+            Word word(0);
+            for (int b(0), be(std::min(RasterMask::WordBits, width - i));
+                 b != be; ++b)
+            {
+                if (threshold(raster(i + b, j))) { word |= Word(1) << b; }
+            }
+            *row++ = word;
         }
     }
 
+    mask.recount();
     return mask;
 }
 
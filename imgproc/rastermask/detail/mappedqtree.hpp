@@ -0,0 +1,93 @@
+/**
+ * Copyright (c) 2021 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file rastermask/detail/mappedqtree.hpp
+ *
+ * Memory-mapped quad-tree raster mask: on-disk format internals shared by
+ * the reader and the writers.
+ */
+
+#ifndef imgproc_rastermask_detail_mappedqtree_hpp_included_
+#define imgproc_rastermask_detail_mappedqtree_hpp_included_
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+namespace imgproc { namespace mappedqtree { namespace detail {
+
+const char IO_MAGIC[6] = { 'M', 'Q', 'M', 'A', 'S', 'K' };
+
+/** Header flags.
+ */
+const std::uint8_t FLAG_INDEX(0x01);
+
+/** Special index values.
+ */
+const std::uint32_t INDEX_BLACK(0x00000000);
+const std::uint32_t INDEX_WHITE(0xffffffff);
+
+/** Index of nodes at given depth, filled in during tree writing.
+ */
+struct Index {
+    Index(unsigned int depth)
+        : depth(depth)
+        , quads(depth ? (std::size_t(1) << (2 * depth)) : 0, INDEX_BLACK)
+    {}
+
+    /** Records white quad at given (depth, x, y).
+     */
+    void white(unsigned int ndepth, unsigned int x, unsigned int y) {
+        if (!depth || (ndepth > depth)) { return; }
+
+        // white quad covers a square in the index grid
+        const auto shift(depth - ndepth);
+        const auto size(1u << shift);
+        x <<= shift;
+        y <<= shift;
+        for (auto j(y), je(y + size); j < je; ++j) {
+            std::fill_n(quads.begin() + ((std::size_t(j) << depth) + x)
+                        , size, INDEX_WHITE);
+        }
+    }
+
+    /** Records gray node at given (depth, x, y) and its offset from tree
+     *  start.
+     */
+    void gray(unsigned int ndepth, unsigned int x, unsigned int y
+              , std::uint64_t offset)
+    {
+        if (!depth || (ndepth != depth)) { return; }
+        quads[(std::size_t(y) << depth) + x] = std::uint32_t(offset);
+    }
+
+    unsigned int depth;
+    std::vector<std::uint32_t> quads;
+};
+
+} } } // namespace imgproc::mappedqtree::detail
+
+#endif // imgproc_rastermask_detail_mappedqtree_hpp_included_
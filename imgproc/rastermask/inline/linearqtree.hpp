@@ -0,0 +1,168 @@
+/**
+ * Copyright (c) 2021 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file rastermask/inline/linearqtree.hpp
+ *
+ * Raster mask (linear quad-tree): inline functions.
+ */
+
+#ifndef imgproc_rastermask_inline_linearqtree_hpp_included_
+#define imgproc_rastermask_inline_linearqtree_hpp_included_
+
+#include <boost/logic/tribool.hpp>
+
+namespace imgproc { namespace linearqtree {
+
+namespace detail {
+
+/** Node types as stored in the node array.
+ */
+enum : std::uint8_t { Black = 0x0, Gray = 0x1, White = 0x3 };
+
+/** Returns type of given child (0=UL, 1=UR, 2=LL, 3=LR).
+ */
+inline std::uint8_t childType(std::uint8_t node, int child)
+{
+    return (node >> (2 * (3 - child))) & 0x3;
+}
+
+} // namespace detail
+
+template <typename Op, typename Value>
+inline void RasterMask::call(unsigned int x, unsigned int y
+                             , unsigned int size, const Op &op
+                             , const Value &value) const
+{
+    // quads completely outside of mask are not reported
+    if ((x >= sizeX_) || (y >= sizeY_)) { return; }
+
+    op(x, y, ((x + size) > sizeX_) ? (sizeX_ - x) : size
+       , ((y + size) > sizeY_) ? (sizeY_ - y) : size
+       , value);
+}
+
+template <typename Op>
+inline void RasterMask::forEachQuad(const Op &op, Filter filter) const
+{
+    if (nodes_.empty()) {
+        if ((filter == Filter::both)
+            || (white_ == (filter == Filter::white)))
+        {
+            call(0, 0, quadSize_, op, white_);
+        }
+        return;
+    }
+
+    std::size_t index(0);
+    descend(index, 0, 0, quadSize_, op, filter);
+}
+
+template <typename Op>
+inline void RasterMask::descend(std::size_t &index, unsigned int x
+                                , unsigned int y, unsigned int size
+                                , const Op &op, Filter filter) const
+{
+    const auto node(nodes_[index++]);
+    const unsigned int split(size >> 1);
+
+    for (int child(0); child < 4; ++child) {
+        const unsigned int cx(x + ((child & 1) ? split : 0));
+        const unsigned int cy(y + ((child & 2) ? split : 0));
+
+        switch (detail::childType(node, child)) {
+        case detail::Black:
+            // filter out black quads
+            if (filter != Filter::white) { call(cx, cy, split, op, false); }
+            break;
+
+        case detail::White:
+            // filter out white quads
+            if (filter != Filter::black) { call(cx, cy, split, op, true); }
+            break;
+
+        default:
+            // gray: subtree follows
+            descend(index, cx, cy, split, op, filter);
+            break;
+        }
+    }
+}
+
+template <typename Op>
+inline void RasterMask::forEachQuad(unsigned int depth, const Op &op) const
+{
+    if (nodes_.empty()) {
+        call(0, 0, quadSize_, op, boost::tribool(white_));
+        return;
+    }
+
+    if (!depth) {
+        call(0, 0, quadSize_, op, boost::tribool(boost::indeterminate));
+        return;
+    }
+
+    std::size_t index(0);
+    descend(index, depth, 0, 0, quadSize_, op);
+}
+
+template <typename Op>
+inline void RasterMask::descend(std::size_t &index, unsigned int depth
+                                , unsigned int x, unsigned int y
+                                , unsigned int size, const Op &op) const
+{
+    const auto node(nodes_[index++]);
+    const unsigned int split(size >> 1);
+
+    for (int child(0); child < 4; ++child) {
+        const unsigned int cx(x + ((child & 1) ? split : 0));
+        const unsigned int cy(y + ((child & 2) ? split : 0));
+
+        switch (detail::childType(node, child)) {
+        case detail::Black:
+            call(cx, cy, split, op, boost::tribool(false));
+            break;
+
+        case detail::White:
+            call(cx, cy, split, op, boost::tribool(true));
+            break;
+
+        default:
+            if (depth > 1) {
+                descend(index, depth - 1, cx, cy, split, op);
+            } else {
+                // bottom reached: report gray quad and jump over subtree
+                call(cx, cy, split, op
+                     , boost::tribool(boost::indeterminate));
+                index += 1 + skip_[index];
+            }
+            break;
+        }
+    }
+}
+
+} } // namespace imgproc::linearqtree
+
+#endif // imgproc_rastermask_inline_linearqtree_hpp_included_
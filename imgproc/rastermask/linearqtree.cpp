@@ -0,0 +1,484 @@
+/**
+ * Copyright (c) 2021 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file rastermask/linearqtree.cpp
+ *
+ * Raster mask (pointer-free linear quad-tree).
+ */
+
+#include <stdexcept>
+#include <algorithm>
+#include <iterator>
+
+#include "dbglog/dbglog.hpp"
+
+#include "linearqtree.hpp"
+
+namespace imgproc { namespace linearqtree {
+
+namespace {
+
+using detail::Black;
+using detail::Gray;
+using detail::White;
+using detail::childType;
+
+unsigned int computeDepth(unsigned int sizeX, unsigned int sizeY)
+{
+    unsigned int quadSize = 1;
+    unsigned int depth(0);
+    while ((quadSize < sizeX) || (quadSize < sizeY)) {
+        quadSize <<= 1;
+        ++depth;
+    }
+    return depth;
+}
+
+/** Returns node with given child set to given type.
+ */
+inline std::uint8_t setChild(std::uint8_t node, int child, std::uint8_t type)
+{
+    const int shift(2 * (3 - child));
+    return std::uint8_t((node & ~(0x3 << shift)) | (type << shift));
+}
+
+/** Returns node with all its leaf children inverted (gray children are left
+ *  intact).
+ */
+inline std::uint8_t invertNode(std::uint8_t node)
+{
+    // flip all bits: black <-> white, gray (01) -> 10
+    const std::uint8_t flipped(~node);
+    // find 10 pairs and turn them back to 01
+    const std::uint8_t hi(flipped & 0xaa & ~((flipped & 0x55) << 1));
+    return std::uint8_t(flipped ^ hi ^ (hi >> 1));
+}
+
+/** Read-only view of a node array.
+ */
+struct Tree {
+    const std::vector<std::uint8_t> &nodes;
+    const std::vector<std::uint32_t> &skip;
+
+    /** Returns index right after subtree at given index.
+     */
+    std::size_t end(std::size_t index) const {
+        return index + 1 + skip[index];
+    }
+};
+
+struct Or { static bool apply(bool a, bool b) { return a || b; } };
+struct And { static bool apply(bool a, bool b) { return a && b; } };
+struct AndNot { static bool apply(bool a, bool b) { return a && !b; } };
+
+/** Builds result of Operation applied to two trees. Result is produced in a
+ *  single simultaneous depth-first pass over both inputs.
+ */
+template <typename Operation>
+class Combiner {
+public:
+    Combiner(const Tree &a, const Tree &b, std::vector<std::uint8_t> &nodes
+             , std::vector<std::uint32_t> &skip)
+        : a_(a), b_(b), nodes_(nodes), skip_(skip)
+    {}
+
+    /** Combines two (sub)trees of given types. Indices of gray nodes are
+     *  advanced past their subtrees. Returns type of result.
+     */
+    std::uint8_t combine(std::uint8_t ta, std::size_t &ia
+                         , std::uint8_t tb, std::size_t &ib)
+    {
+        if ((ta != Gray) && (tb != Gray)) {
+            return Operation::apply(ta == White, tb == White)
+                ? White : Black;
+        }
+
+        if (ta != Gray) { return leaf(ta == White, true, b_, ib); }
+        if (tb != Gray) { return leaf(tb == White, false, a_, ia); }
+
+        // gray vs gray: go down
+        const auto pos(nodes_.size());
+        nodes_.push_back(0);
+        skip_.push_back(0);
+
+        const auto na(a_.nodes[ia++]);
+        const auto nb(b_.nodes[ib++]);
+
+        std::uint8_t node(0);
+        for (int child(0); child < 4; ++child) {
+            node = setChild(node, child
+                            , combine(childType(na, child), ia
+                                      , childType(nb, child), ib));
+        }
+
+        return finish(pos, node);
+    }
+
+    /** Finalizes node placed at given position. Uniform node is removed
+     *  from the output and its type is returned instead.
+     */
+    std::uint8_t finish(std::size_t pos, std::uint8_t node) {
+        if ((node == 0x00) || (node == 0xff)) {
+            // no gray children were written
+            nodes_.resize(pos);
+            skip_.resize(pos);
+            return node ? White : Black;
+        }
+
+        nodes_[pos] = node;
+        skip_[pos] = std::uint32_t(nodes_.size() - pos - 1);
+        return Gray;
+    }
+
+private:
+    /** Combines leaf value with gray subtree of given tree.
+     */
+    std::uint8_t leaf(bool value, bool leafFirst, const Tree &tree
+                      , std::size_t &index)
+    {
+        const bool r0(leafFirst ? Operation::apply(value, false)
+                      : Operation::apply(false, value));
+        const bool r1(leafFirst ? Operation::apply(value, true)
+                      : Operation::apply(true, value));
+
+        const auto end(tree.end(index));
+
+        if (r0 == r1) {
+            // constant result, subtree is skipped
+            index = end;
+            return r0 ? White : Black;
+        }
+
+        // identity or negation: copy subtree
+        if (r0) {
+            std::transform(tree.nodes.begin() + index
+                           , tree.nodes.begin() + end
+                           , std::back_inserter(nodes_), invertNode);
+        } else {
+            nodes_.insert(nodes_.end(), tree.nodes.begin() + index
+                          , tree.nodes.begin() + end);
+        }
+        skip_.insert(skip_.end(), tree.skip.begin() + index
+                     , tree.skip.begin() + end);
+
+        index = end;
+        return Gray;
+    }
+
+    const Tree &a_;
+    const Tree &b_;
+    std::vector<std::uint8_t> &nodes_;
+    std::vector<std::uint32_t> &skip_;
+};
+
+} // namespace
+
+RasterMask::RasterMask(unsigned int sizeX, unsigned int sizeY
+                       , const InitMode mode)
+    : sizeX_(sizeX), sizeY_(sizeY)
+    , depth_(computeDepth(sizeX_, sizeY_))
+    , quadSize_(1 << depth_)
+    , count_((mode == FULL) ? capacity() : 0)
+    , white_(mode == FULL)
+{}
+
+RasterMask::RasterMask(const math::Size2 &size, const InitMode mode)
+    : RasterMask(size.width, size.height, mode)
+{}
+
+RasterMask::RasterMask(const quadtree::RasterMask &mask)
+    : sizeX_(mask.sizeX_), sizeY_(mask.sizeY_)
+    , depth_(computeDepth(sizeX_, sizeY_))
+    , quadSize_(1 << depth_)
+    , count_(), white_()
+{
+    white_ = (append(mask.root_) == White);
+    recount();
+}
+
+std::uint8_t RasterMask::append(const quadtree::RasterMask::Node &node)
+{
+    typedef quadtree::RasterMask QRasterMask;
+
+    switch (node.type) {
+    case QRasterMask::WHITE: return White;
+    case QRasterMask::BLACK: return Black;
+    case QRasterMask::GRAY: break;
+    }
+
+    const auto pos(nodes_.size());
+    nodes_.push_back(0);
+    skip_.push_back(0);
+
+    const auto &children(*node.children);
+    std::uint8_t value(0);
+    value = setChild(value, 0, append(children.ul));
+    value = setChild(value, 1, append(children.ur));
+    value = setChild(value, 2, append(children.ll));
+    value = setChild(value, 3, append(children.lr));
+
+    // source tree may not be contracted (e.g. after coarsen)
+    if ((value == 0x00) || (value == 0xff)) {
+        nodes_.resize(pos);
+        skip_.resize(pos);
+        return value ? White : Black;
+    }
+
+    nodes_[pos] = value;
+    skip_[pos] = std::uint32_t(nodes_.size() - pos - 1);
+    return Gray;
+}
+
+quadtree::RasterMask RasterMask::asQuadtree() const
+{
+    quadtree::RasterMask mask(sizeX_, sizeY_
+                              , (white_ ? quadtree::RasterMask::FULL
+                                 : quadtree::RasterMask::EMPTY));
+    if (!nodes_.empty()) {
+        std::size_t index(0);
+        build(mask.root_, index);
+        mask.count_ = count_;
+    }
+    return mask;
+}
+
+void RasterMask::build(quadtree::RasterMask::Node &node
+                       , std::size_t &index) const
+{
+    typedef quadtree::RasterMask QRasterMask;
+
+    const auto value(nodes_[index++]);
+    node.type = QRasterMask::GRAY;
+    node.children = node.mask.malloc();
+
+    auto child([&](QRasterMask::Node &child, int i)
+    {
+        switch (childType(value, i)) {
+        case Black: child.type = QRasterMask::BLACK; break;
+        case White: child.type = QRasterMask::WHITE; break;
+        default: build(child, index); break;
+        }
+    });
+
+    child(node.children->ul, 0);
+    child(node.children->ur, 1);
+    child(node.children->ll, 2);
+    child(node.children->lr, 3);
+}
+
+void RasterMask::invert()
+{
+    std::transform(nodes_.begin(), nodes_.end(), nodes_.begin()
+                   , invertNode);
+    white_ = !white_;
+    count_ = capacity() - count_;
+}
+
+std::size_t RasterMask::childIndex(std::size_t index, int child) const
+{
+    const auto node(nodes_[index]);
+    ++index;
+    for (int c(0); c < child; ++c) {
+        if (childType(node, c) == Gray) { index += 1 + skip_[index]; }
+    }
+    return index;
+}
+
+bool RasterMask::get(int x, int y) const
+{
+    if ((x < 0) || (x >= int(sizeX_)) || (y < 0) || (y >= int(sizeY_))) {
+        return false;
+    }
+
+    if (nodes_.empty()) { return white_; }
+
+    std::size_t index(0);
+    for (unsigned int size(quadSize_ >> 1); ; size >>= 1) {
+        const int child(((x & size) ? 1 : 0) | ((y & size) ? 2 : 0));
+        switch (childType(nodes_[index], child)) {
+        case Black: return false;
+        case White: return true;
+        default: index = childIndex(index, child); break;
+        }
+    }
+}
+
+void RasterMask::set(int x, int y, bool value)
+{
+    if ((x < 0) || (x >= int(sizeX_)) || (y < 0) || (y >= int(sizeY_))) {
+        return;
+    }
+
+    const std::uint8_t type(value ? White : Black);
+
+    // creates chain of gray nodes from quad of given size (filled with
+    // leaf) down to the pixel at (x, y); returns chain length
+    auto split([&](std::size_t at, unsigned int size, std::uint8_t leaf)
+               -> std::size_t
+    {
+        std::vector<std::uint8_t> nodes;
+        std::vector<std::uint32_t> skip;
+        for (size >>= 1; size; size >>= 1) {
+            const int child(((x & size) ? 1 : 0) | ((y & size) ? 2 : 0));
+            nodes.push_back(setChild((leaf == White) ? 0xff : 0x00, child
+                                     , (size > 1) ? std::uint8_t(Gray)
+                                     : type));
+        }
+
+        for (std::size_t i(nodes.size()); i; --i) {
+            skip.push_back(std::uint32_t(i - 1));
+        }
+
+        nodes_.insert(nodes_.begin() + at, nodes.begin(), nodes.end());
+        skip_.insert(skip_.begin() + at, skip.begin(), skip.end());
+        return nodes.size();
+    });
+
+    if (nodes_.empty()) {
+        if (white_ == value) { return; }
+
+        if (!depth_) {
+            // single pixel mask
+            white_ = value;
+        } else {
+            split(0, quadSize_, white_ ? White : Black);
+        }
+        count_ = value ? (count_ + 1) : (count_ - 1);
+        return;
+    }
+
+    // gray nodes on the path from root and child index taken in each
+    std::size_t path[sizeof(unsigned int) * 8 + 1];
+    int children[sizeof(unsigned int) * 8 + 1];
+    int length(0);
+
+    std::size_t index(0);
+    for (unsigned int size(quadSize_ >> 1); ; size >>= 1) {
+        const int child(((x & size) ? 1 : 0) | ((y & size) ? 2 : 0));
+        path[length] = index;
+        children[length] = child;
+        ++length;
+
+        const auto node(nodes_[index]);
+        const auto ct(childType(node, child));
+        if (ct == Gray) {
+            index = childIndex(index, child);
+            continue;
+        }
+
+        // leaf node
+        if (ct == type) { return; }
+        count_ = value ? (count_ + 1) : (count_ - 1);
+
+        if (size > 1) {
+            // split leaf quad into chain of gray nodes
+            const auto added(split(childIndex(index, child), size, ct));
+            nodes_[index] = setChild(node, child, Gray);
+            for (int i(0); i < length; ++i) {
+                skip_[path[i]] += std::uint32_t(added);
+            }
+            return;
+        }
+
+        // single pixel, change in place
+        nodes_[index] = setChild(node, child, type);
+        break;
+    }
+
+    // contract path bottom up
+    for (int i(length - 1); i >= 0; --i) {
+        const auto node(nodes_[path[i]]);
+        if ((node != 0x00) && (node != 0xff)) { break; }
+
+        // uniform node has no gray children, just remove it
+        nodes_.erase(nodes_.begin() + path[i]);
+        skip_.erase(skip_.begin() + path[i]);
+
+        if (!i) {
+            white_ = node;
+            break;
+        }
+
+        nodes_[path[i - 1]] = setChild(nodes_[path[i - 1]], children[i - 1]
+                                       , node ? White : Black);
+        for (int j(0); j < i; ++j) { --skip_[path[j]]; }
+    }
+}
+
+template <typename Operation>
+void RasterMask::combine(const RasterMask &other, const char *what)
+{
+    if ((sizeX_ != other.sizeX_) || (sizeY_ != other.sizeY_)) {
+        LOGTHROW(err1, std::runtime_error)
+            << "Attempt to " << what << " mask with diferent dimensions.";
+    }
+
+    std::vector<std::uint8_t> nodes;
+    std::vector<std::uint32_t> skip;
+
+    const Tree a{ nodes_, skip_ };
+    const Tree b{ other.nodes_, other.skip_ };
+    Combiner<Operation> combiner(a, b, nodes, skip);
+
+    std::size_t ia(0), ib(0);
+    const auto root(combiner.combine
+                    (nodes_.empty() ? (white_ ? White : Black) : Gray, ia
+                     , (other.nodes_.empty()
+                        ? (other.white_ ? White : Black) : Gray), ib));
+
+    nodes_.swap(nodes);
+    skip_.swap(skip);
+    white_ = (root == White);
+    recount();
+}
+
+void RasterMask::merge(const RasterMask &other)
+{
+    combine<Or>(other, "merge");
+}
+
+void RasterMask::intersect(const RasterMask &other)
+{
+    combine<And>(other, "intersect");
+}
+
+void RasterMask::subtract(const RasterMask &other)
+{
+    combine<AndNot>(other, "subtract");
+}
+
+void RasterMask::recount()
+{
+    unsigned long long count(0);
+    forEachQuad([&count](unsigned int, unsigned int, unsigned long long xsize
+                         , unsigned long long ysize, bool)
+    {
+        count += xsize * ysize;
+    }, Filter::white);
+    count_ = count;
+}
+
+} } // namespace imgproc::linearqtree
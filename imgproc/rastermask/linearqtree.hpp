@@ -0,0 +1,218 @@
+/**
+ * Copyright (c) 2021 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file rastermask/linearqtree.hpp
+ *
+ * Raster mask (pointer-free linear quad-tree).
+ */
+
+#ifndef imgproc_rastermask_linearqtree_hpp_included_
+#define imgproc_rastermask_linearqtree_hpp_included_
+
+#include <vector>
+#include <cstdint>
+
+#include "math/geometry_core.hpp"
+
+#include "quadtree.hpp"
+
+/**** linear quad-tree version of rastermask ****/
+
+/** Representation:
+ *
+ *  Only gray (inner) nodes are stored. They live in a single array in
+ *  depth-first order with children visited in UL, UR, LL, LR order, i.e. the
+ *  array is ordered by Morton code of the nodes. Each gray node is one byte
+ *  holding the types of its 4 children, 2 bits each, the same way as in the
+ *  mappedqtree on-disk format:
+ *
+ *      node = UL << 6 | UR << 4 | LL << 2 | LR
+ *
+ *      00: black node
+ *      01: gray node
+ *      11: white node
+ *
+ *  Subtree of a gray child immediately follows subtrees of its preceding
+ *  gray siblings. Each gray node has an associated number of gray nodes in
+ *  its subtree (kept in a parallel array) so that siblings can be jumped over
+ *  during random access.
+ *
+ *  Mask without any gray node is uniform (either full or empty).
+ */
+
+namespace imgproc { namespace linearqtree {
+
+class RasterMask {
+public:
+    enum InitMode {
+        EMPTY = 0,
+        FULL = 1
+    };
+
+    RasterMask()
+        : sizeX_(), sizeY_(), depth_(), quadSize_(1), count_(), white_()
+    {}
+
+    /** initialize mask */
+    RasterMask(unsigned int sizeX, unsigned int sizeY, const InitMode mode);
+
+    /** initialize mask */
+    RasterMask(const math::Size2 &size, const InitMode mode);
+
+    /** Converts quad-tree mask into linear representation.
+     */
+    explicit RasterMask(const quadtree::RasterMask &mask);
+
+    /** Converts mask into quad-tree representation.
+     */
+    quadtree::RasterMask asQuadtree() const;
+
+    /** return size of mask */
+    math::Size2 size() const { return math::Size2(sizeX_, sizeY_); }
+
+    math::Size2 dims() const { return math::Size2(sizeX_, sizeY_); }
+
+    /** invert a mask (negate pixels) */
+    void invert();
+
+    /** obtain mask value at given pos, return false if x, y out of bounds */
+    bool get(int x, int y) const;
+
+    /** Set mask value at given pos.
+     *
+     *  Splitting or contracting a node shifts the tail of the node array;
+     *  use merge/intersect/subtract for bulk updates.
+     */
+    void set(int x, int y, bool value = true);
+
+    /** Merges other mask into this mask (union).
+     */
+    void merge(const RasterMask &other);
+
+    /** In place intersects other mask with this mask.
+     */
+    void intersect(const RasterMask &other);
+
+    /** Set difference with other mask.
+     */
+    void subtract(const RasterMask &other);
+
+    /** return mask size (number of white pixels) */
+    unsigned long long count() const { return count_; }
+
+    /** return total number of pixels */
+    unsigned long long capacity() const {
+        return (unsigned long long)(sizeX_) * (unsigned long long)(sizeY_);
+    }
+
+    /** test mask for emptiness */
+    bool empty() const { return count_ == 0; }
+
+    bool full() const { return count_ == capacity(); }
+
+    /** Returns maximal depth of tree.
+     */
+    unsigned int depth() const { return depth_; }
+
+    /** Returns number of gray nodes in the tree.
+     */
+    std::size_t nodeCount() const { return nodes_.size(); }
+
+    /** Returns number of bytes occupied by the tree.
+     */
+    std::size_t byteCount() const {
+        return nodes_.size() * (sizeof(std::uint8_t) + sizeof(std::uint32_t));
+    }
+
+    typedef quadtree::RasterMask::Filter Filter;
+
+    /** Runs op(x, y, xsize, ysize, white) for each black/white quad in
+     *  Morton order.
+     */
+    template <typename Op>
+    void forEachQuad(const Op &op, Filter filter = Filter::both) const;
+
+    /** Runs op(x, y, xsize, ysize, boost::tribool) for each black/white/gray
+     *  quad (gray is marked by indeterminate value). Tree descent is terminated
+     *  at given tree depth.
+     */
+    template <typename Op>
+    void forEachQuad(unsigned int depth, const Op &op) const;
+
+private:
+    template <typename Operation>
+    void combine(const RasterMask &other, const char *what);
+
+    void recount();
+
+    /** Index of given child's subtree of gray node at given index.
+     */
+    std::size_t childIndex(std::size_t index, int child) const;
+
+    /** Appends subtree of quad-tree node, returns its type.
+     */
+    std::uint8_t append(const quadtree::RasterMask::Node &node);
+
+    /** Builds quad-tree node from subtree at given index.
+     */
+    void build(quadtree::RasterMask::Node &node, std::size_t &index) const;
+
+    template <typename Op>
+    void descend(std::size_t &index, unsigned int x, unsigned int y
+                 , unsigned int size, const Op &op, Filter filter) const;
+
+    template <typename Op>
+    void descend(std::size_t &index, unsigned int depth
+                 , unsigned int x, unsigned int y
+                 , unsigned int size, const Op &op) const;
+
+    template <typename Op, typename Value>
+    void call(unsigned int x, unsigned int y, unsigned int size
+              , const Op &op, const Value &value) const;
+
+    unsigned int sizeX_, sizeY_;
+    unsigned int depth_;
+    unsigned int quadSize_;
+    unsigned long long count_;
+
+    /** Gray nodes in Morton order.
+     */
+    std::vector<std::uint8_t> nodes_;
+
+    /** Number of gray nodes in subtree of each node (node itself excluded).
+     */
+    std::vector<std::uint32_t> skip_;
+
+    /** Value of the whole mask when there are no gray nodes.
+     */
+    bool white_;
+};
+
+} } // namespace imgproc::linearqtree
+
+#include "inline/linearqtree.hpp"
+
+#endif // imgproc_rastermask_linearqtree_hpp_included_
@@ -0,0 +1,446 @@
+/**
+ * Copyright (c) 2021 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file rastermask/mappedqtree-writer.cpp
+ *
+ * Streaming writer of the memory-mapped quad-tree raster mask format.
+ */
+
+#include <sstream>
+#include <stdexcept>
+
+#include "dbglog/dbglog.hpp"
+
+#include "utility/binaryio.hpp"
+#include "utility/align.hpp"
+
+#include "mappedqtree-writer.hpp"
+#include "quadtree.hpp"
+#include "detail/mappedqtree.hpp"
+
+namespace bin = utility::binaryio;
+
+namespace imgproc { namespace mappedqtree {
+
+namespace detail {
+
+namespace {
+
+enum : std::uint8_t { Black = 0x0, Gray = 0x1, White = 0x3 };
+
+/** Quad coordinates -> Morton code.
+ */
+inline std::uint64_t morton(unsigned int x, unsigned int y)
+{
+    std::uint64_t code(0);
+    for (unsigned int bit(0); (x | y); ++bit, x >>= 1, y >>= 1) {
+        code |= std::uint64_t(x & 1) << (2 * bit);
+        code |= std::uint64_t(y & 1) << (2 * bit + 1);
+    }
+    return code;
+}
+
+/** Writes zero bytes up to aligned position.
+ */
+void pad(std::ostream &os)
+{
+    const auto pos(os.tellp());
+    for (auto aligned(utility::align(pos, sizeof(std::uint32_t)))
+             , p(pos); p != aligned; p += 1)
+    {
+        bin::write(os, std::uint8_t(0));
+    }
+}
+
+inline std::uint8_t type(const boost::tribool &value)
+{
+    if (boost::indeterminate(value)) { return Gray; }
+    return value ? White : Black;
+}
+
+} // namespace
+
+/** Builds tree bottom-up, writes it to the output stream.
+ *
+ *  Only nodes on the path from the root to the last placed quad are kept
+ *  open. A node is written out (jump value placeholder and child byte
+ *  placeholder) only when it is known to be gray, i.e. when first of its gray
+ *  descendants is written or when it is closed with non-uniform leaf
+ *  children. Placeholders are patched when the node is closed.
+ */
+class Builder {
+public:
+    Builder(std::ostream &os, unsigned int depth, Index *index)
+        : os_(os), depth_(depth), start_(os.tellp()), index_(index)
+        , next_(), root_(Black), finished_(false)
+    {}
+
+    void place(unsigned int depth, unsigned int x, unsigned int y
+               , std::uint8_t type, const std::string *data = nullptr);
+
+    /** Closes all nodes and writes leaf root. Returns root type.
+     */
+    std::uint8_t finish();
+
+private:
+    struct Level {
+        unsigned int x, y;
+        std::uint8_t types[4];
+        bool emitted;
+        std::streampos jump;
+        std::streampos node;
+
+        Level(unsigned int x, unsigned int y)
+            : x(x), y(y), types{ Black, Black, Black, Black }
+            , emitted(false)
+        {}
+    };
+
+    /** Closes top node and reports it to its parent.
+     */
+    void close();
+
+    /** Writes placeholders of all open nodes not written yet.
+     */
+    void emit();
+
+    std::ostream &os_;
+    unsigned int depth_;
+    std::streampos start_;
+    Index *index_;
+
+    /** Open nodes, stack_[d] is node at depth d.
+     */
+    std::vector<Level> stack_;
+
+    /** Morton code of the next free pixel.
+     */
+    std::uint64_t next_;
+
+    std::uint8_t root_;
+    bool finished_;
+};
+
+void Builder::emit()
+{
+    for (std::size_t d(0); d < stack_.size(); ++d) {
+        auto &level(stack_[d]);
+        if (level.emitted) { continue; }
+
+        if (d) {
+            // jump value placeholder at aligned position
+            pad(os_);
+            level.jump = os_.tellp();
+            bin::write(os_, std::uint32_t(0));
+        }
+
+        level.node = os_.tellp();
+        bin::write(os_, std::uint8_t(0));
+        level.emitted = true;
+    }
+}
+
+void Builder::place(unsigned int depth, unsigned int x, unsigned int y
+                    , std::uint8_t type, const std::string *data)
+{
+    if (finished_) {
+        LOGTHROW(err2, std::logic_error)
+            << "Mapped QTree writer: cannot place quad into finished tree.";
+    }
+
+    if ((depth > depth_) || (x >> depth) || (y >> depth)) {
+        LOGTHROW(err2, std::logic_error)
+            << "Mapped QTree writer: quad " << depth << "-" << x << "-" << y
+            << " is outside of tree of depth " << depth_ << ".";
+    }
+
+    // check Morton order
+    const auto shift(2 * (depth_ - depth));
+    const auto code(morton(x, y) << shift);
+    if (code < next_) {
+        LOGTHROW(err2, std::logic_error)
+            << "Mapped QTree writer: quad " << depth << "-" << x << "-" << y
+            << " is not in Morton order.";
+    }
+    next_ = code + (std::uint64_t(1) << shift);
+
+    // black is default
+    if (type == Black) { return; }
+
+    if (!depth) {
+        // whole tree
+        if (type == Gray) {
+            if (utility::align(start_, sizeof(std::uint32_t)) != start_) {
+                LOGTHROW(err2, std::logic_error)
+                    << "Mapped QTree writer: gray subtree cannot be placed "
+                    "at unaligned root.";
+            }
+            bin::write(os_, data->data(), data->size());
+        } else if (index_) {
+            index_->white(0, 0, 0);
+        }
+        root_ = type;
+        return;
+    }
+
+    // close open nodes not containing this quad
+    while (!stack_.empty()) {
+        const auto d(stack_.size() - 1);
+        const auto &top(stack_.back());
+        if ((d < depth) && ((x >> (depth - d)) == top.x)
+            && ((y >> (depth - d)) == top.y))
+        {
+            break;
+        }
+        close();
+    }
+
+    // open nodes down to the parent of this quad
+    while (stack_.size() < depth) {
+        const auto d(stack_.size());
+        stack_.emplace_back(x >> (depth - d), y >> (depth - d));
+    }
+
+    auto &parent(stack_.back());
+    const int child((x & 1) | ((y & 1) << 1));
+    parent.types[child] = type;
+
+    if (type == White) {
+        if (index_) { index_->white(depth, x, y); }
+        return;
+    }
+
+    // gray subtree: write all ancestors and then subtree with its jump
+    if (index_ && (depth < index_->depth)) {
+        LOGTHROW(err2, std::logic_error)
+            << "Mapped QTree writer: gray subtree cannot be placed above "
+            "index depth.";
+    }
+
+    emit();
+    pad(os_);
+    bin::write(os_, std::uint32_t(data->size()));
+    if (index_) { index_->gray(depth, x, y, os_.tellp() - start_); }
+    bin::write(os_, data->data(), data->size());
+}
+
+void Builder::close()
+{
+    const auto depth(stack_.size() - 1);
+    auto &top(stack_.back());
+
+    const std::uint8_t value((top.types[0] << 6) | (top.types[1] << 4)
+                             | (top.types[2] << 2) | top.types[3]);
+
+    std::uint8_t type(Gray);
+    if (!top.emitted) {
+        if ((value == 0x00) || (value == 0xff)) {
+            // uniform node, collapse to leaf
+            type = value ? White : Black;
+        } else {
+            // gray node with leaf children only
+            emit();
+        }
+    }
+
+    if (type == Gray) {
+        // patch child byte and jump value
+        const auto end(os_.tellp());
+        os_.seekp(top.node);
+        bin::write(os_, value);
+        if (depth) {
+            os_.seekp(top.jump);
+            bin::write(os_, std::uint32_t
+                       (end - top.jump - sizeof(std::uint32_t)));
+        }
+        os_.seekp(end);
+
+        if (index_) { index_->gray(depth, top.x, top.y, top.node - start_); }
+    }
+
+    const auto x(top.x), y(top.y);
+    stack_.pop_back();
+
+    // report to parent
+    if (!depth) {
+        root_ = type;
+        return;
+    }
+
+    stack_.back().types[(x & 1) | ((y & 1) << 1)] = type;
+    if (index_ && (type == White)) { index_->white(depth, x, y); }
+}
+
+std::uint8_t Builder::finish()
+{
+    if (finished_) { return root_; }
+
+    while (!stack_.empty()) { close(); }
+
+    // leaf root is represented by single byte
+    switch (root_) {
+    case Black: bin::write(os_, std::uint8_t(0x00)); break;
+    case White: bin::write(os_, std::uint8_t(0xff)); break;
+    default: break;
+    }
+
+    finished_ = true;
+    return root_;
+}
+
+} // namespace detail
+
+Writer::Writer(std::ostream &os, unsigned int depth, unsigned int indexDepth)
+    : os_(os), depth_(depth)
+{
+    // index depth must be inside the tree
+    if (indexDepth >= depth) { indexDepth = depth ? (depth - 1) : 0; }
+
+    bin::write(os_, detail::IO_MAGIC); // 6 bytes
+    bin::write(os_, std::uint8_t(indexDepth ? detail::FLAG_INDEX : 0));
+    bin::write(os_, std::uint8_t(0)); // reserved
+    bin::write(os_, std::uint8_t(depth));
+
+    // make room for data size
+    sizePlace_ = os_.tellp();
+    bin::write(os_, std::uint32_t(0));
+
+    index_.reset(new detail::Index(indexDepth));
+    builder_.reset(new detail::Builder
+                   (os_, depth, indexDepth ? index_.get() : nullptr));
+}
+
+Writer::~Writer() {}
+
+void Writer::quad(unsigned int depth, unsigned int x, unsigned int y
+                  , bool value)
+{
+    builder_->place(depth, x, y, value ? detail::White : detail::Black);
+}
+
+void Writer::subtree(unsigned int depth, unsigned int x, unsigned int y
+                     , const Subtree &subtree)
+{
+    builder_->place(depth, x, y, detail::type(subtree.value), &subtree.data);
+}
+
+void Writer::subtree(unsigned int depth, unsigned int x, unsigned int y
+                     , const quadtree::RasterMask &mask)
+{
+    if (depth + mask.depth() != depth_) {
+        LOGTHROW(err2, std::logic_error)
+            << "Mapped QTree writer: subtree of depth " << mask.depth()
+            << " doesn't fit at depth " << depth << " of tree of depth "
+            << depth_ << ".";
+    }
+    subtree(depth, x, y, RasterMask::serialize(mask));
+}
+
+void Writer::finish()
+{
+    builder_->finish();
+
+    // compute data size and write to pre-allocated place
+    const auto end(os_.tellp());
+    os_.seekp(sizePlace_);
+    bin::write(os_, std::uint32_t(end - sizePlace_ - sizeof(std::uint32_t)));
+    os_.seekp(end);
+
+    if (index_->depth) {
+        // write index after the tree
+        bin::write(os_, std::uint8_t(index_->depth));
+        detail::pad(os_);
+        bin::write(os_, index_->quads.data(), index_->quads.size());
+    }
+}
+
+SubtreeWriter::SubtreeWriter(unsigned int depth)
+    : os_(new std::ostringstream())
+    , builder_(new detail::Builder(*os_, depth, nullptr))
+{}
+
+SubtreeWriter::~SubtreeWriter() {}
+
+void SubtreeWriter::quad(unsigned int depth, unsigned int x, unsigned int y
+                         , bool value)
+{
+    builder_->place(depth, x, y, value ? detail::White : detail::Black);
+}
+
+void SubtreeWriter::subtree(unsigned int depth, unsigned int x
+                            , unsigned int y, const Subtree &subtree)
+{
+    builder_->place(depth, x, y, detail::type(subtree.value), &subtree.data);
+}
+
+Subtree SubtreeWriter::finish()
+{
+    switch (builder_->finish()) {
+    case detail::Black: return Subtree(false);
+    case detail::White: return Subtree(true);
+    default: break;
+    }
+
+    Subtree subtree(boost::indeterminate);
+    subtree.data = os_->str();
+    return subtree;
+}
+
+Subtree RasterMask::serialize(const quadtree::RasterMask &mask)
+{
+    typedef quadtree::RasterMask::Node Node;
+    typedef quadtree::RasterMask::NodeType NodeType;
+
+    SubtreeWriter writer(mask.depth());
+
+    // walk the tree in Morton order
+    struct Walker {
+        SubtreeWriter &writer;
+
+        void walk(const Node &node, unsigned int depth, unsigned int x
+                  , unsigned int y)
+        {
+            switch (node.type) {
+            case NodeType::BLACK: return;
+            case NodeType::WHITE: writer.quad(depth, x, y); return;
+            case NodeType::GRAY: break;
+            }
+
+            ++depth;
+            x <<= 1;
+            y <<= 1;
+            walk(node.children->ul, depth, x, y);
+            walk(node.children->ur, depth, x + 1, y);
+            walk(node.children->ll, depth, x, y + 1);
+            walk(node.children->lr, depth, x + 1, y + 1);
+        }
+    };
+
+    Walker{ writer }.walk(mask.root_, 0, 0, 0);
+    return writer.finish();
+}
+
+} } // namespace imgproc::mappedqtree
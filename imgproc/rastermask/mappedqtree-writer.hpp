@@ -0,0 +1,220 @@
+/**
+ * Copyright (c) 2021 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file rastermask/mappedqtree-writer.hpp
+ *
+ * Streaming writer of the memory-mapped quad-tree raster mask format.
+ */
+
+#ifndef imgproc_rastermask_mappedqtree_writer_hpp_included_
+#define imgproc_rastermask_mappedqtree_writer_hpp_included_
+
+#include <memory>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <ios>
+
+#include <boost/logic/tribool.hpp>
+
+#include "utility/openmp.hpp"
+
+#include "mappedqtree.hpp"
+
+namespace imgproc { namespace mappedqtree {
+
+/** Serialized subtree in the mappedqtree on-disk format.
+ *
+ *  Gray subtree always starts at 4-byte aligned offset in the file (right
+ *  after its jump value) therefore its serialized form does not depend on
+ *  its final position and can be produced independently (e.g. in parallel)
+ *  and stitched into the output later.
+ */
+struct Subtree {
+    /** White (true), black (false) or gray (indeterminate) subtree.
+     */
+    boost::tribool value;
+
+    /** Serialized gray subtree, empty for black/white subtree.
+     */
+    std::string data;
+
+    Subtree(boost::tribool value = false) : value(value) {}
+};
+
+namespace detail {
+
+class Builder;
+struct Index;
+
+/** Morton code -> quad coordinates.
+ */
+inline void demorton(std::uint64_t code, unsigned int &x, unsigned int &y)
+{
+    x = y = 0;
+    for (unsigned int bit(0); code; ++bit, code >>= 2) {
+        x |= unsigned(code & 1) << bit;
+        y |= unsigned((code >> 1) & 1) << bit;
+    }
+}
+
+} // namespace detail
+
+/** Streaming writer of the mappedqtree::RasterMask on-disk format.
+ *
+ *  Tree is built bottom-up from leaf quads (or pre-serialized subtrees)
+ *  given in Morton order (UL, UR, LL, LR); quads not covered by input are
+ *  black. Finished nodes are written to the output immediately, only the path
+ *  from the root to the current quad is kept in memory. Output stream must be
+ *  seekable: child bytes and jump values are patched in place.
+ */
+class Writer {
+public:
+    /** Writes header and prepares for tree data.
+     *
+     *  \param os output stream
+     *  \param depth tree depth
+     *  \param indexDepth depth of optional node index, see RasterMask::write
+     */
+    Writer(std::ostream &os, unsigned int depth, unsigned int indexDepth = 0);
+
+    ~Writer();
+
+    /** Sets quad at given depth to given value.
+     *
+     *  \param depth depth in tree, root starts at 0
+     *  \param x horizontal index in quads at given depth
+     *  \param y vertical index in quads at given depth
+     *  \param value value to set
+     */
+    void quad(unsigned int depth, unsigned int x, unsigned int y
+              , bool value = true);
+
+    /** Places serialized subtree at given quad. Gray subtree cannot be placed
+     *  at the root or above index depth.
+     */
+    void subtree(unsigned int depth, unsigned int x, unsigned int y
+                 , const Subtree &subtree);
+
+    /** Places quad-tree mask at given quad. Mask depth must match.
+     */
+    void subtree(unsigned int depth, unsigned int x, unsigned int y
+                 , const quadtree::RasterMask &mask);
+
+    /** Closes all pending nodes, writes tree size and index. Must be called
+     *  to get valid output.
+     */
+    void finish();
+
+private:
+    std::ostream &os_;
+    unsigned int depth_;
+    std::streampos sizePlace_;
+    std::unique_ptr<detail::Index> index_;
+    std::unique_ptr<detail::Builder> builder_;
+};
+
+/** Builds serialized subtree in memory from quads given in Morton order.
+ */
+class SubtreeWriter {
+public:
+    /** \param depth subtree depth
+     */
+    SubtreeWriter(unsigned int depth);
+
+    ~SubtreeWriter();
+
+    /** Sets quad at given depth (relative to subtree) to given value.
+     */
+    void quad(unsigned int depth, unsigned int x, unsigned int y
+              , bool value = true);
+
+    /** Places serialized subtree at given quad (depth > 0).
+     */
+    void subtree(unsigned int depth, unsigned int x, unsigned int y
+                 , const Subtree &subtree);
+
+    /** Finishes and returns serialized subtree.
+     */
+    Subtree finish();
+
+private:
+    std::unique_ptr<std::ostringstream> os_;
+    std::unique_ptr<detail::Builder> builder_;
+};
+
+/** Writes mask of given depth generated tile by tile.
+ *
+ *  Tiles are quads at tileDepth (> 0). Each tile is produced by
+ *  generator(x, y) -> Subtree (e.g. via SubtreeWriter or
+ *  RasterMask::serialize). Tiles are generated in parallel in batches of
+ *  given size (in Morton order) and then stitched to the output; only one
+ *  batch is kept in memory.
+ *
+ *  Index depth, if non-zero, must not be bigger than tile depth.
+ */
+template <typename Generator>
+void writeTiled(std::ostream &os, unsigned int depth, unsigned int tileDepth
+                , const Generator &generator, unsigned int indexDepth = 0
+                , std::size_t batchSize = 1024);
+
+// inlines
+
+template <typename Generator>
+void writeTiled(std::ostream &os, unsigned int depth, unsigned int tileDepth
+                , const Generator &generator, unsigned int indexDepth
+                , std::size_t batchSize)
+{
+    Writer writer(os, depth, indexDepth);
+
+    const std::uint64_t tiles(std::uint64_t(1) << (2 * tileDepth));
+    std::vector<Subtree> batch;
+
+    for (std::uint64_t begin(0); begin < tiles; begin += batchSize) {
+        const auto count(std::int64_t(std::min<std::uint64_t>
+                                      (batchSize, tiles - begin)));
+        batch.assign(count, Subtree());
+
+        UTILITY_OMP(parallel for schedule(dynamic))
+        for (std::int64_t i = 0; i < count; ++i) {
+            unsigned int x, y;
+            detail::demorton(begin + i, x, y);
+            batch[i] = generator(x, y);
+        }
+
+        for (std::int64_t i(0); i < count; ++i) {
+            unsigned int x, y;
+            detail::demorton(begin + i, x, y);
+            writer.subtree(tileDepth, x, y, batch[i]);
+        }
+    }
+
+    writer.finish();
+}
+
+} } // namespace imgproc::mappedqtree
+
+#endif // imgproc_rastermask_mappedqtree_writer_hpp_included_
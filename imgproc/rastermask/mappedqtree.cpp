@@ -35,21 +35,21 @@
 
 #include "mappedqtree.hpp"
 #include "quadtree.hpp"
+#include "detail/mappedqtree.hpp"
 
 namespace bi = boost::interprocess;
 namespace bin = utility::binaryio;
 
 namespace imgproc { namespace mappedqtree {
 
-namespace {
-
-const char IO_MAGIC[6] = { 'M', 'Q', 'M', 'A', 'S', 'K' };
-
-} // namespcace
+using detail::IO_MAGIC;
+using detail::FLAG_INDEX;
+using detail::INDEX_BLACK;
+using detail::INDEX_WHITE;
 
 struct MemoryBase {
     MemoryBase(const boost::filesystem::path &path, std::size_t offset)
-        : treeStart(), size(), depth()
+        : treeStart(), size(), depth(), indexStart(), indexDepth(), end()
     {
         utility::ifstreambuf f(path.string());
         f.seekg(offset);
@@ -61,8 +61,8 @@ struct MemoryBase {
                 << "Mapped QTree RasterMask has wrong magic.";
         }
 
-        uint8_t reserved;
-        bin::read(f, reserved); // reserved
+        uint8_t flags, reserved;
+        bin::read(f, flags);
         bin::read(f, reserved); // reserved
 
         uint8_t tmpDepth;
@@ -76,25 +76,57 @@ struct MemoryBase {
         // here start data
         treeStart = f.tellg();
         size = tmpSize + treeStart;
+        end = size;
+
+        if (flags & FLAG_INDEX) {
+            // index follows the tree
+            f.seekg(size);
+            uint8_t tmpIndexDepth;
+            bin::read(f, tmpIndexDepth);
+            indexDepth = tmpIndexDepth;
+
+            if (!indexDepth || (indexDepth >= depth)) {
+                LOGTHROW(err2, std::runtime_error)
+                    << "Mapped QTree RasterMask has invalid index depth "
+                    << indexDepth << " (tree depth " << depth << ").";
+            }
+
+            indexStart = utility::align(std::size_t(f.tellg())
+                                        , sizeof(std::uint32_t));
+            end = indexStart
+                + (std::size_t(1) << (2 * indexDepth))
+                * sizeof(std::uint32_t);
+        }
     }
 
     char *data;
     std::size_t treeStart;
     std::size_t size;
     unsigned int depth;
+
+    std::size_t indexStart;
+    unsigned int indexDepth;
+
+    /** End of mapped data (tree or index). */
+    std::size_t end;
 };
 
 struct RasterMask::Memory : MemoryBase {
     Memory(const boost::filesystem::path &path, std::size_t offset)
         : MemoryBase(path, offset)
         , file(path.string().c_str(), bi::read_only)
-        , region(file, bi::read_only, 0, treeStart + size)
+        , region(file, bi::read_only, 0, end)
         , data()
     {
 
         data = static_cast<char*>(region.get_address());
     }
 
+    const std::uint32_t* index() const {
+        if (!indexDepth) { return nullptr; }
+        return reinterpret_cast<const std::uint32_t*>(data + indexStart);
+    }
+
     bi::file_mapping file;
     bi::mapped_region region;
     const char *data;
@@ -102,6 +134,7 @@ struct RasterMask::Memory : MemoryBase {
 
 RasterMask::RasterMask()
     : memory_(), data_(), dataSize_(), depth_(), start_()
+    , index_(), indexDepth_()
 {}
 
 RasterMask::RasterMask(const boost::filesystem::path &path
@@ -110,6 +143,8 @@ RasterMask::RasterMask(const boost::filesystem::path &path
     , data_(memory_->data), dataSize_(memory_->size)
     , depth_(memory_->depth)
     , start_(memory_->treeStart)
+    , index_(memory_->index())
+    , indexDepth_(memory_->indexDepth)
 {
 }
 
@@ -121,20 +156,117 @@ RasterMask::RasterMask(const boost::optional<boost::filesystem::path> &path
     , dataSize_(memory_ ? memory_->size : 0)
     , depth_(memory_ ? memory_->depth : 0)
     , start_(memory_ ? memory_->treeStart : 0)
+    , index_(memory_ ? memory_->index() : nullptr)
+    , indexDepth_(memory_ ? memory_->indexDepth : 0)
 {
 }
 
+bool RasterMask::get(int x, int y) const
+{
+    if ((x < 0) || (y < 0)) { return false; }
+
+    // pixel is either white or black
+    return bool(getQuad(depth_, x, y));
+}
+
+boost::tribool RasterMask::getQuad(unsigned int depth, unsigned int x
+                                   , unsigned int y) const
+{
+    if (!data_) { return false; }
+
+    if (depth > depth_) {
+        // subpixel quad -> use pixel
+        x >>= (depth - depth_);
+        y >>= (depth - depth_);
+        depth = depth_;
+    }
+
+    if ((x >> depth) || (y >> depth)) {
+        // out of bounds
+        return false;
+    }
+
+    // root node
+    std::size_t index(start_);
+    switch (*reinterpret_cast<const std::uint8_t*>(data_ + index)) {
+    case 0x00: return false;
+    case 0xff: return true;
+    default: break;
+    }
+
+    if (!depth) { return boost::indeterminate; }
+
+    // depth of node at index
+    unsigned int level(0);
+
+    if (index_ && (depth >= indexDepth_)) {
+        // start at index depth
+        const auto shift(depth - indexDepth_);
+        const auto value(index_[((y >> shift) << indexDepth_)
+                                + (x >> shift)]);
+        switch (value) {
+        case INDEX_BLACK: return false;
+        case INDEX_WHITE: return true;
+        default: break;
+        }
+
+        if (depth == indexDepth_) { return boost::indeterminate; }
+        index = start_ + value;
+        level = indexDepth_;
+    }
+
+    for (;;) {
+        const auto children(read<std::uint8_t>(index));
+        auto type([&](int child) -> std::uint8_t
+        {
+            // UL is stored in the most significant bits
+            return ((children >> (2 * (3 - child))) & 0x3);
+        });
+
+        const auto shift(depth - level - 1);
+        const int child((((x >> shift) & 1) ? 1 : 0)
+                        | (((y >> shift) & 1) ? 2 : 0));
+
+        // jump over preceding gray siblings
+        for (int c(0); c < child; ++c) {
+            switch (type(c)) {
+            case 0x0: case 0x3: break;
+            default: {
+                const auto jump(read<std::uint32_t>(index));
+                index += jump;
+                break;
+            }
+            }
+        }
+
+        switch (type(child)) {
+        case 0x0: return false;
+        case 0x3: return true;
+        default: break;
+        }
+
+        // gray child
+        if (++level == depth) { return boost::indeterminate; }
+
+        // skip jump value, index points to child's node
+        read<std::uint32_t>(index);
+    }
+}
+
 void RasterMask::write(std::ostream &f, const quadtree::RasterMask &mask
-                       , unsigned int depth, unsigned int x, unsigned int y)
+                       , unsigned int depth, unsigned int x, unsigned int y
+                       , unsigned int indexDepth)
 {
     typedef quadtree::RasterMask::Node Node;
     typedef quadtree::RasterMask::NodeType NodeType;
 
+    typedef detail::Index Index;
+
     struct Writer {
-        Writer(const Node &node, std::ostream &f)
-            : f(f)
+        Writer(const Node &node, std::ostream &f, Index &index)
+            : f(f), index(index), start(f.tellp())
         {
-            write(node);
+            write(node, 0, 0, 0);
         }
 
         inline std::uint8_t bitValue(NodeType type, std::uint8_t offset) {
@@ -146,8 +278,13 @@ void RasterMask::write(std::ostream &f, const quadtree::RasterMask &mask
             return 0;
         }
 
-        inline void writeSubtree(const Node &node) {
-            if (node.type != NodeType::GRAY) { return; }
+        inline void writeSubtree(const Node &node, unsigned int depth
+                                 , unsigned int x, unsigned int y)
+        {
+            if (node.type != NodeType::GRAY) {
+                if (node.type == NodeType::WHITE) { index.white(depth, x, y); }
+                return;
+            }
 
             // record current position and align it to sizeof jump value
             auto jump(utility::align(f.tellp(), sizeof(std::uint32_t)));
@@ -156,7 +293,7 @@ void RasterMask::write(std::ostream &f, const quadtree::RasterMask &mask
             f.seekp(jump + std::streampos(sizeof(std::uint32_t)));
 
             // write subtree
-            write(node);
+            write(node, depth, x, y);
 
             // remember current position
             auto end(f.tellp());
@@ -172,7 +309,11 @@ void RasterMask::write(std::ostream &f, const quadtree::RasterMask &mask
             f.seekp(end);
         }
 
-        inline void write(const Node &node) {
+        inline void write(const Node &node, unsigned int depth
+                          , unsigned int x, unsigned int y)
+        {
+            index.gray(depth, x, y, f.tellp() - start);
+
             std::uint8_t value
                 (bitValue(node.children->ul.type, 3)
                  | bitValue(node.children->ur.type, 2)
@@ -181,32 +322,44 @@ void RasterMask::write(std::ostream &f, const quadtree::RasterMask &mask
 
             bin::write(f, value);
 
-            writeSubtree(node.children->ul);
-            writeSubtree(node.children->ur);
-            writeSubtree(node.children->ll);
-            writeSubtree(node.children->lr);
+            ++depth;
+            x <<= 1;
+            y <<= 1;
+            writeSubtree(node.children->ul, depth, x, y);
+            writeSubtree(node.children->ur, depth, x + 1, y);
+            writeSubtree(node.children->ll, depth, x, y + 1);
+            writeSubtree(node.children->lr, depth, x + 1, y + 1);
         }
 
         std::ostream &f;
+        Index &index;
+        std::streampos start;
     };
 
+    // write depth
+    auto d(mask.depth() - depth);
+
+    // index depth must be inside the tree
+    if (indexDepth >= d) { indexDepth = d ? (d - 1) : 0; }
+
     bin::write(f, IO_MAGIC); // 6 bytes
-    bin::write(f, uint8_t(0)); // reserved
+    bin::write(f, uint8_t(indexDepth ? FLAG_INDEX : 0)); // flags
     bin::write(f, uint8_t(0)); // reserved
 
-    // write depth
-    auto d(mask.depth() - depth);
     bin::write(f, std::uint8_t(d));
 
     // make room for data size
     auto sizePlace(f.tellp());
     f.seekp(sizePlace + std::streampos(sizeof(std::uint32_t)));
 
+    Index index(indexDepth);
+
     if (const auto *start = mask.findSubtree(depth, x, y)) {
         // write root node or descend
         switch (start->type) {
         case NodeType::WHITE:
             bin::write(f, std::uint8_t(0xff));
+            index.white(0, 0, 0);
             break;
 
         case NodeType::BLACK:
@@ -214,7 +367,7 @@ void RasterMask::write(std::ostream &f, const quadtree::RasterMask &mask
             break;
 
         default:
-            Writer(*start, f);
+            Writer(*start, f, index);
             break;
         }
     } else {
@@ -230,6 +383,13 @@ void RasterMask::write(std::ostream &f, const quadtree::RasterMask &mask
 
     // move back to the end
     f.seekp(end);
+
+    if (indexDepth) {
+        // write index after the tree
+        bin::write(f, std::uint8_t(indexDepth));
+        f.seekp(utility::align(f.tellp(), sizeof(std::uint32_t)));
+        bin::write(f, index.quads.data(), index.quads.size());
+    }
 }
 
 } } // namespace imgproc::mappedqtree
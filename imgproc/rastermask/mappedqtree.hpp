@@ -40,6 +40,7 @@
 #include <iosfwd>
 
 #include <boost/filesystem/path.hpp>
+#include <boost/optional.hpp>
 #include <boost/logic/tribool.hpp>
 
 #include "dbglog/dbglog.hpp"
@@ -56,13 +57,13 @@
  *
  *  Header = {
  *      uint8[6] magic = "MQMASK"
- *      uint8 reserved1; // reserved for future use
+ *      uint8 flags;     // bit 0: index present
  *      uint8 reserved2; // reserved for future use
  *      uint8 depth;     // tree depth
  *      uint32 size;     // tree size
  *  }
  *
- *  The header is followed by the data tree.
+ *  The header is followed by the data tree and optional index.
  *
  *  Tree is either:
  *      * uint8(0xff): while tree valid.
@@ -82,6 +83,20 @@
  *          01: gray node
  *          10: gray node
  *          11: white node
+ *
+ *  Index (present only if flags & 0x01) immediately follows the tree:
+ *
+ *  Index = {
+ *      uint8 depth;     // index depth, 1 <= depth < tree depth
+ *      aligned uint32 quads[4^depth]; // row-major grid of quads at index
+ *                                     // depth:
+ *                                     //  0x00000000: black quad
+ *                                     //  0xffffffff: white quad
+ *                                     //  otherwise: offset of gray node
+ *                                     //  (its children byte) from tree start
+ *  }
+ *
+ *  Index allows point queries to start at index depth instead of the root.
  */
 
 namespace imgproc { namespace quadtree {
@@ -90,6 +105,8 @@ class RasterMask;
 
 namespace imgproc { namespace mappedqtree {
 
+struct Subtree;
+
 class RasterMask {
 public:
     RasterMask();
@@ -158,15 +175,44 @@ public:
         return math::Size2i(1 << depth_, 1 << depth_);
     }
 
+    /** Obtain mask value at given pos, return false if x, y out of bounds.
+     */
+    bool get(int x, int y) const;
+
+    /** Obtain value of quad at given depth: true (white), false (black) or
+     *  indeterminate (gray). Quads out of bounds are black. Depth bigger
+     *  than tree depth addresses pixel containing given subpixel quad.
+     *
+     *  \param depth depth in tree, root starts at 0
+     *  \param x horizontal index in quads at given depth
+     *  \param y vertical index in quads at given depth
+     */
+    boost::tribool getQuad(unsigned int depth, unsigned int x
+                           , unsigned int y) const;
+
+    /** Returns depth of index or 0 when the mask has no index.
+     */
+    unsigned int indexDepth() const { return indexDepth_; }
+
     /** Writes quadtree::RasterMask in the mappedqtree::RasterMask's on-disk
      *  format.
      *
      *  Start node (detauls to mask root) can be set by (depth, x,
      *  y). Coordinates are in grid defined by nodes at given depth.
+     *
+     *  Non-zero indexDepth makes the writer append an index of nodes at given
+     *  depth (clipped to tree depth - 1). Index takes 4^indexDepth * 4
+     *  bytes and speeds up point queries (get/getQuad).
      */
     static void write(std::ostream &out, const quadtree::RasterMask &mask
                       , unsigned int depth = 0, unsigned int x = 0
-                      , unsigned int y = 0);
+                      , unsigned int y = 0, unsigned int indexDepth = 0);
+
+    /** Serializes quadtree::RasterMask into position independent subtree
+     *  that can be placed into output by streaming Writer. Can be run in
+     *  parallel. See mappedqtree-writer.hpp.
+     */
+    static Subtree serialize(const quadtree::RasterMask &mask);
 
 private:
     template <typename T>
@@ -191,6 +237,10 @@ private:
 
     unsigned int depth_;
     std::size_t start_;
+
+    // optional index (managed inside a Memory object)
+    const std::uint32_t *index_;
+    unsigned int indexDepth_;
 };
 
 struct AsNode { std::uint8_t value; };
@@ -34,6 +34,9 @@
 #include <stdexcept>
 #include <numeric>
 #include <cstdint>
+#include <new>
+
+#include <boost/logic/tribool.hpp>
 
 #include "dbglog/dbglog.hpp"
 #include "utility/binaryio.hpp"
@@ -158,6 +161,10 @@ void RasterMask::reset(bool value)
 {
     // set root to given value
     root_ = Node(*this, value ? NodeType::WHITE : NodeType::BLACK);
+    count_ = value ? capacity() : 0;
+
+    // whole tree is gone, release node storage
+    pool_.clear();
 }
 
 bool RasterMask::onBoundary( int x, int y ) const {
@@ -218,6 +225,8 @@ void RasterMask::load( std::istream & f )
     std::uint32_t count(0);
     f.read( reinterpret_cast<char *>( & count ), sizeof( count ) );
 
+    // drop current tree before loading new one
+    reset(false);
     root_.load( f );
     recount();
 }
@@ -236,19 +245,75 @@ RasterMask & RasterMask::operator = ( const RasterMask & op )
 }
 
 
+namespace {
+
+/** First and maximal chunk size (in blocks) of node pool.
+ */
+const std::size_t NodePoolMinChunk(64);
+const std::size_t NodePoolMaxChunk(1 << 16);
+
+} // namespace
+
+void* RasterMask::NodePool::allocate()
+{
+    ++live_;
+
+    if (freeList_) {
+        // reuse released block
+        auto *block(freeList_);
+        freeList_ = block->next;
+        return block;
+    }
+
+    if (used_ == chunkSize_) {
+        // last chunk exhausted, allocate new (bigger) one
+        chunkSize_ = (chunkSize_
+                      ? std::min(chunkSize_ * 2, NodePoolMaxChunk)
+                      : NodePoolMinChunk);
+        chunks_.emplace_back(new Block[chunkSize_]);
+        used_ = 0;
+    }
+
+    return &chunks_.back()[used_++];
+}
+
+void RasterMask::NodePool::release(void *block)
+{
+    auto *b(static_cast<Block*>(block));
+    b->next = freeList_;
+    freeList_ = b;
+    --live_;
+}
+
+void RasterMask::NodePool::clear()
+{
+    if (live_) {
+        LOGTHROW(err2, std::logic_error)
+            << "Attempt to clear node pool with " << live_
+            << " live block(s).";
+    }
+
+    chunks_.clear();
+    freeList_ = nullptr;
+    used_ = chunkSize_ = 0;
+}
+
 RasterMask::NodeChildren* RasterMask::malloc()
 {
-    return new NodeChildren(*this);
+    return new (pool_.allocate()) NodeChildren(*this);
 }
 
 RasterMask::NodeChildren* RasterMask::malloc(NodeType type)
 {
-    return new NodeChildren(*this, type);
+    return new (pool_.allocate()) NodeChildren(*this, type);
 }
 
 void RasterMask::free(NodeChildren *&children)
 {
-    delete children;
+    if (!children) { return; }
+
+    children->~NodeChildren();
+    pool_.release(children);
     children = 0x0;
 }
 
@@ -463,17 +528,137 @@ void RasterMask::Node::load( std::istream & f )
     }
 }
 
+namespace {
+
+typedef imgproc::bitfield::RasterMask Bitfield;
+typedef Bitfield::Word Word;
+
+/** Sets bits [x, ex) in bitfield row.
+ */
+void fillSpan(Word *row, unsigned int x, unsigned int ex)
+{
+    const unsigned int bits(Bitfield::WordBits);
+
+    auto *word(row + x / bits);
+    auto *last(row + ex / bits);
+    const Word head(~Word(0) << (x % bits));
+    const Word tail((Word(1) << (ex % bits)) - 1);
+
+    if (word == last) {
+        *word |= head & tail;
+        return;
+    }
+
+    *word++ |= head;
+    for (; word != last; ++word) { *word = ~Word(0); }
+    if (tail) { *last |= tail; }
+}
+
+/** Checks whether quad at (x, y) of given size is uniform in bitfield mask.
+ *  Quad size must be a power of two not greater than one word and quad must
+ *  be aligned to its size, i.e. it lies inside single column of words.
+ *  Pixels outside the mask are ignored.
+ *
+ *  Returns pixel value of uniform quad or indeterminate.
+ */
+boost::tribool uniform(const Bitfield &m, unsigned int x, unsigned int y
+                       , unsigned int size)
+{
+    const unsigned int bits(Bitfield::WordBits);
+    const auto &dims(m.dims());
+
+    const unsigned int n(std::min(size, dims.width - x));
+    const Word mask(((n >= bits) ? ~Word(0) : ((Word(1) << n) - 1))
+                    << (x % bits));
+    const auto index(x / bits);
+
+    bool white(false), black(false);
+    for (unsigned int j(y), ej(std::min(y + size, unsigned(dims.height)))
+             ; j < ej; ++j)
+    {
+        const auto word(m.row(j)[index] & mask);
+        white |= (word != 0);
+        black |= (word != mask);
+        if (white && black) { return boost::indeterminate; }
+    }
+
+    return white;
+}
+
+} // namespace
+
 imgproc::bitfield::RasterMask RasterMask::asBitfield() const
 {
     LOG(info1) << "Converting raster mask from quad-tree based representation";
     imgproc::bitfield::RasterMask m
         (sizeX_, sizeY_, imgproc::bitfield::RasterMask::EMPTY);
     root_.dump(m, 0, 0, quadSize_);
+    m.recount();
     LOG(info1) << "RasterMask: " << m.size() << " vs " << count_;
 
     return m;
 }
 
+RasterMask::RasterMask(const imgproc::bitfield::RasterMask &mask)
+    : sizeX_(mask.dims().width), sizeY_(mask.dims().height)
+    , depth_(computeDepth(sizeX_, sizeY_))
+    , quadSize_(1 << depth_)
+    , count_(0)
+    , root_(*this)
+{
+    if (!sizeX_ || !sizeY_) { return; }
+
+    root_.build(mask, 0, 0, quadSize_);
+    recount();
+}
+
+void RasterMask::Node::build(const imgproc::bitfield::RasterMask &m
+                             , unsigned int x, unsigned int y
+                             , unsigned int size)
+{
+    if (size <= unsigned(Bitfield::WordBits)) {
+        // quad lies in single word column, check by word comparison
+        const auto value(uniform(m, x, y, size));
+        if (!boost::indeterminate(value)) {
+            type = value ? WHITE : BLACK;
+            return;
+        }
+    }
+
+    // split and build children; quads outside mask are left black
+    const unsigned int split(size / 2);
+    type = GRAY;
+    children = mask.malloc();
+
+    const struct { Node *node; unsigned int x, y; } quads[4] = {
+        { &children->ul, x, y }
+        , { &children->ur, x + split, y }
+        , { &children->ll, x, y + split }
+        , { &children->lr, x + split, y + split }
+    };
+
+    // contract when all inner children are equal leaves
+    bool contract(true);
+    NodeType common(GRAY);
+    bool any(false);
+    for (const auto &quad : quads) {
+        if ((quad.x >= mask.sizeX_) || (quad.y >= mask.sizeY_)) { continue; }
+
+        quad.node->build(m, quad.x, quad.y, split);
+        const auto childType(quad.node->type);
+        if ((childType == GRAY) || (any && (common != childType))) {
+            contract = false;
+        }
+        common = childType;
+        any = true;
+    }
+
+    if (contract && any) {
+        mask.free(children);
+        type = common;
+    }
+}
+
 void RasterMask::Node::dump(imgproc::bitfield::RasterMask &m
                               , unsigned int x, unsigned int y, unsigned int size)
     const
@@ -482,16 +667,17 @@ void RasterMask::Node::dump(imgproc::bitfield::RasterMask &m
 
     switch ( type ) {
     case WHITE: {
-        // fill in quad
+        // fill in quad, row spans are filled by whole words; pixel count is
+        // fixed in asBitfield()
+        if ((x >= mask.sizeX_) || (y >= mask.sizeY_)) { return; }
+
         unsigned int ex(x + size);
         unsigned int ey(y + size);
         if (ex > mask.sizeX_) { ex = mask.sizeX_; };
         if (ey > mask.sizeY_) { ey = mask.sizeY_; };
 
         for (unsigned int j(y); j < ey; ++j) {
-            for (unsigned int i(x); i < ex; ++i) {
-                m.set(i, j);
-            }
+            fillSpan(m.row(j), x, ex);
         }
         return;
     }
@@ -672,6 +858,115 @@ void RasterMask::Node::coarsen(unsigned int size, const unsigned int threshold)
     children->lr.coarsen(size, threshold);
 }
 
+void RasterMask::dilate(unsigned int distance)
+{
+    morphology(distance, WHITE);
+}
+
+void RasterMask::erode(unsigned int distance)
+{
+    morphology(distance, BLACK);
+}
+
+void RasterMask::morphology(unsigned int distance, NodeType value)
+{
+    if (!distance || zeroSize()) { return; }
+
+    // quads are painted into this tree while walking a snapshot of the
+    // original; a quad's frame lies in its neighbours only and painting
+    // stops at nodes having the painted value already, so nodes are only
+    // created along the boundary
+    const RasterMask src(*this);
+    const int d(std::min(distance, quadSize_));
+    const bool white(value == WHITE);
+
+    src.forEachQuad([&](unsigned int x, unsigned int y
+                        , unsigned int xsize, unsigned int ysize, bool)
+    {
+        // quads completely outside the mask
+        if ((x >= sizeX_) || (y >= sizeY_)) { return; }
+
+        // paint whole grown quad in one descent: the quad itself has the
+        // painted value already and is skipped
+        setRect(int(x) - d, int(y) - d, xsize + 2 * d, ysize + 2 * d, white);
+    }, white ? Filter::white : Filter::black);
+}
+
+void RasterMask::setRect(int x, int y, int width, int height, bool value)
+{
+    const int ex(std::min(x + width, int(sizeX_)));
+    const int ey(std::min(y + height, int(sizeY_)));
+    x = std::max(x, 0);
+    y = std::max(y, 0);
+    if ((x >= ex) || (y >= ey)) { return; }
+
+    root_.fill(0, 0, quadSize_, math::Extents2i(x, y, ex, ey)
+               , value ? WHITE : BLACK);
+}
+
+void RasterMask::Node::fill(unsigned int x, unsigned int y, unsigned int size
+                            , const math::Extents2i &rect, NodeType value)
+{
+    const int llx(x), lly(y), urx(x + size), ury(y + size);
+
+    if ((urx <= rect.ll(0)) || (llx >= rect.ur(0))
+        || (ury <= rect.ll(1)) || (lly >= rect.ur(1)))
+    {
+        // disjoint
+        return;
+    }
+
+    // nothing to change
+    if (type == value) { return; }
+
+    if ((llx >= rect.ll(0)) && (urx <= rect.ur(0))
+        && (lly >= rect.ll(1)) && (ury <= rect.ur(1)))
+    {
+        // fully covered, drop subtree; node lies inside the mask
+        const auto white(area(size));
+        mask.count_ += ((value == WHITE)
+                        ? ((unsigned long long)(size) * size - white)
+                        : -white);
+        mask.free(children);
+        type = value;
+        return;
+    }
+
+    const unsigned int split(size / 2);
+    if (type != GRAY) {
+        // split; quads outside mask are made black (as in build)
+        children = mask.malloc(type);
+        type = GRAY;
+
+        if ((x + split) >= mask.sizeX_) {
+            children->ur.type = children->lr.type = BLACK;
+        }
+        if ((y + split) >= mask.sizeY_) {
+            children->ll.type = children->lr.type = BLACK;
+        }
+    }
+
+    children->ul.fill(x, y, split, rect, value);
+    children->ur.fill(x + split, y, split, rect, value);
+    children->ll.fill(x, y + split, split, rect, value);
+    children->lr.fill(x + split, y + split, split, rect, value);
+
+    contract();
+}
+
+unsigned long long RasterMask::Node::area(unsigned int size) const
+{
+    switch (type) {
+    case WHITE: return (unsigned long long)(size) * size;
+    case BLACK: return 0;
+    case GRAY: break;
+    }
+
+    size >>= 1;
+    return (children->ul.area(size) + children->ur.area(size)
+            + children->ll.area(size) + children->lr.area(size));
+}
+
 RasterMask::RasterMask(const RasterMask &other, const math::Size2 &size
                        , unsigned int depth, unsigned int x, unsigned int y)
     : sizeX_(size.width), sizeY_(size.height)
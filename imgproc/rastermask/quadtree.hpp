@@ -34,9 +34,11 @@
 #define imgproc_rastermask_quadtree_hpp_included_
 
 #include <memory>
+#include <vector>
 #include <cstdint>
 #include <cstring>
 #include <algorithm>
+#include <type_traits>
 #include <iosfwd>
 
 #include <boost/scoped_array.hpp>
@@ -51,6 +53,10 @@ namespace imgproc { namespace mappedqtree {
 class RasterMask;
 } } // imgproc::mappedqtree
 
+namespace imgproc { namespace linearqtree {
+class RasterMask;
+} } // imgproc::linearqtree
+
 namespace imgproc { namespace quadtree {
 
 class RasterMask {
@@ -77,6 +83,11 @@ public :
     RasterMask(const RasterMask &other, const math::Size2 &size
                , unsigned int depth, unsigned int x, unsigned int y);
 
+    /** Initialize mask from bitfield mask. Uniform blocks are detected by
+     *  word comparisons and stored as whole quads.
+     */
+    explicit RasterMask(const imgproc::bitfield::RasterMask &mask);
+
     /** return size of mask */
     math::Size2 size() const { return math::Size2(sizeX_, sizeY_); }
 
@@ -110,6 +121,17 @@ public :
      */
     void setQuad(int depth, int x, int y, bool value = true);
 
+    /** Set mask value in whole rectangle. Rectangle is clipped to the mask.
+     *  Nodes are split only along rectangle's boundary.
+     *
+     *  \param x left column of rectangle
+     *  \param y top row of rectangle
+     *  \param width rectangle width
+     *  \param height rectangle height
+     *  \param value value to set to
+     */
+    void setRect(int x, int y, int width, int height, bool value = true);
+
     /** Set subtree from other mask. Subtree is clipped at maximum mask depth.
      *
      *  \param depth depth in tree, root starts at 0
@@ -190,6 +212,23 @@ public :
      */
     void coarsen(const unsigned int threshold = 2);
 
+    /** Dilates mask by given distance, i.e. with a square kernel of size
+     *  (2 * distance + 1). Pixels outside the mask are treated as black.
+     *
+     *  Works on the tree directly: every white quad paints a frame of given
+     *  width around itself, painting stops at nodes that are white already.
+     *  Memory is therefore proportional to boundary length, not to area.
+     */
+    void dilate(unsigned int distance = 1);
+
+    /** Erodes mask by given distance, i.e. with a square kernel of size
+     *  (2 * distance + 1). Pixels outside the mask are treated as white.
+     *
+     *  White quads shrink only where they touch gray/black neighbours, see
+     *  dilate() for details.
+     */
+    void erode(unsigned int distance = 1);
+
     /** Returns new raster mask that created from subtreee at given quad.
      *
      * Quad is addressed by depth from root and index in grid at given depth.
@@ -208,6 +247,11 @@ private :
 
     enum NodeType { WHITE, BLACK, GRAY };
 
+    /** Paints a frame of given width around each quad of given type with
+     *  that type. Common implementation of dilate() and erode().
+     */
+    void morphology(unsigned int distance, NodeType type);
+
     struct NodeChildren;
 
     struct Node
@@ -236,6 +280,10 @@ private :
         void dump( imgproc::bitfield::RasterMask &m, unsigned int x, unsigned int y
                    , unsigned int size ) const;
 
+        /** Builds subtree from bitfield mask. Called from RasterMask ctor. */
+        void build(const imgproc::bitfield::RasterMask &m, unsigned int x
+                   , unsigned int y, unsigned int size);
+
         /** Called from RasterMask::forEachQuad */
         template <typename Op>
         void descend(unsigned int x, unsigned int y, unsigned int size, const Op &op
@@ -257,6 +305,17 @@ private :
 
         void coarsen(unsigned int size, const unsigned int threshold);
 
+        /** Sets all pixels inside rectangle [ll, ur) to given type (WHITE or
+         *  BLACK). Rectangle must lie inside the mask. Nodes already having
+         *  given type are not entered.
+         */
+        void fill(unsigned int x, unsigned int y, unsigned int size
+                  , const math::Extents2i &rect, NodeType value);
+
+        /** Number of white pixels in subtree.
+         */
+        unsigned long long area(unsigned int size) const;
+
         /** Contracts node if all children are either white or black.
          */
         void contract();
@@ -283,6 +342,54 @@ private :
         Node ul, ur, ll, lr;
     };
 
+    /** Slab allocator for node children. Each mask owns its own pool.
+     *
+     *  Blocks are carved from geometrically growing chunks; released blocks
+     *  go to a free list and are reused by subsequent allocations. Memory is
+     *  returned to the system only when the pool is cleared or destroyed.
+     */
+    class NodePool {
+    public:
+        NodePool() : freeList_(), used_(), chunkSize_(), live_() {}
+
+        NodePool(const NodePool&) = delete;
+        NodePool& operator=(const NodePool&) = delete;
+
+        /** Returns uninitialized storage for one NodeChildren instance.
+         */
+        void* allocate();
+
+        /** Returns storage obtained from allocate() back to the pool.
+         */
+        void release(void *block);
+
+        /** Releases all chunks. No block can be live.
+         */
+        void clear();
+
+        /** Number of blocks currently in use.
+         */
+        std::size_t live() const { return live_; }
+
+    private:
+        union Block {
+            Block *next;
+            std::aligned_storage<sizeof(NodeChildren)
+                                 , alignof(NodeChildren)>::type storage;
+        };
+
+        std::vector<std::unique_ptr<Block[]>> chunks_;
+        Block *freeList_;
+
+        /** Number of blocks handed out from the last chunk. */
+        std::size_t used_;
+
+        /** Size of the last chunk (in blocks). */
+        std::size_t chunkSize_;
+
+        std::size_t live_;
+    };
+
     NodeChildren* malloc();
     NodeChildren* malloc(NodeType type);
     void free(NodeChildren *&children);
@@ -292,11 +399,19 @@ private :
     unsigned int depth_;
     unsigned int quadSize_;
     unsigned long long count_;
+
+    /** Node storage, must outlive root_.
+     */
+    NodePool pool_;
     Node root_;
 
     /** Needed for mappedqtree::RasterMask creation.
      */
     friend class mappedqtree::RasterMask;
+
+    /** Needed for conversion from/to linearqtree::RasterMask.
+     */
+    friend class linearqtree::RasterMask;
 };
 
 void resizeMask(const RasterMask &src, RasterMask &dst);
@@ -23,71 +23,228 @@
  * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
  * POSSIBILITY OF SUCH DAMAGE.
  */
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <vector>
+#include <algorithm>
+
+#include "utility/openmp.hpp"
+
 #include "dbglog/dbglog.hpp"
 
 #include "transform.hpp"
-#include "cvmat.hpp"
 
 namespace imgproc { namespace quadtree {
 
 namespace {
 
-inline math::Point2 trans(const Matrix2x3 &tr, int x, int y)
+/** Output is split into tiles (quads at this depth) that are built in
+ *  parallel and then attached to the output tree.
+ */
+const unsigned int TileDepth(2);
+
+/** Open interval (min, max).
+ */
+struct Interval {
+    double min;
+    double max;
+
+    Interval(double min = -std::numeric_limits<double>::infinity()
+             , double max = std::numeric_limits<double>::infinity())
+        : min(min), max(max)
+    {}
+
+    Interval intersect(const Interval &o) const {
+        return Interval(std::max(min, o.min), std::min(max, o.max));
+    }
+};
+
+/** Solves q * i + r in range for i.
+ */
+Interval solve(double q, double r, const Interval &range)
+{
+    if (!q) {
+        // all or nothing
+        if ((range.min < r) && (r < range.max)) { return {}; }
+        return Interval(0, 0);
+    }
+
+    const Interval i((range.min - r) / q, (range.max - r) / q);
+    return (q > 0) ? i : Interval(i.max, i.min);
+}
+
+/** Minimum/maximum of coef * v for v in interval.
+ */
+double lower(double coef, const Interval &i)
 {
-    return {
-        tr(0, 0) * x + tr(0, 1) * y + tr(0, 2)
-        , tr(1, 0) * x + tr(1, 1) * y + tr(1, 2)
-     };
+    if (!coef) { return 0; }
+    return coef * ((coef > 0) ? i.min : i.max);
 }
 
+double upper(double coef, const Interval &i)
+{
+    if (!coef) { return 0; }
+    return coef * ((coef > 0) ? i.max : i.min);
+}
+
+/** Integer range [first, last] inside open interval, clipped to [lo, hi].
+ */
+struct Range {
+    int first;
+    int last;
+
+    Range(const Interval &i, int lo, int hi)
+        : first(std::max(double(lo), std::floor(i.min) + 1))
+        , last(std::min(double(hi), std::ceil(i.max) - 1))
+    {}
+
+    bool empty() const { return first > last; }
+};
+
+/** Area of influence of one black source quad: output pixel (i, j) is black
+ *  iff trafo(i, j) lies inside open box x * y.
+ */
+struct Influence {
+    Interval x;
+    Interval y;
+
+    /** Output rows (inclusive) the box can map to.
+     */
+    int rowMin;
+    int rowMax;
+};
+
+typedef std::vector<Influence> Influences;
+
 } // namespace
 
 RasterMask transform(const RasterMask &mask, const math::Size2 &size
                      , const Matrix2x3 &trafo)
 {
+    // Output pixel (i, j) is white iff all source pixels in window
+    // [floor(p - k), ceil(p + k)] (clamped to source) around
+    // p = trafo * (i, j) are white. I.e. it is black iff its window touches
+    // some black source quad. Therefore, output starts white and only black
+    // quads are processed: each one blackens an output area in one go.
+    // Nothing is ever rasterized.
+    RasterMask out(size, RasterMask::EMPTY);
+    if (out.zeroSize() || mask.zeroSize()) { return out; }
+
     // kernel sizes (from scaling factor)
-    double kw(trafo(0, 0) / 2.0);
-    double kh(trafo(1, 1) / 2.0);
+    const double kw(std::abs(trafo(0, 0)) / 2.0);
+    const double kh(std::abs(trafo(1, 1)) / 2.0);
 
-    auto m(asCvMat(mask));
+    const double a(trafo(0, 0)), b(trafo(0, 1)), c(trafo(0, 2));
+    const double d(trafo(1, 0)), e(trafo(1, 1)), f(trafo(1, 2));
+    const double det(a * e - b * d);
 
-    auto clamp([](int i, int max) -> int
-    {
-        if (i < 0) { return 0; }
-        if (i > max) { return max; }
-        return i;
-    });
-
-    // both ends of kernel are inclusive -> clip to -1 and use <=
-    const int xMax(m.cols - 1);
-    const int yMax(m.rows - 1);
-    auto scan([&](const math::Point2 &p) -> bool
+    // span of output row does not depend on row
+    const bool axisAligned(!b && !d);
+
+    const auto msize(mask.size());
+
+    // collect influence areas of black quads
+    Influences influences;
+    mask.forEachQuad([&](unsigned int x, unsigned int y
+                         , unsigned int xsize, unsigned int ysize, bool)
     {
-        for (int y(clamp(std::floor(p(1) - kh), yMax))
-                 , ey(clamp(std::ceil(p(1) + kh), yMax));
-             y <= ey; ++y)
+        // quads completely outside the mask
+        if ((int(x) >= msize.width) || (int(y) >= msize.height)) { return; }
+
+        Influence inf;
+
+        // window [floor(p - k), ceil(p + k)] touches quad [q0, q1] iff
+        // q0 - 1 - k < p < q1 + 1 + k; windows are clamped to mask,
+        // therefore quads at mask edge extend to infinity
+        if (x) { inf.x.min = x - 1.0 - kw; }
+        if (int(x + xsize) < msize.width) { inf.x.max = x + xsize + kw; }
+        if (y) { inf.y.min = y - 1.0 - kh; }
+        if (int(y + ysize) < msize.height) { inf.y.max = y + ysize + kh; }
+
+        if (det) {
+            // j = (a * (py - f) - d * (px - c)) / det
+            const double ja(a / det), jd(-d / det);
+            const double j0((d * c - a * f) / det);
+            const Range rows(Interval
+                             (j0 + lower(ja, inf.y) + lower(jd, inf.x)
+                              , j0 + upper(ja, inf.y) + upper(jd, inf.x))
+                             , 0, size.height - 1);
+            if (rows.empty()) { return; }
+            inf.rowMin = rows.first;
+            inf.rowMax = rows.last;
+        } else {
+            inf.rowMin = 0;
+            inf.rowMax = size.height - 1;
+        }
+
+        influences.push_back(inf);
+    }, RasterMask::Filter::black);
+
+    LOG(info1) << "Transforming quadtree mask: " << influences.size()
+               << " black quads.";
+
+    // output tiles
+    const unsigned int tileDepth(std::min(TileDepth, out.depth()));
+    const int tileSize(1 << (out.depth() - tileDepth));
+    const int tilesX((size.width + tileSize - 1) / tileSize);
+    const int tilesY((size.height + tileSize - 1) / tileSize);
+    const int tileCount(tilesX * tilesY);
+
+    std::vector<std::unique_ptr<RasterMask>> tiles(tileCount);
+
+    UTILITY_OMP(parallel for schedule(dynamic))
+    for (int t = 0; t < tileCount; ++t) {
+        const int tx((t % tilesX) * tileSize), ty((t / tilesX) * tileSize);
+        const int tw(std::min(tileSize, size.width - tx));
+        const int th(std::min(tileSize, size.height - ty));
+
+        tiles[t].reset(new RasterMask(tileSize, tileSize, RasterMask::FULL));
+        auto &tile(*tiles[t]);
+
+        // pixels past output must be black, tile count is taken over
+        tile.setRect(tw, 0, tileSize - tw, tileSize, false);
+        tile.setRect(0, th, tileSize, tileSize - th, false);
+
+        const auto span([&](const Influence &inf, int j) -> Range
         {
-            for (int x(clamp(std::floor(p(0) - kw), xMax))
-                     , ex(clamp(std::ceil(p(0) + kw), xMax));
-                 x <= ex; ++x)
-            {
-                if (!m.at<std::uint8_t>(y, x)) {
-                    return false;
+            return Range(solve(a, b * j + c, inf.x)
+                         .intersect(solve(d, e * j + f, inf.y))
+                         , tx, tx + tw - 1);
+        });
+
+        for (const auto &inf : influences) {
+            const int r0(std::max(inf.rowMin, ty));
+            const int r1(std::min(inf.rowMax, ty + th - 1));
+            if (r0 > r1) { continue; }
+
+            if (axisAligned) {
+                // block
+                const auto s(span(inf, r0));
+                if (!s.empty()) {
+                    tile.setRect(s.first - tx, r0 - ty, s.last - s.first + 1
+                                 , r1 - r0 + 1, false);
                 }
+                continue;
             }
-        }
-        return true;
-    });
 
-    RasterMask out(size, RasterMask::EMPTY);
-    for (int j(0); j < size.height; ++j) {
-        for (int i(0); i < size.width; ++i) {
-            if (scan(trans(trafo, i, j))) {
-                out.set(i, j);
+            // row by row
+            for (int j(r0); j <= r1; ++j) {
+                const auto s(span(inf, j));
+                if (!s.empty()) {
+                    tile.setRect(s.first - tx, j - ty, s.last - s.first + 1
+                                 , 1, false);
+                }
             }
         }
     }
 
+    // attach tiles
+    for (int t(0); t < tileCount; ++t) {
+        out.setSubtree(tileDepth, t % tilesX, t / tilesX, *tiles[t]);
+        tiles[t].reset();
+    }
+
     // done
     return out;
 }
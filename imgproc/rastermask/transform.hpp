@@ -26,7 +26,7 @@
 #ifndef imgproc_rastermask_transform_hpp_included_
 #define imgproc_rastermask_transform_hpp_included_
 
-#include <opencv2/core/core.hpp>
+#include <boost/numeric/ublas/matrix.hpp>
 
 #include "quadtree.hpp"
 
@@ -37,7 +37,12 @@ typedef boost::numeric::ublas::matrix
  , boost::numeric::ublas::bounded_array<double, 6> > Matrix2x3;
 
 /** Transforms raster mask to new mask of size size by given transformation
- *  matrix.
+ *  matrix (maps destination pixels to source pixels).
+ *
+ *  Destination pixel is set iff all source pixels in window of size given by
+ *  the matrix' diagonal around its mapped position are set. Works directly
+ *  on the quadtree: only black source quads are processed, each blackening
+ *  a whole block of destination pixels.
  */
 RasterMask transform(const RasterMask &mask, const math::Size2 &size
                      , const Matrix2x3 &trafo);
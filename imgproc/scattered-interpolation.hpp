@@ -35,12 +35,15 @@
 #define imgproc_scattered_interpolation_hpp_included_
 
 #include <vector>
+#include <cstdint>
+#include <algorithm>
 #include <Eigen/Sparse>
 #include <opencv2/core/core.hpp>
 
 #include "dbglog/dbglog.hpp"
 #include "utility/gccversion.hpp"
 #include "rastermask.hpp"
+#include "detail/laplace.hpp"
 
 namespace imgproc {
 
@@ -49,6 +52,29 @@ namespace imgproc {
                            "compiled with both OpenCV and Eigen3 libraries.")
 #endif
 
+/** Linear solver used by laplaceInterpolate().
+ */
+enum class LaplaceSolver {
+    /** Assembles sparse matrix of all unknowns and solves it by Eigen's
+     *  BiCGSTAB with diagonal preconditioner.
+     */
+    eigen,
+
+    /** Matrix-free geometric multigrid (used as conjugate gradient
+     *  preconditioner) on the bounding box of the unknowns. Linear memory
+     *  and time, computes in double precision regardless of T_OPT.
+     */
+    multigrid
+};
+
+namespace detail {
+
+template<typename T_DATA, int nChan>
+void laplaceInterpolateMultigrid(cv::Mat &data, const imgproc::RasterMask &mask
+                                 , double tol);
+
+} // namespace detail
+
 /** Solves the boundary value problem -\Delta u = 0 on elements in the matrix
  *  'data' that correspond to unset elements in 'mask'. Elements corresponding
  *  to set positions in 'mask' are regarded as given data.
@@ -61,18 +87,26 @@ namespace imgproc {
  *  typename T_DATA: numeric type of (per-channel) elements of 'data' matrix,
  *                   if it's an integral type results are rounded before storing
  *  int nChan:       number of channels of 'data' matrix
+ *  solverType:      see LaplaceSolver; both solvers stop at relative residual
+ *                   'tol'
  *
  *  Example usage: for 'data' matrix of type CV_32FC2 use <float, 2, T_OPT>
  *                 for 'data' matrix of type  CV_8UC3 use <unsigned char, 3, T_OPT>
  */
 template<typename T_DATA, int nChan, typename T_OPT = float>
-void laplaceInterpolate(cv::Mat &data, const imgproc::RasterMask &mask, double tol = 1e-12)
+void laplaceInterpolate(cv::Mat &data, const imgproc::RasterMask &mask, double tol = 1e-12
+                        , LaplaceSolver solverType = LaplaceSolver::eigen)
 {
     static_assert(std::is_floating_point<T_OPT>::value,
                   "Floating-point numeric type expected.");
 
     assert(sizeof(T_DATA) == data.elemSize1() && data.channels() == nChan);
 
+    if (solverType == LaplaceSolver::multigrid) {
+        detail::laplaceInterpolateMultigrid<T_DATA, nChan>(data, mask, tol);
+        return;
+    }
+
     // round results if 'data' matrix elements are of integral type
     constexpr bool doRound = std::is_integral<T_DATA>::value;
 
@@ -213,6 +247,112 @@ void laplaceInterpolate(cv::Mat &data, const imgproc::RasterMask &mask, double t
     }
 }
 
+namespace detail {
+
+template<typename T_DATA, int nChan>
+void laplaceInterpolateMultigrid(cv::Mat &data, const imgproc::RasterMask &mask
+                                 , double tol)
+{
+    constexpr bool doRound = std::is_integral<T_DATA>::value;
+    using cvVec = cv::Vec<T_DATA, nChan>;
+
+    // bounding box of free points; only free points and their direct
+    // neighbours take part in the computation
+    int x0 = data.cols, y0 = data.rows, x1 = -1, y1 = -1;
+    for (int y = 0; y < data.rows; ++y)
+    for (int x = 0; x < data.cols; ++x)
+    {
+        if (!mask.get(x, y)) {
+            x0 = std::min(x0, x); x1 = std::max(x1, x);
+            y0 = std::min(y0, y); y1 = std::max(y1, y);
+        }
+    }
+
+    if (x1 < 0) {
+        LOG(debug) << "All points are given, nothing to do.";
+        return;
+    }
+
+    x0 = std::max(x0 - 1, 0); x1 = std::min(x1 + 1, data.cols - 1);
+    y0 = std::max(y0 - 1, 0); y1 = std::min(y1 + 1, data.rows - 1);
+    const int w = x1 - x0 + 1, h = y1 - y0 + 1;
+
+    LOG(debug) << "Building multigrid hierarchy on " << w << "x" << h
+               << " grid. # of channels: " << nChan;
+
+    // finest level: free point couples with free neighbours, in-image
+    // neighbours count into diagonal; box edges are image edges or given
+    // points so in-box neighbour count equals in-image neighbour count
+    std::vector<std::uint8_t> free(std::size_t(w) * h);
+    for (int y = 0, p = 0; y < h; ++y)
+    for (int x = 0; x < w; ++x, ++p)
+    {
+        free[p] = !mask.get(x0 + x, y0 + y);
+    }
+    auto isFree([&](int x, int y) -> bool { return free[y * w + x]; });
+
+    laplace::Level fine(w, h);
+    for (int y = 0; y < h; ++y)
+    for (int x = 0; x < w; ++x)
+    {
+        if (!isFree(x, y)) { continue; }
+        const auto p(fine.index(x, y));
+        fine.diag[p] = (x > 0) + (x + 1 < w) + (y > 0) + (y + 1 < h);
+        if ((x + 1 < w) && isFree(x + 1, y)) { fine.east[p] = 1.f; }
+        if ((y + 1 < h) && isFree(x, y + 1)) { fine.south[p] = 1.f; }
+    }
+
+    laplace::Solver solver(std::move(fine));
+    LOG(debug) << "Multigrid hierarchy has " << solver.depth() << " levels.";
+
+    const auto &grid(solver.fine());
+    std::vector<double> rhs(grid.size()), sln(grid.size());
+    const int maxIterations(std::max(2 * w * h, 100));
+
+    for (int i = 0; i < nChan; ++i)
+    {
+        // given neighbours of free points go to the right hand side
+        for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x)
+        {
+            if (!isFree(x, y)) { continue; }
+
+            double sum = 0.0;
+            const auto given([&](int xx, int yy)
+            {
+                if (!isFree(xx, yy)) {
+                    sum += data.at<cvVec>(y0 + yy, x0 + xx)(i);
+                }
+            });
+            if (x > 0) { given(x - 1, y); }
+            if (x + 1 < w) { given(x + 1, y); }
+            if (y > 0) { given(x, y - 1); }
+            if (y + 1 < h) { given(x, y + 1); }
+            rhs[grid.index(x, y)] = sum;
+        }
+
+        LOG(debug) << "Solving system with rhs = channel " << (i + 1)
+                   << " out of " << nChan;
+
+        std::fill(sln.begin(), sln.end(), 0.0);
+        const auto iterations(solver.solve(sln, rhs, tol, maxIterations));
+
+        LOG(debug) << "#iterations: " << iterations;
+        LOG(debug) << "estimated error: " << solver.error();
+
+        for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x)
+        {
+            if (!isFree(x, y)) { continue; }
+            const double value = sln[grid.index(x, y)];
+            data.at<cvVec>(y0 + y, x0 + x)(i)
+                = (doRound ? std::round(value) : value);
+        }
+    }
+}
+
+} // namespace detail
+
 } // imgproc
 
 #endif // imgproc_scattered_interpolation_hpp_included_
@@ -0,0 +1,192 @@
+/**
+ * Copyright (c) 2021 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file test-contours/bench.cpp
+ *
+ * Contour extraction benchmark: measures throughput of single-class
+ * (bitfield) and multi-class contour extraction on synthetic classification
+ * rasters, both sequential and tiled.
+ */
+
+#include <cstdlib>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int_distribution.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "imgproc/contours.hpp"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+/** Runs op() and reports its duration and throughput in pixels/second.
+ */
+template <typename Op>
+void measure(const std::string &name, unsigned long long pixels
+             , const Op &op)
+{
+    const auto start(Clock::now());
+    op();
+    const auto elapsed(std::chrono::duration<double>
+                       (Clock::now() - start).count());
+
+    std::cout << std::setw(18) << std::left << name
+              << std::setw(12) << std::right << std::fixed
+              << std::setprecision(3) << elapsed << " s"
+              << std::setw(14) << std::setprecision(1)
+              << (pixels / elapsed / 1e6) << " Mpx/s"
+              << std::endl;
+}
+
+/** Minimal single-channel class raster (see const-raster.hpp).
+ */
+class ClassRaster {
+public:
+    ClassRaster(const math::Size2 &size)
+        : size_(size), data_(math::area(size))
+    {}
+
+    math::Size2 size() const { return size_; }
+    int width() const { return size_.width; }
+    int height() const { return size_.height; }
+
+    const int* operator()(int x, int y) const {
+        return &data_[std::size_t(y) * size_.width + x];
+    }
+
+    int& at(int x, int y) {
+        return data_[std::size_t(y) * size_.width + x];
+    }
+
+private:
+    math::Size2 size_;
+    std::vector<int> data_;
+};
+
+/** Generates classification raster: cells of given size filled with random
+ *  class, one in four cells is noisy (random class per pixel).
+ */
+void generate(ClassRaster &raster, int classes, unsigned int seed
+              , int cell = 32)
+{
+    boost::random::mt19937 gen(seed);
+    boost::random::uniform_int_distribution<> kind(0, 3);
+    boost::random::uniform_int_distribution<> cls(0, classes - 1);
+
+    const auto size(raster.size());
+    for (int cj(0); cj < size.height; cj += cell) {
+        for (int ci(0); ci < size.width; ci += cell) {
+            const bool noisy(!kind(gen));
+            const auto c(cls(gen));
+            for (int j(cj), je(std::min(cj + cell, size.height));
+                 j < je; ++j)
+            {
+                for (int i(ci), ie(std::min(ci + cell, size.width));
+                     i < ie; ++i)
+                {
+                    raster.at(i, j) = noisy ? cls(gen) : c;
+                }
+            }
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    dbglog::set_mask("ALL");
+    if (argc > 4) {
+        std::cerr << "usage: " << argv[0] << " [size [classes [tileSize]]]"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const int size((argc > 1) ? boost::lexical_cast<int>(argv[1]) : 4096);
+    const int classes((argc > 2) ? boost::lexical_cast<int>(argv[2]) : 4);
+    const int tileSize((argc > 3)
+                       ? boost::lexical_cast<int>(argv[3]) : 512);
+    const unsigned long long pixels((unsigned long long)(size) * size);
+
+    std::cout << "Contours " << size << "x" << size << ", " << classes
+              << " classes, tile size " << tileSize << "." << std::endl;
+
+    ClassRaster raster(math::Size2(size, size));
+    generate(raster, classes, 42);
+
+    imgproc::ContourParameters params;
+
+    // single class
+    std::size_t rings(0);
+    const auto mask(imgproc::bitfield::fromRaster
+                    (raster, [](const int *v) { return !*v; }));
+    measure("single", pixels, [&]() {
+        rings = imgproc::findContour(mask, params).rings.size();
+    });
+    std::cout << "single-rings      " << rings << std::endl;
+
+    params.setTileSize(tileSize);
+    measure("single-tiled", pixels, [&]() {
+        imgproc::findContour(mask, params);
+    });
+
+    // all classes at once
+    params.setTileSize(0);
+    measure("multi", pixels, [&]() {
+        rings = 0;
+        for (const auto &contour
+                 : imgproc::findContours(raster, classes, params))
+        {
+            rings += contour.rings.size();
+        }
+    });
+    std::cout << "multi-rings       " << rings << std::endl;
+
+    params.setTileSize(tileSize);
+    measure("multi-tiled", pixels, [&]() {
+        imgproc::findContours(raster, classes, params);
+    });
+
+    // all classes, streamed row by row
+    measure("multi-stream", pixels, [&]() {
+        rings = 0;
+        imgproc::ContourStream cs
+            (size, classes, [&](int, imgproc::Contour::Ring&&) { ++rings; }
+             , params);
+        for (int j(0); j < size; ++j) { cs.feedRow(raster(0, j)); }
+        cs.finish();
+    });
+    std::cout << "multi-stream-rings " << rings << std::endl;
+
+    return EXIT_SUCCESS;
+}
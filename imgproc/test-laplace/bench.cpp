@@ -0,0 +1,183 @@
+/**
+ * Copyright (c) 2021 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file test-laplace/bench.cpp
+ *
+ * Laplace interpolation benchmark: compares the Eigen (assembled sparse
+ * matrix, BiCGSTAB) and the matrix-free multigrid solvers of
+ * laplaceInterpolate() on a smooth image with random rectangular holes and
+ * scattered missing pixels.
+ */
+
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int_distribution.hpp>
+
+#include <opencv2/core/core.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "imgproc/rastermask.hpp"
+#include "imgproc/scattered-interpolation.hpp"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+typedef cv::Vec<float, 3> Pixel;
+
+/** Smooth 3-channel image.
+ */
+cv::Mat generateImage(int size)
+{
+    cv::Mat image(size, size, CV_32FC3);
+    for (int j(0); j < size; ++j) {
+        for (int i(0); i < size; ++i) {
+            auto &px(image.at<Pixel>(j, i));
+            px[0] = 128.0 + 100.0 * std::sin(i * 0.01) * std::cos(j * 0.02);
+            px[1] = (255.0 * i) / size;
+            px[2] = (255.0 * j) / size;
+        }
+    }
+    return image;
+}
+
+/** Mask of given pixels: random rectangular holes plus scattered missing
+ *  pixels (about holes % of all pixels).
+ */
+imgproc::RasterMask generateMask(int size, int holes, unsigned int seed)
+{
+    imgproc::RasterMask mask(size, size, imgproc::RasterMask::FULL);
+
+    boost::random::mt19937 gen(seed);
+    boost::random::uniform_int_distribution<> coord(0, size - 1);
+    boost::random::uniform_int_distribution<> extent(1, std::max(1, size / 8));
+    boost::random::uniform_int_distribution<> percent(0, 99);
+
+    for (int k(0); k < 2 * holes; ++k) {
+        const int x(coord(gen)), y(coord(gen));
+        const int w(extent(gen)), h(extent(gen));
+        for (int j(y), je(std::min(y + h, size)); j < je; ++j) {
+            for (int i(x), ie(std::min(x + w, size)); i < ie; ++i) {
+                mask.set(i, j, false);
+            }
+        }
+    }
+
+    for (int j(0); j < size; ++j) {
+        for (int i(0); i < size; ++i) {
+            if (percent(gen) < holes) { mask.set(i, j, false); }
+        }
+    }
+
+    return mask;
+}
+
+/** Runs one solver on a copy of image, reports duration and returns
+ *  result.
+ */
+template <typename Op>
+cv::Mat measure(const std::string &name, const cv::Mat &image, const Op &op)
+{
+    cv::Mat result(image.clone());
+
+    const auto start(Clock::now());
+    op(result);
+    const auto elapsed(std::chrono::duration<double>
+                       (Clock::now() - start).count());
+
+    std::cout << std::setw(16) << std::left << name
+              << std::setw(12) << std::right << std::fixed
+              << std::setprecision(3) << elapsed << " s" << std::endl;
+    return result;
+}
+
+/** Maximum absolute difference between two images.
+ */
+double maxDiff(const cv::Mat &a, const cv::Mat &b)
+{
+    double diff(0.0);
+    for (int j(0); j < a.rows; ++j) {
+        for (int i(0); i < a.cols; ++i) {
+            const auto &pa(a.at<Pixel>(j, i));
+            const auto &pb(b.at<Pixel>(j, i));
+            for (int c(0); c < 3; ++c) {
+                diff = std::max(diff, double(std::abs(pa[c] - pb[c])));
+            }
+        }
+    }
+    return diff;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    if (argc > 4) {
+        std::cerr << "usage: " << argv[0] << " [size [holes% [tolerance]]]"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const int size((argc > 1) ? boost::lexical_cast<int>(argv[1]) : 512);
+    const int holes((argc > 2) ? boost::lexical_cast<int>(argv[2]) : 20);
+    const double tol((argc > 3) ? boost::lexical_cast<double>(argv[3])
+                     : 1e-8);
+
+    const auto image(generateImage(size));
+    const auto mask(generateMask(size, holes, 42));
+
+    std::cout << "Laplace interpolation " << size << "x" << size << ", "
+              << (size * size - mask.size()) << " unknowns, tolerance "
+              << tol << "." << std::endl;
+
+    const auto eigen(measure("eigen-double", image, [&](cv::Mat &data) {
+        imgproc::laplaceInterpolate<float, 3, double>
+            (data, mask, tol, imgproc::LaplaceSolver::eigen);
+    }));
+
+    measure("eigen-float", image, [&](cv::Mat &data) {
+        imgproc::laplaceInterpolate<float, 3, float>
+            (data, mask, tol, imgproc::LaplaceSolver::eigen);
+    });
+
+    const auto multigrid(measure("multigrid", image, [&](cv::Mat &data) {
+        imgproc::laplaceInterpolate<float, 3>
+            (data, mask, tol, imgproc::LaplaceSolver::multigrid);
+    }));
+
+    std::cout << "max difference  " << std::setw(12) << std::right
+              << std::scientific << std::setprecision(3)
+              << maxDiff(eigen, multigrid) << std::endl;
+
+    return EXIT_SUCCESS;
+}
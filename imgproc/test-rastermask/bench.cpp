@@ -0,0 +1,250 @@
+/**
+ * Copyright (c) 2021 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file test-rastermask/bench.cpp
+ *
+ * Quad-tree raster mask benchmark: measures throughput of mask building and
+ * of the structural operations (copy, merge, intersect, coarsen,
+ * dilate, erode).
+ */
+
+#include <cstdlib>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <memory>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int_distribution.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "imgproc/rastermask/bitfield.hpp"
+#include "imgproc/rastermask/quadtree.hpp"
+#include "imgproc/rastermask/linearqtree.hpp"
+
+namespace {
+
+using imgproc::quadtree::RasterMask;
+
+typedef std::chrono::steady_clock Clock;
+
+/** Runs op() and reports its duration and throughput in pixels/second.
+ */
+template <typename Op>
+void measure(const std::string &name, unsigned long long pixels
+             , const Op &op)
+{
+    const auto start(Clock::now());
+    op();
+    const auto elapsed(std::chrono::duration<double>
+                       (Clock::now() - start).count());
+
+    std::cout << std::setw(14) << std::left << name
+              << std::setw(12) << std::right << std::fixed
+              << std::setprecision(3) << elapsed << " s"
+              << std::setw(14) << std::setprecision(1)
+              << (pixels / elapsed / 1e6) << " Mpx/s"
+              << std::endl;
+}
+
+/** Generates mask with random blobs: each pixel in a cell of given size
+ *  is set with probability given by the cell's random density. Produces
+ *  large uniform areas interleaved with noisy ones (i.e. lots of gray
+ *  nodes).
+ */
+void generate(RasterMask &mask, unsigned int seed, int cell = 64)
+{
+    boost::random::mt19937 gen(seed);
+    boost::random::uniform_int_distribution<> density(0, 4);
+    boost::random::uniform_int_distribution<> pixel(0, 3);
+
+    const auto size(mask.dims());
+    for (int cj(0); cj < size.height; cj += cell) {
+        for (int ci(0); ci < size.width; ci += cell) {
+            const auto d(density(gen));
+            for (int j(cj), je(std::min(cj + cell, size.height));
+                 j < je; ++j)
+            {
+                for (int i(ci), ie(std::min(ci + cell, size.width));
+                     i < ie; ++i)
+                {
+                    mask.set(i, j, pixel(gen) < d);
+                }
+            }
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    dbglog::set_mask("ALL");
+    if (argc > 3) {
+        std::cerr << "usage: " << argv[0] << " [size [iterations]]"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const int size((argc > 1) ? boost::lexical_cast<int>(argv[1]) : 4096);
+    const int iterations((argc > 2)
+                         ? boost::lexical_cast<int>(argv[2]) : 5);
+    const unsigned long long pixels((unsigned long long)(size) * size);
+
+    std::cout << "Quadtree raster mask " << size << "x" << size
+              << ", " << iterations << " iteration(s)." << std::endl;
+
+    for (int it(0); it < iterations; ++it) {
+        RasterMask a(size, size, RasterMask::EMPTY);
+        RasterMask b(size, size, RasterMask::EMPTY);
+
+        measure("build", 2 * pixels, [&]() {
+            generate(a, 2 * it);
+            generate(b, 2 * it + 1);
+        });
+
+        measure("copy", pixels, [&]() { RasterMask c(a); });
+
+        {
+            RasterMask c(a);
+            measure("merge", pixels, [&]() { c.merge(b); });
+        }
+
+        {
+            RasterMask c(a);
+            measure("intersect", pixels, [&]() { c.intersect(b); });
+        }
+
+        {
+            RasterMask c(a);
+            measure("subtract", pixels, [&]() { c.subtract(b); });
+        }
+
+        {
+            RasterMask c(a);
+            measure("coarsen", pixels, [&]() { c.coarsen(4); });
+        }
+
+        {
+            RasterMask c(a);
+            measure("dilate", pixels, [&]() { c.dilate(2); });
+        }
+
+        {
+            RasterMask c(a);
+            measure("erode", pixels, [&]() { c.erode(2); });
+        }
+
+        {
+            std::unique_ptr<RasterMask> c(new RasterMask(a));
+            measure("destroy", pixels, [&]() { c.reset(); });
+        }
+
+        // linear quadtree
+        {
+            namespace lqt = imgproc::linearqtree;
+            std::unique_ptr<lqt::RasterMask> la, lb;
+            measure("lqt-convert", 2 * pixels, [&]() {
+                la.reset(new lqt::RasterMask(a));
+                lb.reset(new lqt::RasterMask(b));
+            });
+
+            std::cout << "lqt-size      " << la->nodeCount() << " gray nodes, "
+                      << la->byteCount() << " bytes" << std::endl;
+
+            {
+                lqt::RasterMask c(*la);
+                measure("lqt-merge", pixels, [&]() { c.merge(*lb); });
+            }
+
+            {
+                lqt::RasterMask c(*la);
+                measure("lqt-intersect", pixels, [&]() { c.intersect(*lb); });
+            }
+
+            unsigned long long walked(0);
+            measure("lqt-walk", pixels, [&]() {
+                la->forEachQuad([&](unsigned int, unsigned int
+                                    , unsigned int xsize, unsigned int ysize
+                                    , bool white)
+                {
+                    if (white) {
+                        walked += (unsigned long long)(xsize) * ysize;
+                    }
+                });
+            });
+
+            std::cout << "lqt-walked    " << walked << " set pixels"
+                      << std::endl;
+            if (walked != la->count()) {
+                std::cerr << "Walked set pixel count " << walked
+                          << " differs from mask count " << la->count()
+                          << "." << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+
+        // bitfield
+        {
+            namespace bf = imgproc::bitfield;
+            bf::RasterMask ba, bb;
+            measure("bf-convert", 2 * pixels, [&]() {
+                ba = a.asBitfield();
+                bb = b.asBitfield();
+            });
+
+            {
+                bf::RasterMask c(ba);
+                measure("bf-merge", pixels, [&]() { c.merge(bb); });
+            }
+
+            {
+                bf::RasterMask c(ba);
+                measure("bf-intersect", pixels, [&]() { c.intersect(bb); });
+            }
+
+            {
+                bf::RasterMask c(ba);
+                measure("bf-subtract", pixels, [&]() { c.subtract(bb); });
+            }
+
+            {
+                bf::RasterMask c(ba);
+                measure("bf-xor", pixels
+                        , [&]() { c.symmetricDifference(bb); });
+            }
+
+            measure("bf-to-qt", 2 * pixels, [&]() {
+                RasterMask qa(ba);
+                RasterMask qb(bb);
+            });
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,222 @@
+/**
+ * Copyright (c) 2021 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file test-reconstruct/bench.cpp
+ *
+ * Filter weight cache benchmark: measures speed and accuracy of ConstRaster
+ * reconstruct() with a CachedFilter2 compared to direct filter evaluation,
+ * both on regular grids (repeating subpixel phase) and at random positions.
+ */
+
+#include <cstdlib>
+#include <cstdint>
+#include <cmath>
+#include <chrono>
+#include <array>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int_distribution.hpp>
+#include <boost/random/uniform_real_distribution.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "math/filters.hpp"
+
+#include "imgproc/const-raster.hpp"
+#include "imgproc/reconstruct.hpp"
+#include "imgproc/cached-filter.hpp"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+/** Simple 3-channel 8-bit raster modelling ConstRaster concept.
+ */
+class Raster : public imgproc::BoundsValidator<Raster> {
+public:
+    typedef std::array<std::uint8_t, 3> value_type;
+    typedef std::uint8_t channel_type;
+
+    Raster(const math::Size2 &size)
+        : size_(size), data_(math::area(size))
+    {}
+
+    int channels() const { return 3; }
+    int width() const { return size_.width; }
+    int height() const { return size_.height; }
+    math::Size2i size() const { return size_; }
+
+    const value_type& operator()(int x, int y) const {
+        return data_[y * size_.width + x];
+    }
+
+    value_type& at(int x, int y) { return data_[y * size_.width + x]; }
+
+    channel_type saturate(double value) const {
+        if (value < 0.0) { return 0; }
+        if (value > 255.0) { return 255; }
+        return channel_type(std::round(value));
+    }
+
+    value_type undefined() const { return {}; }
+
+private:
+    math::Size2 size_;
+    std::vector<value_type> data_;
+};
+
+/** Fills raster with smooth gradients and noise.
+ */
+void generate(Raster &raster, unsigned int seed)
+{
+    boost::random::mt19937 gen(seed);
+    boost::random::uniform_int_distribution<> noise(0, 31);
+
+    for (int j(0); j < raster.height(); ++j) {
+        for (int i(0); i < raster.width(); ++i) {
+            auto &v(raster.at(i, j));
+            v[0] = (i * 3 + j) % 224 + noise(gen);
+            v[1] = ((i / 16 + j / 16) % 2) * 192 + noise(gen);
+            v[2] = 128 + 96 * std::sin(i * 0.05) * std::cos(j * 0.03);
+        }
+    }
+}
+
+typedef std::vector<math::Point2> Positions;
+
+/** Regular grid of positions: origin + step * (i, j).
+ */
+Positions grid(const math::Size2 &size, double step, double origin)
+{
+    Positions out;
+    for (int j(0); j < size.height; ++j) {
+        for (int i(0); i < size.width; ++i) {
+            out.emplace_back(origin + step * i, origin + step * j);
+        }
+    }
+    return out;
+}
+
+/** Random positions inside raster.
+ */
+Positions random(const math::Size2 &rasterSize, std::size_t count
+                 , unsigned int seed)
+{
+    boost::random::mt19937 gen(seed);
+    boost::random::uniform_real_distribution<> x(0, rasterSize.width - 1);
+    boost::random::uniform_real_distribution<> y(0, rasterSize.height - 1);
+
+    Positions out;
+    for (std::size_t i(0); i < count; ++i) { out.emplace_back(x(gen), y(gen)); }
+    return out;
+}
+
+template <typename Filter2>
+double sample(const Raster &raster, const Filter2 &filter
+              , const Positions &positions
+              , std::vector<Raster::value_type> &out)
+{
+    out.resize(positions.size());
+    const auto start(Clock::now());
+    auto iout(out.begin());
+    for (const auto &pos : positions) {
+        *iout++ = imgproc::reconstruct(raster, filter, pos);
+    }
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/** Runs reconstruction at given positions with direct and cached filter and
+ *  reports time and difference.
+ */
+void run(const std::string &name, const Raster &raster
+         , const Positions &positions, double halfwin)
+{
+    const math::SincHamming2 filter(halfwin, halfwin);
+    std::vector<Raster::value_type> direct, cached;
+
+    const auto directTime(sample(raster, filter, positions, direct));
+
+    const auto buildStart(Clock::now());
+    const imgproc::CachedFilter2<math::SincHamming2> cachedFilter(filter);
+    const auto buildTime(std::chrono::duration<double>
+                         (Clock::now() - buildStart).count());
+
+    const auto cachedTime(sample(raster, cachedFilter, positions, cached));
+
+    int maxDiff(0);
+    double sumDiff(0.0);
+    for (std::size_t i(0); i < direct.size(); ++i) {
+        for (int c(0); c < 3; ++c) {
+            const int diff(std::abs(int(direct[i][c]) - int(cached[i][c])));
+            maxDiff = std::max(maxDiff, diff);
+            sumDiff += diff;
+        }
+    }
+
+    const double mpx(positions.size() / 1e6);
+    std::cout << std::setw(16) << std::left << name << std::right
+              << std::fixed << std::setprecision(1)
+              << " direct " << std::setw(7) << (mpx / directTime)
+              << " Mpx/s, cached " << std::setw(7) << (mpx / cachedTime)
+              << " Mpx/s (table " << std::setprecision(3) << buildTime
+              << " s), max diff " << maxDiff << ", mean diff "
+              << std::setprecision(4) << (sumDiff / (3 * direct.size()))
+              << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    dbglog::set_mask("ALL");
+    if (argc > 2) {
+        std::cerr << "usage: " << argv[0] << " [size]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const int size((argc > 1) ? boost::lexical_cast<int>(argv[1]) : 2048);
+
+    std::cout << "Reconstruct " << size << "x" << size << "." << std::endl;
+
+    Raster raster(math::Size2(size, size));
+    generate(raster, 42);
+
+    // upscaling: 4 subpixel phases
+    run("grid-up", raster, grid(math::Size2(size, size), 0.75, 0.125), 2.0);
+
+    // downscaling 3.3x: filter window scaled accordingly
+    run("grid-down", raster
+        , grid(math::Size2(size / 3, size / 3), 3.3, 1.15), 6.6);
+
+    // arbitrary phases: quantization error
+    run("random", raster, random(raster.size(), size * size / 4, 7), 2.0);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,124 @@
+/**
+ * Copyright (c) 2021 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file test-texturing/bench.cpp
+ *
+ * Texture patch packing benchmark: packs random patches (mostly small with
+ * a few large ones, like mesh texture patches) with every packing algorithm
+ * (and with all strategies tried concurrently) and reports time, atlas size
+ * and packing efficiency (patch area / atlas area).
+ */
+
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int_distribution.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "imgproc/texturing.hpp"
+
+namespace {
+
+namespace tx = imgproc::tx;
+
+typedef std::chrono::steady_clock Clock;
+
+/** Generates patches: 99 % of 2..40 pixel wide ones, 1 % up to 400 pixels.
+ */
+std::vector<tx::Patch> generate(int count, unsigned int seed)
+{
+    boost::random::mt19937 gen(seed);
+    boost::random::uniform_int_distribution<> small(2, 40);
+    boost::random::uniform_int_distribution<> large(40, 400);
+
+    std::vector<tx::Patch> patches;
+    patches.reserve(count);
+    for (int i(0); i < count; ++i) {
+        auto &dist((i % 100) ? small : large);
+        patches.emplace_back(0, 0, dist(gen), dist(gen));
+    }
+    return patches;
+}
+
+void measure(const std::string &name, std::vector<tx::Patch> patches
+             , const tx::PackOptions &options)
+{
+    unsigned long long total(0);
+    for (const auto &patch : patches) { total += math::area(patch.size()); }
+
+    tx::Patch::list list;
+    for (auto &patch : patches) { list.push_back(&patch); }
+
+    const auto start(Clock::now());
+    const auto size(tx::pack(list, options));
+    const auto elapsed(std::chrono::duration<double>
+                       (Clock::now() - start).count());
+
+    std::cout << std::setw(12) << std::left << name
+              << std::setw(10) << std::right << std::fixed
+              << std::setprecision(3) << elapsed << " s"
+              << std::setw(8) << size.width << "x" << std::setw(6)
+              << std::left << size.height
+              << std::setw(8) << std::right << std::setprecision(1)
+              << (100.0 * total / math::area(size)) << " %"
+              << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    if (argc > 3) {
+        std::cerr << "usage: " << argv[0] << " [count [iterations]]"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const int count((argc > 1) ? boost::lexical_cast<int>(argv[1]) : 100000);
+    const int iterations((argc > 2)
+                         ? boost::lexical_cast<int>(argv[2]) : 3);
+
+    std::cout << "Packing " << count << " patches, " << iterations
+              << " iteration(s)." << std::endl;
+
+    for (int it(0); it < iterations; ++it) {
+        const auto patches(generate(count, it));
+        measure("guillotine", patches, tx::PackOptions
+                (2.f, boost::none, tx::PackAlgorithm::guillotine));
+        measure("skyline", patches, tx::PackOptions
+                (2.f, boost::none, tx::PackAlgorithm::skyline));
+        measure("try-all", patches, tx::PackOptions
+                (2.f, boost::none, tx::PackAlgorithm::guillotine, true));
+    }
+
+    return EXIT_SUCCESS;
+}
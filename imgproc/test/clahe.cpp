@@ -0,0 +1,118 @@
+/**
+ * Copyright (c) 2021 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <limits>
+#include <cstdint>
+#include <algorithm>
+
+#include <boost/test/unit_test.hpp>
+
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int_distribution.hpp>
+
+#include <opencv2/core/core.hpp>
+
+#include "imgproc/clahe.hpp"
+
+#include "dbglog/dbglog.hpp"
+
+namespace {
+
+/** Low contrast image: slow gradient with noise in [base, base + 40).
+ */
+template <typename T>
+cv::Mat lowContrast(int width, int height, int type, int base)
+{
+    cv::Mat mat(height, width, type);
+    boost::random::mt19937 gen;
+    boost::random::uniform_int_distribution<> noise(0, 9);
+    for (int j(0); j < height; ++j) {
+        auto *row(mat.ptr<T>(j));
+        for (int i(0); i < width; ++i) {
+            row[i] = T(base + (i + j) * 30 / (width + height) + noise(gen));
+        }
+    }
+    return mat;
+}
+
+template <typename T>
+std::pair<int, int> range(const cv::Mat &mat)
+{
+    std::pair<int, int> r(std::numeric_limits<int>::max(), 0);
+    for (int j(0); j < mat.rows; ++j) {
+        const auto *row(mat.ptr<T>(j));
+        for (int i(0); i < mat.cols; ++i) {
+            r.first = std::min(r.first, int(row[i]));
+            r.second = std::max(r.second, int(row[i]));
+        }
+    }
+    return r;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(clahe_arbitrary_size)
+{
+    BOOST_TEST_MESSAGE("* Testing CLAHE on image not divisible by regions.");
+
+    // size is not a multiple of region size, single region row
+    for (const auto &size : { cv::Size(333, 257), cv::Size(100, 40) }) {
+        const auto src(lowContrast<std::uint8_t>
+                       (size.width, size.height, CV_8UC1, 100));
+
+        cv::Mat dst;
+        imgproc::CLAHE(src, dst, 64, 3.0);
+        BOOST_REQUIRE_EQUAL(dst.type(), src.type());
+        BOOST_REQUIRE_EQUAL(dst.rows, src.rows);
+        BOOST_REQUIRE_EQUAL(dst.cols, src.cols);
+
+        // contrast is stretched
+        const auto in(range<std::uint8_t>(src)), out(range<std::uint8_t>(dst));
+        BOOST_CHECK_GT(out.second - out.first, 2 * (in.second - in.first));
+
+        // in-place processing gives the same result
+        cv::Mat inplace(src.rows, src.cols, src.type());
+        src.copyTo(inplace);
+        imgproc::CLAHE(inplace, inplace, 64, 3.0);
+        for (int j(0); j < src.rows; ++j) {
+            for (int i(0); i < src.cols; ++i) {
+                BOOST_REQUIRE_EQUAL(int(inplace.at<std::uint8_t>(j, i))
+                                    , int(dst.at<std::uint8_t>(j, i)));
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(clahe_16bit)
+{
+    BOOST_TEST_MESSAGE("* Testing CLAHE on 16-bit image.");
+
+    const auto src(lowContrast<std::uint16_t>(300, 200, CV_16UC1, 20000));
+
+    cv::Mat dst;
+    imgproc::CLAHE(src, dst, 32);
+    const auto in(range<std::uint16_t>(src)), out(range<std::uint16_t>(dst));
+    BOOST_CHECK_GT(out.second - out.first, 100 * (in.second - in.first));
+}
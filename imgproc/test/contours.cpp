@@ -0,0 +1,195 @@
+/**
+ * Copyright (c) 2021 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <algorithm>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int_distribution.hpp>
+
+#include "imgproc/contours.hpp"
+
+#include "dbglog/dbglog.hpp"
+
+namespace {
+
+typedef std::vector<std::pair<double, double>> Ring;
+
+/** Converts rings to comparable form.
+ */
+std::vector<Ring> plain(const math::MultiPolygon &rings)
+{
+    std::vector<Ring> out;
+    for (const auto &ring : rings) {
+        out.emplace_back();
+        for (const auto &p : ring) { out.back().emplace_back(p(0), p(1)); }
+    }
+    return out;
+}
+
+/** Converts rings to canonical form: each ring starts at its smallest vertex
+ *  and rings are sorted.
+ */
+std::vector<Ring> canonical(const math::MultiPolygon &rings)
+{
+    auto out(plain(rings));
+    for (auto &r : out) {
+        std::rotate(r.begin(), std::min_element(r.begin(), r.end()), r.end());
+    }
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+void compare(const imgproc::Contour &a, const imgproc::Contour &b)
+{
+    BOOST_REQUIRE(canonical(a.rings) == canonical(b.rings));
+
+    const auto &size(a.border.dims());
+    BOOST_REQUIRE_EQUAL(a.border.size(), b.border.size());
+    for (int j(0); j < size.height; ++j) {
+        for (int i(0); i < size.width; ++i) {
+            BOOST_REQUIRE_EQUAL(a.border.get(i, j), b.border.get(i, j));
+        }
+    }
+}
+
+/** Minimal multi-color const raster.
+ */
+struct ColorRaster {
+    math::Size2 size_;
+    std::vector<int> data;
+
+    ColorRaster(const math::Size2 &size)
+        : size_(size), data(math::area(size)) {}
+
+    math::Size2 size() const { return size_; }
+    const int* operator()(int x, int y) const {
+        return &data[y * size_.width + x];
+    }
+};
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(contours_tiled)
+{
+    BOOST_TEST_MESSAGE("* Testing tiled contour extraction.");
+
+    // odd size, blocky data with noisy cells
+    math::Size2 size(333, 201);
+
+    imgproc::Contour::Raster raster(size, imgproc::Contour::Raster::EMPTY);
+    ColorRaster colors(size);
+    boost::random::mt19937 gen;
+    boost::random::uniform_int_distribution<> dist(0, 3);
+    for (int cy(0); cy < size.height; cy += 8) {
+        for (int cx(0); cx < size.width; cx += 8) {
+            const auto kind(dist(gen));
+            for (int j(cy); j < std::min(cy + 8, size.height); ++j) {
+                for (int i(cx); i < std::min(cx + 8, size.width); ++i) {
+                    const auto value((kind == 3) ? dist(gen) : kind);
+                    raster.set(i, j, value & 1);
+                    colors.data[j * size.width + i] = value % 3;
+                }
+            }
+        }
+    }
+
+    for (auto simplification : { imgproc::ChainSimplification::none
+                                 , imgproc::ChainSimplification::simple })
+    {
+        imgproc::ContourParameters params;
+        params.setSimplification(simplification);
+
+        const auto reference(imgproc::findContour(raster, params));
+        BOOST_REQUIRE(!reference.rings.empty());
+
+        for (int tileSize : { 64, 100, 256 }) {
+            params.setTileSize(tileSize);
+            compare(reference, imgproc::findContour(raster, params));
+        }
+
+        params.setTileSize(0);
+        const auto mreference(imgproc::findContours(colors, 3, params));
+        params.setTileSize(64);
+        const auto mtiled(imgproc::findContours(colors, 3, params));
+        BOOST_REQUIRE_EQUAL(mreference.size(), mtiled.size());
+        for (std::size_t c(0); c < mtiled.size(); ++c) {
+            compare(mreference[c], mtiled[c]);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(contours_stream)
+{
+    BOOST_TEST_MESSAGE("* Testing streaming contour extraction.");
+
+    math::Size2 size(157, 93);
+
+    ColorRaster colors(size);
+    boost::random::mt19937 gen;
+    boost::random::uniform_int_distribution<> dist(0, 3);
+    for (int cy(0); cy < size.height; cy += 8) {
+        for (int cx(0); cx < size.width; cx += 8) {
+            const auto kind(dist(gen));
+            for (int j(cy); j < std::min(cy + 8, size.height); ++j) {
+                for (int i(cx); i < std::min(cx + 8, size.width); ++i) {
+                    colors.data[j * size.width + i]
+                        = ((kind == 3) ? dist(gen) : kind);
+                }
+            }
+        }
+    }
+
+    for (auto simplification : { imgproc::ChainSimplification::none
+                                 , imgproc::ChainSimplification::simple
+                                 , imgproc::ChainSimplification::rdp })
+    {
+        imgproc::ContourParameters params;
+        params.setSimplification(simplification);
+
+        const auto reference(imgproc::findContours(colors, 3, params));
+
+        std::vector<math::MultiPolygon> streamed(3);
+        imgproc::ContourStream cs
+            (size.width, 3, [&](int color, imgproc::Contour::Ring &&ring)
+             {
+                 streamed[color].push_back(std::move(ring));
+             }, params);
+
+        for (int j(0); j < size.height; ++j) { cs.feedRow(colors(0, j)); }
+        cs.finish();
+
+        BOOST_REQUIRE_EQUAL(cs.rows(), size.height);
+        BOOST_CHECK_THROW(cs.feedRow(colors(0, 0)), std::logic_error);
+
+        // same rings in the same order
+        for (int c(0); c < 3; ++c) {
+            BOOST_REQUIRE(!streamed[c].empty());
+            BOOST_REQUIRE(plain(streamed[c]) == plain(reference[c].rings));
+        }
+    }
+}
@@ -0,0 +1,264 @@
+/**
+ * Copyright (c) 2021 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#ifdef _OPENMP
+#  include <omp.h>
+#endif
+
+#include <boost/test/unit_test.hpp>
+
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_real_distribution.hpp>
+
+#include "imgproc/imgwarp.hpp"
+
+#include "dbglog/dbglog.hpp"
+
+namespace {
+
+/** Fills image with random values spanning whole range of given type.
+ */
+template <typename T>
+void generate(cv::Mat &image, double max, unsigned int seed)
+{
+    boost::random::mt19937 gen(seed);
+    boost::random::uniform_real_distribution<> noise(0.0, max);
+
+    for (int y(0); y < image.rows; ++y) {
+        T *row(image.ptr<T>(y));
+        for (int i(0), ie(image.cols * image.channels()); i < ie; ++i) {
+            row[i] = T(noise(gen));
+        }
+    }
+}
+
+int positiveMod(int i, int n) { return (i % n + n) % n; }
+
+/** Maps pixel outside of the image inside, returns false for constant
+ *  border. Formulas of the original single channel implementation.
+ */
+bool mapBorder(int border, int &x, int &y, int cols, int rows)
+{
+    const int maxX(cols - 1), maxY(rows - 1);
+    switch (border) {
+    case cv::BORDER_CONSTANT:
+        return false;
+
+    case cv::BORDER_REPLICATE:
+        break;
+
+    case cv::BORDER_REFLECT:
+        x = x - (x < 0) * (2 * x + 1) + (x > maxX) * (2 * maxX - 2 * x + 1);
+        y = y - (y < 0) * (2 * y + 1) + (y > maxY) * (2 * maxY - 2 * y + 1);
+        break;
+
+    case cv::BORDER_WRAP:
+        x = positiveMod(x, cols);
+        y = positiveMod(y, rows);
+        break;
+
+    case cv::BORDER_REFLECT_101:
+        x = x - (x < 0) * 2 * x + (x > maxX) * (2 * maxX - 2 * x);
+        y = y - (y < 0) * 2 * y + (y > maxY) * (2 * maxY - 2 * y);
+        break;
+    }
+
+    x = std::max(0, std::min(x, maxX));
+    y = std::max(0, std::min(y, maxY));
+    return true;
+}
+
+/** Straightforward per-pixel warp: full homography, border handling and
+ *  bilinear interpolation for every pixel and channel.
+ */
+template <typename T>
+cv::Mat reference(const cv::Mat &src, const cv::Mat &H, const cv::Size &size
+                  , int border, double borderValue)
+{
+    cv::Mat dst(size.height, size.width, src.type());
+    const int channels(src.channels());
+
+    cv::Mat_<double> Hinv;
+    cv::invert(H, Hinv);
+
+    const auto value([&](int x, int y, int c) -> float
+    {
+        if ((x < 0) || (y < 0) || (x >= src.cols) || (y >= src.rows)) {
+            if (!mapBorder(border, x, y, src.cols, src.rows)) {
+                return cv::saturate_cast<T>(borderValue);
+            }
+        }
+        return src.ptr<T>(y)[x * channels + c];
+    });
+
+    for (int y(0); y < dst.rows; ++y) {
+        for (int x(0); x < dst.cols; ++x) {
+            const double iw(1.0 / (Hinv(2, 0) * x + Hinv(2, 1) * y
+                                   + Hinv(2, 2)));
+            const float u((Hinv(0, 0) * x + Hinv(0, 1) * y + Hinv(0, 2))
+                          * iw);
+            const float v((Hinv(1, 0) * x + Hinv(1, 1) * y + Hinv(1, 2))
+                          * iw);
+
+            const int x0(std::floor(u)), y0(std::floor(v));
+            const float fx(u - x0), fy(v - y0);
+
+            for (int c(0); c < channels; ++c) {
+                const float v00(value(x0, y0, c));
+                const float v01(value(x0 + 1, y0, c));
+                const float v10(value(x0, y0 + 1, c));
+                const float v11(value(x0 + 1, y0 + 1, c));
+
+                const float w0(v00 + (v01 - v00) * fx);
+                const float w1(v10 + (v11 - v10) * fx);
+                dst.ptr<T>(y)[x * channels + c] = T(w0 + (w1 - w0) * fy);
+            }
+        }
+    }
+
+    return dst;
+}
+
+/** Returns true if both images have the same type, size and content.
+ */
+bool identical(const cv::Mat &a, const cv::Mat &b)
+{
+    if ((a.type() != b.type()) || (a.rows != b.rows) || (a.cols != b.cols)) {
+        return false;
+    }
+
+    const std::size_t bytes(a.cols * a.elemSize());
+    for (int y(0); y < a.rows; ++y) {
+        if (std::memcmp(a.ptr<uchar>(y), b.ptr<uchar>(y), bytes)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/** Rotation, scale and mild perspective, maps part of the output outside of
+ *  the source image.
+ */
+cv::Mat homography(double angle, double scale, const cv::Size &size)
+{
+    const double cx(size.width / 2.0), cy(size.height / 2.0);
+    const double c(std::cos(angle) * scale), s(std::sin(angle) * scale);
+
+    cv::Mat_<double> H(3, 3);
+    H(0, 0) = c; H(0, 1) = -s; H(0, 2) = cx - c * cx + s * cy + 3.3;
+    H(1, 0) = s; H(1, 1) = c; H(1, 2) = cy - s * cx - c * cy - 2.7;
+    H(2, 0) = 0.0004; H(2, 1) = -0.0003; H(2, 2) = 1.0;
+    return H;
+}
+
+template <typename T>
+void check(int type, double max)
+{
+    const int borders[] = {
+        cv::BORDER_CONSTANT, cv::BORDER_REPLICATE, cv::BORDER_REFLECT
+        , cv::BORDER_WRAP, cv::BORDER_REFLECT_101
+    };
+
+    // odd sizes exercise vector loop tails, tiny images degenerate interior
+    const cv::Size sizes[][2] = {
+        { cv::Size(61, 47), cv::Size(83, 71) }
+        , { cv::Size(64, 64), cv::Size(64, 64) }
+        , { cv::Size(2, 3), cv::Size(9, 7) }
+        , { cv::Size(1, 1), cv::Size(5, 3) }
+    };
+
+    unsigned int seed(type);
+    for (const auto &size : sizes) {
+        cv::Mat src(size[0].height, size[0].width, type);
+        generate<T>(src, max, ++seed);
+
+        for (const double angle : { 0.0, 0.3, 2.1 }) {
+            const auto H(homography(angle, 0.8 + angle / 4, size[0]));
+            for (const int border : borders) {
+                for (const double borderValue : { 0.0, 77.5, 1e6 }) {
+                    cv::Mat dst;
+                    imgproc::warpPerspective(src, dst, H, size[1], border
+                                             , borderValue);
+                    BOOST_CHECK_MESSAGE
+                        (identical(dst, reference<T>(src, H, size[1], border
+                                                     , borderValue))
+                         , "type " << type << ", border " << border
+                         << ", size " << size[0].width << "x"
+                         << size[0].height << ", angle " << angle
+                         << ", border value " << borderValue);
+                }
+            }
+        }
+    }
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(imgwarp_reference)
+{
+    BOOST_TEST_MESSAGE("* Testing perspective warp against reference.");
+
+#ifdef _OPENMP
+    // force multiple threads even on a single core machine
+    const int threads(omp_get_max_threads());
+    omp_set_num_threads(4);
+#endif
+
+    check<uchar>(CV_8UC1, 255.0);
+    check<uchar>(CV_8UC3, 255.0);
+    check<uchar>(CV_8UC4, 255.0);
+    check<ushort>(CV_16UC1, 65535.0);
+    check<ushort>(CV_16UC3, 65535.0);
+    check<ushort>(CV_16UC4, 65535.0);
+    check<float>(CV_32FC1, 1000.0);
+    check<float>(CV_32FC3, 1000.0);
+    check<float>(CV_32FC4, 1000.0);
+
+#ifdef _OPENMP
+    omp_set_num_threads(threads);
+#endif
+}
+
+BOOST_AUTO_TEST_CASE(imgwarp_errors)
+{
+    BOOST_TEST_MESSAGE("* Testing perspective warp error handling.");
+
+    const auto H(homography(0.0, 1.0, cv::Size(8, 8)));
+    cv::Mat dst;
+
+    cv::Mat empty;
+    BOOST_CHECK_THROW(imgproc::warpPerspective(empty, dst, H, cv::Size(8, 8)
+                                               , cv::BORDER_CONSTANT)
+                      , std::runtime_error);
+
+    cv::Mat src(8, 8, CV_8UC1);
+    BOOST_CHECK_THROW(imgproc::warpPerspective(src, dst, H, cv::Size(8, 8)
+                                               , 100)
+                      , std::runtime_error);
+}
@@ -0,0 +1,206 @@
+/**
+ * Copyright (c) 2021 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#ifdef _OPENMP
+#  include <omp.h>
+#endif
+
+#include <boost/test/unit_test.hpp>
+
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int_distribution.hpp>
+
+#include "imgproc/inpaint.hpp"
+
+#include "dbglog/dbglog.hpp"
+
+namespace {
+
+typedef cv::Vec<unsigned char, 3> Pixel;
+
+/** Random image and block mask: each block is randomly empty, full or
+ *  partial with random density.
+ */
+void generate(cv::Mat &img, cv::Mat &mask, int blkWidth, int blkHeight
+              , unsigned int seed)
+{
+    boost::random::mt19937 gen(seed);
+    boost::random::uniform_int_distribution<> value(0, 255);
+    boost::random::uniform_int_distribution<> kind(0, 5);
+    boost::random::uniform_int_distribution<> percent(0, 99);
+
+    for (int y(0); y < img.rows; ++y) {
+        for (int x(0); x < img.cols; ++x) {
+            auto &px(img.at<Pixel>(y, x));
+            for (int c(0); c < 3; ++c) { px[c] = value(gen); }
+        }
+    }
+
+    for (int by(0); by < mask.rows; by += blkHeight) {
+        for (int bx(0); bx < mask.cols; bx += blkWidth) {
+            const int k(kind(gen));
+            const int density((k == 0) ? 0 : (k == 1) ? 100
+                              : 5 + 90 * (k - 2) / 3);
+            for (int y(by), ye(std::min(by + blkHeight, mask.rows));
+                 y < ye; ++y)
+            {
+                for (int x(bx), xe(std::min(bx + blkWidth, mask.cols));
+                     x < xe; ++x)
+                {
+                    mask.at<uchar>(y, x) = (percent(gen) < density) ? 255 : 0;
+                }
+            }
+        }
+    }
+}
+
+/** Original inpainting: every partial block solved by laplaceInterpolate().
+ */
+cv::Mat reference(const cv::Mat &img, const cv::Mat &mask
+                  , int blkWidth, int blkHeight)
+{
+    cv::Mat out(img.clone());
+
+    for (int by(0); by < img.rows; by += blkHeight) {
+        for (int bx(0); bx < img.cols; bx += blkWidth) {
+            const int w(std::min(blkWidth, img.cols - bx));
+            const int h(std::min(blkHeight, img.rows - by));
+
+            cv::Mat block(h, w, CV_8UC3);
+            imgproc::RasterMask blkMask(w, h);
+            bool full(true), empty(true);
+            for (int y(0); y < h; ++y) {
+                for (int x(0); x < w; ++x) {
+                    block.at<Pixel>(y, x) = img.at<Pixel>(by + y, bx + x);
+                    const bool m(mask.at<uchar>(by + y, bx + x));
+                    blkMask.set(x, y, m);
+                    full = full && m;
+                    empty = empty && !m;
+                }
+            }
+
+            if (full) { continue; }
+
+            if (empty) {
+                block = cv::Mat(h, w, CV_8UC3);
+                block.setTo(cv::Scalar());
+            } else {
+                imgproc::laplaceInterpolate<unsigned char, 3, double>
+                    (block, blkMask, 1e-12);
+            }
+
+            for (int y(0); y < h; ++y) {
+                for (int x(0); x < w; ++x) {
+                    out.at<Pixel>(by + y, bx + x) = block.at<Pixel>(y, x);
+                }
+            }
+        }
+    }
+
+    return out;
+}
+
+/** Returns maximum channel difference, requires given pixels to be intact.
+ */
+int difference(const cv::Mat &a, const cv::Mat &b, const cv::Mat &mask)
+{
+    int diff(0);
+    for (int y(0); y < a.rows; ++y) {
+        for (int x(0); x < a.cols; ++x) {
+            const auto &pa(a.at<Pixel>(y, x));
+            const auto &pb(b.at<Pixel>(y, x));
+            for (int c(0); c < 3; ++c) {
+                const int d(std::abs(int(pa[c]) - int(pb[c])));
+                if (mask.at<uchar>(y, x) && d) { return 256; }
+                diff = std::max(diff, d);
+            }
+        }
+    }
+    return diff;
+}
+
+bool identical(const cv::Mat &a, const cv::Mat &b)
+{
+    const std::size_t bytes(a.cols * a.elemSize());
+    for (int y(0); y < a.rows; ++y) {
+        if (std::memcmp(a.ptr<uchar>(y), b.ptr<uchar>(y), bytes)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(inpaint_block_patterns)
+{
+    BOOST_TEST_MESSAGE("* Testing per-pattern JPEG block inpainting.");
+
+#ifdef _OPENMP
+    // force multiple threads even on a single core machine
+    const int threads(omp_get_max_threads());
+    omp_set_num_threads(4);
+#endif
+
+    struct Setup { int width, height, blkWidth, blkHeight; };
+
+    // sizes not divisible by block size produce partial right/bottom blocks
+    for (const auto &setup : { Setup{ 64, 48, 8, 8 }, Setup{ 61, 45, 8, 8 }
+                               , Setup{ 37, 23, 4, 6 }, Setup{ 5, 3, 8, 8 } })
+    {
+        cv::Mat img(setup.height, setup.width, CV_8UC3);
+        cv::Mat mask(setup.height, setup.width, CV_8UC1);
+        generate(img, mask, setup.blkWidth, setup.blkHeight
+                 , setup.width * setup.height);
+
+        const auto expect(reference(img, mask, setup.blkWidth
+                                    , setup.blkHeight));
+
+        cv::Mat out(img.clone());
+        imgproc::jpegBlockInpaint<unsigned char, 3>
+            (out, mask, setup.blkWidth, setup.blkHeight);
+
+        // exact solution vs sparse solver, rounding may differ by one
+        BOOST_CHECK_LE(difference(out, expect, mask), 1);
+
+        // bounded pattern table: solvers built in several runs
+        for (const std::size_t maxPatterns : { 1, 2, 7 }) {
+            cv::Mat bounded(img.clone());
+            imgproc::detail::jpegBlockInpaintPatterns<unsigned char, 3>
+                (bounded, mask, setup.blkWidth, setup.blkHeight
+                 , maxPatterns);
+            BOOST_CHECK_MESSAGE(identical(out, bounded)
+                                , "max patterns " << maxPatterns);
+        }
+    }
+
+#ifdef _OPENMP
+    omp_set_num_threads(threads);
+#endif
+}
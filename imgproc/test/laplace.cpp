@@ -0,0 +1,222 @@
+/**
+ * Copyright (c) 2021 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <cmath>
+#include <algorithm>
+
+#include <boost/test/unit_test.hpp>
+
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int_distribution.hpp>
+#include <boost/random/uniform_real_distribution.hpp>
+
+#include "imgproc/rastermask.hpp"
+#include "imgproc/scattered-interpolation.hpp"
+
+#include "dbglog/dbglog.hpp"
+
+namespace {
+
+typedef cv::Vec<float, 3> Pixel;
+
+/** Smooth image with noise; free pixels get garbage the solvers must
+ *  overwrite.
+ */
+cv::Mat generate(int width, int height, unsigned int seed)
+{
+    boost::random::mt19937 gen(seed);
+    boost::random::uniform_real_distribution<> noise(-20.0, 20.0);
+
+    cv::Mat image(height, width, CV_32FC3);
+    for (int y(0); y < height; ++y) {
+        for (int x(0); x < width; ++x) {
+            auto &px(image.at<Pixel>(y, x));
+            px[0] = 128.0 + 100.0 * std::sin(x * 0.05) * std::cos(y * 0.03)
+                + noise(gen);
+            px[1] = 20.0 + (200.0 * x) / width + noise(gen);
+            px[2] = 20.0 + (200.0 * y) / height + noise(gen);
+        }
+    }
+    return image;
+}
+
+/** Random mask: 'percent' % of scattered free pixels plus 'holes'
+ *  rectangular holes, some of them clipped by image edges. Pixel (gx, gy)
+ *  is always given so that no system is singular.
+ */
+imgproc::RasterMask generateMask(int width, int height, int percent
+                                 , int holes, unsigned int seed)
+{
+    imgproc::RasterMask mask(width, height, imgproc::RasterMask::FULL);
+
+    boost::random::mt19937 gen(seed);
+    boost::random::uniform_int_distribution<> coin(0, 99);
+    boost::random::uniform_int_distribution<> cx(-width / 8, width - 1);
+    boost::random::uniform_int_distribution<> cy(-height / 8, height - 1);
+    boost::random::uniform_int_distribution<> extent
+        (1, std::max(2, std::max(width, height) / 4));
+
+    for (int k(0); k < holes; ++k) {
+        const int x(cx(gen)), y(cy(gen)), w(extent(gen)), h(extent(gen));
+        for (int j(std::max(y, 0)), je(std::min(y + h, height)); j < je; ++j)
+        {
+            for (int i(std::max(x, 0)), ie(std::min(x + w, width)); i < ie;
+                 ++i)
+            {
+                mask.set(i, j, false);
+            }
+        }
+    }
+
+    for (int y(0); y < height; ++y) {
+        for (int x(0); x < width; ++x) {
+            if (coin(gen) < percent) { mask.set(x, y, false); }
+        }
+    }
+
+    mask.set(width / 2, height / 2, true);
+    return mask;
+}
+
+/** Solves the system by both solvers and checks they agree and keep given
+ *  pixels intact.
+ */
+void compare(const cv::Mat &image, const imgproc::RasterMask &mask
+             , double tol)
+{
+    cv::Mat eigen(image.clone()), multigrid(image.clone());
+
+    imgproc::laplaceInterpolate<float, 3, double>
+        (eigen, mask, tol, imgproc::LaplaceSolver::eigen);
+    imgproc::laplaceInterpolate<float, 3>
+        (multigrid, mask, tol, imgproc::LaplaceSolver::multigrid);
+
+    // both solvers stop at relative residual 'tol'; error of the solution
+    // is at most condition number times that, which grows with square of
+    // grid extent; results are stored as float (values up to 255)
+    const double extent(std::max(image.cols, image.rows));
+    const double bound(255.0 * (tol * extent * extent + 1e-6));
+
+    double diff(0.0);
+    bool intact(true);
+    for (int y(0); y < image.rows; ++y) {
+        for (int x(0); x < image.cols; ++x) {
+            const auto &src(image.at<Pixel>(y, x));
+            const auto &pe(eigen.at<Pixel>(y, x));
+            const auto &pm(multigrid.at<Pixel>(y, x));
+            for (int c(0); c < 3; ++c) {
+                diff = std::max(diff, double(std::abs(pe[c] - pm[c])));
+                if (mask.get(x, y) && ((pm[c] != src[c]) || (pe[c] != src[c])))
+                {
+                    intact = false;
+                }
+            }
+        }
+    }
+
+    BOOST_CHECK_MESSAGE(diff <= bound
+                        , image.cols << "x" << image.rows
+                        << ": max difference " << diff
+                        << " exceeds " << bound);
+    BOOST_CHECK_MESSAGE(intact, image.cols << "x" << image.rows
+                        << ": given pixels changed");
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(laplace_multigrid)
+{
+    BOOST_TEST_MESSAGE("* Testing multigrid Laplace interpolation.");
+
+    struct Setup { int width, height, percent, holes; };
+
+    unsigned int seed(0);
+    for (const auto &setup : {
+            // random masks, odd sizes for uneven coarsening
+            Setup{ 200, 150, 20, 6 }, Setup{ 257, 129, 10, 8 }
+            , Setup{ 300, 300, 40, 0 }, Setup{ 64, 64, 60, 2 }
+            // thin images
+            , Setup{ 50, 1, 30, 1 }, Setup{ 1, 50, 30, 1 }
+            , Setup{ 1000, 3, 20, 3 }, Setup{ 3, 1000, 20, 3 }
+            , Setup{ 2, 2, 50, 0 } })
+    {
+        ++seed;
+        const auto image(generate(setup.width, setup.height, seed));
+        const auto mask(generateMask(setup.width, setup.height
+                                     , setup.percent, setup.holes, seed));
+        for (const double tol : { 1e-8, 1e-11 }) {
+            compare(image, mask, tol);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(laplace_multigrid_edges)
+{
+    BOOST_TEST_MESSAGE("* Testing multigrid Laplace holes at image edges.");
+
+    const int width(97), height(61);
+    const auto image(generate(width, height, 7));
+
+    // hole covering each edge and corner region
+    const struct { int x0, y0, x1, y1; } holes[] = {
+        { 0, 0, width, 10 }, { 0, height - 10, width, height }
+        , { 0, 0, 12, height }, { width - 12, 0, width, height }
+        , { 0, 0, 30, 20 }, { width - 30, height - 20, width, height }
+        , { 1, 1, width - 1, height - 1 }
+    };
+
+    for (const auto &hole : holes) {
+        imgproc::RasterMask mask(width, height, imgproc::RasterMask::FULL);
+        for (int y(hole.y0); y < hole.y1; ++y) {
+            for (int x(hole.x0); x < hole.x1; ++x) {
+                mask.set(x, y, false);
+            }
+        }
+        compare(image, mask, 1e-10);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(laplace_multigrid_noop)
+{
+    BOOST_TEST_MESSAGE("* Testing multigrid Laplace with all pixels given.");
+
+    const auto image(generate(33, 17, 3));
+    const imgproc::RasterMask mask(33, 17, imgproc::RasterMask::FULL);
+
+    cv::Mat result(image.clone());
+    imgproc::laplaceInterpolate<float, 3>
+        (result, mask, 1e-8, imgproc::LaplaceSolver::multigrid);
+
+    bool same(true);
+    for (int y(0); y < image.rows; ++y) {
+        for (int x(0); x < image.cols; ++x) {
+            for (int c(0); c < 3; ++c) {
+                same = same && (result.at<Pixel>(y, x)[c]
+                                == image.at<Pixel>(y, x)[c]);
+            }
+        }
+    }
+    BOOST_CHECK(same);
+}
@@ -0,0 +1,166 @@
+/**
+ * Copyright (c) 2021 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <vector>
+#include <algorithm>
+
+#include <boost/test/unit_test.hpp>
+
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int_distribution.hpp>
+
+#include "imgproc/rastermask/bitfield.hpp"
+#include "imgproc/morphology.hpp"
+
+#include "dbglog/dbglog.hpp"
+
+namespace {
+
+/** Naive square-kernel extremum, pixels outside image are ignored.
+ */
+template <typename T, typename Op>
+std::vector<T> naive(const std::vector<T> &in, int width, int height
+                     , int radius, const Op &op)
+{
+    std::vector<T> out(in.size());
+    for (int y(0); y < height; ++y) {
+        for (int x(0); x < width; ++x) {
+            T value(in[y * width + x]);
+            for (int j(std::max(0, y - radius))
+                     , je(std::min(height, y + radius + 1)); j < je; ++j)
+            {
+                for (int i(std::max(0, x - radius))
+                         , ie(std::min(width, x + radius + 1)); i < ie; ++i)
+                {
+                    value = op(value, in[j * width + i]);
+                }
+            }
+            out[y * width + x] = value;
+        }
+    }
+    return out;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(morphology_running_extremum)
+{
+    BOOST_TEST_MESSAGE("* Testing van Herk/Gil-Werman morphology.");
+
+    namespace mp = imgproc::detail::morphology;
+
+    boost::random::mt19937 gen(11);
+    boost::random::uniform_int_distribution<> value(0, 255);
+
+    for (const auto &size : { math::Size2(1, 1), math::Size2(7, 3)
+                              , math::Size2(131, 97), math::Size2(70, 200) })
+    {
+        std::vector<int> image(math::area(size));
+        for (auto &v : image) { v = value(gen); }
+
+        for (int radius : { 1, 2, 7, 40 }) {
+            auto eroded(image);
+            mp::filter(eroded.data(), size.width, size.width, size.height
+                       , radius, mp::Min<int>());
+            BOOST_REQUIRE(eroded == naive(image, size.width, size.height
+                                          , radius, mp::Min<int>()));
+
+            auto dilated(image);
+            mp::filter(dilated.data(), size.width, size.width, size.height
+                       , radius, mp::Max<int>());
+            BOOST_REQUIRE(dilated == naive(image, size.width, size.height
+                                           , radius, mp::Max<int>()));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(morphology_bitfield)
+{
+    BOOST_TEST_MESSAGE("* Testing bitfield morphology.");
+
+    namespace bf = imgproc::bitfield;
+    namespace mp = imgproc::detail::morphology;
+
+    boost::random::mt19937 gen(13);
+    boost::random::uniform_int_distribution<> pixel(0, 9);
+
+    for (const auto &size : { math::Size2(1, 1), math::Size2(64, 5)
+                              , math::Size2(200, 130)
+                              , math::Size2(65, 300) })
+    {
+        bf::RasterMask mask(size, bf::RasterMask::EMPTY);
+        std::vector<int> pixels(math::area(size));
+        for (int y(0); y < size.height; ++y) {
+            for (int x(0); x < size.width; ++x) {
+                // sparse noise and a solid block
+                const bool set((pixel(gen) == 0)
+                               || ((x > size.width / 4) && (x < size.width / 2)
+                                   && (y > size.height / 3)));
+                mask.set(x, y, set);
+                pixels[y * size.width + x] = set;
+            }
+        }
+
+        const auto check([&](const bf::RasterMask &m
+                             , const std::vector<int> &expected)
+        {
+            std::size_t count(0);
+            for (int y(0); y < size.height; ++y) {
+                for (int x(0); x < size.width; ++x) {
+                    BOOST_REQUIRE_EQUAL(int(m.get(x, y))
+                                        , expected[y * size.width + x]);
+                    count += expected[y * size.width + x];
+                }
+            }
+            BOOST_REQUIRE_EQUAL(m.size(), count);
+        });
+
+        for (int kernel : { 3, 5, 16, 131 }) {
+            const int radius(kernel / 2);
+            const auto eroded(naive(pixels, size.width, size.height, radius
+                                    , mp::Min<int>()));
+            const auto dilated(naive(pixels, size.width, size.height, radius
+                                     , mp::Max<int>()));
+
+            bf::RasterMask e(mask);
+            bf::erode(e, kernel);
+            check(e, eroded);
+
+            bf::RasterMask d(mask);
+            bf::dilate(d, kernel);
+            check(d, dilated);
+
+            bf::RasterMask o(mask);
+            bf::open(o, kernel);
+            check(o, naive(eroded, size.width, size.height, radius
+                           , mp::Max<int>()));
+
+            bf::RasterMask c(mask);
+            bf::close(c, kernel);
+            check(c, naive(dilated, size.width, size.height, radius
+                           , mp::Min<int>()));
+        }
+    }
+}
@@ -0,0 +1,233 @@
+/**
+ * Copyright (c) 2021 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <cmath>
+#include <array>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int_distribution.hpp>
+
+#include "imgproc/pyramid.hpp"
+
+#include "dbglog/dbglog.hpp"
+
+namespace {
+
+/** Simple raster with optional validity (const raster concept subset).
+ */
+struct Image {
+    typedef std::array<float, 3> value_type;
+
+    Image(const math::Size2 &size)
+        : size(size), values(math::area(size)), mask(math::area(size), 1)
+    {}
+
+    int width() const { return size.width; }
+    int height() const { return size.height; }
+    int channels() const { return 3; }
+
+    const value_type& operator()(int x, int y) const {
+        return values[y * size.width + x];
+    }
+
+    bool valid(int x, int y) const { return mask[y * size.width + x]; }
+
+    math::Size2 size;
+    std::vector<value_type> values;
+    std::vector<std::uint8_t> mask;
+};
+
+/** Reference decimation: direct 2D normalized convolution.
+ */
+Image decimate(const Image &src)
+{
+    const float kernel[4] = { 1.f / 8, 3.f / 8, 3.f / 8, 1.f / 8 };
+
+    Image dst(math::Size2((src.size.width + 1) / 2
+                          , (src.size.height + 1) / 2));
+    for (int y(0); y < dst.height(); ++y) {
+        for (int x(0); x < dst.width(); ++x) {
+            double sum[3] = { 0, 0, 0 };
+            double weight(0);
+            bool cover(false);
+            for (int j(0); j < 4; ++j) {
+                for (int i(0); i < 4; ++i) {
+                    const int sx(2 * x - 1 + i), sy(2 * y - 1 + j);
+                    if ((sx < 0) || (sy < 0) || (sx >= src.width())
+                        || (sy >= src.height()) || !src.valid(sx, sy))
+                    {
+                        continue;
+                    }
+                    const double w(kernel[i] * kernel[j]);
+                    for (int c(0); c < 3; ++c) {
+                        sum[c] += w * src(sx, sy)[c];
+                    }
+                    weight += w;
+                    if ((i == 1 || i == 2) && (j == 1 || j == 2)) {
+                        cover = true;
+                    }
+                }
+            }
+
+            auto &out(dst.values[y * dst.width() + x]);
+            dst.mask[y * dst.width() + x] = cover;
+            for (int c(0); c < 3; ++c) {
+                out[c] = cover ? sum[c] / weight : 0.0;
+            }
+        }
+    }
+    return dst;
+}
+
+/** Collects tiles into level images, checks that each pixel is delivered
+ *  exactly once.
+ */
+struct Collector {
+    void operator()(const imgproc::PyramidTile &tile) {
+        BOOST_REQUIRE(tile.level >= 1);
+        if (int(levels.size()) < tile.level) {
+            levels.resize(tile.level, Image(math::Size2(0, 0)));
+            counts.resize(tile.level);
+        }
+        auto &level(levels[tile.level - 1]);
+        auto &count(counts[tile.level - 1]);
+
+        // grow to cover tile (tiles arrive row-major)
+        const auto &e(tile.extents);
+        if (e.ur(0) > level.size.width || e.ur(1) > level.size.height) {
+            Image grown(math::Size2(std::max(e.ur(0), level.size.width)
+                                    , std::max(e.ur(1), level.size.height)));
+            std::vector<int> grownCount(math::area(grown.size));
+            for (int y(0); y < level.height(); ++y) {
+                for (int x(0); x < level.width(); ++x) {
+                    const auto from(y * level.width() + x);
+                    const auto to(y * grown.width() + x);
+                    grown.values[to] = level.values[from];
+                    grown.mask[to] = level.mask[from];
+                    grownCount[to] = count[from];
+                }
+            }
+            level = grown;
+            count = grownCount;
+        }
+
+        for (int y(e.ll(1)); y < e.ur(1); ++y) {
+            for (int x(e.ll(0)); x < e.ur(0); ++x) {
+                const auto index(y * level.width() + x);
+                ++count[index];
+                level.mask[index] = tile.valid(x - e.ll(0), y - e.ll(1));
+                for (int c(0); c < 3; ++c) {
+                    level.values[index][c]
+                        = tile.value(x - e.ll(0), y - e.ll(1), c);
+                }
+            }
+        }
+    }
+
+    std::vector<Image> levels;
+    std::vector<std::vector<int>> counts;
+};
+
+void compare(const Image &image, const imgproc::PyramidParameters &params)
+{
+    Collector collector;
+    imgproc::buildPyramid(image, std::ref(collector), params);
+
+    Image reference(image);
+    for (const auto &level : collector.levels) {
+        reference = decimate(reference);
+        BOOST_REQUIRE_EQUAL(level.size.width, reference.size.width);
+        BOOST_REQUIRE_EQUAL(level.size.height, reference.size.height);
+
+        for (std::size_t i(0); i < level.values.size(); ++i) {
+            BOOST_REQUIRE_EQUAL(collector.counts[&level
+                                                 - &collector.levels[0]][i]
+                                , 1);
+            BOOST_REQUIRE_EQUAL(int(level.mask[i]), int(reference.mask[i]));
+            for (int c(0); c < 3; ++c) {
+                BOOST_REQUIRE_SMALL(level.values[i][c]
+                                    - reference.values[i][c], 1e-3f);
+            }
+        }
+    }
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(pyramid_reference)
+{
+    BOOST_TEST_MESSAGE("* Testing pyramid builder against reference.");
+
+    boost::random::mt19937 gen(7);
+    boost::random::uniform_int_distribution<> value(0, 255);
+
+    Image image(math::Size2(77, 45));
+    for (auto &v : image.values) {
+        for (auto &c : v) { c = value(gen); }
+    }
+
+    {
+        Collector collector;
+        imgproc::buildPyramid(image, std::ref(collector));
+        // 77x45 -> ... -> 1x1
+        BOOST_CHECK_EQUAL(collector.levels.size(), 7);
+    }
+
+    compare(image, imgproc::PyramidParameters().setTileSize(16));
+    compare(image, imgproc::PyramidParameters().setTileSize(0));
+    compare(image, imgproc::PyramidParameters().setLevels(3).setTileSize(7));
+}
+
+BOOST_AUTO_TEST_CASE(pyramid_mask)
+{
+    BOOST_TEST_MESSAGE("* Testing masked pyramid building.");
+
+    // valid disc of constant color, garbage outside
+    Image image(math::Size2(64, 50));
+    for (int y(0); y < image.height(); ++y) {
+        for (int x(0); x < image.width(); ++x) {
+            const auto index(y * image.width() + x);
+            const bool inside(std::hypot(x - 30, y - 22) < 17);
+            image.mask[index] = inside;
+            image.values[index].fill(inside ? 10.f : 1000.f);
+        }
+    }
+
+    compare(image, imgproc::PyramidParameters().setTileSize(8));
+
+    Collector collector;
+    imgproc::buildPyramid(image, std::ref(collector));
+    for (const auto &level : collector.levels) {
+        for (std::size_t i(0); i < level.values.size(); ++i) {
+            const float expect(level.mask[i] ? 10.f : 0.f);
+            for (int c(0); c < 3; ++c) {
+                BOOST_REQUIRE_SMALL(level.values[i][c] - expect, 1e-4f);
+            }
+        }
+    }
+}
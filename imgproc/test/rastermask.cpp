@@ -24,13 +24,23 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 #include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
 
 #include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
 
 #include <boost/random/mersenne_twister.hpp>
 #include <boost/random/uniform_int_distribution.hpp>
 
+#include "imgproc/rastermask/bitfield.hpp"
 #include "imgproc/rastermask/quadtree.hpp"
+#include "imgproc/rastermask/transform.hpp"
+#include "imgproc/rastermask/linearqtree.hpp"
+#include "imgproc/rastermask/mappedqtree.hpp"
+#include "imgproc/rastermask/mappedqtree-writer.hpp"
 
 #include "dbglog/dbglog.hpp"
 
@@ -63,3 +73,479 @@ BOOST_AUTO_TEST_CASE(rastermask_quadtree_invert)
         }
     }
 }
+
+BOOST_AUTO_TEST_CASE(rastermask_quadtree_setops)
+{
+    BOOST_TEST_MESSAGE("* Testing QuadTree-based rastermask set operations.");
+
+    using imgproc::quadtree::RasterMask;
+
+    math::Size2 size(300, 200);
+
+    // prepare masks with random blocky data
+    boost::random::mt19937 gen;
+    boost::random::uniform_int_distribution<> dist(0, 3);
+    auto generate([&](RasterMask &mask)
+    {
+        for (int j(0); j < size.height; ++j) {
+            for (int i(0); i < size.width; ++i) {
+                mask.set(i, j, dist(gen) < ((i / 16 + j / 16) % 4));
+            }
+        }
+    });
+
+    RasterMask a(size, RasterMask::InitMode::EMPTY);
+    RasterMask b(size, RasterMask::InitMode::EMPTY);
+    generate(a);
+    generate(b);
+
+    RasterMask merged(a), intersected(a), subtracted(a);
+    merged.merge(b);
+    intersected.intersect(b);
+    subtracted.subtract(b);
+
+    unsigned long long count(0);
+    for (int j(0); j < size.height; ++j) {
+        for (int i(0); i < size.width; ++i) {
+            const bool va(a.get(i, j)), vb(b.get(i, j));
+            BOOST_REQUIRE(merged.get(i, j) == (va || vb));
+            BOOST_REQUIRE(intersected.get(i, j) == (va && vb));
+            BOOST_REQUIRE(subtracted.get(i, j) == (va && !vb));
+            count += va;
+        }
+    }
+    BOOST_REQUIRE_EQUAL(a.count(), count);
+
+    // rebuild mask in place, node storage is reused
+    a.reset(false);
+    BOOST_REQUIRE(a.empty());
+    generate(a);
+    a.merge(b);
+    a.subtract(b);
+    for (int j(0); j < size.height; ++j) {
+        for (int i(0); i < size.width; ++i) {
+            BOOST_REQUIRE(!a.get(i, j) || !b.get(i, j));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(rastermask_quadtree_morphology)
+{
+    BOOST_TEST_MESSAGE("* Testing QuadTree-based rastermask erode/dilate.");
+
+    using imgproc::quadtree::RasterMask;
+
+    // non power of two size, blocky data with noisy cells
+    math::Size2 size(301, 190);
+
+    RasterMask src(size, RasterMask::InitMode::EMPTY);
+    boost::random::mt19937 gen;
+    boost::random::uniform_int_distribution<> dist(0, 7);
+    for (int j(0); j < size.height; ++j) {
+        for (int i(0); i < size.width; ++i) {
+            const auto kind((i / 32 + 3 * (j / 32)) % 4);
+            src.set(i, j, (kind == 3) ? !dist(gen) : (kind & 1));
+        }
+    }
+
+    // brute force reference; outside pixels do not contribute
+    auto reference([&](int x, int y, int distance, bool white) -> bool
+    {
+        for (int j(y - distance); j <= y + distance; ++j) {
+            for (int i(x - distance); i <= x + distance; ++i) {
+                if ((i < 0) || (j < 0) || (i >= size.width)
+                    || (j >= size.height))
+                {
+                    continue;
+                }
+                if (src.get(i, j) == white) { return white; }
+            }
+        }
+        return !white;
+    });
+
+    for (int distance : { 1, 2, 5, 40 }) {
+        RasterMask dilated(src), eroded(src);
+        dilated.dilate(distance);
+        eroded.erode(distance);
+
+        unsigned long long dcount(0), ecount(0);
+        for (int j(0); j < size.height; ++j) {
+            for (int i(0); i < size.width; ++i) {
+                BOOST_REQUIRE_EQUAL(dilated.get(i, j)
+                                    , reference(i, j, distance, true));
+                BOOST_REQUIRE_EQUAL(eroded.get(i, j)
+                                    , reference(i, j, distance, false));
+                dcount += dilated.get(i, j);
+                ecount += eroded.get(i, j);
+            }
+        }
+        BOOST_REQUIRE_EQUAL(dilated.count(), dcount);
+        BOOST_REQUIRE_EQUAL(eroded.count(), ecount);
+    }
+
+    // full mask is not eroded from outside
+    RasterMask full(size, RasterMask::InitMode::FULL);
+    full.erode(3);
+    BOOST_REQUIRE(full.full());
+}
+
+BOOST_AUTO_TEST_CASE(rastermask_quadtree_transform)
+{
+    BOOST_TEST_MESSAGE("* Testing QuadTree-based rastermask transformation.");
+
+    using imgproc::quadtree::RasterMask;
+    using imgproc::quadtree::Matrix2x3;
+
+    // blobs with noisy cells
+    math::Size2 size(237, 181);
+    RasterMask src(size, RasterMask::InitMode::EMPTY);
+    boost::random::mt19937 gen;
+    boost::random::uniform_int_distribution<> dist(0, 7);
+    for (int j(0); j < size.height; ++j) {
+        for (int i(0); i < size.width; ++i) {
+            const auto kind((i / 24 + 2 * (j / 24)) % 5);
+            src.set(i, j, (kind == 4) ? bool(dist(gen)) : (kind & 1));
+        }
+    }
+
+    // brute force: all pixels in (clamped) window must be set
+    auto reference([&](const Matrix2x3 &tr, int i, int j) -> bool
+    {
+        const double kw(std::abs(tr(0, 0)) / 2.0);
+        const double kh(std::abs(tr(1, 1)) / 2.0);
+        const double px(tr(0, 0) * i + tr(0, 1) * j + tr(0, 2));
+        const double py(tr(1, 0) * i + tr(1, 1) * j + tr(1, 2));
+
+        auto clamp([](double v, int max) -> int {
+            return std::min(std::max(int(v), 0), max);
+        });
+
+        for (int y(clamp(std::floor(py - kh), size.height - 1))
+                 , ey(clamp(std::ceil(py + kh), size.height - 1));
+             y <= ey; ++y)
+        {
+            for (int x(clamp(std::floor(px - kw), size.width - 1))
+                     , ex(clamp(std::ceil(px + kw), size.width - 1));
+                 x <= ex; ++x)
+            {
+                if (!src.get(x, y)) { return false; }
+            }
+        }
+        return true;
+    });
+
+    auto trafo([](double a, double b, double c, double d, double e, double f)
+    {
+        Matrix2x3 tr(2, 3);
+        tr(0, 0) = a; tr(0, 1) = b; tr(0, 2) = c;
+        tr(1, 0) = d; tr(1, 1) = e; tr(1, 2) = f;
+        return tr;
+    });
+
+    const struct { math::Size2 size; Matrix2x3 trafo; } cases[] = {
+        { { 119, 91 }, trafo(2, 0, 0.5, 0, 2, 0.5) } // downscale
+        , { { 500, 400 }, trafo(0.45, 0, -10, 0, 0.45, 3) } // upscale
+        , { { 237, 181 }, trafo(1, 0, 0, 0, 1, 0) } // identity
+        // rotation (offsets avoid exact ties at window edges)
+        , { { 300, 300 }, trafo(0.8, -0.6, 100.137, 0.6, 0.8, -60.291) }
+        , { { 200, 150 }, trafo(-1.5, 0, 250, 0, 1.2, 0.3) } // flip
+        , { { 64, 64 }, trafo(1, 0, -500, 0, 1, 1000) } // outside
+    };
+
+    for (const auto &c : cases) {
+        const auto dst(imgproc::quadtree::transform(src, c.size, c.trafo));
+        BOOST_REQUIRE(dst.size() == c.size);
+
+        unsigned long long count(0);
+        for (int j(0); j < c.size.height; ++j) {
+            for (int i(0); i < c.size.width; ++i) {
+                BOOST_REQUIRE_EQUAL(dst.get(i, j), reference(c.trafo, i, j));
+                count += dst.get(i, j);
+            }
+        }
+        BOOST_REQUIRE_EQUAL(dst.count(), count);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(rastermask_linearqtree)
+{
+    BOOST_TEST_MESSAGE("* Testing linear QuadTree-based rastermask.");
+
+    namespace qt = imgproc::quadtree;
+    namespace lqt = imgproc::linearqtree;
+
+    math::Size2 size(300, 200);
+
+    // prepare masks with random blocky data in both representations
+    boost::random::mt19937 gen;
+    boost::random::uniform_int_distribution<> dist(0, 3);
+
+    qt::RasterMask qa(size, qt::RasterMask::EMPTY);
+    qt::RasterMask qb(size, qt::RasterMask::EMPTY);
+    lqt::RasterMask la(size, lqt::RasterMask::EMPTY);
+    for (int j(0); j < size.height; ++j) {
+        for (int i(0); i < size.width; ++i) {
+            const bool va(dist(gen) < ((i / 8 + j / 8) % 4));
+            qa.set(i, j, va);
+            la.set(i, j, va);
+            qb.set(i, j, dist(gen) < ((i / 16 + j / 4) % 4));
+        }
+    }
+
+    const lqt::RasterMask lb(qb);
+    const auto back(la.asQuadtree());
+    BOOST_REQUIRE_EQUAL(la.count(), qa.count());
+    BOOST_REQUIRE_EQUAL(lb.count(), qb.count());
+    BOOST_REQUIRE_EQUAL(back.count(), qa.count());
+
+    lqt::RasterMask merged(la), intersected(la), subtracted(la);
+    merged.merge(lb);
+    intersected.intersect(lb);
+    subtracted.subtract(lb);
+
+    for (int j(0); j < size.height; ++j) {
+        for (int i(0); i < size.width; ++i) {
+            const bool va(qa.get(i, j)), vb(qb.get(i, j));
+            BOOST_REQUIRE(la.get(i, j) == va);
+            BOOST_REQUIRE(lb.get(i, j) == vb);
+            BOOST_REQUIRE(back.get(i, j) == va);
+            BOOST_REQUIRE(merged.get(i, j) == (va || vb));
+            BOOST_REQUIRE(intersected.get(i, j) == (va && vb));
+            BOOST_REQUIRE(subtracted.get(i, j) == (va && !vb));
+        }
+    }
+
+    // same tree built by set() and by conversion
+    BOOST_REQUIRE_EQUAL(lqt::RasterMask(qa).nodeCount(), la.nodeCount());
+}
+
+BOOST_AUTO_TEST_CASE(rastermask_mappedqtree_get)
+{
+    BOOST_TEST_MESSAGE("* Testing mapped QuadTree-based rastermask queries.");
+
+    namespace qt = imgproc::quadtree;
+    namespace mqt = imgproc::mappedqtree;
+    namespace fs = boost::filesystem;
+
+    math::Size2 size(300, 200);
+
+    boost::random::mt19937 gen;
+    boost::random::uniform_int_distribution<> dist(0, 3);
+    qt::RasterMask src(size, qt::RasterMask::EMPTY);
+    for (int j(0); j < size.height; ++j) {
+        for (int i(0); i < size.width; ++i) {
+            src.set(i, j, dist(gen) < ((i / 8 + j / 8) % 4));
+        }
+    }
+
+    const auto path(fs::temp_directory_path() / fs::unique_path());
+
+    // without and with index
+    for (unsigned int indexDepth : { 0, 4 }) {
+        {
+            std::ofstream f(path.string(), std::ios::binary);
+            mqt::RasterMask::write(f, src, 0, 0, 0, indexDepth);
+        }
+
+        mqt::RasterMask mask(path);
+        BOOST_REQUIRE_EQUAL(mask.indexDepth(), indexDepth);
+
+        for (int j(-1); j <= mask.size().height; ++j) {
+            for (int i(-1); i <= mask.size().width; ++i) {
+                BOOST_REQUIRE(mask.get(i, j) == src.get(i, j));
+            }
+        }
+
+        // quads reported by full walk must match point queries
+        mask.forEachQuad([&](const mqt::RasterMask::Node &node
+                             , boost::tribool value)
+        {
+            const auto q(mask.getQuad(node.depth, node.x >> (mask.depth()
+                                                             - node.depth)
+                                      , node.y >> (mask.depth()
+                                                   - node.depth)));
+            if (boost::indeterminate(value)) {
+                BOOST_REQUIRE(boost::indeterminate(q));
+            } else {
+                BOOST_REQUIRE(!boost::indeterminate(q));
+                BOOST_REQUIRE(bool(q) == bool(value));
+            }
+        }, mqt::RasterMask::Constraints(5));
+    }
+
+    fs::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(rastermask_mappedqtree_writer)
+{
+    BOOST_TEST_MESSAGE("* Testing mapped QuadTree-based rastermask "
+                       "tiled writer.");
+
+    namespace qt = imgproc::quadtree;
+    namespace mqt = imgproc::mappedqtree;
+    namespace fs = boost::filesystem;
+
+    math::Size2 size(256, 256);
+
+    boost::random::mt19937 gen;
+    boost::random::uniform_int_distribution<> dist(0, 3);
+    qt::RasterMask src(size, qt::RasterMask::EMPTY);
+    for (int j(0); j < size.height; ++j) {
+        for (int i(0); i < size.width; ++i) {
+            src.set(i, j, dist(gen) < ((i / 8 + j / 8) % 4));
+        }
+    }
+
+    const auto path(fs::temp_directory_path() / fs::unique_path());
+    auto load([&]() -> std::string
+    {
+        std::ifstream f(path.string(), std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(f), {});
+    });
+
+    // reference: whole tree writer
+    {
+        std::ofstream f(path.string(), std::ios::binary);
+        mqt::RasterMask::write(f, src, 0, 0, 0, 2);
+    }
+    const auto reference(load());
+
+    // tiles at depth 3 stitched into single tree
+    {
+        const unsigned int tileDepth(3);
+        const math::Size2 tileSize(size.width >> tileDepth
+                                   , size.height >> tileDepth);
+
+        std::ofstream f(path.string(), std::ios::binary);
+        mqt::writeTiled(f, src.depth(), tileDepth
+                        , [&](unsigned int x, unsigned int y)
+        {
+            return mqt::RasterMask::serialize
+                (src.subTree(tileSize, tileDepth, x, y));
+        }, 2, 5);
+    }
+
+    BOOST_REQUIRE(load() == reference);
+
+    mqt::RasterMask mask(path);
+    for (int j(0); j < size.height; ++j) {
+        for (int i(0); i < size.width; ++i) {
+            BOOST_REQUIRE(mask.get(i, j) == src.get(i, j));
+        }
+    }
+
+    fs::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(rastermask_bitfield_setops)
+{
+    BOOST_TEST_MESSAGE("* Testing bitfield rastermask set operations.");
+
+    using imgproc::bitfield::RasterMask;
+
+    // odd width: exercises row padding
+    math::Size2 size(301, 97);
+
+    RasterMask a(size, RasterMask::EMPTY);
+    RasterMask b(size, RasterMask::EMPTY);
+    boost::random::mt19937 gen;
+    boost::random::uniform_int_distribution<> dist(0, 1);
+    for (int j(0); j < size.height; ++j) {
+        for (int i(0); i < size.width; ++i) {
+            a.set(i, j, dist(gen));
+            b.set(i, j, dist(gen));
+        }
+    }
+
+    auto check([&](const RasterMask &m, const char *what
+                   , bool (*op)(bool, bool))
+    {
+        BOOST_TEST_MESSAGE("    " << what);
+        std::size_t count(0);
+        for (int j(0); j < size.height; ++j) {
+            for (int i(0); i < size.width; ++i) {
+                const bool value(op(a.get(i, j), b.get(i, j)));
+                BOOST_REQUIRE_EQUAL(m.get(i, j), value);
+                count += value;
+            }
+        }
+        BOOST_REQUIRE_EQUAL(m.size(), count);
+    });
+
+    RasterMask m(a);
+    m.merge(b);
+    check(m, "merge", [](bool x, bool y) { return x || y; });
+
+    m = a;
+    m.intersect(b);
+    check(m, "intersect", [](bool x, bool y) { return x && y; });
+
+    m = a;
+    m.subtract(b);
+    check(m, "subtract", [](bool x, bool y) { return x && !y; });
+
+    m = a;
+    m.symmetricDifference(b);
+    check(m, "xor", [](bool x, bool y) { return x != y; });
+
+    m = a;
+    m.invert();
+    check(m, "invert", [](bool x, bool) { return !x; });
+
+    // round trip through packed serialization
+    std::stringstream ss;
+    a.dump(ss);
+    m.load(ss);
+    check(m, "load", [](bool x, bool) { return x; });
+
+    // cannot combine masks of different sizes
+    RasterMask other(size.width + 1, size.height, RasterMask::FULL);
+    BOOST_CHECK_THROW(m.merge(other), std::logic_error);
+}
+
+BOOST_AUTO_TEST_CASE(rastermask_bitfield_quadtree)
+{
+    BOOST_TEST_MESSAGE("* Testing bitfield <-> quadtree conversion.");
+
+    namespace bf = imgproc::bitfield;
+    namespace qt = imgproc::quadtree;
+
+    // non power of two size, blocky data with noisy cells
+    math::Size2 size(333, 170);
+
+    bf::RasterMask src(size, bf::RasterMask::EMPTY);
+    boost::random::mt19937 gen;
+    boost::random::uniform_int_distribution<> dist(0, 3);
+    for (int cy(0); cy < size.height; cy += 16) {
+        for (int cx(0); cx < size.width; cx += 16) {
+            const auto kind(dist(gen));
+            for (int j(cy); j < std::min(cy + 16, size.height); ++j) {
+                for (int i(cx); i < std::min(cx + 16, size.width); ++i) {
+                    src.set(i, j, (kind == 3) ? (dist(gen) & 1) : (kind & 1));
+                }
+            }
+        }
+    }
+
+    const qt::RasterMask tree(src);
+    BOOST_REQUIRE_EQUAL(tree.count(), src.size());
+    for (int j(0); j < size.height; ++j) {
+        for (int i(0); i < size.width; ++i) {
+            BOOST_REQUIRE_EQUAL(tree.get(i, j), src.get(i, j));
+        }
+    }
+
+    const auto dst(tree.asBitfield());
+    BOOST_REQUIRE_EQUAL(dst.size(), src.size());
+    for (int j(0); j < size.height; ++j) {
+        for (int i(0); i < size.width; ++i) {
+            BOOST_REQUIRE_EQUAL(dst.get(i, j), src.get(i, j));
+        }
+    }
+
+    // uniform masks collapse into single node
+    const qt::RasterMask full(bf::RasterMask(size, bf::RasterMask::FULL));
+    BOOST_REQUIRE(full.full());
+    BOOST_REQUIRE_EQUAL(full.asBitfield().size(), full.count());
+}
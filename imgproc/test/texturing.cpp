@@ -0,0 +1,225 @@
+/**
+ * Copyright (c) 2021 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int_distribution.hpp>
+#include <boost/random/uniform_real_distribution.hpp>
+
+#include <opencv2/core/core.hpp>
+
+#include "imgproc/texturing.hpp"
+#include "imgproc/texturing-atlas.hpp"
+
+#include "dbglog/dbglog.hpp"
+
+namespace {
+
+namespace tx = imgproc::tx;
+
+/** Checks that all patches lie inside the atlas and do not overlap.
+ */
+void checkPacking(const std::vector<tx::Patch> &patches
+                  , const math::Size2 &size)
+{
+    std::vector<unsigned char> used(math::area(size));
+    for (const auto &patch : patches) {
+        const auto &dst(patch.dst());
+        BOOST_REQUIRE(dst.point(0) >= 0);
+        BOOST_REQUIRE(dst.point(1) >= 0);
+        BOOST_REQUIRE(dst.point(0) + dst.size.width <= size.width);
+        BOOST_REQUIRE(dst.point(1) + dst.size.height <= size.height);
+
+        for (int j(0); j < dst.size.height; ++j) {
+            auto *row(&used[(dst.point(1) + j) * size.width + dst.point(0)]);
+            for (int i(0); i < dst.size.width; ++i) {
+                BOOST_REQUIRE(!row[i]);
+                row[i] = 1;
+            }
+        }
+    }
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(texturing_pack)
+{
+    BOOST_TEST_MESSAGE("* Testing texture patch packing.");
+
+    boost::random::mt19937 gen(5);
+    boost::random::uniform_int_distribution<> small(1, 20);
+    boost::random::uniform_int_distribution<> large(1, 300);
+
+    for (const auto &options
+             : { tx::PackOptions(2.f, boost::none
+                                 , tx::PackAlgorithm::guillotine)
+                 , tx::PackOptions(2.f, boost::none
+                                   , tx::PackAlgorithm::skyline)
+                 , tx::PackOptions(2.f, boost::none
+                                   , tx::PackAlgorithm::guillotine, true) })
+    {
+        for (int count : { 1, 10, 500, 3000 }) {
+            std::vector<tx::Patch> patches;
+            for (int i(0); i < count; ++i) {
+                auto &dist((i % 10) ? small : large);
+                patches.emplace_back(i, -i, dist(gen), dist(gen));
+            }
+
+            tx::Patch::list list;
+            for (auto &patch : patches) { list.push_back(&patch); }
+            const auto size(tx::pack(list, options));
+            checkPacking(patches, size);
+
+            // patches must keep their source rectangles
+            for (int i(0); i < count; ++i) {
+                BOOST_CHECK_EQUAL(patches[i].src().point(0), i);
+                BOOST_CHECK_EQUAL(patches[i].src().point(1), -i);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(texturing_atlas)
+{
+    BOOST_TEST_MESSAGE("* Testing texture atlas composition.");
+
+    typedef cv::Vec<unsigned char, 3> Pixel;
+
+    boost::random::mt19937 gen(7);
+    boost::random::uniform_int_distribution<> value(0, 255);
+    boost::random::uniform_int_distribution<> extent(1, 40);
+
+    std::vector<cv::Mat> sources;
+    for (const auto &size : { math::Size2(97, 61), math::Size2(16, 130) }) {
+        sources.emplace_back(size.height, size.width, CV_8UC3);
+        auto &source(sources.back());
+        for (int j(0); j < source.rows; ++j) {
+            for (int i(0); i < source.cols; ++i) {
+                for (int c(0); c < 3; ++c) {
+                    source.at<Pixel>(j, i)[c] = value(gen);
+                }
+            }
+        }
+    }
+
+    // patches partially (or completely) outside their source, some of them
+    // clipped beforehand
+    std::vector<tx::Patch> patches;
+    std::vector<int> sourceIndex;
+    for (int i(0); i < 400; ++i) {
+        const auto &source(sources[i % 2]);
+        boost::random::uniform_int_distribution<> x(-20, source.cols + 5);
+        boost::random::uniform_int_distribution<> y(-20, source.rows + 5);
+        patches.emplace_back(x(gen), y(gen), extent(gen), extent(gen));
+        if (!(i % 7)) { patches.back().srcClip(source.cols, source.rows); }
+        sourceIndex.push_back(i % 2);
+    }
+
+    std::vector<tx::Patch::list> lists(sources.size());
+    for (std::size_t i(0); i < patches.size(); ++i) {
+        lists[sourceIndex[i]].push_back(&patches[i]);
+    }
+
+    const cv::Scalar background(1, 2, 3);
+    const auto atlas(tx::atlas(sources, lists, tx::PackOptions()
+                               , background));
+    const math::Size2 size(atlas.cols, atlas.rows);
+    checkPacking(patches, size);
+
+    std::vector<unsigned char> used(math::area(size));
+    for (std::size_t p(0); p < patches.size(); ++p) {
+        const auto &source(sources[sourceIndex[p]]);
+        const auto &src(patches[p].src());
+        const auto &dst(patches[p].dst());
+        for (int j(0); j < dst.size.height; ++j) {
+            const int sy(std::min(std::max(src.point(1) + j, 0)
+                                  , source.rows - 1));
+            for (int i(0); i < dst.size.width; ++i) {
+                const int sx(std::min(std::max(src.point(0) + i, 0)
+                                      , source.cols - 1));
+                const int x(dst.point(0) + i), y(dst.point(1) + j);
+                used[y * size.width + x] = 1;
+                for (int c(0); c < 3; ++c) {
+                    BOOST_REQUIRE_EQUAL
+                        (int(atlas.at<Pixel>(y, x)[c])
+                         , int(source.at<Pixel>(sy, sx)[c]));
+                }
+            }
+        }
+    }
+
+    for (int y(0); y < size.height; ++y) {
+        for (int x(0); x < size.width; ++x) {
+            if (used[y * size.width + x]) { continue; }
+            for (int c(0); c < 3; ++c) {
+                BOOST_REQUIRE_EQUAL(int(atlas.at<Pixel>(y, x)[c])
+                                    , int(background[c]));
+            }
+        }
+    }
+
+    // bulk mapping must match per-point mapping
+    tx::Patch::list list;
+    for (auto &patch : patches) { list.push_back(&patch); }
+
+    boost::random::uniform_int_distribution<> patch(0, patches.size() - 1);
+    boost::random::uniform_real_distribution<> coord(-50.0, 150.0);
+    std::vector<int> index;
+    std::vector<double> uv;
+    for (int i(0); i < 1000; ++i) {
+        index.push_back(patch(gen));
+        uv.push_back(coord(gen));
+        uv.push_back(coord(gen));
+    }
+
+    auto mapped(uv);
+    tx::map(list, index.data(), mapped.data(), index.size());
+    for (std::size_t i(0); i < index.size(); ++i) {
+        const auto expect(patches[index[i]].map
+                          (math::Point2d(uv[2 * i], uv[2 * i + 1])));
+        BOOST_CHECK_EQUAL(mapped[2 * i], expect(0));
+        BOOST_CHECK_EQUAL(mapped[2 * i + 1], expect(1));
+    }
+
+    // single patch bulk mapping
+    const auto &front(patches.front());
+    mapped = uv;
+    front.map(mapped.data(), index.size());
+    auto unmapped(mapped);
+    front.imap(unmapped.data(), index.size());
+    for (std::size_t i(0); i < index.size(); ++i) {
+        const math::Point2d point(uv[2 * i], uv[2 * i + 1]);
+        const auto expect(front.map(point));
+        BOOST_CHECK_EQUAL(mapped[2 * i], expect(0));
+        BOOST_CHECK_EQUAL(mapped[2 * i + 1], expect(1));
+
+        const auto back(front.imap(expect));
+        BOOST_CHECK_EQUAL(unmapped[2 * i], back(0));
+        BOOST_CHECK_EQUAL(unmapped[2 * i + 1], back(1));
+    }
+}
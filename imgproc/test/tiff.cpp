@@ -0,0 +1,253 @@
+/**
+ * Copyright (c) 2021 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <cstdio>
+#include <vector>
+#include <fstream>
+#include <iterator>
+
+#include <boost/test/unit_test.hpp>
+
+#include <boost/filesystem.hpp>
+
+#include <tiffio.h>
+
+#include <opencv2/core/core.hpp>
+
+#include "imgproc/tiff.hpp"
+
+#include "dbglog/dbglog.hpp"
+
+namespace fs = boost::filesystem;
+
+namespace {
+
+struct Config {
+    int width;
+    int height;
+    std::uint16_t bpp;
+    std::uint16_t spp;
+    std::uint16_t photometric;
+    std::uint16_t planar;
+    std::uint16_t compression;
+    bool tiled;
+};
+
+/** Stored sample value.
+ */
+int sample(int x, int y, int c, int bpp)
+{
+    const int value((x * 7 + y * 13 + c * 101) % 251);
+    return (bpp == 16) ? (value * 257 + c) : value;
+}
+
+/** Writes test TIFF file.
+ */
+void write(const fs::path &path, const Config &config
+           , std::uint16_t orientation)
+{
+    auto *tiff(TIFFOpen(path.string().c_str(), "w"));
+    BOOST_REQUIRE(tiff);
+
+    TIFFSetField(tiff, TIFFTAG_IMAGEWIDTH, std::uint32_t(config.width));
+    TIFFSetField(tiff, TIFFTAG_IMAGELENGTH, std::uint32_t(config.height));
+    TIFFSetField(tiff, TIFFTAG_BITSPERSAMPLE, config.bpp);
+    TIFFSetField(tiff, TIFFTAG_SAMPLESPERPIXEL, config.spp);
+    TIFFSetField(tiff, TIFFTAG_PHOTOMETRIC, config.photometric);
+    TIFFSetField(tiff, TIFFTAG_PLANARCONFIG, config.planar);
+    TIFFSetField(tiff, TIFFTAG_COMPRESSION, config.compression);
+    TIFFSetField(tiff, TIFFTAG_ORIENTATION, orientation);
+    if (config.spp == 4) {
+        std::uint16_t extra(2); // unassociated alpha
+        TIFFSetField(tiff, TIFFTAG_EXTRASAMPLES, 1, &extra);
+    }
+
+    const int bw(config.tiled ? 32 : config.width);
+    const int bh(config.tiled ? 16 : 5);
+    if (config.tiled) {
+        TIFFSetField(tiff, TIFFTAG_TILEWIDTH, std::uint32_t(bw));
+        TIFFSetField(tiff, TIFFTAG_TILELENGTH, std::uint32_t(bh));
+    } else {
+        TIFFSetField(tiff, TIFFTAG_ROWSPERSTRIP, std::uint32_t(bh));
+    }
+
+    const bool separate(config.planar == PLANARCONFIG_SEPARATE);
+    const int planes(separate ? config.spp : 1);
+    const int spp(separate ? 1 : config.spp);
+    const int bytes(config.bpp / 8);
+
+    std::uint32_t block(0);
+    for (int plane(0); plane < planes; ++plane) {
+        for (int by(0); by < config.height; by += bh) {
+            for (int bx(0); bx < config.width; bx += bw) {
+                const int rows(config.tiled
+                               ? bh : std::min(bh, config.height - by));
+                std::vector<unsigned char> data(bw * rows * spp * bytes);
+                for (int j(0); j < rows; ++j) {
+                    for (int i(0); i < bw; ++i) {
+                        for (int c(0); c < spp; ++c) {
+                            const int x(bx + i), y(by + j);
+                            const int v(((x < config.width)
+                                         && (y < config.height))
+                                        ? sample(x, y, plane + c, config.bpp)
+                                        : 0);
+                            const auto index((j * bw + i) * spp + c);
+                            if (bytes == 1) {
+                                data[index] = v;
+                            } else {
+                                reinterpret_cast<std::uint16_t*>
+                                    (data.data())[index] = v;
+                            }
+                        }
+                    }
+                }
+
+                const auto result(config.tiled
+                                  ? TIFFWriteEncodedTile
+                                  (tiff, block, data.data(), data.size())
+                                  : TIFFWriteEncodedStrip
+                                  (tiff, block, data.data(), data.size()));
+                BOOST_REQUIRE(result >= 0);
+                ++block;
+            }
+        }
+    }
+
+    TIFFClose(tiff);
+}
+
+/** Returns output position of stored pixel (x, y).
+ */
+cv::Point2i oriented(int x, int y, const Config &config
+                     , std::uint16_t orientation)
+{
+    const int w(config.width - 1), h(config.height - 1);
+    switch (orientation) {
+    case ORIENTATION_TOPRIGHT: return { w - x, y };
+    case ORIENTATION_BOTRIGHT: return { w - x, h - y };
+    case ORIENTATION_BOTLEFT: return { x, h - y };
+    case ORIENTATION_LEFTTOP: return { y, x };
+    case ORIENTATION_RIGHTTOP: return { h - y, x };
+    case ORIENTATION_RIGHTBOT: return { h - y, w - x };
+    case ORIENTATION_LEFTBOT: return { y, w - x };
+    }
+    return { x, y };
+}
+
+template <typename T>
+void check(const cv::Mat &image, const Config &config
+           , std::uint16_t orientation)
+{
+    const bool transposed(orientation > ORIENTATION_BOTLEFT);
+    BOOST_REQUIRE_EQUAL(image.cols
+                        , transposed ? config.height : config.width);
+    BOOST_REQUIRE_EQUAL(image.rows
+                        , transposed ? config.width : config.height);
+
+    // RGBA interface decodes to 8 bits per sample
+    const int shift((config.bpp == 8) ? 0 : 8);
+    const bool gray(config.spp == 1);
+
+    for (int y(0); y < config.height; ++y) {
+        for (int x(0); x < config.width; ++x) {
+            const auto p(oriented(x, y, config, orientation));
+            const auto *px(image.ptr<T>(p.y) + 3 * p.x);
+            for (int c(0); c < 3; ++c) {
+                int value(sample(x, y, gray ? 0 : c, config.bpp));
+                if (sizeof(T) == 1) { value >>= shift; }
+                if (config.photometric == PHOTOMETRIC_MINISWHITE) {
+                    value = ((sizeof(T) == 1) ? 0xff : 0xffff) - value;
+                }
+                // BGR output
+                BOOST_REQUIRE_EQUAL(int(px[2 - c]), value);
+            }
+        }
+    }
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(tiff_read)
+{
+    BOOST_TEST_MESSAGE("* Testing TIFF reader.");
+
+    const auto path(fs::temp_directory_path()
+                    / fs::unique_path("imgproc-test-%%%%-%%%%.tif"));
+
+    const Config configs[] = {
+        { 75, 43, 8, 3, PHOTOMETRIC_RGB, PLANARCONFIG_CONTIG
+          , COMPRESSION_NONE, false }
+        , { 75, 43, 8, 3, PHOTOMETRIC_RGB, PLANARCONFIG_CONTIG
+            , COMPRESSION_LZW, true }
+        , { 70, 33, 16, 3, PHOTOMETRIC_RGB, PLANARCONFIG_CONTIG
+            , COMPRESSION_ADOBE_DEFLATE, true }
+        , { 64, 31, 16, 4, PHOTOMETRIC_RGB, PLANARCONFIG_CONTIG
+            , COMPRESSION_NONE, false }
+        , { 40, 50, 8, 1, PHOTOMETRIC_MINISBLACK, PLANARCONFIG_CONTIG
+            , COMPRESSION_LZW, true }
+        , { 41, 17, 16, 1, PHOTOMETRIC_MINISWHITE, PLANARCONFIG_CONTIG
+            , COMPRESSION_NONE, false }
+        // decoded via RGBA interface
+        , { 37, 29, 8, 3, PHOTOMETRIC_RGB, PLANARCONFIG_SEPARATE
+            , COMPRESSION_NONE, false }
+        , { 37, 29, 8, 3, PHOTOMETRIC_RGB, PLANARCONFIG_SEPARATE
+            , COMPRESSION_NONE, true }
+    };
+
+    for (const auto &config : configs) {
+        for (std::uint16_t orientation(ORIENTATION_TOPLEFT);
+             orientation <= ORIENTATION_LEFTBOT; ++orientation)
+        {
+            write(path, config, orientation);
+
+            std::ifstream f(path.string(), std::ios::binary);
+            const std::vector<char> data
+                ((std::istreambuf_iterator<char>(f))
+                 , std::istreambuf_iterator<char>());
+            f.close();
+
+            const auto fromFile(imgproc::readTiff(path));
+            const auto fromMemory(imgproc::readTiff(data.data()
+                                                    , data.size()));
+            const bool rgba(config.planar == PLANARCONFIG_SEPARATE);
+
+            if ((config.bpp == 8) || rgba) {
+                BOOST_REQUIRE_EQUAL(fromFile.type(), CV_8UC3);
+                check<std::uint8_t>(fromFile, config, orientation);
+                check<std::uint8_t>(fromMemory, config, orientation);
+            } else {
+                BOOST_REQUIRE_EQUAL(fromFile.type(), CV_16UC3);
+                check<std::uint16_t>(fromFile, config, orientation);
+                check<std::uint16_t>(fromMemory, config, orientation);
+            }
+
+            const auto size(imgproc::tiffSize(path));
+            BOOST_CHECK_EQUAL(size.width, fromFile.cols);
+            BOOST_CHECK_EQUAL(size.height, fromFile.rows);
+        }
+    }
+
+    fs::remove(path);
+}
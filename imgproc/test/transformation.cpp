@@ -0,0 +1,226 @@
+/**
+ * Copyright (c) 2021 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <cmath>
+
+#ifdef _OPENMP
+#  include <omp.h>
+#endif
+
+#include <boost/test/unit_test.hpp>
+
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int_distribution.hpp>
+
+#include "imgproc/transformation.hpp"
+
+#include "dbglog/dbglog.hpp"
+
+namespace {
+
+/** Fills image with blocky noise.
+ */
+template <typename Image>
+void generate(Image &image, unsigned int seed)
+{
+    boost::random::mt19937 gen(seed);
+    boost::random::uniform_int_distribution<> noise(0, 39);
+
+    const auto v(gil::view(image));
+    const int channels(gil::num_channels<typename Image::view_t>::value);
+    for (int y(0); y < v.height(); ++y) {
+        for (int x(0); x < v.width(); ++x) {
+            for (int c(0); c < channels; ++c) {
+                v(x, y)[c] = ((x / 7 + y / 5 + c) % 3) * 80 + noise(gen);
+            }
+        }
+    }
+}
+
+/** Transforms image using both per-pixel reconstruction and separable path
+ *  and returns maximum channel difference.
+ */
+template <typename Image, typename Mapping2>
+double compare(const Image &src, const math::Size2 &size
+               , const Mapping2 &mapping)
+{
+    Image a(size.width, size.height), b(size.width, size.height);
+
+    imgproc::detail::transform<imgproc::DefaultFilter>
+        (mapping, gil::const_view(src), gil::view(a), std::false_type()
+         , imgproc::ExecutionPolicy::sequential);
+    imgproc::transform(mapping, gil::const_view(src), gil::view(b));
+
+    const auto va(gil::view(a)), vb(gil::view(b));
+    const int channels(gil::num_channels<typename Image::view_t>::value);
+    double diff(0.0);
+    for (int y(0); y < size.height; ++y) {
+        for (int x(0); x < size.width; ++x) {
+            for (int c(0); c < channels; ++c) {
+                diff = std::max(diff, std::abs(double(va(x, y)[c])
+                                               - double(vb(x, y)[c])));
+            }
+        }
+    }
+    return diff;
+}
+
+/** Returns true if both images are identical.
+ */
+template <typename Image>
+bool identical(const Image &a, const Image &b)
+{
+    return gil::equal_pixels(gil::const_view(a), gil::const_view(b));
+}
+
+/** Non-linear mapping (smooth distortion).
+ */
+struct Distortion {
+    math::Point2 map(const math::Point2i &op) const {
+        const double x(op(0)), y(op(1));
+        return math::Point2(0.9 * x + 0.0004 * y * y + 3.0
+                            , 1.1 * y + 5.0 * std::sin(x * 0.02) - 2.0);
+    }
+
+    math::Point2 derivatives(const math::Point2i &op) const {
+        return math::Point2(0.9, 1.1 + 0.1 * std::cos(op(0) * 0.02));
+    }
+};
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(transformation_separable)
+{
+    BOOST_TEST_MESSAGE("* Testing separable resampling.");
+
+    gil::rgb8_image_t rgb(400, 300);
+    generate(rgb, 1);
+
+    gil::gray16_image_t gray(333, 217);
+    generate(gray, 2);
+
+    // uint8 results may differ by one due to single precision accumulation
+    BOOST_CHECK_LE(compare(rgb, math::Size2(100, 75)
+                           , imgproc::Scaling2(math::Size2(100, 75)
+                                               , math::Size2(400, 300)))
+                   , 1.0);
+
+    BOOST_CHECK_LE(compare(rgb, math::Size2(613, 421)
+                           , imgproc::Scaling2(math::Size2(613, 421)
+                                               , math::Size2(400, 300)))
+                   , 1.0);
+
+    BOOST_CHECK_LE(compare(gray, math::Size2(129, 64)
+                           , imgproc::GridScaling2(math::Size2(333, 217)
+                                                   , math::Size2(129, 64)))
+                   , 1.0);
+
+    // crop reaching outside of source
+    BOOST_CHECK_LE(compare(rgb, math::Size2(128, 128)
+                           , imgproc::ReverseCroppingAndScaling2
+                           (imgproc::Crop2_<int>(300, 200, -50, 250)
+                            , math::Size2(128, 128)))
+                   , 1.0);
+}
+
+BOOST_AUTO_TEST_CASE(transformation_approximated)
+{
+    BOOST_TEST_MESSAGE("* Testing grid-approximated mapping.");
+
+    const Distortion distortion;
+    const math::Size2 size(301, 203);
+
+    for (const double tolerance : { 0.5, 0.05, 0.001 }) {
+        const auto approx(imgproc::approximate(distortion, size, tolerance));
+
+        for (int y(0); y < size.height; ++y) {
+            for (int x(0); x < size.width; ++x) {
+                const math::Point2i p(x, y);
+                const auto exact(distortion.map(p));
+                const auto value(approx.map(p));
+                BOOST_REQUIRE_SMALL(exact(0) - value(0), 2.0 * tolerance);
+                BOOST_REQUIRE_SMALL(exact(1) - value(1), 2.0 * tolerance);
+            }
+        }
+
+        BOOST_TEST_MESSAGE("tolerance " << tolerance << ": "
+                           << approx.evaluations() << " evaluations");
+    }
+
+    // coarse tolerance must be much cheaper than per-pixel evaluation
+    BOOST_CHECK_LT(imgproc::approximate(distortion, size, 0.5).evaluations()
+                   , std::size_t(math::area(size) / 20));
+}
+
+BOOST_AUTO_TEST_CASE(transformation_parallel)
+{
+    BOOST_TEST_MESSAGE("* Testing parallel transformation.");
+
+#ifdef _OPENMP
+    // force multiple threads even on a single core machine
+    const int threads(omp_get_max_threads());
+    omp_set_num_threads(4);
+#endif
+
+    gil::rgb8_image_t src(400, 300);
+    generate(src, 3);
+
+    const auto sequential(imgproc::ExecutionPolicy::sequential);
+    const auto parallel(imgproc::ExecutionPolicy::parallel);
+
+    // per-pixel path (non axis-aligned mapping)
+    {
+        const math::Size2 size(351, 277);
+        gil::rgb8_image_t a(size.width, size.height);
+        gil::rgb8_image_t b(size.width, size.height);
+        imgproc::transform(Distortion(), gil::const_view(src), gil::view(a)
+                           , sequential);
+        imgproc::transform(Distortion(), gil::const_view(src), gil::view(b)
+                           , parallel);
+        BOOST_CHECK(identical(a, b));
+    }
+
+    // separable path
+    {
+        gil::rgb8_image_t a(613, 421), b(613, 421);
+        imgproc::scale(gil::const_view(src), gil::view(a), sequential);
+        imgproc::scale(gil::const_view(src), gil::view(b), parallel);
+        BOOST_CHECK(identical(a, b));
+    }
+
+    {
+        const imgproc::Crop2_<int> crop(300, 200, -50, 150);
+        gil::rgb8_image_t a(257, 190), b(257, 190);
+        imgproc::cropAndScale(gil::const_view(src), gil::view(a), crop
+                              , sequential);
+        imgproc::cropAndScale(gil::const_view(src), gil::view(b), crop
+                              , parallel);
+        BOOST_CHECK(identical(a, b));
+    }
+
+#ifdef _OPENMP
+    omp_set_num_threads(threads);
+#endif
+}
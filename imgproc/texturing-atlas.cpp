@@ -0,0 +1,187 @@
+/**
+ * Copyright (c) 2021 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file texturing-atlas.cpp
+ *
+ * Texture atlas composition.
+ */
+
+#include <cstring>
+#include <algorithm>
+
+#include "dbglog/dbglog.hpp"
+
+#include "utility/openmp.hpp"
+
+#include "error.hpp"
+#include "texturing-atlas.hpp"
+
+namespace imgproc { namespace tx {
+
+namespace {
+
+struct Job {
+    const cv::Mat *source;
+    const Patch *patch;
+
+    Job(const cv::Mat &source, const Patch &patch)
+        : source(&source), patch(&patch)
+    {}
+
+    typedef std::vector<Job> list;
+};
+
+/** Collects non-empty patches and checks their validity.
+ */
+void collect(Job::list &jobs, const cv::Mat &atlas, const cv::Mat &source
+             , const Patch::list &patches)
+{
+    if (patches.empty()) { return; }
+
+    if (source.empty()) {
+        LOGTHROW(err1, Error)
+            << "Cannot compose atlas from empty source texture.";
+    }
+
+    if (source.type() != atlas.type()) {
+        LOGTHROW(err1, TypeError)
+            << "Source texture type (" << source.type()
+            << ") differs from atlas type (" << atlas.type() << ").";
+    }
+
+    for (const auto *patch : patches) {
+        const auto &dst(patch->dst());
+        if ((dst.size.width <= 0) || (dst.size.height <= 0)) { continue; }
+
+        if ((dst.point(0) < 0) || (dst.point(1) < 0)
+            || ((dst.point(0) + dst.size.width) > atlas.cols)
+            || ((dst.point(1) + dst.size.height) > atlas.rows))
+        {
+            LOGTHROW(err1, Error)
+                << "Patch destination " << dst.size << " at ("
+                << dst.point(0) << ", " << dst.point(1)
+                << ") lies outside atlas " << atlas.cols << "x"
+                << atlas.rows << ".";
+        }
+
+        jobs.emplace_back(source, *patch);
+    }
+}
+
+/** Copies one patch, source pixels are clamped to the source image.
+ */
+void copy(cv::Mat &atlas, const cv::Mat &source, const Patch &patch)
+{
+    const auto &src(patch.src());
+    const auto &dst(patch.dst());
+    const std::size_t pixel(source.elemSize());
+    const int width(dst.size.width);
+
+    // destination columns [0, left) lie left of source, columns
+    // [right, width) lie right of source
+    const int left(std::min(std::max(-src.point(0), 0), width));
+    const int right(std::min(std::max(source.cols - src.point(0), left)
+                             , width));
+
+    for (int j(0); j < dst.size.height; ++j) {
+        const int sy(std::min(std::max(src.point(1) + j, 0)
+                              , source.rows - 1));
+        const auto *s(source.ptr<uchar>(sy));
+        auto *d(atlas.ptr<uchar>(dst.point(1) + j) + dst.point(0) * pixel);
+
+        for (int i(0); i < left; ++i, d += pixel) {
+            std::memcpy(d, s, pixel);
+        }
+
+        const std::size_t size((right - left) * pixel);
+        std::memcpy(d, s + (src.point(0) + left) * pixel, size);
+        d += size;
+
+        const auto *last(s + (source.cols - 1) * pixel);
+        for (int i(right); i < width; ++i, d += pixel) {
+            std::memcpy(d, last, pixel);
+        }
+    }
+}
+
+void compose(cv::Mat &atlas, const Job::list &jobs)
+{
+    UTILITY_OMP(parallel for schedule(dynamic, 16))
+    for (std::size_t i = 0; i < jobs.size(); ++i) {
+        const auto &job(jobs[i]);
+        copy(atlas, *job.source, *job.patch);
+    }
+}
+
+} // namespace
+
+void compose(cv::Mat &atlas, const cv::Mat &source
+             , const Patch::list &patches)
+{
+    Job::list jobs;
+    collect(jobs, atlas, source, patches);
+    compose(atlas, jobs);
+}
+
+void compose(cv::Mat &atlas, const std::vector<cv::Mat> &sources
+             , const std::vector<Patch::list> &patches)
+{
+    if (sources.size() != patches.size()) {
+        LOGTHROW(err1, Error)
+            << "Number of source textures (" << sources.size()
+            << ") differs from number of patch lists (" << patches.size()
+            << ").";
+    }
+
+    Job::list jobs;
+    for (std::size_t i(0), e(sources.size()); i != e; ++i) {
+        collect(jobs, atlas, sources[i], patches[i]);
+    }
+    compose(atlas, jobs);
+}
+
+cv::Mat atlas(const std::vector<cv::Mat> &sources
+              , const std::vector<Patch::list> &patches
+              , const PackOptions &options
+              , const cv::Scalar &background)
+{
+    if (sources.empty()) {
+        LOGTHROW(err1, Error) << "No source texture to compose atlas from.";
+    }
+
+    Patch::list all;
+    for (const auto &list : patches) {
+        all.insert(all.end(), list.begin(), list.end());
+    }
+    const auto size(pack(all, options));
+
+    cv::Mat result(size.height, size.width, sources.front().type());
+    result.setTo(background);
+    compose(result, sources, patches);
+    return result;
+}
+
+} } // namespace imgproc::tx
@@ -0,0 +1,85 @@
+/**
+ * Copyright (c) 2021 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file texturing-atlas.hpp
+ *
+ * Texture atlas composition: copies source pixels of packed texture patches
+ * into an atlas.
+ */
+
+#ifndef imgproc_texturing_atlas_hpp_included_
+#define imgproc_texturing_atlas_hpp_included_
+
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "texturing.hpp"
+
+namespace imgproc { namespace tx {
+
+/** Copies source pixels of all patches into atlas.
+ *
+ *  Destination rectangle of each patch is filled from its source rectangle
+ *  in the source image. Parts of the source rectangle outside the source
+ *  image (i.e. those removed by Patch::srcClip()) are filled by replicating
+ *  the nearest source pixel, therefore the border added by patch inflation
+ *  is always valid for interpolation. Patches are copied in parallel.
+ *
+ *  Atlas must be allocated and of the same type as source; pixels not
+ *  covered by any patch are left untouched. Destination rectangles must lie
+ *  inside the atlas and must not overlap (as produced by pack()).
+ *
+ *  @param atlas destination atlas
+ *  @param source source texture
+ *  @param patches placed patches
+ */
+void compose(cv::Mat &atlas, const cv::Mat &source
+             , const Patch::list &patches);
+
+/** Copies source pixels of all patches into atlas, multiple source
+ *  version: patches[i] are copied from sources[i].
+ */
+void compose(cv::Mat &atlas, const std::vector<cv::Mat> &sources
+             , const std::vector<Patch::list> &patches);
+
+/** Packs patches, creates atlas filled with background and copies source
+ *  pixels of all patches into it. Patches are placed as by pack().
+ *
+ *  @param sources source textures, all of the same type
+ *  @param patches patches to pack, patches[i] map into sources[i]
+ *  @param options packing options
+ *  @param background color of pixels not covered by any patch
+ *  @return texture atlas
+ */
+cv::Mat atlas(const std::vector<cv::Mat> &sources
+              , const std::vector<Patch::list> &patches
+              , const PackOptions &options = PackOptions()
+              , const cv::Scalar &background = cv::Scalar());
+
+} } // namespace imgproc::tx
+
+#endif // imgproc_texturing_atlas_hpp_included_
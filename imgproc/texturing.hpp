@@ -27,11 +27,14 @@
 #define imgproc_texturing_hpp_included_
 
 #include <vector>
+#include <cstddef>
 
 #include <boost/optional/optional_io.hpp>
 
 #include "math/geometry_core.hpp"
 
+#include "packing.hpp"
+
 namespace imgproc { namespace tx {
 
 /** Uv patch.
@@ -93,6 +96,12 @@ public:
     template <typename T>
     void map(T &x, T &y) const;
 
+    /** Maps source texturing coordinates to destination texturing coordinates.
+     *  Modifies count interleaved (u, v) pairs starting at uv in place.
+     */
+    template <typename T>
+    void map(T *uv, std::size_t count) const;
+
     math::Point2d imap(const math::Point2d &uv) const;
 
     /** Maps destination texturing coordinates to source texturing coordinates.
@@ -107,6 +116,12 @@ public:
     template <typename T>
     void imap(T &x, T &y) const;
 
+    /** Maps destination texturing coordinates to source texturing coordinates.
+     *  Modifies count interleaved (u, v) pairs starting at uv in place.
+     */
+    template <typename T>
+    void imap(T *uv, std::size_t count) const;
+
     /** Whole pixel rectangle circumscribed around subpixel patch.
      */
     struct Rect {
@@ -165,15 +180,27 @@ private:
     math::Point2 shift_;
 };
 
+using imgproc::PackAlgorithm;
+using imgproc::PackOptions;
+
 /** Packs texture patches.
  *  Returns size of resulting texture.
  *
  *  @param inflateFactor Specifies how much the atlas grows (in 1 dimension)
  *                       after every unsuccessful packing attempt.
  *  @param maxAllowed The maximum atlas size acceptable by the caller.
+ *  @param algorithm Packing algorithm.
  */
 math::Size2 pack(Patch::list &patches, float inflateFactor = 2.f,
-                 boost::optional<math::Size2i> maxAllowed = boost::none);
+                 boost::optional<math::Size2i> maxAllowed = boost::none,
+                 PackAlgorithm algorithm = PackAlgorithm::guillotine);
+
+/** Packs texture patches.
+ *  Returns size of resulting texture.
+ *
+ *  @param options Packing options.
+ */
+math::Size2 pack(Patch::list &patches, const PackOptions &options);
 
 /** Packs texture patches.
  *  Returns size of resulting texture.
@@ -185,7 +212,8 @@ math::Size2 pack(Patch::list &patches, float inflateFactor = 2.f,
  *  @param maxAllowed The maximum atlas size acceptable by the caller.
  */
 math::Size2 pack(const Patch::list &patches, float inflateFactor = 2.f,
-                 boost::optional<math::Size2i> maxAllowed = boost::none);
+                 boost::optional<math::Size2i> maxAllowed = boost::none,
+                 PackAlgorithm algorithm = PackAlgorithm::guillotine);
 
 /** Generate container.
  *  Function Patch* asPatch(*iterator) must exist.
@@ -196,7 +224,16 @@ math::Size2 pack(const Patch::list &patches, float inflateFactor = 2.f,
  */
 template <typename Iterator>
 math::Size2 pack(Iterator begin, Iterator end, float inflateFactor = 2.f,
-                 boost::optional<math::Size2i> maxAllowed = boost::none);
+                 boost::optional<math::Size2i> maxAllowed = boost::none,
+                 PackAlgorithm algorithm = PackAlgorithm::guillotine);
+
+/** Maps texturing coordinates in bulk. Modifies count interleaved (u, v)
+ *  pairs starting at uv in place, i-th pair is mapped by
+ *  patches[patchIndex[i]].
+ */
+template <typename T, typename Index>
+void map(const Patch::list &patches, const Index *patchIndex
+         , T *uv, std::size_t count);
 
 /** Default implementaion of asPatch for, well, patch itself.
  */
@@ -258,6 +295,16 @@ void Patch::map(T &x, T &y) const
     y += shift_(1);
 }
 
+template <typename T>
+void Patch::map(T *uv, std::size_t count) const
+{
+    const T sx(shift_(0)), sy(shift_(1));
+    for (auto *end(uv + 2 * count); uv != end; uv += 2) {
+        uv[0] += sx;
+        uv[1] += sy;
+    }
+}
+
 inline math::Point2d Patch::imap(const math::Point2d &uv) const
 {
     return { uv(0) - shift_(0), uv(1) - shift_(1) };
@@ -276,6 +323,16 @@ void Patch::imap(T &x, T &y) const
     y -= shift_(1);
 }
 
+template <typename T>
+void Patch::imap(T *uv, std::size_t count) const
+{
+    const T sx(shift_(0)), sy(shift_(1));
+    for (auto *end(uv + 2 * count); uv != end; uv += 2) {
+        uv[0] -= sx;
+        uv[1] -= sy;
+    }
+}
+
 inline void UvPatch::inflate(double size)
 {
     auto &self(static_cast<math::Extents2&>(*this));
@@ -304,21 +361,32 @@ template <typename T> void UvPatch::update(const math::Point2_<T> &point)
 }
 
 inline math::Size2 pack(const Patch::list &patches, float inflateFactor,
-                        boost::optional<math::Size2i> maxAllowed)
+                        boost::optional<math::Size2i> maxAllowed,
+                        PackAlgorithm algorithm)
 {
     auto copy(patches);
-    return pack(copy, inflateFactor, maxAllowed);
+    return pack(copy, inflateFactor, maxAllowed, algorithm);
 }
 
 template <typename Iterator>
 math::Size2 pack(Iterator begin, Iterator end, float inflateFactor,
-                 boost::optional<math::Size2i> maxAllowed)
+                 boost::optional<math::Size2i> maxAllowed,
+                 PackAlgorithm algorithm)
 {
     Patch::list patches;
     for (; begin != end; ++begin) {
         patches.push_back(asPatch(*begin));
     }
-    return pack(patches, inflateFactor, maxAllowed);
+    return pack(patches, inflateFactor, maxAllowed, algorithm);
+}
+
+template <typename T, typename Index>
+void map(const Patch::list &patches, const Index *patchIndex
+         , T *uv, std::size_t count)
+{
+    for (auto *end(uv + 2 * count); uv != end; uv += 2) {
+        patches[*patchIndex++]->map(uv[0], uv[1]);
+    }
 }
 
 inline Patch* asPatch(Patch &patch) { return &patch; }
@@ -23,22 +23,37 @@
  * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
  * POSSIBILITY OF SUCH DAMAGE.
  */
+/**
+ * @file tiff.cpp
+ *
+ * TIFF reader. Image data are read via libtiff directly (from file or from
+ * memory using TIFFClientOpen), tiles/strips are decoded in parallel (each
+ * thread uses its own TIFF handle) straight into the output matrix while
+ * applying the orientation transformation.
+ */
+
+#include <cstring>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <algorithm>
+
+#include <tiffio.h>
 
 #include "dbglog/dbglog.hpp"
 
-#include "tiff_io.hpp"
+#include "utility/openmp.hpp"
+
 #include "tiff.hpp"
 #include "error.hpp"
-#include "cvmat.hpp"
 
 namespace imgproc {
 
-namespace gil = boost::gil;
 namespace fs = boost::filesystem;
 
 namespace detail {
 
-typedef boost::shared_ptr<TIFF> Tiff;
+typedef std::shared_ptr<TIFF> Tiff;
 
 Tiff openTiff(const fs::path &path)
 {
@@ -51,21 +66,112 @@ Tiff openTiff(const fs::path &path)
     throw;
 }
 
+/** Read-only memory stream for TIFFClientOpen. Memory is mapped directly,
+ *  therefore no data are copied.
+ */
+struct MemoryStream {
+    const char *data;
+    toff_t size;
+    toff_t offset;
+
+    MemoryStream(const void *data, std::size_t size)
+        : data(static_cast<const char*>(data)), size(size), offset(0)
+    {}
+
+    static MemoryStream& self(thandle_t handle) {
+        return *static_cast<MemoryStream*>(handle);
+    }
+
+    static tmsize_t read(thandle_t handle, void *buf, tmsize_t size) {
+        auto &s(self(handle));
+        if ((size < 0) || (s.offset >= s.size)) { return 0; }
+        const auto count(std::min(toff_t(size), s.size - s.offset));
+        std::memcpy(buf, s.data + s.offset, count);
+        s.offset += count;
+        return count;
+    }
+
+    static tmsize_t write(thandle_t, void*, tmsize_t) { return -1; }
+
+    static toff_t seek(thandle_t handle, toff_t offset, int whence) {
+        auto &s(self(handle));
+        switch (whence) {
+        case SEEK_SET: s.offset = offset; break;
+        case SEEK_CUR: s.offset += offset; break;
+        case SEEK_END: s.offset = s.size + offset; break;
+        default: return toff_t(-1);
+        }
+        return s.offset;
+    }
+
+    static int close(thandle_t) { return 0; }
+
+    static toff_t sizeOf(thandle_t handle) { return self(handle).size; }
+
+    static int map(thandle_t handle, void **base, toff_t *size) {
+        auto &s(self(handle));
+        *base = const_cast<char*>(s.data);
+        *size = s.size;
+        return 1;
+    }
+
+    static void unmap(thandle_t, void*, toff_t) {}
+};
+
+Tiff openTiff(const void *data, std::size_t size)
+{
+    auto stream(std::make_shared<MemoryStream>(data, size));
+    if (auto t = TIFFClientOpen("<memory>", "r", stream.get()
+                                , &MemoryStream::read, &MemoryStream::write
+                                , &MemoryStream::seek, &MemoryStream::close
+                                , &MemoryStream::sizeOf
+                                , &MemoryStream::map, &MemoryStream::unmap))
+    {
+        // stream must outlive the handle
+        return Tiff(t, [stream](TIFF *t) { if (t) TIFFClose(t); });
+    }
+
+    LOGTHROW(err1, Error)
+        << "Cannot open TIFF from memory.";
+    throw;
+}
+
+/** How stored samples are converted to BGR pixels.
+ */
+enum class Conversion {
+    /** Samples decoded directly: gray or RGB(A), 8 or 16 bits per sample.
+     */
+    gray, minIsWhite, rgb,
+
+    /** Everything else: decoded by libtiff's RGBA interface to 8 bits per
+     *  sample.
+     */
+    rgba
+};
+
 struct ImageParams {
-    fs::path path;
+    std::string name;
 
     std::uint16_t bpp;
+    std::uint16_t spp;
     std::uint16_t orientation;
     std::uint32_t width;
     std::uint32_t height;
     bool tiled;
-
-    ImageParams(const fs::path &path)
-        : path(path), bpp(8), orientation(1), width(0), height(0)
-        , tiled(false)
+    std::uint32_t blockWidth;
+    std::uint32_t blockHeight;
+    bool jpegYCbCr;
+    Conversion conversion;
+
+    ImageParams(const std::string &name)
+        : name(name), bpp(8), spp(3), orientation(1), width(0), height(0)
+        , tiled(false), blockWidth(0), blockHeight(0), jpegYCbCr(false)
+        , conversion(Conversion::rgba)
     {}
 
     int cvType() const {
+        if (conversion == Conversion::rgba) { return CV_8UC3; }
+
         switch (bpp) {
         case 8: return CV_8UC3;
         case 16: return CV_16UC3;
@@ -73,7 +179,7 @@ struct ImageParams {
 
         LOGTHROW(err1, Error)
             << "Unsupported bit field " << bpp
-            << " in  TIFF file " << path << ".";
+            << " in  TIFF file " << name << ".";
         throw;
     }
 
@@ -89,17 +195,24 @@ struct ImageParams {
         return { int(height), int(width) };
     }
 
+    /** Prepares (per-thread) handle for decoding.
+     */
+    void prepare(TIFF *tiff) const {
+        if (jpegYCbCr) {
+            // let the JPEG codec convert YCbCr to RGB
+            TIFFSetField(tiff, TIFFTAG_JPEGCOLORMODE, JPEGCOLORMODE_RGB);
+        }
+    }
 };
 
-ImageParams getParams(const fs::path &path)
+ImageParams getParams(TIFF *tiff, const std::string &name)
 {
-    auto tiff(openTiff(path));
-    ImageParams params(path);
-    if (!TIFFGetField(tiff.get(), TIFFTAG_BITSPERSAMPLE, &params.bpp)) {
+    ImageParams params(name);
+    if (!TIFFGetField(tiff, TIFFTAG_BITSPERSAMPLE, &params.bpp)) {
         params.bpp = 8;
     }
 
-    if (!TIFFGetField(tiff.get(), TIFFTAG_ORIENTATION, &params.orientation)) {
+    if (!TIFFGetField(tiff, TIFFTAG_ORIENTATION, &params.orientation)) {
         params.orientation = 1;
     } else {
         switch (params.orientation) {
@@ -119,158 +232,288 @@ ImageParams getParams(const fs::path &path)
         }
     }
 
-    if (!TIFFGetField(tiff.get(), TIFFTAG_IMAGEWIDTH, &params.width)) {
+    if (!TIFFGetField(tiff, TIFFTAG_IMAGEWIDTH, &params.width)) {
         LOGTHROW(err1, Error)
-            << "Cannot get TIFF file " << path << " width.";
+            << "Cannot get TIFF file " << name << " width.";
     }
-    if (!TIFFGetField(tiff.get(), TIFFTAG_IMAGELENGTH, &params.height)) {
+    if (!TIFFGetField(tiff, TIFFTAG_IMAGELENGTH, &params.height)) {
         LOGTHROW(err1, Error)
-            << "Cannot get TIFF file " << path << " height.";
+            << "Cannot get TIFF file " << name << " height.";
+    }
+
+    params.tiled = TIFFIsTiled(tiff);
+    if (params.tiled) {
+        TIFFGetField(tiff, TIFFTAG_TILEWIDTH, &params.blockWidth);
+        TIFFGetField(tiff, TIFFTAG_TILELENGTH, &params.blockHeight);
+    } else {
+        params.blockWidth = params.width;
+        TIFFGetFieldDefaulted(tiff, TIFFTAG_ROWSPERSTRIP
+                              , &params.blockHeight);
+        params.blockHeight = std::min(params.blockHeight, params.height);
     }
 
-    std::uint32_t tileWidth;
-    params.tiled = TIFFGetField(tiff.get(), TIFFTAG_TILEWIDTH, &tileWidth);
+    std::uint16_t photometric(PHOTOMETRIC_RGB);
+    std::uint16_t planar(PLANARCONFIG_CONTIG);
+    std::uint16_t sampleFormat(SAMPLEFORMAT_UINT);
+    std::uint16_t compression(COMPRESSION_NONE);
+    TIFFGetFieldDefaulted(tiff, TIFFTAG_SAMPLESPERPIXEL, &params.spp);
+    TIFFGetField(tiff, TIFFTAG_PHOTOMETRIC, &photometric);
+    TIFFGetFieldDefaulted(tiff, TIFFTAG_PLANARCONFIG, &planar);
+    TIFFGetFieldDefaulted(tiff, TIFFTAG_SAMPLEFORMAT, &sampleFormat);
+    TIFFGetFieldDefaulted(tiff, TIFFTAG_COMPRESSION, &compression);
+
+    if ((photometric == PHOTOMETRIC_YCBCR)
+        && (compression == COMPRESSION_JPEG))
+    {
+        params.jpegYCbCr = true;
+        photometric = PHOTOMETRIC_RGB;
+    }
+
+    const bool direct((planar == PLANARCONFIG_CONTIG)
+                      && (sampleFormat == SAMPLEFORMAT_UINT)
+                      && ((params.bpp == 8) || (params.bpp == 16))
+                      && params.blockWidth && params.blockHeight);
+
+    if (direct && (params.spp >= 1)
+        && (photometric == PHOTOMETRIC_MINISBLACK))
+    {
+        params.conversion = Conversion::gray;
+    } else if (direct && (params.spp >= 1)
+               && (photometric == PHOTOMETRIC_MINISWHITE))
+    {
+        params.conversion = Conversion::minIsWhite;
+    } else if (direct && (params.spp >= 3)
+               && (photometric == PHOTOMETRIC_RGB))
+    {
+        params.conversion = Conversion::rgb;
+    } else {
+        params.conversion = Conversion::rgba;
+        params.jpegYCbCr = false;
+    }
 
     return params;
 }
 
-template <typename View>
-void loadTiled(const ImageParams &params, View view)
-{
-    switch (params.orientation) {
-    case ORIENTATION_TOPLEFT:
-    case ORIENTATION_TOPRIGHT:
-    case ORIENTATION_BOTRIGHT:
-    case ORIENTATION_BOTLEFT:
-        // correct
-        gil::tiff_read_and_convert_view(params.path.c_str(), view);
-        break;
+/** Maps stored image pixels to output matrix: stored pixel (x, y) is
+ *  written at origin + x * dx + y * dy.
+ */
+struct Layout {
+    uchar *origin;
+    std::ptrdiff_t dx;
+    std::ptrdiff_t dy;
+
+    Layout(cv::Mat &mat, const ImageParams &params) {
+        const std::ptrdiff_t px(mat.elemSize());
+        const std::ptrdiff_t row(mat.step[0]);
+        const std::ptrdiff_t w(params.width - 1);
+        const std::ptrdiff_t h(params.height - 1);
+
+        std::ptrdiff_t offset(0);
+        switch (params.orientation) {
+        case ORIENTATION_TOPLEFT:
+            offset = 0; dx = px; dy = row; break;
 
-    case ORIENTATION_LEFTTOP:
-        // correct
-        gil::tiff_read_and_convert_view
-            (params.path.c_str()
-             , gil::flipped_left_right_view(gil::rotated90cw_view(view)));
-        break;
+        case ORIENTATION_TOPRIGHT:
+            offset = w * px; dx = -px; dy = row; break;
 
-    case ORIENTATION_RIGHTTOP:
-        // read does left-right flip
-        gil::tiff_read_and_convert_view
-            (params.path.c_str()
-             , gil::flipped_left_right_view(gil::rotated90ccw_view(view)));
-        break;
+        case ORIENTATION_BOTRIGHT:
+            offset = w * px + h * row; dx = -px; dy = -row; break;
 
-    case ORIENTATION_RIGHTBOT:
-        // read does rot180
-        gil::tiff_read_and_convert_view
-            (params.path.c_str()
-             , gil::flipped_left_right_view(gil::rotated90cw_view(view)));
-        break;
+        case ORIENTATION_BOTLEFT:
+            offset = h * row; dx = px; dy = -row; break;
 
-    case ORIENTATION_LEFTBOT:
-        // read does up-down flip
-        gil::tiff_read_and_convert_view
-            (params.path.c_str()
-             , gil::flipped_up_down_view(gil::rotated90cw_view(view)));
-        break;
-    }
-}
+        case ORIENTATION_LEFTTOP:
+            // transposed
+            offset = 0; dx = row; dy = px; break;
 
-template <typename View>
-void loadStriped(const ImageParams &params, View view)
-{
-    switch (params.orientation) {
-    case ORIENTATION_TOPLEFT:
-        gil::tiff_read_and_convert_view(params.path.c_str(), view);
-        break;
+        case ORIENTATION_RIGHTTOP:
+            // rotated 90 degrees clockwise
+            offset = h * px; dx = row; dy = -px; break;
 
-    case ORIENTATION_TOPRIGHT:
-        gil::tiff_read_and_convert_view
-            (params.path.c_str()
-             , gil::flipped_left_right_view(view));
-        break;
+        case ORIENTATION_RIGHTBOT:
+            offset = h * px + w * row; dx = -row; dy = -px; break;
 
-    case ORIENTATION_BOTRIGHT:
-        gil::tiff_read_and_convert_view
-            (params.path.c_str(), rotated180_view(view));
-        break;
+        case ORIENTATION_LEFTBOT:
+            // rotated 90 degrees counterclockwise
+            offset = w * row; dx = -row; dy = px; break;
+        }
 
-    case ORIENTATION_BOTLEFT:
-        gil::tiff_read_and_convert_view
-            (params.path.c_str()
-             , gil::flipped_up_down_view(view));
-        break;
+        origin = mat.data + offset;
+    }
+
+    uchar* at(int x, int y) const { return origin + x * dx + y * dy; }
+};
 
-    case ORIENTATION_LEFTTOP:
-        gil::tiff_read_and_convert_view
-            (params.path.c_str()
-             , gil::flipped_left_right_view(gil::rotated90cw_view(view)));
+/** Converts count stored pixels to BGR pixels.
+ */
+template <typename T>
+void convert(const T *src, int count, int spp, Conversion conversion
+             , uchar *dst, std::ptrdiff_t dx)
+{
+    switch (conversion) {
+    case Conversion::gray:
+        for (int i(0); i < count; ++i, src += spp, dst += dx) {
+            auto *d(reinterpret_cast<T*>(dst));
+            d[0] = d[1] = d[2] = src[0];
+        }
         break;
 
-    case ORIENTATION_RIGHTTOP:
-        gil::tiff_read_and_convert_view
-            (params.path.c_str()
-             , gil::rotated90ccw_view(view));
+    case Conversion::minIsWhite:
+        for (int i(0); i < count; ++i, src += spp, dst += dx) {
+            auto *d(reinterpret_cast<T*>(dst));
+            d[0] = d[1] = d[2] = T(~src[0]);
+        }
         break;
 
-    case ORIENTATION_RIGHTBOT:
-        gil::tiff_read_and_convert_view
-            (params.path.c_str()
-             , gil::flipped_left_right_view(gil::rotated90ccw_view(view)));
+    case Conversion::rgb:
+        for (int i(0); i < count; ++i, src += spp, dst += dx) {
+            auto *d(reinterpret_cast<T*>(dst));
+            d[0] = src[2];
+            d[1] = src[1];
+            d[2] = src[0];
+        }
         break;
 
-    case ORIENTATION_LEFTBOT:
-        gil::tiff_read_and_convert_view
-            (params.path.c_str()
-             , gil::rotated90cw_view(view));
+    case Conversion::rgba:
         break;
     }
 }
 
-template <typename View>
-void load(const ImageParams &params, View view)
+/** Decodes all tiles/strips in parallel.
+ */
+template <typename T, typename Open>
+void loadDirect(const ImageParams &params, const Open &open, cv::Mat &mat)
 {
-    if (params.tiled) {
-        loadTiled(params, view);
-    } else {
-        loadStriped(params, view);
+    const Layout layout(mat, params);
+    const int width(params.width);
+    const int height(params.height);
+    const int bw(params.blockWidth);
+    const int bh(params.blockHeight);
+    const int across((width + bw - 1) / bw);
+    const int down((height + bh - 1) / bh);
+    const int blocks(across * down);
+
+    std::atomic<int> failed(-1);
+
+    UTILITY_OMP(parallel)
+    {
+        Tiff tiff;
+        try {
+            tiff = open();
+            params.prepare(tiff.get());
+        } catch (...) {}
+
+        const tmsize_t size(!tiff ? 0 : params.tiled
+                            ? TIFFTileSize(tiff.get())
+                            : TIFFStripSize(tiff.get()));
+        std::vector<T> buffer((size + sizeof(T) - 1) / sizeof(T));
+
+        UTILITY_OMP(for schedule(dynamic))
+        for (int block = 0; block < blocks; ++block) {
+            if (failed >= 0) { continue; }
+
+            const auto read(!tiff ? -1 : params.tiled
+                            ? TIFFReadEncodedTile(tiff.get(), block
+                                                  , buffer.data(), size)
+                            : TIFFReadEncodedStrip(tiff.get(), block
+                                                   , buffer.data(), size));
+            if (read < 0) {
+                failed = block;
+                continue;
+            }
+
+            const int x(bw * (block % across));
+            const int y(bh * (block / across));
+            const int cols(std::min(bw, width - x));
+            const int rows(std::min(bh, height - y));
+            const std::size_t stride(std::size_t(bw) * params.spp);
+
+            for (int j(0); j < rows; ++j) {
+                convert(buffer.data() + j * stride, cols, params.spp
+                        , params.conversion, layout.at(x, y + j), layout.dx);
+            }
+        }
     }
-}
 
-} // namespace detail;
+    if (failed >= 0) {
+        LOGTHROW(err1, Error)
+            << "Cannot decode " << (params.tiled ? "tile " : "strip ")
+            << failed << " of TIFF file " << params.name << ".";
+    }
+}
 
-cv::Mat readTiff(const void *data, std::size_t size)
+/** Decodes image via libtiff's RGBA interface (handles any photometric
+ *  interpretation and planar configuration supported by libtiff).
+ */
+void loadRgba(const ImageParams &params, TIFF *tiff, cv::Mat &mat)
 {
-    (void) data;
-    (void) size;
-    LOGTHROW(err3, Error)
-        << "Open TIFF from memory: not-implemented.";
-    throw;
+    const int width(params.width);
+    const int height(params.height);
+
+    // request stored orientation: rows come in the order they are stored
+    std::vector<std::uint32_t> raster(std::size_t(width) * height);
+    if (!TIFFReadRGBAImageOriented(tiff, width, height, raster.data()
+                                   , params.orientation, 1))
+    {
+        LOGTHROW(err1, Error)
+            << "Cannot decode TIFF file " << params.name << ".";
+    }
+
+    const Layout layout(mat, params);
+
+    UTILITY_OMP(parallel for)
+    for (int y = 0; y < height; ++y) {
+        const auto *src(raster.data() + std::size_t(y) * width);
+        auto *dst(layout.at(0, y));
+        for (int x(0); x < width; ++x, ++src, dst += layout.dx) {
+            dst[0] = TIFFGetB(*src);
+            dst[1] = TIFFGetG(*src);
+            dst[2] = TIFFGetR(*src);
+        }
+    }
 }
 
-cv::Mat readTiff(const fs::path &path)
+/** Reads image. Open creates new TIFF handle (one per decoding thread).
+ */
+template <typename Open>
+cv::Mat read(const Open &open, const std::string &name)
 {
-    const auto params(detail::getParams(path));
+    const auto tiff(open());
+    const auto params(getParams(tiff.get(), name));
     const auto dims(params.dims());
 
     cv::Mat img(dims.height, dims.width, params.cvType());
+    if (img.empty()) { return img; }
 
-    switch (params.bpp) {
-    case 8:
-        detail::load(params, imgproc::view<gil::bgr8_pixel_t>(img));
-        break;
-
-    case 16:
-        detail::load(params, imgproc::view<gil::bgr16_pixel_t>(img));
-        break;
+    if (params.conversion == Conversion::rgba) {
+        loadRgba(params, tiff.get(), img);
+    } else if (params.bpp == 8) {
+        loadDirect<std::uint8_t>(params, open, img);
+    } else {
+        loadDirect<std::uint16_t>(params, open, img);
     }
 
     return img;
 }
 
+} // namespace detail;
+
+cv::Mat readTiff(const void *data, std::size_t size)
+{
+    return detail::read([&]() { return detail::openTiff(data, size); }
+                        , "<memory>");
+}
+
+cv::Mat readTiff(const fs::path &path)
+{
+    return detail::read([&]() { return detail::openTiff(path); }
+                        , path.string());
+}
+
 math::Size2 tiffSize(const fs::path &path)
 {
-    return detail::getParams(path).dims();
+    return detail::getParams(detail::openTiff(path).get(), path.string())
+        .dims();
 }
 
 } // namespace imgproc
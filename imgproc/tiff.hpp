@@ -34,8 +34,16 @@
 
 namespace imgproc {
 
+/** Reads TIFF image from memory. Data are not copied.
+ *
+ *  Result is BGR, 8 or 16 bits per channel. Image orientation is applied.
+ */
 cv::Mat readTiff(const void *data, std::size_t size);
 
+/** Reads TIFF image from file.
+ *
+ *  Result is BGR, 8 or 16 bits per channel. Image orientation is applied.
+ */
 cv::Mat readTiff(const boost::filesystem::path &path);
 
 math::Size2 tiffSize(const boost::filesystem::path &path);
@@ -33,15 +33,21 @@
 #ifndef IMGPROC_TRANSFORMATION_HPP
 #define IMGPROC_TRANSFORMATION_HPP
 
+#include <cmath>
+#include <vector>
+#include <algorithm>
 #include <type_traits>
 
 #include "dbglog/dbglog.hpp"
 
+#include "utility/openmp.hpp"
+
 #include "math/math_all.hpp"
 #include "math/boost_gil_all.hpp"
 
 #include "filtering.hpp"
 #include "crop.hpp"
+#include "detail/resample.hpp"
 
 namespace imgproc {
 
@@ -53,7 +59,27 @@ namespace imgproc {
  *      math::Point2 map( const math::Point2i & op ) const;
  *      math::Point2 derivatives( const math::Point2i & op ) const;
  * };
+ *
+ * When used with ExecutionPolicy::parallel, map() and derivatives() are
+ * called concurrently from multiple threads and therefore must be
+ * thread-safe (e.g. a mapping wrapping a non-reentrant reprojection object
+ * must not be used in parallel mode).
+ */
+
+/** Execution policy of transform(), scale() and cropAndScale().
  */
+enum class ExecutionPolicy {
+    /** Whole transformation runs in the calling thread.
+     */
+    sequential,
+
+    /** Destination rows are processed in parallel (OpenMP). Mapping (see
+     *  Mapping2Concept) and LowPassFilter2 must be thread-safe. Output is
+     *  identical to sequential execution. Small destinations are still
+     *  processed sequentially.
+     */
+    parallel
+};
 
 /**
  * Scaling2 is a 2D scaling in pixel registration (pixel is area).
@@ -141,31 +167,141 @@ private:
     float offY_;
 };
 
+/** Approximation of an expensive Mapping2 (e.g. georeferenced reprojection)
+ *  by interpolation on a sparse grid; models Mapping2 concept itself.
+ *
+ *  Destination area is split into step x step cells. Mapping (source position
+ *  and derivatives) is evaluated exactly in cell corners and bilinearly
+ *  interpolated in between. If the interpolated source position differs from
+ *  the exact one by more than tolerance (in source pixels, checked in cell
+ *  center) the cell is subdivided (step halved) until error is within
+ *  tolerance or mapping is evaluated in every pixel of the cell.
+ *
+ *  Whole approximation is computed in constructor, wrapped mapping is not
+ *  referenced afterwards. Points outside destination area are extrapolated
+ *  from the nearest cell.
+ */
+template <typename Mapping2>
+class ApproximatedMapping2 {
+public:
+    ApproximatedMapping2(const Mapping2 &mapping, const math::Size2 &dstSize
+                         , double tolerance = 0.125, int step = 16);
+
+    math::Point2 map(const math::Point2i &op) const {
+        return interpolate(op, &Node::pos);
+    }
+
+    math::Point2 derivatives(const math::Point2i &op) const {
+        return interpolate(op, &Node::deriv);
+    }
+
+    /** Number of exact mapping evaluations needed to build approximation.
+     */
+    std::size_t evaluations() const { return evaluations_; }
+
+private:
+    struct Node {
+        math::Point2 pos;
+        math::Point2 deriv;
+    };
+
+    /** Cell: grid of (nx + 1) * (ny + 1) nodes with given spacing, last
+     *  node in each direction is clipped to cell size.
+     */
+    struct Cell {
+        int x0, y0;
+        int width, height;
+        int step;
+        int nx, ny;
+        std::size_t offset;
+    };
+
+    /** Builds cell nodes with given step. Returns false (and drops nodes) if
+     *  approximation error exceeds tolerance.
+     */
+    bool build(Cell &cell, int step, const Mapping2 &mapping);
+
+    Node evaluate(const Mapping2 &mapping, int x, int y) {
+        ++evaluations_;
+        const math::Point2i p(x, y);
+        return { mapping.map(p), mapping.derivatives(p) };
+    }
+
+    template <typename Member>
+    math::Point2 interpolate(const math::Point2i &op, Member member) const;
+
+    template <typename Member>
+    math::Point2 interpolate(const Cell &cell, int x, int y
+                             , Member member) const;
+
+    double tolerance_;
+    int step_;
+    int cellsX_, cellsY_;
+    std::vector<Cell> cells_;
+    std::vector<Node> nodes_;
+    std::size_t evaluations_;
+};
+
+/** Helper to create approximated mapping, e.g.:
+ *
+ *      transform(approximate(mapping, dstSize), srcView, dstView);
+ */
+template <typename Mapping2>
+ApproximatedMapping2<Mapping2>
+approximate(const Mapping2 &mapping, const math::Size2 &dstSize
+            , double tolerance = 0.125, int step = 16);
+
 typedef math::SincHamming2 DefaultFilter;
 
+/** Axis-aligned mapping trait. Mapping is axis-aligned if it has constant
+ *  derivatives and source x (y) depends only on destination x (y).
+ *
+ *  transform() uses separable resampling (weights precomputed per row and
+ *  column) for axis-aligned mappings when the filter is separable. Specialize
+ *  for your own mapping to enable it.
+ */
+template <typename Mapping2>
+struct AxisAligned : std::false_type {};
+
+template <> struct AxisAligned<Scaling2> : std::true_type {};
+template <> struct AxisAligned<GridScaling2> : std::true_type {};
+template <> struct AxisAligned<ReverseCroppingAndScaling2>
+    : std::true_type {};
+
 /*
  * Transform between two views using a generic reverse mapping function
+ *
+ * Axis-aligned mappings (see AxisAligned) with a separable filter are
+ * resampled in two passes using precomputed filter weights; the result is the
+ * same as per-pixel reconstruction up to single precision rounding.
+ *
+ * Runs sequentially unless ExecutionPolicy::parallel is given (see
+ * ExecutionPolicy for thread-safety requirements).
  */
 template <typename LowPassFilter2, typename Mapping2
           , typename SrcView, typename DstView>
 inline void transform(
         const Mapping2 & mapping,
-        const SrcView & view1, const DstView & view2 );
+        const SrcView & view1, const DstView & view2,
+        ExecutionPolicy policy = ExecutionPolicy::sequential );
 
 /** Same as above, use DefaultFilter.
  */
 template <typename Mapping2, typename SrcView, typename DstView>
 inline void transform(
         const Mapping2 & mapping,
-        const SrcView & view1, const DstView & view2 );
+        const SrcView & view1, const DstView & view2,
+        ExecutionPolicy policy = ExecutionPolicy::sequential );
 
 template <typename LowPassFilter2, typename SrcView, typename DstView>
-inline void scale(const SrcView & view1, const DstView & view2);
+inline void scale(const SrcView & view1, const DstView & view2
+                  , ExecutionPolicy policy = ExecutionPolicy::sequential);
 
 /** Same as above, use DefaultFilter.
  */
 template <typename SrcView, typename DstView>
-inline void scale(const SrcView &view1, const DstView &view2);
+inline void scale(const SrcView &view1, const DstView &view2
+                  , ExecutionPolicy policy = ExecutionPolicy::sequential);
 
 /** Crop area from src and scale it to fit to dstview.
  *
@@ -175,11 +311,14 @@ inline void scale(const SrcView &view1, const DstView &view2);
  *  \param view1 source view
  *  \param view2 destination view
  *  \param srcCrop crop area from view1
+ *  \param policy execution policy
  */
 template <typename LowPassFilter2, typename SrcView, typename DstView
           , typename T>
 inline void cropAndScale(const SrcView &view1, const DstView &view2
-                         , const imgproc::Crop2_<T> &srcCrop);
+                         , const imgproc::Crop2_<T> &srcCrop
+                         , ExecutionPolicy policy
+                         = ExecutionPolicy::sequential);
 
 /** Crop area from src and scale it to fit to dstview. Used default low pass
  * filter.
@@ -187,21 +326,175 @@ inline void cropAndScale(const SrcView &view1, const DstView &view2
  *  \param view1 source view
  *  \param view2 destination view
  *  \param srcCrop crop area from view1
+ *  \param policy execution policy
  */
 template <typename SrcView, typename DstView, typename T>
 inline void cropAndScale(const SrcView &view1, const DstView &view2
-                         , const imgproc::Crop2_<T> &srcCrop);
+                         , const imgproc::Crop2_<T> &srcCrop
+                         , ExecutionPolicy policy
+                         = ExecutionPolicy::sequential);
 
 /* implementation */
 
+template <typename Mapping2>
+ApproximatedMapping2<Mapping2>
+::ApproximatedMapping2(const Mapping2 &mapping, const math::Size2 &dstSize
+                       , double tolerance, int step)
+    : tolerance_(tolerance), step_(std::max(step, 1))
+    , cellsX_(std::max(1, (dstSize.width - 1 + step_ - 1) / step_))
+    , cellsY_(std::max(1, (dstSize.height - 1 + step_ - 1) / step_))
+    , evaluations_()
+{
+    cells_.reserve(cellsX_ * cellsY_);
+    for (int cy(0); cy < cellsY_; ++cy) {
+        for (int cx(0); cx < cellsX_; ++cx) {
+            Cell cell;
+            cell.x0 = cx * step_;
+            cell.y0 = cy * step_;
+            cell.width = std::max(0, std::min(step_, dstSize.width - 1
+                                              - cell.x0));
+            cell.height = std::max(0, std::min(step_, dstSize.height - 1
+                                               - cell.y0));
+
+            // refine until precise enough; step 1 is exact
+            for (int s(step_); !build(cell, s, mapping); s = (s + 1) / 2) {}
+            cells_.push_back(cell);
+        }
+    }
+}
+
+template <typename Mapping2>
+bool ApproximatedMapping2<Mapping2>::build(Cell &cell, int step
+                                           , const Mapping2 &mapping)
+{
+    cell.step = step;
+    cell.nx = (cell.width + step - 1) / step;
+    cell.ny = (cell.height + step - 1) / step;
+    cell.offset = nodes_.size();
+
+    const auto coord([&](int origin, int size, int i) {
+        return origin + std::min(i * step, size);
+    });
+
+    for (int j(0); j <= cell.ny; ++j) {
+        for (int i(0); i <= cell.nx; ++i) {
+            nodes_.push_back(evaluate(mapping
+                                      , coord(cell.x0, cell.width, i)
+                                      , coord(cell.y0, cell.height, j)));
+        }
+    }
+
+    if (step == 1) { return true; }
+
+    // check centers of all sub-cells
+    for (int j(0); j < std::max(cell.ny, 1); ++j) {
+        const int ya(coord(cell.y0, cell.height, j));
+        const int y(ya + (coord(cell.y0, cell.height, j + 1) - ya) / 2);
+        for (int i(0); i < std::max(cell.nx, 1); ++i) {
+            const int xa(coord(cell.x0, cell.width, i));
+            const int x(xa + (coord(cell.x0, cell.width, i + 1) - xa) / 2);
+
+            const auto exact(mapping.map(math::Point2i(x, y)));
+            ++evaluations_;
+            const auto approx(interpolate(cell, x, y, &Node::pos));
+            if ((std::abs(exact(0) - approx(0)) > tolerance_)
+                || (std::abs(exact(1) - approx(1)) > tolerance_))
+            {
+                nodes_.resize(cell.offset);
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+template <typename Mapping2>
+template <typename Member>
+math::Point2 ApproximatedMapping2<Mapping2>
+::interpolate(const math::Point2i &op, Member member) const
+{
+    const int cx(std::min(std::max(op(0), 0) / step_, cellsX_ - 1));
+    const int cy(std::min(std::max(op(1), 0) / step_, cellsY_ - 1));
+    return interpolate(cells_[cy * cellsX_ + cx], op(0), op(1), member);
+}
+
+template <typename Mapping2>
+template <typename Member>
+math::Point2 ApproximatedMapping2<Mapping2>
+::interpolate(const Cell &cell, int x, int y, Member member) const
+{
+    // node interval and position inside it
+    const auto locate([&](int v, int origin, int size, int n
+                          , int &i0, int &i1, double &t)
+    {
+        i0 = std::min(std::max((v - origin) / cell.step, 0)
+                      , std::max(n - 1, 0));
+        i1 = std::min(i0 + 1, n);
+        const int a(origin + i0 * cell.step);
+        const int b(origin + std::min(i1 * cell.step, size));
+        t = (b > a) ? double(v - a) / (b - a) : 0.0;
+    });
+
+    int i0, i1, j0, j1;
+    double tx, ty;
+    locate(x, cell.x0, cell.width, cell.nx, i0, i1, tx);
+    locate(y, cell.y0, cell.height, cell.ny, j0, j1, ty);
+
+    const auto *nodes(&nodes_[cell.offset]);
+    const int row(cell.nx + 1);
+    const auto &n00(nodes[j0 * row + i0].*member);
+    const auto &n10(nodes[j0 * row + i1].*member);
+    const auto &n01(nodes[j1 * row + i0].*member);
+    const auto &n11(nodes[j1 * row + i1].*member);
+
+    const auto lerp([&](int c) {
+        return ((1.0 - ty) * ((1.0 - tx) * n00(c) + tx * n10(c))
+                + ty * ((1.0 - tx) * n01(c) + tx * n11(c)));
+    });
+    return math::Point2(lerp(0), lerp(1));
+}
+
+template <typename Mapping2>
+ApproximatedMapping2<Mapping2>
+approximate(const Mapping2 &mapping, const math::Size2 &dstSize
+            , double tolerance, int step)
+{
+    return ApproximatedMapping2<Mapping2>(mapping, dstSize, tolerance, step);
+}
+
+namespace detail {
+
+/** Number of destination rows processed by one task of the separable path.
+ */
+constexpr int TransformBand(64);
+
+/** Do not spawn threads for destinations smaller than this (in pixels).
+ */
+constexpr long TransformParallelThreshold(1 << 14);
+
+template <typename DstView>
+inline bool parallelTransform(const DstView &view, ExecutionPolicy policy)
+{
+    return ((policy == ExecutionPolicy::parallel)
+            && ((long(view.width()) * view.height())
+                >= TransformParallelThreshold));
+}
+
 template <typename LowPassFilter2, typename Mapping2
           , typename SrcView, typename DstView>
 inline void transform(
         const Mapping2 & mapping,
         const SrcView & view1,
-        const DstView & view2 ) {
+        const DstView & view2, std::false_type,
+        ExecutionPolicy policy ) {
 
-    for ( int i = 0, ei(view2.height()); i < ei; i++ ) {
+    // every pixel is computed independently -> output does not depend on
+    // scheduling
+    const int height(view2.height());
+    UTILITY_OMP(parallel for schedule(dynamic, 4)
+                if(parallelTransform(view2, policy)))
+    for ( int i = 0; i < height; i++ ) {
 
         typename DstView::x_iterator dstit = view2.row_begin( i );
 
@@ -221,47 +514,106 @@ inline void transform(
     }
 }
 
+template <typename LowPassFilter2, typename Mapping2
+          , typename SrcView, typename DstView>
+inline void transform(const Mapping2 &mapping, const SrcView &view1
+                      , const DstView &view2, std::true_type
+                      , ExecutionPolicy policy)
+{
+    // constant derivatives -> the same filter for all pixels
+    const math::Point2 deriv(mapping.derivatives(math::Point2i(0, 0)));
+    const LowPassFilter2 filter(std::max(2.0, 2.0 * deriv(0))
+                                , std::max(2.0, 2.0 * deriv(1)));
+
+    if (!separable(filter)) {
+        return transform<LowPassFilter2>(mapping, view1, view2
+                                         , std::false_type(), policy);
+    }
+
+    // f(x, y) = f(x, 0) * f(0, y) / f(0, 0)
+    const double center(filter(0.0, 0.0));
+
+    const auto x(resample::axis
+                 (view2.width(), view1.width(), filter.halfwinx()
+                  , [&](int j) { return mapping.map(math::Point2i(j, 0))(0); }
+                  , [&](double t) { return filter(t, 0.0); }));
+    const auto y(resample::axis
+                 (view2.height(), view1.height(), filter.halfwiny()
+                  , [&](int i) { return mapping.map(math::Point2i(0, i))(1); }
+                  , [&](double t) { return filter(0.0, t) / center; }));
+
+    // each band has its own row buffer; rows at band boundaries are filtered
+    // horizontally by both bands
+    const int height(view2.height());
+    const int bands((height + TransformBand - 1) / TransformBand);
+    UTILITY_OMP(parallel for schedule(dynamic)
+                if(parallelTransform(view2, policy)))
+    for (int b = 0; b < bands; ++b) {
+        resample::resample(view1, view2, x, y, b * TransformBand
+                           , std::min(height, (b + 1) * TransformBand));
+    }
+}
+
+} // namespace detail
+
+template <typename LowPassFilter2, typename Mapping2
+          , typename SrcView, typename DstView>
+inline void transform(
+        const Mapping2 & mapping,
+        const SrcView & view1,
+        const DstView & view2,
+        ExecutionPolicy policy )
+{
+    detail::transform<LowPassFilter2>
+        (mapping, view1, view2, AxisAligned<Mapping2>(), policy);
+}
+
 template <typename Mapping2, typename SrcView, typename DstView>
 inline void transform(
         const Mapping2 & mapping,
-        const SrcView & view1, const DstView & view2 )
+        const SrcView & view1, const DstView & view2,
+        ExecutionPolicy policy )
 {
-    return transform<DefaultFilter>(mapping, view1, view2);
+    return transform<DefaultFilter>(mapping, view1, view2, policy);
 }
 
 template <typename LowPassFilter2, typename SrcView, typename DstView>
-inline void scale(const SrcView & view1, const DstView & view2)
+inline void scale(const SrcView & view1, const DstView & view2
+                  , ExecutionPolicy policy)
 {
     Scaling2 scaling( math::Size2( view2.width(), view2.height() ),
               math::Size2( view1.width(), view1.height() ) );
 
-    transform<LowPassFilter2>(scaling, view1, view2);
+    transform<LowPassFilter2>(scaling, view1, view2, policy);
 }
 
 template <typename SrcView, typename DstView>
-inline void scale(const SrcView &view1, const DstView &view2)
+inline void scale(const SrcView &view1, const DstView &view2
+                  , ExecutionPolicy policy)
 {
-    return scale<DefaultFilter>(view1, view2);
+    return scale<DefaultFilter>(view1, view2, policy);
 }
 
 template <typename LowPassFilter2, typename SrcView, typename DstView
           , typename T>
 inline void cropAndScale(const SrcView & view1, const DstView &view2
-                         , const imgproc::Crop2_<T> &srcCrop)
+                         , const imgproc::Crop2_<T> &srcCrop
+                         , ExecutionPolicy policy)
 {
     // since transform traverses destination view and maps coordinates to src
     // viewport we must create reverse mapping
 
     ReverseCroppingAndScaling2
         op(srcCrop, math::Size2(view2.width(), view2.height()));
-    transform<LowPassFilter2>(op, view1, view2);
+    transform<LowPassFilter2>(op, view1, view2, policy);
 }
 
 template <typename SrcView, typename DstView, typename T>
 inline void cropAndScale(const SrcView &view1, const DstView &view2
-                         , const imgproc::Crop2_<T> &srcCrop)
+                         , const imgproc::Crop2_<T> &srcCrop
+                         , ExecutionPolicy policy)
 {
-    return cropAndScale<DefaultFilter>(view1, view2, srcCrop);
+    return cropAndScale<DefaultFilter>(view1, view2, srcCrop, policy);
 }
 
 } // namespace imgproc
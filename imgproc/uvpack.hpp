@@ -28,6 +28,8 @@
 
 #include <opencv2/core/core.hpp>
 
+#include "packing.hpp"
+
 namespace imgproc {
 
 typedef cv::Point2f UVCoord;
@@ -96,12 +98,11 @@ struct UVRect
 
 
 /// Calculates a (not necessarily optimal) packing of small rectangles into one
-/// big rectangle (texture). The class maintains a list of free areas (initially
-/// the whole rectangle) and each new rectangle uses one of the free rectangles,
-/// splitting the remaining space into two new parts and the process repeats.
-/// The rectangles are collected first with addRect() and later sorted by size
-/// and packed (starting with the largest) using the method pack(). If the rect-
-/// angles don't fit, the total pack area is doubled repeatedly until they do.
+/// big rectangle (texture). The rectangles are collected first with addRect()
+/// and later packed using the method pack(), see packRectangles() in
+/// packing.hpp for the available algorithms. By default, rectangles are sorted
+/// by size and packed (starting with the largest) into a guillotine tree; if
+/// they don't fit, the total pack area is doubled repeatedly until they do.
 ///
 class RectPacker
 {
@@ -114,32 +115,13 @@ public:
         { list.push_back(rect); }
 
     /// Pack the rectangles, updating their packX and packY
-    void pack();
+    void pack(const PackOptions &options = PackOptions());
 
     int width() const { return packWidth; }
     int height() const { return packHeight; }
 
 protected:
 
-    struct Node
-    {
-        UVRect* rect; ///< nonzero means regular node, 0 means leaf (unallocated)
-        int x, y, width, height; ///< this node position and size
-        int remaining; ///< space remaining in this node and its subtree
-        Node* son[2]; ///< son[0] is space below, son[1] is space to the right
-
-        Node(int x, int y, int w, int h)
-            : rect(0), x(x), y(y), width(w), height(h), remaining(w*h)
-            { son[0] = son[1] = 0; }
-
-        ~Node() {
-            if (son[0]) delete son[0];
-            if (son[1]) delete son[1];
-        }
-
-        Node* findSpace(int rw, int rh); ///< find leaf large enough
-    };
-
     int packWidth, packHeight;
     std::vector<UVRect*> list;
 };